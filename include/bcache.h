@@ -0,0 +1,53 @@
+// include/bcache.h — shared block cache with background writeback
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * 4 KiB blocks of backing image files, keyed by (image path, block number).
+ * Most callers go through diskio (diskio_pread_cached/diskio_pwrite_cached,
+ * diskio_sync) rather than using this directly.
+ *
+ * Writes made with bcache_write() stay dirty in memory and are written back,
+ * sorted by block and merged into contiguous runs, by a flusher thread when
+ *   - an image's oldest dirty block is BCACHE_EXPIRE_MS old, or
+ *   - dirty data exceeds BCACHE_DIRTY_BG bytes;
+ * inline by the writer itself once dirty data exceeds BCACHE_DIRTY_MAX
+ * (so bulk writes are throttled to device speed); and on bcache_sync(),
+ * which fsync/syncfs/umount/`sync` use. Everything left is flushed at exit.
+ */
+
+#ifndef BCACHE_MAX_BYTES
+#define BCACHE_MAX_BYTES  (32u << 20)   /* clean + dirty */
+#endif
+#ifndef BCACHE_DIRTY_BG
+#define BCACHE_DIRTY_BG   (4u << 20)    /* wake the flusher */
+#endif
+#ifndef BCACHE_DIRTY_MAX
+#define BCACHE_DIRTY_MAX  (16u << 20)   /* writers flush inline */
+#endif
+#ifndef BCACHE_EXPIRE_MS
+#define BCACHE_EXPIRE_MS  3000u
+#endif
+#define BCACHE_BLOCK      4096u
+
+typedef struct bcache_stats {
+    uint64_t blocks, dirty_blocks;      /* currently cached */
+    uint64_t hits, misses;              /* cached reads, per block */
+    uint64_t flushes;                   /* image flushes (any trigger) */
+    uint64_t runs, blocks_written;      /* pwrites issued / blocks they covered */
+    uint64_t throttled;                 /* writers that had to flush inline */
+} bcache_stats_t;
+
+bool bcache_read (const char *path, uint64_t off, void *dst, uint32_t len);
+bool bcache_write(const char *path, uint64_t off, const void *src, uint32_t len);
+
+/* Keep uncached readers and write-through writers coherent with the cache. */
+void bcache_overlay(const char *path, uint64_t off, void *dst, size_t len);
+void bcache_update (const char *path, uint64_t off, const void *src, size_t len);
+
+int  bcache_sync(const char *path);     /* NULL: every image; 0 or -EIO */
+void bcache_invalidate(const char *path, uint64_t off, uint64_t len);
+int  bcache_release(const char *path);  /* sync, then drop the image's blocks and entry */
+void bcache_get_stats(bcache_stats_t *out);
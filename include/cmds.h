@@ -39,6 +39,7 @@ int cmd_mkdir(int argc, char **argv);
 int cmd_cp(int argc, char **argv);
 int cmd_mount(int argc, char **argv);
 int cmd_mkfs_ext2(int argc, char **argv);
+int cmd_fsck_ext2(int argc, char **argv);
 int cmd_cd(int argc, char **argv);
 int cmd_cat(int argc, char **argv);
 int cmd_debug(int, char**);
@@ -49,5 +50,10 @@ int cmd_mkfs_ntfs(int argc, char **argv);
 int cmd_partscan(int argc, char **argv);
 int cmd_version(int argc, char **argv);
 int cmd_lls(int argc, char **argv);
+int cmd_populate(int argc, char **argv);
 int cmd_lcat(int argc, char **argv);
-int cmd_stat(int argc, char **argv);
\ No newline at end of file
+int cmd_stat(int argc, char **argv);
+int cmd_stress(int argc, char **argv);
+int cmd_sync(int argc, char **argv);
+int cmd_vfsstat(int argc, char **argv);
+int cmd_holes(int argc, char **argv);
\ No newline at end of file
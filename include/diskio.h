@@ -16,4 +16,38 @@ const char *diskio_resolve     (const char *devkey);
 bool diskio_pread (const char *devkey, uint64_t off, void *dst, uint32_t len);
 bool diskio_pwrite(const char *devkey, uint64_t off, const void *src, uint32_t len);
 
+/* Through the shared block cache (bcache.h): writes are write-back and reach
+   the image when the flusher runs or on diskio_sync(). The plain calls above
+   stay write-through and see/update cached blocks. */
+bool diskio_pread_cached (const char *devkey, uint64_t off, void *dst, uint32_t len);
+bool diskio_pwrite_cached(const char *devkey, uint64_t off, const void *src, uint32_t len);
+int  diskio_sync(const char *devkey);   /* NULL: every image; 0 or -errno */
+
 uint64_t diskio_size_bytes(const char *devkey);
+
+/* Map [off, off+len) of a backing image read-only (shared mmap). Returns a
+   pointer to byte 'off', or NULL when the range is outside the image or the
+   host can't map it; undo with diskio_unmap_range(addr, len). */
+const void *diskio_map_range  (const char *devkey, uint64_t off, size_t len);
+void        diskio_unmap_range(const void *addr, size_t len);
+
+/* Copy a byte range between (or within) backing images without bouncing it
+   through the caller: reflink (FICLONERANGE) when the host fs can share
+   blocks, else copy_file_range(2), else a large-buffer copy. Overlapping
+   ranges of one image are rejected. */
+typedef enum {
+    DISKIO_COPY_BUFFERED = 0,
+    DISKIO_COPY_KERNEL,         /* copy_file_range(2) */
+    DISKIO_COPY_CLONE           /* FICLONERANGE reflink */
+} diskio_copy_how_t;
+
+bool diskio_copy_range(const char *src_key, uint64_t src_off,
+                       const char *dst_key, uint64_t dst_off,
+                       uint64_t len, diskio_copy_how_t *how_out);
+
+/* Make [off, off+len) of a backing image read as zeros. discard only
+   deallocates it (punches a hole) and fails when the host can't, which
+   leaves the range as it was; zero_range then falls back to an in-kernel
+   zeroing or to writing zeros. Write-through; cached blocks are dropped. */
+bool diskio_discard   (const char *devkey, uint64_t off, uint64_t len);
+bool diskio_zero_range(const char *devkey, uint64_t off, uint64_t len);
@@ -2,6 +2,8 @@
 #pragma once
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 /* ---- packing helper ---- */
 #if defined(__GNUC__) || defined(__clang__)
@@ -11,7 +13,7 @@
   #define PACKED
 #endif
 
-/* ---- superblock (only fields we use) ---- */
+/* ---- superblock (rev 1 layout; 1024 bytes at byte 1024 of the fs) ---- */
 typedef struct PACKED {
     uint32_t s_inodes_count;
     uint32_t s_blocks_count;
@@ -24,10 +26,56 @@ typedef struct PACKED {
     uint32_t s_blocks_per_group;
     uint32_t s_frags_per_group;
     uint32_t s_inodes_per_group;
-    /* ... many more fields in real ext2; omitted for now ... */
+    uint32_t s_mtime;
+    uint32_t s_wtime;
+    uint16_t s_mnt_count;
+    uint16_t s_max_mnt_count;
+    uint16_t s_magic;               // EXT2_SUPER_MAGIC
+    uint16_t s_state;
+    uint16_t s_errors;
+    uint16_t s_minor_rev_level;
+    uint32_t s_lastcheck;
+    uint32_t s_checkinterval;
+    uint32_t s_creator_os;
+    uint32_t s_rev_level;           // 0 = good old, 1 = dynamic
+    uint16_t s_def_resuid;
+    uint16_t s_def_resgid;
+    /* rev 1 (dynamic) */
+    uint32_t s_first_ino;
+    uint16_t s_inode_size;
+    uint16_t s_block_group_nr;
+    uint32_t s_feature_compat;
+    uint32_t s_feature_incompat;
+    uint32_t s_feature_ro_compat;
+    uint8_t  s_uuid[16];
+    char     s_volume_name[16];
+    char     s_last_mounted[64];
+    uint32_t s_algo_bitmap;
+    uint8_t  s_prealloc_blocks;
+    uint8_t  s_prealloc_dir_blocks;
+    uint16_t s_reserved_gdt_blocks;
+    uint8_t  s_journal_uuid[16];
+    uint32_t s_journal_inum;
+    uint32_t s_journal_dev;
+    uint32_t s_last_orphan;
+    uint32_t s_hash_seed[4];        // dir_index htree
+    uint8_t  s_def_hash_version;
+    uint8_t  s_jnl_backup_type;
+    uint16_t s_desc_size;           // 64bit feature: group descriptor size
+    uint32_t s_default_mount_opts;
+    uint32_t s_first_meta_bg;
+    uint32_t s_mkfs_time;
+    uint32_t s_jnl_blocks[17];
+    uint32_t s_blocks_count_hi;     // 64bit feature
+    uint32_t s_r_blocks_count_hi;
+    uint32_t s_free_blocks_count_hi;
+    uint16_t s_min_extra_isize;
+    uint16_t s_want_extra_isize;
+    uint32_t s_flags;
+    uint8_t  s_reserved[1024 - 0x164];
 } ext2_superblock;
 
-/* ---- group descriptor (only fields we use) ---- */
+/* ---- group descriptor (32 bytes; the tail is ext4's but harmless) ---- */
 typedef struct PACKED {
     uint32_t bg_block_bitmap;   // block number of block bitmap
     uint32_t bg_inode_bitmap;   // block number of inode bitmap
@@ -35,11 +83,15 @@ typedef struct PACKED {
     uint16_t bg_free_blocks_count;
     uint16_t bg_free_inodes_count;
     uint16_t bg_used_dirs_count;
-    uint16_t bg_pad;
-    uint32_t bg_reserved[3];
+    uint16_t bg_flags;          // EXT2_BG_* (was padding in ext2)
+    uint32_t bg_exclude_bitmap;
+    uint16_t bg_block_bitmap_csum;
+    uint16_t bg_inode_bitmap_csum;
+    uint16_t bg_itable_unused;
+    uint16_t bg_checksum;
 } ext2_group_desc;
 
-/* ---- inode (only fields we use) ---- */
+/* ---- inode (the 128-byte rev 0 part; s_inode_size may be larger) ---- */
 typedef struct PACKED {
     uint16_t i_mode;
     uint16_t i_uid;
@@ -50,13 +102,13 @@ typedef struct PACKED {
     uint32_t i_dtime;
     uint16_t i_gid;
     uint16_t i_links_count;
-    uint32_t i_blocks;
+    uint32_t i_blocks;      // 512-byte sectors
     uint32_t i_flags;
     uint32_t i_osd1;
     uint32_t i_block[15];   // direct[0..11], single, double, triple
     uint32_t i_generation;
     uint32_t i_file_acl;
-    uint32_t i_dir_acl;
+    uint32_t i_dir_acl;     // regular files: i_size_high (large_file)
     uint32_t i_faddr;
     uint8_t  i_osd2[12];
 } ext2_inode;
@@ -70,18 +122,166 @@ typedef struct PACKED {
     char     name[];      // not NUL-terminated
 } ext2_dirent;
 
+/* ---- htree (dir_index): block 0 of an indexed directory holds "." and
+   ".." (the latter spanning the block), then the root info and the first
+   count/limit header; interior index blocks start with an empty dirent
+   spanning the block, then count/limit. Each header overlays the hash of
+   entry 0, whose hash is implicitly 0. ---- */
+typedef struct PACKED {
+    uint32_t reserved_zero;
+    uint8_t  hash_version;      // EXT2_DX_HASH_*
+    uint8_t  info_length;       // 8
+    uint8_t  indirect_levels;
+    uint8_t  unused_flags;
+} ext2_dx_root_info;
+
+typedef struct PACKED {
+    uint16_t limit;             // entries that fit in this block
+    uint16_t count;             // entries in use, including entry 0
+} ext2_dx_countlimit;
+
+typedef struct PACKED {
+    uint32_t hash;              // low bit: continues a collision chain
+    uint32_t block;             // logical block within the directory
+} ext2_dx_entry;
+
+/* ---- ext4 extent tree: i_block[] of an inode with EXT4_EXTENTS_FL holds a
+   header and up to 4 entries; deeper nodes are whole blocks laid out the
+   same way. Entries are index entries above depth 0, extents at it. ---- */
+typedef struct PACKED {
+    uint16_t eh_magic;          // EXT4_EXT_MAGIC
+    uint16_t eh_entries;
+    uint16_t eh_max;            // entries that fit in this node
+    uint16_t eh_depth;          // 0: entries are extents
+    uint32_t eh_generation;
+} ext4_extent_header;
+
+typedef struct PACKED {
+    uint32_t ee_block;          // first logical block
+    uint16_t ee_len;            // > EXT4_EXT_INIT_MAX_LEN: uninitialized
+    uint16_t ee_start_hi;
+    uint32_t ee_start_lo;       // first physical block
+} ext4_extent;
+
+typedef struct PACKED {
+    uint32_t ei_block;          // first logical block under this node
+    uint32_t ei_leaf_lo;        // the node's block
+    uint16_t ei_leaf_hi;
+    uint16_t ei_unused;
+} ext4_extent_idx;
+
 #if !defined(__GNUC__) && !defined(__clang__)
   #pragma pack(pop)
 #endif
 #undef PACKED
 
-/* ---- public API you’re exposing from ext2.c ---- */
-bool ext2_create_and_write(const char *path, const uint8_t *data, uint32_t len);
+_Static_assert(sizeof(ext2_superblock) == 1024, "ext2 superblock layout");
+_Static_assert(sizeof(ext2_group_desc) == 32,   "ext2 group descriptor layout");
+_Static_assert(sizeof(ext2_inode) == 128,       "ext2 inode layout");
+_Static_assert(sizeof(ext4_extent) == 12 && sizeof(ext4_extent_idx) == 12 &&
+               sizeof(ext4_extent_header) == 12, "ext4 extent layout");
+
+#define EXT2_SUPER_MAGIC   0xEF53u
+#define EXT2_SUPER_OFFSET  1024u
+#define EXT2_ROOT_INO      2u
+#define EXT2_RESIZE_INO    7u               /* owns the reserved GDT blocks */
+#define EXT2_GOOD_OLD_INODE_SIZE 128u
+#define EXT2_GOOD_OLD_FIRST_INO  11u
+
+#define EXT2_NDIR_BLOCKS   12u
+#define EXT2_IND_BLOCK     12u
+#define EXT2_DIND_BLOCK    13u
+#define EXT2_TIND_BLOCK    14u
+
+/* feature flags this tree knows about */
+#define EXT2_FEATURE_COMPAT_RESIZE_INODE    0x0010u
+#define EXT2_FEATURE_COMPAT_DIR_INDEX       0x0020u
+#define EXT2_FEATURE_INCOMPAT_FILETYPE      0x0002u
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER 0x0001u
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE   0x0002u
+
+/* ext4 features that can be read (the mount is then read-only) */
+#define EXT4_FEATURE_INCOMPAT_RECOVER       0x0004u     /* journal not replayed */
+#define EXT4_FEATURE_INCOMPAT_EXTENTS       0x0040u
+#define EXT4_FEATURE_INCOMPAT_64BIT         0x0080u
+#define EXT4_FEATURE_INCOMPAT_FLEX_BG       0x0200u
+#define EXT4_FEATURE_INCOMPAT_CSUM_SEED     0x2000u
+#define EXT4_FEATURE_INCOMPAT_LARGEDIR      0x4000u
+#define EXT4_FEATURE_RO_COMPAT_HUGE_FILE    0x0008u
+#define EXT4_DESC_SIZE_64BIT 64u            /* minimum s_desc_size with 64bit */
+
+/* inode i_flags */
+#define EXT2_INDEX_FL      0x00001000u      /* directory has an htree */
+#define EXT4_HUGE_FILE_FL  0x00040000u      /* i_blocks counts fs blocks, not sectors */
+#define EXT4_EXTENTS_FL    0x00080000u      /* i_block[] holds an extent tree */
+
+/* extent tree */
+#define EXT4_EXT_MAGIC        0xF30Au
+#define EXT4_EXT_INIT_MAX_LEN 32768u        /* longer ee_len: uninitialized, reads as zeros */
+#define EXT4_EXT_MAX_DEPTH    5u
+
+/* superblock s_flags: how htree hashes treat chars >= 0x80 */
+#define EXT2_FLAGS_SIGNED_HASH   0x0001u
+#define EXT2_FLAGS_UNSIGNED_HASH 0x0002u
+
+/* htree hash versions (dx_root_info.hash_version, s_def_hash_version) */
+#define EXT2_DX_HASH_LEGACY            0u
+#define EXT2_DX_HASH_HALF_MD4          1u
+#define EXT2_DX_HASH_TEA               2u
+#define EXT2_DX_HASH_LEGACY_UNSIGNED   3u
+#define EXT2_DX_HASH_HALF_MD4_UNSIGNED 4u
+#define EXT2_DX_HASH_TEA_UNSIGNED      5u
+
+/* directory entry file_type (incompat FILETYPE) */
+#define EXT2_FT_UNKNOWN  0u
+#define EXT2_FT_REG_FILE 1u
+#define EXT2_FT_DIR      2u
+#define EXT2_FT_SYMLINK  7u
+
+#define EXT2_LINK_MAX    32000u             /* i_links_count limit (subdirectories + 2) */
+
+/* ---- htree (dir_index) name hash, ext2_hash.c ---- */
+/* Major hash of a name as the htree index stores it (low bit clear), for
+   one of the EXT2_DX_HASH_* versions and the superblock's s_hash_seed.
+   false for an unknown version. */
+bool ext2_dirhash(const char *name, size_t len, unsigned version,
+                  const uint32_t seed[4], uint32_t *hash);
+
+/* ---- bitmap search, ext2_bitmap.c ---- */
+/* Bitmaps as 64-bit words, bit i in word i/64 (the on-disk layout on a
+   little-endian host). Bits past nbits are never looked at. */
+uint32_t ext2_bitmap_next_zero(const uint64_t *map, uint32_t from, uint32_t nbits);   /* nbits if none */
+uint32_t ext2_bitmap_zero_run(const uint64_t *map, uint32_t from, uint32_t nbits, uint32_t max);
+void     ext2_bitmap_set_range(uint64_t *map, uint32_t from, uint32_t n);
+uint32_t ext2_bitmap_clear_range(uint64_t *map, uint32_t from, uint32_t n);  /* how many were set */
+uint32_t ext2_bitmap_count(const uint64_t *map, uint32_t nbits);             /* set bits */
+
+/* ---- mkfs, ext2.c ---- */
+/* Zero fields pick the mke2fs.conf default for the size. */
+typedef struct ext2_mkfs_opts {
+    uint32_t    block_size;     /* 1024, 2048 or 4096 */
+    uint32_t    inode_ratio;    /* bytes per inode */
+    uint32_t    inode_size;     /* 128, 256, ... up to the block size */
+    const char *label;
+} ext2_mkfs_opts_t;
+
+/* Format bytes at byte 'off' of image 'key'; 0 or -1 (reported on stderr). */
+int mkfs_ext2_format(const char *key, uint64_t off, uint64_t bytes, const ext2_mkfs_opts_t *o);
+int mkfs_ext2_core(const char *key, uint64_t off, uint64_t bytes, const char *label);
+
+/* Does group g hold a superblock and descriptor copy? */
+bool ext2_group_has_super(uint32_t g, bool sparse_super);
+
+/* ---- read-only check, ext2_fsck.c ---- */
+typedef struct ext2_fsck_opts {
+    unsigned threads;           /* 0: one per CPU, at most 8 */
+    unsigned max_report;        /* problems listed in the report (all are counted); 0: 100 */
+} ext2_fsck_opts_t;
 
-/* If other TUs need them, you can also declare readers/writers here:
-bool ext2_read_super(ext2_superblock *out);
-bool ext2_read_inode(uint32_t ino, ext2_inode *out);
-*/
+/* Check the filesystem at byte 'off' of image 'key' without writing to it
+   and print a JSON report to 'out'. Returns what e2fsck -n would: 0 clean,
+   4 problems found, 8 the check could not run. */
+int ext2_fsck(const char *key, uint64_t off, uint64_t bytes, const ext2_fsck_opts_t *o, FILE *out);
 
 /* ---- directory creation (planned full implementation) ---- */
 /* Create a single directory (no parents). Returns true on success. */
@@ -9,4 +9,12 @@ int file_write_at(FILE *f, uint64_t off, const void *buf, size_t n);
 
 int file_read_at_path (const char *path, uint64_t off, void *buf,        size_t n);
 int file_write_at_path(const char *path, uint64_t off, const void *buf,  size_t n);
-int file_ensure_size  (const char *path, uint64_t size_bytes);
\ No newline at end of file
+int file_ensure_size  (const char *path, uint64_t size_bytes);
+
+/* Host directory listing: fn(ctx, dir, name, st) for each entry of 'dir'
+   in readdir order, "." and ".." included. st is the entry's lstat, or NULL
+   when that failed (errno says why). Stops at the first non-zero return of
+   fn and returns it; 0 at the end, -errno if dir cannot be opened. */
+struct stat;
+typedef int (*host_dir_fn)(void *ctx, const char *dir, const char *name, const struct stat *st);
+int host_dir_scan(const char *dir, host_dir_fn fn, void *ctx);
@@ -0,0 +1,50 @@
+// include/gu_arena.h — per-thread bump allocator for short-lived buffers
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+/*
+ * Each thread owns one arena: a list of chunks that only ever grows and a
+ * bump pointer into it. Allocation is a pointer add; nothing is freed
+ * individually. Instead a caller takes a mark, allocates freely, and
+ * releases back to the mark in O(1):
+ *
+ *   gu_arena_mark_t m = gu_arena_mark();
+ *   char *tmp = gu_arena_strdup(path);
+ *   ...
+ *   gu_arena_release(m);              // tmp (and anything after it) is gone
+ *
+ * run_command_line() brackets every command this way, so commands may hand
+ * out arena memory without freeing it; helpers that run outside a command
+ * (VFS path resolution) take their own mark. Marks nest; releasing an outer
+ * mark drops everything allocated under inner ones. Chunks are kept for
+ * reuse and freed when the thread exits, so a long script reaches a steady
+ * state with no heap traffic from arena users.
+ */
+
+#ifndef GU_ARENA_CHUNK
+#define GU_ARENA_CHUNK (64u * 1024u)
+#endif
+
+typedef struct gu_arena_mark {
+    void  *chunk;
+    size_t off;
+} gu_arena_mark_t;
+
+typedef struct gu_arena_stats {
+    uint64_t chunks;        /* chunks malloc'd (all threads, ever) */
+    uint64_t chunk_bytes;   /* bytes in chunks currently held */
+    uint64_t allocs;        /* arena allocations served */
+    uint64_t high_water;    /* largest footprint any thread reached */
+} gu_arena_stats_t;
+
+void *gu_arena_alloc(size_t n);                 /* max_align_t-aligned; NULL on OOM */
+char *gu_arena_strdup(const char *s);
+char *gu_arena_strndup(const char *s, size_t n);
+char *gu_arena_printf(const char *fmt, ...);
+
+gu_arena_mark_t gu_arena_mark(void);
+void            gu_arena_release(gu_arena_mark_t m);
+
+void gu_arena_get_stats(gu_arena_stats_t *out);
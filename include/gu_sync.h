@@ -0,0 +1,61 @@
+// include/gu_sync.h — locking primitives shared by the VFS and block layer
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+/*
+ * Locking model (see also the "Locking" block in vfs.h)
+ * -----------------------------------------------------
+ *  - Lookup tables that are read on every path walk or I/O (mount trie,
+ *    vblk registry, diskio devkey map, fs registry, mnttab) are read without
+ *    locks. Writers serialise on a per-table mutex and publish with release
+ *    stores; anything a reader may still be looking at is either never freed
+ *    (append-only tables) or freed only after gu_rcu_synchronize().
+ *  - Everything else is guarded by a plain mutex/rwlock owned by its module.
+ *
+ * The RCU here is deliberately tiny: two reader counters and an epoch.
+ * Readers bracket their access with gu_rcu_read_lock/unlock (cheap, never
+ * blocks); a writer that unpublished something calls gu_rcu_synchronize()
+ * and may then free it. Read sections must be short and must not sleep on
+ * anything a writer could hold.
+ */
+
+typedef pthread_mutex_t  gu_mutex_t;
+typedef pthread_rwlock_t gu_rwlock_t;
+typedef pthread_cond_t   gu_cond_t;
+
+#define GU_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#define GU_COND_INIT  PTHREAD_COND_INITIALIZER
+
+static inline void gu_mutex_init(gu_mutex_t *m)    { pthread_mutex_init(m, NULL); }
+static inline void gu_mutex_destroy(gu_mutex_t *m) { pthread_mutex_destroy(m); }
+static inline void gu_mutex_lock(gu_mutex_t *m)   { pthread_mutex_lock(m); }
+static inline void gu_mutex_unlock(gu_mutex_t *m) { pthread_mutex_unlock(m); }
+
+static inline void gu_rwlock_init(gu_rwlock_t *l)    { pthread_rwlock_init(l, NULL); }
+static inline void gu_rwlock_destroy(gu_rwlock_t *l) { pthread_rwlock_destroy(l); }
+static inline void gu_read_lock(gu_rwlock_t *l)      { pthread_rwlock_rdlock(l); }
+static inline void gu_write_lock(gu_rwlock_t *l)     { pthread_rwlock_wrlock(l); }
+static inline void gu_rw_unlock(gu_rwlock_t *l)      { pthread_rwlock_unlock(l); }
+
+static inline void gu_cond_wait(gu_cond_t *c, gu_mutex_t *m) { pthread_cond_wait(c, m); }
+static inline void gu_cond_broadcast(gu_cond_t *c)           { pthread_cond_broadcast(c); }
+
+/* Wait at most 'ms' milliseconds; returns false on timeout. */
+static inline bool gu_cond_timedwait_ms(gu_cond_t *c, gu_mutex_t *m, unsigned ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec  += ms / 1000u;
+    ts.tv_nsec += (long)(ms % 1000u) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+    return pthread_cond_timedwait(c, m, &ts) == 0;
+}
+static inline void gu_cond_signal(gu_cond_t *c) { pthread_cond_signal(c); }
+
+/* RCU-style read sections; the token returned by read_lock goes to unlock. */
+unsigned gu_rcu_read_lock(void);
+void     gu_rcu_read_unlock(unsigned token);
+void     gu_rcu_synchronize(void);
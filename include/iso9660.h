@@ -112,7 +112,25 @@ int  iso_walk_component(const iso9660_t *iso,
                         uint32_t *out_lba,
 						uint32_t *out_size,
                         uint8_t  *out_flags,
-						time_t *out_mtime);
+						time_t *out_mtime,
+                        uint64_t *out_rec_pos);
+
+/* One directory record as iso_walk_dir() sees it. */
+typedef struct iso_rec {
+    const char    *name;     /* version stripped, lower-cased */
+    uint32_t       lba, size;
+    uint8_t        flags;    /* 0x02 = directory */
+    const uint8_t *rec;      /* raw record (dates at +18) */
+    uint64_t       rec_pos;  /* absolute byte offset of the record */
+} iso_rec_t;
+
+typedef int (*iso_rec_cb)(const iso_rec_t *r, void *user);   /* nonzero stops */
+
+int  iso_walk_dir(const iso9660_t *iso, uint32_t dir_lba, uint32_t dir_size,
+                  iso_rec_cb cb, void *user);
+
+/* Directory record "recording date" (7 bytes at record offset 18) -> time_t */
+time_t iso_recdate_to_time(const uint8_t rec[7]);
 
 struct file;      // from vfs.h
 
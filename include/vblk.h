@@ -21,15 +21,16 @@ typedef struct vblk {
     bool     ro;                  /* NEW: read-only media? (CD/ISO=true) */
 } vblk_t;
 
-/* Global table (owned/defined in vblk.c). */
-extern vblk_t g_vblk[];
-extern int    g_vblk_count;
+/* Global table (owned by vblk.c). Safe to read from any thread; rows are
+   immutable once registered and stay valid for the life of the process. */
+int     vblk_count(void);
+vblk_t *vblk_at(int index);      /* NULL if out of range */
 
 /* Lookup by human-readable name (returns NULL if not found). */
 const vblk_t *vblk_by_name(const char *name);
 
 /* Registry helpers */
-int  vblk_register(const vblk_t *entry);  /* returns index or -1 on full */
+int  vblk_register(const vblk_t *entry);  /* returns index or -1 on full; replaces a row with the same name */
 void vblk_clear(void);
 
 /* ------------------------------------------------------------------------------------- */
@@ -77,6 +78,25 @@ bool vblk_read_bytes  (vblk_t *dev, uint64_t off,  uint32_t len,   void *dst);
  
 bool vblk_read_blocks (vblk_t *dev, uint64_t lba, uint32_t count, void *dst);
 
+/**
+ * Name: vblk_copy_range
+ *
+ * Copy a byte range from one virtual block device to another (or within one)
+ * host-side, without staging it in the caller. Offsets are relative to each
+ * vblk. Uses reflink / copy_file_range(2) on the backing images when the
+ * host supports it. Fails if 'dst' is read-only or a range is out of bounds.
+ */
+bool vblk_copy_range(vblk_t *src, uint64_t soff, vblk_t *dst, uint64_t doff, uint64_t len);
+
+/**
+ * Name: vblk_map_range
+ *
+ * Map 'len' bytes at 'off' (relative to the vblk) read-only straight from
+ * the backing image. Returns NULL when out of bounds or the host can't
+ * mmap; release with diskio_unmap_range(addr, len).
+ */
+const void *vblk_map_range(vblk_t *dev, uint64_t off, size_t len);
+
 // Resolve a vblk name (e.g. "/dev/a1" or "/dev/a") into:
 //  - base key/path to pass into diskio_*
 //  - starting byte offset of the slice (0 for whole-disk)
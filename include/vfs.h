@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "vblk.h"
+#include "vfs_stat.h"
+#include "gu_sync.h"
 
 /* ===== ssize_t portability ===== */
 #if defined(_MSC_VER)
@@ -30,6 +32,8 @@
 #define VFS_SEEK_SET    0
 #define VFS_SEEK_CUR    1
 #define VFS_SEEK_END    2
+#define VFS_SEEK_DATA   3   /* next byte at or after off that is not in a hole */
+#define VFS_SEEK_HOLE   4   /* next hole at or after off (EOF counts as one) */
 
 /* st_mode type bits */
 #define VFS_S_IFMT   0170000
@@ -81,6 +85,21 @@ typedef struct vfs_dirent64 {
     char     d_name[];
 } vfs_dirent64_t;
 
+/* getdents64_plus record: a dirent with the entry's attributes attached, so
+   `ls -l` needs no per-entry path walk. d_stat is valid iff
+   (d_flags & VFS_DIRENTPLUS_STAT). Records are 8-byte aligned. */
+typedef struct vfs_direntplus64 {
+    uint64_t d_ino;
+    int64_t  d_off;
+    uint16_t d_reclen;
+    uint8_t  d_type;
+    uint8_t  d_flags;
+    struct g_stat d_stat;
+    char     d_name[];
+} vfs_direntplus64_t;
+
+#define VFS_DIRENTPLUS_STAT 0x01u
+
 /* ===== Forward decls ===== */
 struct superblock; struct inode; struct file;
 struct filesystem_type;
@@ -88,10 +107,6 @@ struct g_stat;      /* in vfs_stat.h */
 struct g_statvfs;   /* in vfs_stat.h */
 
 /* ===== Public mount view ===== */
-#ifndef VFS_MAX_MOUNTS
-#define VFS_MAX_MOUNTS 32
-#endif
-
 typedef struct {
     char src[64];      // "/dev/a1"
     char fstype[16];   // "ext2"
@@ -104,11 +119,14 @@ typedef struct super_ops {
     int  (*statfs)(struct superblock*, struct g_statvfs*);
     int  (*syncfs)(struct superblock*);
     void (*kill_sb)(struct superblock*);
+    void (*evict_inode)(struct inode*);   /* free i_private; VFS frees the inode */
 } super_ops_t;
 
 typedef struct inode_ops {
     int   (*lookup)(struct inode* dir, const char *name, struct inode **out);
     int   (*mkdir)(struct inode* dir, const char *name, uint32_t mode);
+    /* Create regular file 'name' in dir; *out gets a referenced inode. */
+    int   (*create)(struct inode* dir, const char *name, uint32_t mode, struct inode **out);
     int   (*rmdir)(struct inode* dir, const char *name);
     int   (*unlink)(struct inode* dir, const char *name);
     int   (*rename)(struct inode* odir, const char *on,
@@ -120,6 +138,21 @@ typedef struct inode_ops {
     int   (*readlink)(struct inode*, char *buf, size_t bufsz);
 } inode_ops_t;
 
+/* Physical extent map (FIEMAP-like). fe_physical is a byte offset on the
+   superblock's bdev; ranges with no extent are holes. */
+typedef struct vfs_extent {
+    uint64_t fe_logical;     /* byte offset in the file */
+    uint64_t fe_physical;    /* byte offset on sb->bdev */
+    uint64_t fe_length;      /* bytes */
+    uint32_t fe_flags;       /* VFS_FIEMAP_EXTENT_* */
+} vfs_extent_t;
+
+#define VFS_FIEMAP_EXTENT_LAST     0x0001u  /* no extents after this one */
+#define VFS_FIEMAP_EXTENT_UNKNOWN  0x0002u  /* data not at a usable device offset */
+
+/* read/write take the file position by pointer and advance only that, never
+   f->f_pos directly: the same entry serves vfs_read (pos = &f->f_pos) and
+   vfs_pread (pos = caller's offset), so positional I/O needs no seek. */
 typedef struct file_ops {
     int     (*open)(struct inode*, struct file** out, int flags, uint32_t mode);
     int     (*release)(struct file*);
@@ -129,8 +162,58 @@ typedef struct file_ops {
     int     (*ioctl)(struct file*, unsigned long, void*);
     int     (*llseek)(struct file*, int64_t off, int whence, uint64_t *newpos);
     ssize_t (*getdents64)(struct file *dirf, void *buf, size_t bytes);
+    ssize_t (*getdents64_plus)(struct file *dirf, void *buf, size_t bytes);  /* optional */
+    /* Fill up to 'max' extents overlapping [start, start+len); *count = filled. */
+    int     (*fiemap)(struct file*, uint64_t start, uint64_t len,
+                      vfs_extent_t *ext, unsigned max, unsigned *count);
+    /* Optional: allocate [off, off+len) (holes read as zeros) and grow i_size
+       to cover it, so fiemap maps the range. Called with the sb lock exclusive. */
+    int     (*fallocate)(struct file*, uint64_t off, uint64_t len);
 } file_ops_t;
 
+/* ===== Page cache =====
+ * File data is cached per inode in VFS_PAGE_SIZE pages (the inode's
+ * address_space). A driver opts in by setting inode->i_data.a_ops when it
+ * fills the inode; vfs_read() then serves regular files from the cache and
+ * only calls readpage(s) on a miss. Pages of all inodes share one LRU that
+ * is bounded by VFS_PAGECACHE_MAX_BYTES.
+ */
+#ifndef VFS_PAGE_SHIFT
+#define VFS_PAGE_SHIFT 12
+#endif
+#define VFS_PAGE_SIZE  (1u << VFS_PAGE_SHIFT)
+
+#ifndef VFS_PAGECACHE_MAX_BYTES
+#define VFS_PAGECACHE_MAX_BYTES (64u << 20)
+#endif
+#ifndef VFS_RA_MAX_PAGES
+#define VFS_RA_MAX_PAGES 32     /* largest readahead batch (128 KiB) */
+#endif
+
+typedef struct vfs_page {
+    struct address_space *mapping;
+    uint64_t         index;          /* file offset >> VFS_PAGE_SHIFT */
+    struct vfs_page *hnext;          /* mapping hash chain */
+    struct vfs_page *lru_prev, *lru_next;
+    uint8_t          data[];         /* VFS_PAGE_SIZE bytes */
+} vfs_page_t;
+
+typedef struct address_space_ops {
+    /* Fill pg->data for file page pg->index; zero bytes past EOF. 0 or -errno. */
+    int (*readpage)(struct inode*, vfs_page_t *pg);
+    /* Optional: fill n pages with consecutive indexes in one request. */
+    int (*readpages)(struct inode*, vfs_page_t **pages, unsigned n);
+} address_space_ops_t;
+
+typedef struct address_space {
+    const address_space_ops_t *a_ops;  /* NULL: uncached, f_op->read is used */
+    vfs_page_t **a_pages;              /* hash of cached pages by index */
+    size_t       a_cap, a_nrpages;
+    uint64_t     a_ra_next;            /* next index if reading sequentially */
+    uint32_t     a_ra_pages;           /* current readahead window */
+    uint64_t     a_gen;                /* bumped by every invalidation */
+} address_space_t;
+
 /* ===== Core objects ===== */
 typedef struct superblock {
     struct filesystem_type *fs_type;
@@ -140,6 +223,11 @@ typedef struct superblock {
     const super_ops_t *s_op;
     void     *fs_private;
 	uint32_t  s_flags;      /* VFS_SB_* flags */
+    struct inode *s_inodes; /* every live inode of this sb (inode cache) */
+    size_t    s_ninodes;
+    gu_rwlock_t s_lock;     /* VFS-owned; see "Locking" below */
+    struct vfs_slab_owner *s_slab; /* objects allocated on behalf of this sb */
+    struct vfs_opstats *s_stats;   /* operation counters (vfs_opstats.c) */
 } superblock_t;
 
 typedef struct inode {
@@ -153,24 +241,291 @@ typedef struct inode {
     const inode_ops_t *i_op;
     const file_ops_t  *i_fop;
     void *i_private;
+    address_space_t i_data;     /* cached file pages (vfs_pagecache.c) */
+    struct vfs_dindex *_Atomic i_dindex; /* directories: name index (vfs_dindex.c) */
+
+    /* inode cache bookkeeping (owned by vfs_inode.c; drivers don't touch) */
+    uint32_t        i_count;    /* references held (walks, open files, sb->root) */
+    uint32_t        i_state;    /* VFS_I_* */
+    struct inode   *i_hash_next;
+    struct inode   *i_lru_prev, *i_lru_next;
+    struct inode   *i_sb_prev,  *i_sb_next;
 } inode_t;
 
+/* inode->i_state bits */
+#define VFS_I_NEW     0x0001u   /* returned by vfs_iget(); driver must fill it */
+#define VFS_I_HASHED  0x0002u   /* reachable through (sb, i_ino) */
+#define VFS_I_BAD     0x0004u   /* fill failed (vfs_iget_failed); never returned */
+
+typedef struct vfs_iovec {
+    void   *iov_base;
+    size_t  iov_len;
+} vfs_iovec_t;
+
+struct mount_rec;
+
 typedef struct file {
     inode_t            *f_inode;
     uint64_t            f_pos;
     int                 f_flags;
     const file_ops_t   *f_op;
     void               *private_data;
+    struct mount_rec   *f_mnt;      /* set by vfs_open: pins the mount while open */
 } file_t;
 
+/* ===== Locking =====
+ * Any number of threads may call into the VFS at once (see gu_sync.h):
+ *
+ *  - Mount lookup is lock-free (RCU-style). A walk pins the mount it landed
+ *    on and every open file keeps that pin, so vfs_umount() only unpublishes
+ *    the mountpoint; kill_sb runs when the last walk or file lets go.
+ *  - Each superblock has an rwlock (s_lock) that the VFS takes around every
+ *    driver call: shared for lookups, reads, getdents, getattr and fiemap;
+ *    exclusive for write, create, mkdir, truncate, release of a writable
+ *    file and syncfs. Drivers therefore see one writer or many readers per
+ *    superblock and must only protect state they share across superblocks.
+ *    The VFS never holds two superblock locks at once itself; a stacked
+ *    filesystem (overlay) calls back into the VFS for its layers while its
+ *    own lock is held, and layers never call up, so the order is always
+ *    overlay before layer.
+ *  - The inode cache and page cache each have one internal mutex; drivers
+ *    never take them directly.
+ *  - A struct file (and its f_pos) belongs to one thread at a time.
+ */
+
+/* ===== Inode cache =====
+ * Inodes are shared and reference counted, keyed by (superblock, i_ino).
+ *
+ *   inode_t *ino = vfs_iget(sb, nr);
+ *   if (!ino) return -ENOMEM;
+ *   if (ino->i_state & VFS_I_NEW) {
+ *       ...fill i_mode/i_op/i_fop/i_private...   (on error: vfs_iget_failed(ino))
+ *       vfs_unlock_new_inode(ino);
+ *   }
+ *
+ * Every successful vfs_iget()/vfs_ihold() is paired with a vfs_iput().
+ * Unreferenced inodes stay cached on an LRU (bounded by VFS_INODE_CACHE_MAX)
+ * and are handed to s_op->evict_inode() when trimmed. kill_sb must drop its
+ * root reference and call vfs_evict_inodes(sb) before freeing fs state.
+ */
+#ifndef VFS_INODE_CACHE_MAX
+#define VFS_INODE_CACHE_MAX 4096
+#endif
+
+inode_t *vfs_iget(superblock_t *sb, uint64_t ino);
+inode_t *vfs_new_inode(superblock_t *sb);        /* unhashed; dies on last iput */
+void     vfs_unlock_new_inode(inode_t *inode);
+void     vfs_iget_failed(inode_t *inode);
+inode_t *vfs_ihold(inode_t *inode);
+void     vfs_iput(inode_t *inode);
+void     vfs_evict_inodes(superblock_t *sb);
+size_t   vfs_inode_cache_count(void);
+
+/* ===== Object caches (vfs_slab.c) =====
+ * Inodes, files and driver-private payloads come from fixed-size slab caches
+ * instead of calloc. Every object is charged to an owner; a superblock made
+ * by vfs_alloc_sb() owns everything allocated for it, and vfs_free_sb()
+ * hands back whatever is left in one sweep, so kill_sb only has to free what
+ * did not come from a cache.
+ *
+ *   static VFS_SLAB_CACHE(my_inode_cache, "myfs_inode", my_inode_t);
+ *   my_inode_t *ip = vfs_slab_alloc(&my_inode_cache, sb->s_slab);   (zeroed)
+ *   ...
+ *   vfs_slab_free(ip);
+ *
+ * Frees land in a per-thread magazine first, so a lookup/open/close cycle
+ * normally touches no cache-wide lock. A NULL owner is allowed (global
+ * objects); they are only freed explicitly.
+ */
+typedef struct vfs_slab_owner vfs_slab_owner_t;
+
+typedef struct vfs_slab_cache {
+    const char *name;
+    size_t      size;
+    /* private to vfs_slab.c */
+    _Atomic int id;             /* 1-based registry slot, 0 until first use */
+    gu_mutex_t  lock;           /* depot and chunk list */
+    void       *depot;          /* free objects not held by any magazine */
+    void       *chunks;
+    uint64_t    nchunks;
+    _Atomic uint64_t allocs, frees;
+} vfs_slab_cache_t;
+
+#define VFS_SLAB_CACHE(var, nm, type) \
+    vfs_slab_cache_t var = { .name = (nm), .size = sizeof(type), .lock = GU_MUTEX_INIT }
+
+typedef struct vfs_slab_stats {
+    const char *name;
+    size_t      obj_size;
+    uint64_t    live;           /* allocated and not yet freed */
+    uint64_t    allocs, frees;  /* since start (0 in per-owner stats) */
+    uint64_t    chunks;         /* VFS_SLAB_CHUNK-sized blocks carved (0 per owner) */
+} vfs_slab_stats_t;
+
+void  *vfs_slab_alloc(vfs_slab_cache_t *c, vfs_slab_owner_t *owner);
+void   vfs_slab_free(void *obj);                   /* NULL is a no-op */
+char  *vfs_slab_strdup(vfs_slab_owner_t *owner, const char *s);
+
+vfs_slab_owner_t *vfs_slab_owner_new(void);
+size_t vfs_slab_owner_release(vfs_slab_owner_t *owner);   /* bulk free; returns count */
+
+int    vfs_slab_get_stats(vfs_slab_stats_t *out, int max);          /* every cache */
+int    vfs_slab_owner_stats(vfs_slab_owner_t *owner,
+                            vfs_slab_stats_t *out, int max);        /* caches it uses */
+
+superblock_t *vfs_alloc_sb(void);               /* zeroed sb with its own s_slab */
+void          vfs_free_sb(superblock_t *sb);    /* bulk-frees s_slab, then the sb */
+struct file  *vfs_alloc_file(inode_t *inode);   /* zeroed, f_inode set, charged to i_sb */
+void          vfs_free_file(struct file *f);
+
+/* ===== Page cache API ===== */
+typedef struct vfs_pagecache_stats {
+    uint64_t pages, bytes;       /* currently cached */
+    uint64_t hits, misses;       /* page lookups from vfs_read */
+    uint64_t readahead;          /* pages read beyond what was asked for */
+    uint64_t evictions;
+} vfs_pagecache_stats_t;
+
+ssize_t vfs_pagecache_read(inode_t *inode, void *buf, size_t n, uint64_t pos);
+void    vfs_pagecache_invalidate(inode_t *inode, uint64_t off, uint64_t len); /* len 0: to EOF */
+void    vfs_pagecache_truncate(inode_t *inode);                                /* drop every page */
+void    vfs_pagecache_get_stats(vfs_pagecache_stats_t *out);
+
+/* ===== Interned names (vfs_intern.c) =====
+ * One process-wide atom per distinct path component. vfs_intern() hashes a
+ * name once and returns the same pointer for equal bytes, so holders compare
+ * atoms with == and reuse a->hash. Atoms are NUL-terminated, never freed and
+ * safe to read from any thread; vfs_intern_find() never adds, and returns
+ * NULL for a name nobody interned. vfs_intern() returns NULL for names longer
+ * than VFS_ATOM_MAX_LEN, or once VFS_INTERN_MAX_BYTES are in use. Only the
+ * mount trie and overlay nodes intern the names they keep; path walks hand
+ * drivers plain copies, so lookups never fill the table.
+ */
+#ifndef VFS_INTERN_MAX_BYTES
+#define VFS_INTERN_MAX_BYTES (64u << 20)
+#endif
+#define VFS_ATOM_MAX_LEN 255u
+
+struct vfs_atom {
+    uint32_t hash;               /* FNV-1a of name[0..len) */
+    uint32_t len;
+    char     name[];
+};
+typedef const struct vfs_atom *vfs_atom_t;
+
+typedef struct vfs_intern_stats {
+    uint64_t atoms, bytes;       /* bytes: atoms plus hash table */
+    uint64_t slots;
+} vfs_intern_stats_t;
+
+vfs_atom_t vfs_intern(const char *name, size_t len);
+vfs_atom_t vfs_intern_find(const char *name, size_t len);
+uint32_t   vfs_name_hash(const char *name, size_t len);
+void       vfs_intern_get_stats(vfs_intern_stats_t *out);
+static inline const char *vfs_atom_str(vfs_atom_t a) { return a ? a->name : ""; }
+
+/* ===== Directory name index (vfs_dindex.c) =====
+ * For drivers whose lookup would otherwise scan directory records. The first
+ * vfs_dindex_lookup() on a directory calls fill(), which enumerates it once
+ * with vfs_dindex_add(); the hash of names it builds stays on the inode until
+ * the inode is evicted or the VFS_DINDEX_MAX_BYTES budget pushes it out.
+ *
+ *   static int my_fill(inode_t *dir, vfs_dindex_t *dx) {
+ *       for each record: vfs_dindex_add(dx, name, len, &info);
+ *       return 0;                                      (or -errno)
+ *   }
+ *   vfs_dentry_info_t di;
+ *   int rc = vfs_dindex_lookup(dir, name, 0, my_fill, &di);
+ *   if (rc < 0) ...scan as before...     rc == 0: no such name
+ *
+ * Drivers that change a directory while its index may be live call
+ * vfs_dindex_insert() or vfs_dindex_drop() with the superblock lock held
+ * exclusive (any create/mkdir path is). The first of two equal names wins.
+ */
+#ifndef VFS_DINDEX_MAX_BYTES
+#define VFS_DINDEX_MAX_BYTES (16u << 20)
+#endif
+#define VFS_DINDEX_CASEFOLD 0x1u    /* ASCII case-insensitive names */
+
+typedef struct vfs_dindex vfs_dindex_t;
+
+typedef struct vfs_dentry_info {
+    uint64_t ino;                /* what the driver passes to vfs_iget */
+    uint64_t size;
+    int64_t  mtime;
+    uint32_t mode;
+    uint32_t flags;              /* driver-defined */
+    uint64_t loc;                /* driver-defined: extent, node pointer... */
+} vfs_dentry_info_t;
+
+typedef struct vfs_dindex_stats {
+    uint64_t indexes, entries, bytes;   /* currently attached */
+    uint64_t builds, evictions;         /* ever */
+} vfs_dindex_stats_t;
+
+typedef int (*vfs_dindex_fill_fn)(inode_t *dir, vfs_dindex_t *dx);
+
+int  vfs_dindex_lookup(inode_t *dir, const char *name, unsigned flags,
+                       vfs_dindex_fill_fn fill, vfs_dentry_info_t *out); /* 1 found, 0 absent, -errno */
+int  vfs_dindex_add(vfs_dindex_t *dx, const char *name, size_t len, const vfs_dentry_info_t *info);
+void vfs_dindex_insert(inode_t *dir, const char *name, const vfs_dentry_info_t *info);
+void vfs_dindex_drop(inode_t *dir);
+void vfs_dindex_get_stats(vfs_dindex_stats_t *out);
+
+/* ===== Operation metrics (vfs_opstats.c) =====
+ * Every superblock counts calls, errors, bytes moved and wall time of the
+ * VFS entry points below, with a log2 latency histogram per operation, plus
+ * inode cache hits and misses. Counters live in per-thread shards that the
+ * hot path bumps without locks, so they stay on. Times nest: an open's time
+ * includes the lookups of its walk, a read's the page cache and driver. Calls
+ * that never reached a mount are charged to sb == NULL.
+ */
+typedef enum vfs_op {
+    VFS_OP_OPEN,        /* vfs_open, including the path walk */
+    VFS_OP_LOOKUP,      /* each driver i_op->lookup; errors are misses */
+    VFS_OP_STAT,        /* vfs_stat */
+    VFS_OP_GETDENTS,    /* vfs_getdents64 and vfs_readdirplus */
+    VFS_OP_READ,        /* vfs_read/pread/preadv, per segment */
+    VFS_OP_WRITE,       /* vfs_write/pwrite */
+    VFS_OP_NR
+} vfs_op_t;
+
+#define VFS_OPSTAT_BUCKETS 32   /* bucket b: [2^b, 2^(b+1)) ns; the last is open-ended */
+
+typedef struct vfs_op_stats {
+    uint64_t calls, errors;
+    uint64_t bytes;              /* read/write only */
+    uint64_t ns;                 /* total time spent */
+    uint64_t hist[VFS_OPSTAT_BUCKETS];
+} vfs_op_stats_t;
+
+typedef struct vfs_sb_stats {
+    vfs_op_stats_t op[VFS_OP_NR];
+    uint64_t icache_hits, icache_misses;     /* vfs_iget found / had to create */
+} vfs_sb_stats_t;
+
+uint64_t    vfs_op_begin(void);                                  /* monotonic ns */
+void        vfs_op_end(superblock_t *sb, vfs_op_t op, uint64_t t0, int64_t rc);
+void        vfs_icache_account(superblock_t *sb, bool hit);
+void        vfs_sb_stats_get(const superblock_t *sb, vfs_sb_stats_t *out);
+void        vfs_sb_stats_reset(superblock_t *sb);
+uint64_t    vfs_op_stats_quantile(const vfs_op_stats_t *s, double q);  /* ns, bucket upper bound */
+const char *vfs_op_name(vfs_op_t op);
+
+struct vfs_opstats *vfs_opstats_new(void);       /* for vfs_alloc_sb */
+void                vfs_opstats_free(struct vfs_opstats *s);
+
 /* ===== Filesystem driver descriptor ===== */
 typedef struct filesystem_type {
     const char *name;   /* "fat", "vfat", "ext2", "iso9660", ... */
     bool (*probe)(vblk_t *dev, char *label_out, size_t label_cap);
     int  (*mount)(vblk_t *dev, const char *opts, superblock_t **out_sb);
     void (*umount)(superblock_t *sb);
+    uint32_t fs_flags;  /* VFS_FS_* */
 } filesystem_type_t;
 
+#define VFS_FS_NODEV 0x0001u    /* mounts without a block device (dev == NULL) */
+
 /* ===== Registry API ===== */
 typedef int (*vfs_fs_iter_cb)(const struct filesystem_type *fs, void *user);
 
@@ -188,6 +543,14 @@ int  vfs_mount_dev(const char *fstype,
                    const char *opts);
 int  vfs_umount(const char *mountpoint);
 void vfs_list_mounts(void);
+void vfs_list_mount_objects(void);    /* live slab objects per mount */
+int  vfs_sync(void);                  /* syncfs every mount, then flush the block cache */
+
+/* Calls cb for each mount in table order with the mount pinned and no VFS
+   lock held; stops early and returns cb's value if it is non-zero. */
+typedef int (*vfs_mount_iter_cb)(const char *mp, const char *fstype,
+                                 superblock_t *sb, void *user);
+int  vfs_for_each_mount(vfs_mount_iter_cb cb, void *user);
 
 /* compatibility views for UI */
 int  vfs_register_mount(const char *src, const char *fstype,
@@ -199,11 +562,52 @@ const vfs_mount_t *vfs_mount_get(int index);
 /* ===== File/path ops ===== */
 int     vfs_open(const char *path, int flags, uint32_t mode, struct file **out);
 int     vfs_close(struct file *f);
+int     vfs_fsync(struct file *f);                                          /* 0 or -errno */
 ssize_t vfs_read(struct file *f, void *buf, size_t n);
 ssize_t vfs_write(struct file *f, const void *buf, size_t n);
+ssize_t vfs_pread(struct file *f, void *buf, size_t n, uint64_t off);       /* f_pos untouched */
+ssize_t vfs_pwrite(struct file *f, const void *buf, size_t n, uint64_t off);
+ssize_t vfs_preadv(struct file *f, const vfs_iovec_t *iov, int iovcnt, uint64_t off);
+int64_t vfs_lseek(struct file *f, int64_t off, int whence);                 /* new pos or -errno */
+/* SEEK_DATA/SEEK_HOLE past EOF give -ENXIO. Drivers without llseek have
+   no holes: all of [0, i_size) is data. */
+int     vfs_fiemap(struct file *f, uint64_t start, uint64_t len,
+                   vfs_extent_t *ext, unsigned max, unsigned *count);
+int     vfs_fallocate(struct file *f, uint64_t off, uint64_t len);          /* 0 or -errno */
+
+/* Read-only view of [off, off+len) of a regular file; the range must lie
+   within i_size. When fiemap puts the whole range in one device extent the
+   pointer is into an mmap of the backing image (no copy); otherwise it is a
+   private copy read through the page cache. The view outlives the file
+   handle; release it with vfs_munmap. NULL on failure. */
+typedef struct vfs_mmap_stats {
+    uint64_t direct, copied;     /* mappings made each way (ever) */
+    uint64_t live, live_bytes;   /* not yet unmapped */
+} vfs_mmap_stats_t;
+
+const void *vfs_mmap(struct file *f, uint64_t off, size_t len);
+int         vfs_munmap(const void *addr);                                   /* 0 or -EINVAL */
+void        vfs_mmap_get_stats(vfs_mmap_stats_t *out);
+
+/* Copy up to 'len' bytes like copy_file_range(2): NULL offsets use and
+   advance f_pos. When both drivers map the range to device extents the data
+   moves image-to-image on the host (reflink / copy_file_range), allocating
+   the destination's blocks first through fallocate; otherwise it goes
+   through a large bounce buffer. With VFS_COPY_EXTENTS_ONLY nothing is
+   bounced: the copy stops where extents end, and is -EXDEV if none moved.
+   Returns bytes copied, 0 at EOF, or -errno. */
+#ifndef VFS_COPY_CHUNK
+#define VFS_COPY_CHUNK (1u << 20)
+#endif
+#define VFS_COPY_EXTENTS_ONLY 0x1u
+ssize_t vfs_copy_file_range(struct file *in,  uint64_t *off_in,
+                            struct file *out, uint64_t *off_out, size_t len, unsigned flags);
 int     vfs_mkdir(const char *path, unsigned mode);
 int     vfs_readlink(const char *path, char *buf, size_t bufsz);
 ssize_t vfs_getdents64(struct file *f, void *buf, size_t bytes);
+/* Like vfs_getdents64 but packs vfs_direntplus64_t records. Drivers without
+   getdents64_plus are served by lookup+getattr on the open directory. */
+ssize_t vfs_readdirplus(struct file *f, void *buf, size_t bytes);
 
 /* ===== Metadata ===== */
 int     vfs_stat(const char *path, struct g_stat *st);
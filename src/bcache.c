@@ -0,0 +1,607 @@
+// src/bcache.c — shared block cache with background writeback (see bcache.h)
+//
+// Blocks live in one hash table keyed by (image, block number). A clean
+// block sits on a global LRU and may be evicted; a dirty block sits on its
+// image's dirty list with the byte range [dlo, dhi) that needs writing.
+//
+// Flushing an image copies its dirty ranges, sorted by block, into one
+// staging buffer under the table lock, marks the blocks clean-but-in-flight
+// (never evicted until the write lands) and writes each contiguous run with
+// a single fwrite outside the lock. A per-image flush mutex keeps two
+// flushers from writing the same block out of order. Readers that miss go
+// to the image themselves; dev->gen tells them whether something they might
+// have raced with (eviction, invalidation, a write-through) happened while
+// they were reading, in which case they read again instead of caching stale
+// bytes.
+//
+// The image table grows as images are used. An image is pinned while a call
+// works on it outside the table lock, and bcache_release() (on detach)
+// writes it back and frees its entry once nothing has it pinned. If an
+// entry cannot be made, I/O to that image bypasses the cache.
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* fileno, fsync */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#define DBG_CAT DBG_BLK
+#include "debug.h"
+#include "bcache.h"
+#include "gu_sync.h"
+
+#define BC_SHIFT        12u
+#define BC_PATH_MAX     512
+#define BC_HASH_BUCKETS 8192u
+#define BC_MAX_BLOCKS   (BCACHE_MAX_BYTES / BCACHE_BLOCK)
+#define BC_READ_RUN     64u             /* blocks per miss read */
+#define BC_TICK_MS      500u
+
+typedef struct bc_buf bc_buf_t;
+
+typedef struct bc_dev {
+    char        path[BC_PATH_MAX];
+    bc_buf_t   *dirty;                  /* unsorted */
+    size_t      ndirty;
+    uint64_t    oldest_ms;              /* when the list last went non-empty */
+    uint64_t    gen;                    /* bumped when blocks leave or change behind readers */
+    int         pins;                   /* calls using it outside g_lock */
+    gu_mutex_t  flush_lock;
+} bc_dev_t;
+
+struct bc_buf {
+    bc_dev_t   *dev;
+    uint64_t    blk;
+    bc_buf_t   *hnext;
+    bc_buf_t   *prev, *next;            /* LRU when clean, dev->dirty when dirty */
+    uint32_t    dlo, dhi;               /* dirty bytes; dhi == 0: clean */
+    uint32_t    valid;                  /* bytes that exist in the image or were written */
+    bool        in_flight;              /* being written by a flush: don't evict */
+    uint8_t     data[BCACHE_BLOCK];
+};
+
+static gu_mutex_t g_lock = GU_MUTEX_INIT;
+static gu_cond_t  g_kick = GU_COND_INIT;
+static bc_buf_t  *g_hash[BC_HASH_BUCKETS];
+static bc_buf_t  *g_lru_head, *g_lru_tail;
+static size_t     g_nbufs, g_ndirty;
+static bc_dev_t **g_devs;
+static int        g_ndevs, g_devcap;
+static bcache_stats_t g_st;
+
+static pthread_t      g_flusher;
+static pthread_once_t g_flusher_once = PTHREAD_ONCE_INIT;
+static bool           g_flusher_up, g_stop, g_kicked;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/* ---------- raw image I/O ---------- */
+
+/* Read up to n bytes at off; returns bytes read (short at EOF). */
+static size_t raw_read(const char *path, uint64_t off, void *buf, size_t n) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    size_t got = 0;
+    if (fseek(f, (long)off, SEEK_SET) == 0) got = fread(buf, 1, n, f);
+    fclose(f);
+    return got;
+}
+
+/* Write-through, for images the table has no room for. */
+static bool raw_write(const char *path, uint64_t off, const void *buf, size_t n) {
+    FILE *f = fopen(path, "r+b");
+    if (!f) return false;
+    bool ok = fseek(f, (long)off, SEEK_SET) == 0 && fwrite(buf, 1, n, f) == n;
+    if (fclose(f) != 0) ok = false;
+    return ok;
+}
+
+/* ---------- table (g_lock held) ---------- */
+
+static inline size_t bc_hash(const bc_dev_t *d, uint64_t blk) {
+    uint64_t h = (uint64_t)(uintptr_t)d ^ (blk * 0x9E3779B97F4A7C15ull);
+    return (size_t)(h ^ (h >> 31)) & (BC_HASH_BUCKETS - 1);
+}
+
+static bc_buf_t *bc_lookup(const bc_dev_t *d, uint64_t blk) {
+    for (bc_buf_t *b = g_hash[bc_hash(d, blk)]; b; b = b->hnext)
+        if (b->dev == d && b->blk == blk) return b;
+    return NULL;
+}
+
+static void lru_del(bc_buf_t *b) {
+    if (b->prev) b->prev->next = b->next; else g_lru_head = b->next;
+    if (b->next) b->next->prev = b->prev; else g_lru_tail = b->prev;
+    b->prev = b->next = NULL;
+}
+
+static void lru_add(bc_buf_t *b) {
+    b->prev = NULL;
+    b->next = g_lru_head;
+    if (g_lru_head) g_lru_head->prev = b;
+    g_lru_head = b;
+    if (!g_lru_tail) g_lru_tail = b;
+}
+
+static void dirty_del(bc_buf_t *b) {
+    bc_dev_t *d = b->dev;
+    if (b->prev) b->prev->next = b->next; else d->dirty = b->next;
+    if (b->next) b->next->prev = b->prev;
+    b->prev = b->next = NULL;
+    d->ndirty--;
+    g_ndirty--;
+}
+
+static void drop_buf(bc_buf_t *b) {
+    bc_buf_t **pp = &g_hash[bc_hash(b->dev, b->blk)];
+    while (*pp != b) pp = &(*pp)->hnext;
+    *pp = b->hnext;
+    if (b->dhi) dirty_del(b); else lru_del(b);
+    b->dev->gen++;
+    g_nbufs--;
+    free(b);
+}
+
+static void evict_clean(void) {
+    bc_buf_t *b = g_lru_tail;
+    while (g_nbufs >= BC_MAX_BLOCKS && b) {
+        bc_buf_t *prev = b->prev;
+        if (!b->in_flight) drop_buf(b);
+        b = prev;
+    }
+}
+
+static bc_buf_t *bc_insert(bc_dev_t *d, uint64_t blk) {
+    if (g_nbufs >= BC_MAX_BLOCKS) evict_clean();
+    bc_buf_t *b = (bc_buf_t*)calloc(1, sizeof *b);
+    if (!b) return NULL;
+    b->dev = d;
+    b->blk = blk;
+    size_t h = bc_hash(d, blk);
+    b->hnext = g_hash[h];
+    g_hash[h] = b;
+    lru_add(b);
+    g_nbufs++;
+    return b;
+}
+
+static void mark_dirty(bc_buf_t *b, uint32_t lo, uint32_t hi) {
+    if (b->dhi) {
+        if (lo < b->dlo) b->dlo = lo;
+        if (hi > b->dhi) b->dhi = hi;
+        return;
+    }
+    bc_dev_t *d = b->dev;
+    lru_del(b);
+    b->dlo = lo;
+    b->dhi = hi;
+    b->next = d->dirty;
+    if (d->dirty) d->dirty->prev = b;
+    d->dirty = b;
+    if (d->ndirty++ == 0) d->oldest_ms = now_ms();
+    g_ndirty++;
+}
+
+/* The image's entry, made if 'create'; pinned when found. NULL if there is
+   none (or no memory for one): the caller goes to the image directly. */
+static bc_dev_t *dev_get(const char *path, bool create) {
+    for (int i = 0; i < g_ndevs; ++i)
+        if (strcmp(g_devs[i]->path, path) == 0) { g_devs[i]->pins++; return g_devs[i]; }
+    if (!create || strlen(path) >= BC_PATH_MAX) return NULL;
+    if (g_ndevs == g_devcap) {
+        const int cap = g_devcap ? g_devcap * 2 : 16;
+        bc_dev_t **v = (bc_dev_t**)realloc(g_devs, (size_t)cap * sizeof *v);
+        if (!v) return NULL;
+        g_devs = v;
+        g_devcap = cap;
+    }
+    bc_dev_t *d = (bc_dev_t*)calloc(1, sizeof *d);
+    if (!d) return NULL;
+    memcpy(d->path, path, strlen(path) + 1);
+    gu_mutex_init(&d->flush_lock);
+    d->pins = 1;
+    g_devs[g_ndevs++] = d;
+    return d;
+}
+
+static void dev_unpin(bc_dev_t *d) {
+    if (d) d->pins--;
+}
+
+/* Pinned copies of the entries for path (NULL: all) into *out; free() it. */
+static int dev_snapshot(const char *path, bc_dev_t ***out) {
+    bc_dev_t **v = (bc_dev_t**)malloc((size_t)(g_ndevs ? g_ndevs : 1) * sizeof *v);
+    int n = 0;
+    for (int i = 0; v && i < g_ndevs; ++i)
+        if (!path || strcmp(g_devs[i]->path, path) == 0) { g_devs[i]->pins++; v[n++] = g_devs[i]; }
+    *out = v;
+    return v ? n : -ENOMEM;
+}
+
+/* ---------- flushing ---------- */
+
+typedef struct { bc_buf_t *b; uint64_t blk; uint32_t lo, hi; } wb_rec_t;
+
+static int cmp_rec(const void *a, const void *b) {
+    uint64_t x = ((const wb_rec_t*)a)->blk, y = ((const wb_rec_t*)b)->blk;
+    return x < y ? -1 : x > y;
+}
+
+/* Write back every dirty block of d. 'durable' adds an fsync. */
+static int flush_dev(bc_dev_t *d, bool durable) {
+    gu_mutex_lock(&d->flush_lock);
+    gu_mutex_lock(&g_lock);
+    size_t n = d->ndirty;
+    if (n == 0 && !durable) {
+        gu_mutex_unlock(&g_lock);
+        gu_mutex_unlock(&d->flush_lock);
+        return 0;
+    }
+    wb_rec_t *rec = n ? (wb_rec_t*)malloc(n * sizeof *rec) : NULL;
+    size_t bytes = 0, k = 0;
+    if (n && !rec) {
+        gu_mutex_unlock(&g_lock);
+        gu_mutex_unlock(&d->flush_lock);
+        return -ENOMEM;
+    }
+    for (bc_buf_t *b = d->dirty; b; b = b->next) {
+        rec[k++] = (wb_rec_t){ b, b->blk, b->dlo, b->dhi };
+        bytes += b->dhi - b->dlo;
+    }
+    qsort(rec, n, sizeof *rec, cmp_rec);
+    uint8_t *stage = bytes ? (uint8_t*)malloc(bytes) : NULL;
+    if (bytes && !stage) {
+        free(rec);
+        gu_mutex_unlock(&g_lock);
+        gu_mutex_unlock(&d->flush_lock);
+        return -ENOMEM;
+    }
+    size_t at = 0;
+    for (size_t i = 0; i < n; ++i) {
+        bc_buf_t *b = rec[i].b;
+        memcpy(stage + at, b->data + rec[i].lo, rec[i].hi - rec[i].lo);
+        at += rec[i].hi - rec[i].lo;
+        dirty_del(b);
+        b->dlo = b->dhi = 0;
+        b->in_flight = true;
+        lru_add(b);
+    }
+    g_st.flushes++;
+    gu_mutex_unlock(&g_lock);
+
+    /* one fwrite per run of back-to-back dirty bytes */
+    int rc = 0;
+    size_t runs = 0;
+    FILE *f = n ? fopen(d->path, "r+b") : NULL;
+    if (n && !f) rc = -EIO;
+    at = 0;
+    for (size_t i = 0; i < n && f; ) {
+        size_t j = i, len = rec[i].hi - rec[i].lo;
+        while (j + 1 < n && rec[j].hi == BCACHE_BLOCK && rec[j + 1].lo == 0 &&
+               rec[j + 1].blk == rec[j].blk + 1) {
+            ++j;
+            len += rec[j].hi;
+        }
+        uint64_t off = (rec[i].blk << BC_SHIFT) + rec[i].lo;
+        if (fseek(f, (long)off, SEEK_SET) != 0 || fwrite(stage + at, 1, len, f) != len) rc = -EIO;
+        at += len;
+        runs++;
+        i = j + 1;
+    }
+    if (f) {
+        if (fflush(f) != 0) rc = -EIO;
+#if !defined(_WIN32)
+        if (durable && rc == 0 && fsync(fileno(f)) != 0) rc = -EIO;
+#endif
+        fclose(f);
+    }
+    DBG("bcache: flushed %zu blocks of '%s' in %zu runs%s rc=%d",
+        n, d->path, runs, durable ? " (sync)" : "", rc);
+
+    gu_mutex_lock(&g_lock);
+    g_st.runs += runs;
+    g_st.blocks_written += n;
+    for (size_t i = 0; i < n; ++i) {
+        bc_buf_t *b = rec[i].b;
+        b->in_flight = false;
+        if (rc != 0) mark_dirty(b, rec[i].lo, rec[i].hi);   /* keep it for the next attempt */
+    }
+    gu_mutex_unlock(&g_lock);
+    gu_mutex_unlock(&d->flush_lock);
+    if (rc != 0) fprintf(stderr, "bcache: write-back to '%s' failed\n", d->path);
+    free(stage);
+    free(rec);
+    return rc;
+}
+
+static void *flusher_main(void *arg) {
+    (void)arg;
+    gu_mutex_lock(&g_lock);
+    while (!g_stop) {
+        if (!g_kicked) (void)gu_cond_timedwait_ms(&g_kick, &g_lock, BC_TICK_MS);
+        g_kicked = false;
+        const uint64_t now = now_ms();
+        const bool over = g_ndirty * BCACHE_BLOCK > BCACHE_DIRTY_BG;
+        bc_dev_t **due = (bc_dev_t**)malloc((size_t)(g_ndevs ? g_ndevs : 1) * sizeof *due);
+        int ndue = 0;
+        for (int i = 0; due && i < g_ndevs; ++i) {
+            bc_dev_t *d = g_devs[i];
+            if (d->ndirty && (over || now - d->oldest_ms >= BCACHE_EXPIRE_MS)) { d->pins++; due[ndue++] = d; }
+        }
+        gu_mutex_unlock(&g_lock);
+        for (int i = 0; i < ndue; ++i) (void)flush_dev(due[i], false);
+        gu_mutex_lock(&g_lock);
+        for (int i = 0; i < ndue; ++i) dev_unpin(due[i]);
+        free(due);
+    }
+    gu_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+static void bcache_shutdown(void) {
+    gu_mutex_lock(&g_lock);
+    bool up = g_flusher_up;
+    g_stop = true;
+    gu_cond_broadcast(&g_kick);
+    gu_mutex_unlock(&g_lock);
+    if (up) pthread_join(g_flusher, NULL);
+    (void)bcache_sync(NULL);
+}
+
+static void flusher_start(void) {
+    if (pthread_create(&g_flusher, NULL, flusher_main, NULL) == 0) g_flusher_up = true;
+    atexit(bcache_shutdown);
+}
+
+/* ---------- public API ---------- */
+
+bool bcache_read(const char *path, uint64_t off, void *dst, uint32_t len) {
+    if (!path || !dst) return false;
+    uint8_t *out = (uint8_t*)dst;
+    uint8_t *run = NULL;
+    bool ok = true;
+
+    gu_mutex_lock(&g_lock);
+    bc_dev_t *d = dev_get(path, true);
+    if (!d) {
+        gu_mutex_unlock(&g_lock);
+        return raw_read(path, off, dst, len) == len;
+    }
+    while (len && ok) {
+        const uint64_t blk = off >> BC_SHIFT;
+        const uint32_t in = (uint32_t)(off & (BCACHE_BLOCK - 1));
+        const uint32_t take = len < BCACHE_BLOCK - in ? len : BCACHE_BLOCK - in;
+        bc_buf_t *b = bc_lookup(d, blk);
+        if (b) {
+            if (in + take > b->valid) { ok = false; break; }
+            memcpy(out, b->data + in, take);
+            if (!b->dhi) { lru_del(b); lru_add(b); }
+            g_st.hits++;
+            out += take; off += take; len -= take;
+            continue;
+        }
+
+        /* miss: read this block and any missing ones right after it */
+        uint32_t nblk = 1;
+        const uint64_t last = (off + len - 1) >> BC_SHIFT;
+        while (nblk < BC_READ_RUN && blk + nblk <= last && !bc_lookup(d, blk + nblk)) nblk++;
+        const uint64_t gen = d->gen;
+        gu_mutex_unlock(&g_lock);
+        if (!run) run = (uint8_t*)malloc((size_t)BC_READ_RUN * BCACHE_BLOCK);
+        size_t got = run ? raw_read(path, blk << BC_SHIFT, run, (size_t)nblk * BCACHE_BLOCK) : 0;
+        gu_mutex_lock(&g_lock);
+        if (!run) { ok = false; break; }
+        if (d->gen != gen) continue;            /* raced with eviction/update: read again */
+        g_st.misses += nblk;
+        for (uint32_t i = 0; i < nblk; ++i) {
+            size_t have = got > (size_t)i * BCACHE_BLOCK ? got - (size_t)i * BCACHE_BLOCK : 0;
+            if (have > BCACHE_BLOCK) have = BCACHE_BLOCK;
+            if (have == 0 || bc_lookup(d, blk + i)) break;
+            bc_buf_t *nb = bc_insert(d, blk + i);
+            if (!nb) break;
+            memcpy(nb->data, run + (size_t)i * BCACHE_BLOCK, have);
+            nb->valid = (uint32_t)have;
+        }
+        if (!bc_lookup(d, blk)) {               /* past EOF or out of memory */
+            size_t have = got;
+            if (in + take > have) { ok = false; break; }
+            memcpy(out, run + in, take);
+            out += take; off += take; len -= take;
+        }
+    }
+    dev_unpin(d);
+    gu_mutex_unlock(&g_lock);
+    free(run);
+    return ok;
+}
+
+bool bcache_write(const char *path, uint64_t off, const void *src, uint32_t len) {
+    if (!path || !src) return false;
+    const uint8_t *in = (const uint8_t*)src;
+    uint8_t tmp[BCACHE_BLOCK];
+    bool ok = true;
+
+    pthread_once(&g_flusher_once, flusher_start);
+    gu_mutex_lock(&g_lock);
+    bc_dev_t *d = dev_get(path, true);
+    if (!d) {
+        gu_mutex_unlock(&g_lock);
+        return raw_write(path, off, src, len);
+    }
+    while (len) {
+        const uint64_t blk = off >> BC_SHIFT;
+        const uint32_t at = (uint32_t)(off & (BCACHE_BLOCK - 1));
+        const uint32_t put = len < BCACHE_BLOCK - at ? len : BCACHE_BLOCK - at;
+        bc_buf_t *b = bc_lookup(d, blk);
+        if (!b) {
+            size_t got = 0;
+            if (put < BCACHE_BLOCK) {           /* partial: need the rest of the block */
+                const uint64_t gen = d->gen;
+                gu_mutex_unlock(&g_lock);
+                got = raw_read(path, blk << BC_SHIFT, tmp, BCACHE_BLOCK);
+                gu_mutex_lock(&g_lock);
+                if (d->gen != gen || bc_lookup(d, blk)) continue;
+            }
+            b = bc_insert(d, blk);
+            if (!b) { ok = false; break; }
+            if (got) memcpy(b->data, tmp, got);
+            b->valid = (uint32_t)got;
+        }
+        memcpy(b->data + at, in, put);
+        if (at + put > b->valid) b->valid = at + put;
+        mark_dirty(b, at, at + put);
+        in += put; off += put; len -= put;
+    }
+    const size_t dirty = g_ndirty * BCACHE_BLOCK;
+    if (dirty > BCACHE_DIRTY_BG && !g_kicked) {
+        g_kicked = true;
+        gu_cond_signal(&g_kick);
+    }
+    const bool throttle = dirty > BCACHE_DIRTY_MAX;
+    if (throttle) g_st.throttled++;
+    gu_mutex_unlock(&g_lock);
+
+    if (throttle) ok = flush_dev(d, false) == 0 && ok;
+    gu_mutex_lock(&g_lock);
+    dev_unpin(d);
+    gu_mutex_unlock(&g_lock);
+    return ok;
+}
+
+void bcache_overlay(const char *path, uint64_t off, void *dst, size_t len) {
+    if (!path || !dst || !len) return;
+    uint8_t *out = (uint8_t*)dst;
+    gu_mutex_lock(&g_lock);
+    bc_dev_t *d = g_nbufs ? dev_get(path, false) : NULL;
+    while (d && len) {
+        const uint32_t in = (uint32_t)(off & (BCACHE_BLOCK - 1));
+        const size_t take = len < BCACHE_BLOCK - in ? len : BCACHE_BLOCK - in;
+        bc_buf_t *b = bc_lookup(d, off >> BC_SHIFT);
+        if (b && in < b->valid) memcpy(out, b->data + in, in + take <= b->valid ? take : b->valid - in);
+        out += take; off += take; len -= take;
+    }
+    dev_unpin(d);
+    gu_mutex_unlock(&g_lock);
+}
+
+void bcache_update(const char *path, uint64_t off, const void *src, size_t len) {
+    if (!path || !src || !len) return;
+    const uint8_t *in = (const uint8_t*)src;
+    gu_mutex_lock(&g_lock);
+    bc_dev_t *d = dev_get(path, false);
+    if (d) d->gen++;
+    while (d && len) {
+        const uint32_t at = (uint32_t)(off & (BCACHE_BLOCK - 1));
+        const size_t put = len < BCACHE_BLOCK - at ? len : BCACHE_BLOCK - at;
+        bc_buf_t *b = bc_lookup(d, off >> BC_SHIFT);
+        if (b) {
+            memcpy(b->data + at, in, put);
+            if (at + put > b->valid) b->valid = (uint32_t)(at + put);
+        }
+        in += put; off += put; len -= put;
+    }
+    dev_unpin(d);
+    gu_mutex_unlock(&g_lock);
+}
+
+int bcache_sync(const char *path) {
+    bc_dev_t **devs;
+    gu_mutex_lock(&g_lock);
+    const int n = dev_snapshot(path, &devs);
+    gu_mutex_unlock(&g_lock);
+    int rc = n < 0 ? n : 0;
+    for (int i = 0; i < n; ++i) {
+        int r = flush_dev(devs[i], true);
+        if (r) rc = r;
+    }
+    gu_mutex_lock(&g_lock);
+    for (int i = 0; i < n; ++i) dev_unpin(devs[i]);
+    gu_mutex_unlock(&g_lock);
+    free(devs);
+    return rc;
+}
+
+void bcache_invalidate(const char *path, uint64_t off, uint64_t len) {
+    if (!path || !len) return;
+    gu_mutex_lock(&g_lock);
+    bc_dev_t *d = dev_get(path, false);
+    bool dirty = d && d->ndirty;
+    gu_mutex_unlock(&g_lock);
+    if (!d) return;
+    if (dirty) (void)flush_dev(d, false);
+
+    gu_mutex_lock(&d->flush_lock);             /* no flush may be in flight */
+    gu_mutex_lock(&g_lock);
+    const uint64_t lo = off >> BC_SHIFT, hi = (off + len - 1) >> BC_SHIFT;
+    if (hi - lo >= BC_HASH_BUCKETS) {          /* huge range: walk the table instead */
+        for (size_t h = 0; h < BC_HASH_BUCKETS && g_nbufs; ++h) {
+            for (bc_buf_t *b = g_hash[h], *next; b; b = next) {
+                next = b->hnext;
+                if (b->dev == d && b->blk >= lo && b->blk <= hi) drop_buf(b);
+            }
+        }
+    } else {
+        for (uint64_t blk = lo; blk <= hi && g_nbufs; ++blk) {
+            bc_buf_t *b = bc_lookup(d, blk);
+            if (b) drop_buf(b);
+        }
+    }
+    d->gen++;
+    gu_mutex_unlock(&g_lock);
+    gu_mutex_unlock(&d->flush_lock);
+    gu_mutex_lock(&g_lock);
+    dev_unpin(d);
+    gu_mutex_unlock(&g_lock);
+}
+
+/* Write back and forget everything cached for an image that is going away,
+   and free its entry unless another call still has it pinned. */
+int bcache_release(const char *path) {
+    if (!path) return 0;
+    gu_mutex_lock(&g_lock);
+    bc_dev_t *d = dev_get(path, false);
+    gu_mutex_unlock(&g_lock);
+    if (!d) return 0;
+    int rc = flush_dev(d, true);
+    gu_mutex_lock(&g_lock);
+    const bool last = rc == 0 && d->pins == 1 && d->ndirty == 0;
+    if (last) {                                 /* nobody else can reach d: no flush in flight */
+        for (size_t h = 0; h < BC_HASH_BUCKETS && g_nbufs; ++h)
+            for (bc_buf_t *b = g_hash[h], *next; b; b = next) {
+                next = b->hnext;
+                if (b->dev == d) drop_buf(b);
+            }
+        for (int i = 0; i < g_ndevs; ++i)
+            if (g_devs[i] == d) { g_devs[i] = g_devs[--g_ndevs]; break; }
+    } else {
+        dev_unpin(d);
+    }
+    gu_mutex_unlock(&g_lock);
+    if (last) {
+        DBG("bcache: released '%s'", d->path);
+        gu_mutex_destroy(&d->flush_lock);
+        free(d);
+    }
+    return rc;
+}
+
+void bcache_get_stats(bcache_stats_t *out) {
+    if (!out) return;
+    gu_mutex_lock(&g_lock);
+    *out = g_st;
+    out->blocks = g_nbufs;
+    out->dirty_blocks = g_ndirty;
+    gu_mutex_unlock(&g_lock);
+}
@@ -1,17 +1,20 @@
 // cmd_cp.c — minimal cp built on the VFS router
 // Copies a single regular file to a file or into an existing directory.
 //
-// Usage: cp <src> <dst>
-// Notes: no -r; if src is a directory, returns error.
+// Usage: cp [--extents-only] <src> <dst>
+// Notes: no -r; if src is a directory, returns error. --extents-only fails
+// unless every byte moved image-to-image (no bounce buffer).
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <errno.h>
 
 #include "vfs.h"       // VFS_O_*, VFS_S_* helpers, vfs_open/read/write/close/stat
 #include "vfs_stat.h"  // struct g_stat (st_mode, etc.)
+#include "gu_arena.h"  // per-command scratch memory
 
 /* ---- Helpers ---- */
 
@@ -31,23 +34,23 @@ static const char* path_basename(const char *p) {
     return sep ? sep + 1 : p;
 }
 
-/* Join dir + file with a single '/' (malloc). Caller must free. */
+/* Join dir + file with a single '/' (arena; gone when the command returns). */
 static char* join_dir_file(const char *dir, const char *file) {
-    size_t dl = strlen(dir), fl = strlen(file);
+    size_t dl = strlen(dir);
     int need_sep = (dl > 0 && dir[dl-1] != '/' && dir[dl-1] != '\\');
-    size_t out_len = dl + (need_sep ? 1 : 0) + fl + 1;
-    char *out = (char*)malloc(out_len);
-    if (!out) return NULL;
-    if (need_sep) snprintf(out, out_len, "%s/%s", dir, file);
-    else          snprintf(out, out_len, "%s%s",    dir, file);
-    return out;
+    return gu_arena_printf(need_sep ? "%s/%s" : "%s%s", dir, file);
 }
 
 /* ---- Command ---- */
 
 int cmd_cp(int argc, char **argv) {
+    unsigned flags = 0;
+    if (argc > 1 && strcmp(argv[1], "--extents-only") == 0) {
+        flags |= VFS_COPY_EXTENTS_ONLY;
+        argc--; argv++;
+    }
     if (argc < 3) {
-        fprintf(stderr, "usage: cp <src> <dst>\n");
+        fprintf(stderr, "usage: cp [--extents-only] <src> <dst>\n");
         return 1;
     }
     const char *src = argv[1];
@@ -60,23 +63,20 @@ int cmd_cp(int argc, char **argv) {
     }
 
     /* If destination is an existing directory, append basename(src) */
-    char *final_alloc = NULL;
     const char *final_dst = dst;
     if (path_is_directory(dst)) {
         const char *base = path_basename(src);
-        final_alloc = join_dir_file(dst, base);
-        if (!final_alloc) {
+        final_dst = join_dir_file(dst, base);
+        if (!final_dst) {
             fprintf(stderr, "cp: out of memory\n");
             return 1;
         }
-        final_dst = final_alloc;
     }
 
     /* Open source for reading */
     struct file *in = NULL;
     if (vfs_open(src, VFS_O_RDONLY, 0, &in) != 0 || !in) {
         fprintf(stderr, "cp: cannot open '%s' for read\n", src);
-        free(final_alloc);
         return 1;
     }
 
@@ -85,37 +85,25 @@ int cmd_cp(int argc, char **argv) {
     if (vfs_open(final_dst, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC, 0644, &out) != 0 || !out) {
         fprintf(stderr, "cp: cannot open '%s' for write\n", final_dst);
         vfs_close(in);
-        free(final_alloc);
         return 1;
     }
 
-    /* Copy loop */
-    char buf[64 * 1024];
+    /* Copy loop: the VFS moves data image-to-image when both sides map to
+       device extents, and through a large buffer otherwise */
     for (;;) {
-        ssize_t n = vfs_read(in, buf, sizeof buf);
+        ssize_t n = vfs_copy_file_range(in, NULL, out, NULL, (size_t)1 << 30, flags);
         if (n < 0) {
-            fprintf(stderr, "cp: read error on '%s'\n", src);
-            vfs_close(in); vfs_close(out); free(final_alloc);
+            if (n == -EXDEV)
+                fprintf(stderr, "cp: '%s' -> '%s' cannot be copied by extents\n", src, final_dst);
+            else
+                fprintf(stderr, "cp: copy error '%s' -> '%s'\n", src, final_dst);
+            vfs_close(in); vfs_close(out);
             return 1;
         }
         if (n == 0) break; /* EOF */
-
-        char *p = buf;
-        ssize_t remain = n;
-        while (remain > 0) {
-            ssize_t w = vfs_write(out, p, (size_t)remain);
-            if (w < 0) {
-                fprintf(stderr, "cp: write error on '%s'\n", final_dst);
-                vfs_close(in); vfs_close(out); free(final_alloc);
-                return 1;
-            }
-            remain -= w;
-            p += w;
-        }
     }
 
     vfs_close(in);
     vfs_close(out);
-    free(final_alloc);
     return 0;
 }
\ No newline at end of file
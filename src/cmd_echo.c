@@ -1,10 +1,12 @@
 // src/cmd_echo.c — echo text to stdout or to a file (creating parent dirs as needed)
 // Usage:
-//   echo [-n] [-a] [--] <text ...>                # print to stdout
-//   echo [-n] [-a] [--] <text ...> <target_path>  # write to file (mkdir -p)
+//   echo [-n] [-a|-s N] [--] <text ...>                # print to stdout
+//   echo [-n] [-a|-s N] [--] <text ...> <target_path>  # write to file (mkdir -p)
 // Flags:
 //   -n / --no-newline : do not append newline
 //   -a / --append     : append to file instead of truncate
+//   -s / --seek N     : write at byte N, keeping the rest of the file; a gap
+//                       past the old end is left as a hole
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,8 +20,11 @@
 
 #include "vfs.h"
 #include "vfs_stat.h"
+#include "gu_arena.h"
 
-/* ---------- Helpers ---------- */
+/* ---------- Helpers ----------
+ * Scratch strings come from the per-command arena (gu_arena.h) and are
+ * dropped when the command returns, so nothing here frees. */
 
 static bool path_exists_dir(const char *path) {
     struct g_stat st;
@@ -27,7 +32,7 @@ static bool path_exists_dir(const char *path) {
     return VFS_S_ISDIR(st.st_mode);
 }
 
-/* Extract parent directory of path into out (returns true if there is a parent) */
+/* Extract parent directory of path into out (arena; returns true if there is a parent) */
 static bool get_parent_dir(const char *path, char **out_parent) {
     *out_parent = NULL;
     if (!path || !*path) return false;
@@ -39,18 +44,9 @@ static bool get_parent_dir(const char *path, char **out_parent) {
 
     if (!sep) return false;                 // no parent (current dir)
     size_t len = (size_t)(sep - path);
-    if (len == 0) {                         // parent is root like "/"
-        *out_parent = (char*)malloc(2);
-        if (!*out_parent) return false;
-        (*out_parent)[0] = '/'; (*out_parent)[1] = '\0';
-        return true;
-    }
-    char *p = (char*)malloc(len + 1);
-    if (!p) return false;
-    memcpy(p, path, len);
-    p[len] = '\0';
-    *out_parent = p;
-    return true;
+    *out_parent = len == 0 ? gu_arena_strdup("/")      // parent is root like "/"
+                           : gu_arena_strndup(path, len);
+    return *out_parent != NULL;
 }
 
 /* Create a single directory if missing */
@@ -65,9 +61,8 @@ static bool mkdir_p(const char *dir) {
     if (!dir || !*dir) return true;
 
     size_t len = strlen(dir);
-    char *buf = (char*)malloc(len + 1);
+    char *buf = gu_arena_strdup(dir);
     if (!buf) return false;
-    memcpy(buf, dir, len + 1);
 
     /* Normalize backslashes to forward slashes for splitting */
     for (size_t i = 0; i < len; ++i) if (buf[i] == '\\') buf[i] = '/';
@@ -87,16 +82,14 @@ static bool mkdir_p(const char *dir) {
     for (size_t i = start; i < len; ++i) {
         if (buf[i] == '/') {
             buf[i] = '\0';
-            if (!mkdir_one_if_needed(buf)) { free(buf); return false; }
+            if (!mkdir_one_if_needed(buf)) return false;
             buf[i] = '/';
             /* skip consecutive slashes */
             while (i + 1 < len && buf[i + 1] == '/') i++;
         }
     }
     /* Create the final directory itself */
-    bool ok = mkdir_one_if_needed(buf);
-    free(buf);
-    return ok;
+    return mkdir_one_if_needed(buf);
 }
 
 /* Ensure parent directories for a target file exist (mkdir -p) */
@@ -104,19 +97,20 @@ static bool ensure_parent_dirs_for(const char *target) {
     char *parent = NULL;
     bool have_parent = get_parent_dir(target, &parent);
     if (!have_parent) return true;  // nothing to make
-    bool ok = mkdir_p(parent);
-    free(parent);
-    return ok;
+    return mkdir_p(parent);
 }
 
-/* Write entire buffer to a file (append or truncate). Creates parents. */
-static bool write_entire_file(const char *path, const void *data, size_t len, bool append) {
+/* Write entire buffer to a file (append, at byte 'seek' if >= 0, or
+   truncate). Creates parents. */
+static bool write_entire_file(const char *path, const void *data, size_t len,
+                              bool append, int64_t seek) {
     if (!ensure_parent_dirs_for(path)) return false;
 
     int flags = VFS_O_WRONLY | VFS_O_CREAT |
-                (append ? VFS_O_APPEND : VFS_O_TRUNC);
+                (append ? VFS_O_APPEND : seek >= 0 ? 0 : VFS_O_TRUNC);
     struct file *f = NULL;
     if (vfs_open(path, flags, VFS_MODE_FILE_0644, &f) != 0 || !f) return false;
+    if (seek >= 0 && vfs_lseek(f, seek, VFS_SEEK_SET) != seek) { vfs_close(f); return false; }
 
     const uint8_t *p = (const uint8_t*)data;
     size_t remain = len;
@@ -130,28 +124,26 @@ static bool write_entire_file(const char *path, const void *data, size_t len, bo
     return true;
 }
 
-/* Join argv[i..j] (inclusive) into a single string with spaces; caller frees. */
-static char* join_words(char **argv, int i, int j, bool add_trailing_nl) {
-    if (i > j) {
-        char *s = (char*)malloc(add_trailing_nl ? 2 : 1);
-        if (!s) return NULL;
-        s[0] = '\0';
-        if (add_trailing_nl) strcat(s, "\n");
-        return s;
-    }
-    size_t total = 0;
-    for (int k = i; k <= j; ++k) total += strlen(argv[k]) + 1; // +1 for space or NUL
+/* Join argv[i..j] (inclusive) into a single arena string with spaces;
+   *out_len gets its length. */
+static char* join_words(char **argv, int i, int j, bool add_trailing_nl, size_t *out_len) {
+    size_t total = 1;                                          // NUL
+    for (int k = i; k <= j; ++k) total += strlen(argv[k]) + 1; // +1 for space
     if (add_trailing_nl) total += 1;
 
-    char *buf = (char*)malloc(total);
+    char *buf = (char*)gu_arena_alloc(total);
     if (!buf) return NULL;
 
-    buf[0] = '\0';
+    size_t n = 0;
     for (int k = i; k <= j; ++k) {
-        strcat(buf, argv[k]);
-        if (k != j) strcat(buf, " ");
+        size_t l = strlen(argv[k]);
+        memcpy(buf + n, argv[k], l);
+        n += l;
+        if (k != j) buf[n++] = ' ';
     }
-    if (add_trailing_nl) strcat(buf, "\n");
+    if (add_trailing_nl) buf[n++] = '\n';
+    buf[n] = '\0';
+    *out_len = n;
     return buf;
 }
 
@@ -160,6 +152,7 @@ static char* join_words(char **argv, int i, int j, bool add_trailing_nl) {
 int cmd_echo(int argc, char **argv) {
     bool no_newline = false;
     bool append = false;
+    int64_t seek = -1;
 
     /* Parse flags */
     int i = 1;
@@ -168,6 +161,13 @@ int cmd_echo(int argc, char **argv) {
         if (strcmp(a, "--") == 0) { i++; break; }
         if (strcmp(a, "-n") == 0 || strcmp(a, "--no-newline") == 0) { no_newline = true; continue; }
         if (strcmp(a, "-a") == 0 || strcmp(a, "--append") == 0) { append = true; continue; }
+        if ((strcmp(a, "-s") == 0 || strcmp(a, "--seek") == 0) && i + 1 < argc) {
+            char *end;
+            long long v = strtoll(argv[++i], &end, 0);
+            if (*end || v < 0) { fprintf(stderr, "echo: bad offset '%s'\n", argv[i]); return 1; }
+            seek = (int64_t)v;
+            continue;
+        }
         break;
     }
 
@@ -196,20 +196,18 @@ int cmd_echo(int argc, char **argv) {
 #endif
 
     /* Build content buffer */
-    char *content = join_words(argv, text_start, text_end, !no_newline);
+    size_t content_len = 0;
+    char *content = join_words(argv, text_start, text_end, !no_newline, &content_len);
     if (!content) { fprintf(stderr, "echo: out of memory\n"); return 1; }
-    size_t content_len = strlen(content);
 
     if (!target) {
         /* Print to stdout */
         size_t w = fwrite(content, 1, content_len, stdout);
-        free(content);
         return (w == content_len) ? 0 : 1;
     }
 
     /* Write to file (mkdir -p parents) */
-    bool ok = write_entire_file(target, content, content_len, append);
-    free(content);
+    bool ok = write_entire_file(target, content, content_len, append, seek);
     if (!ok) {
         fprintf(stderr, "echo: failed to write '%s'\n", target);
         return 1;
@@ -0,0 +1,64 @@
+// src/cmd_fsck_ext2.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vblk.h"
+#include "diskio.h"
+#include "ext2.h"
+#include "vfs.h"
+
+static void usage(void){
+    printf("fsck.ext2 -n [-t threads] [--max-report N] <device>\n");
+}
+
+/* Returns the e2fsck exit code (0 clean, 4 problems left, 8 could not check),
+   so a script stops on a damaged filesystem. */
+int cmd_fsck_ext2(int argc, char **argv){
+    const char *target = NULL;
+    bool readonly = false;
+    ext2_fsck_opts_t o = { 0 };
+
+    for (int i=1; i<argc; ++i){
+        if (strcmp(argv[i], "-n")==0) {
+            readonly = true;
+        } else if (strcmp(argv[i], "-t")==0 && i+1<argc) {
+            o.threads = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-report")==0 && i+1<argc) {
+            o.max_report = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (argv[i][0] != '-' && !target) {
+            target = argv[i];
+        } else {
+            fprintf(stderr, "fsck.ext2: unknown option '%s'\n", argv[i]);
+            return 8;
+        }
+    }
+    if (!target) { usage(); return 8; }
+    if (!readonly) {
+        fprintf(stderr, "fsck.ext2: only checking is supported, pass -n\n");
+        return 8;
+    }
+
+    char key[256];
+    uint64_t off=0, len=0;
+    if (!vblk_resolve_to_base(target, key, sizeof key, &off, &len)) {
+        const char *p = diskio_resolve(target);
+        if (!p) {
+            fprintf(stderr, "fsck.ext2: unknown device %s (use -i <img> %s first)\n", target, target);
+            return 8;
+        }
+        snprintf(key, sizeof key, "%s", p);
+        off = 0;
+        len = diskio_size_bytes(key);
+    }
+    if (len == 0) {
+        fprintf(stderr, "fsck.ext2: cannot determine size for %s\n", target);
+        return 8;
+    }
+
+    /* a mounted filesystem is checked as it would be after a sync */
+    vfs_sync();
+    return ext2_fsck(key, off, len, &o, stdout);
+}
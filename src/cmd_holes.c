@@ -0,0 +1,40 @@
+// src/cmd_holes.c — show which byte ranges of a file hold data
+// Usage:
+//   holes <path>
+//
+// Walks the file with SEEK_DATA/SEEK_HOLE and prints one line per range
+// (start inclusive, end exclusive), then the size. Drivers without hole
+// tracking report the whole file as data.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "vfs.h"
+
+int cmd_holes(int argc, char **argv) {
+    if (argc != 2) { fprintf(stderr, "usage: holes <path>\n"); return 1; }
+
+    struct file *f = NULL;
+    if (vfs_open(argv[1], VFS_O_RDONLY, 0, &f) != 0 || !f) {
+        fprintf(stderr, "holes: cannot open '%s'\n", argv[1]);
+        return 1;
+    }
+    int64_t size = vfs_lseek(f, 0, VFS_SEEK_END);
+    int rc = size < 0;
+    for (int64_t off = 0; !rc && off < size; ) {
+        int64_t data = vfs_lseek(f, off, VFS_SEEK_DATA);
+        if (data == -ENXIO) data = size;            /* only a hole is left */
+        if (data < 0) { rc = 1; break; }
+        if (data > off) printf("hole %12lld - %lld\n", (long long)off, (long long)data);
+        if (data >= size) break;
+        int64_t hole = vfs_lseek(f, data, VFS_SEEK_HOLE);
+        if (hole < 0) { rc = 1; break; }
+        printf("data %12lld - %lld\n", (long long)data, (long long)hole);
+        off = hole;
+    }
+    if (rc) fprintf(stderr, "holes: seek failed on '%s'\n", argv[1]);
+    else    printf("size %12lld\n", (long long)size);
+    vfs_close(f);
+    return rc;
+}
@@ -8,7 +8,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
@@ -16,6 +15,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "fileutil.h"
 #include "debug.h"
 #ifndef DBG
 #define DBG(...) do{}while(0)
@@ -44,15 +44,15 @@ static void mode_to_str(mode_t m, char out[11]) {
     out[10] = '\0';
 }
 
-static void print_long(const char *dir, const char *name) {
+static void print_long(const char *dir, const char *name, const struct stat *sp) {
     char path[4096];
     if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) return;
 
-    struct stat st;
-    if (lstat(path, &st) != 0) {
+    if (!sp) {
         printf("?????????? ? %12s %s (lstat: %s)\n", "?", name, strerror(errno));
         return;
     }
+    const struct stat st = *sp;
 
     char perm[11]; mode_to_str(st.st_mode, perm);
 
@@ -85,6 +85,16 @@ static void print_long(const char *dir, const char *name) {
     printf("\n");
 }
 
+typedef struct { int opt_long, opt_all; } lls_opts_t;
+
+static int lls_entry(void *ctx, const char *dir, const char *name, const struct stat *st) {
+    const lls_opts_t *o = (const lls_opts_t*)ctx;
+    if (!o->opt_all && name[0] == '.') return 0; // skip dot files unless -a
+    if (o->opt_long) print_long(dir, name, st);
+    else printf("%s\n", name);
+    return 0;
+}
+
 int cmd_lls(int argc, char **argv) {
     int opt_long = 0, opt_all = 0;
     const char *path = ".";
@@ -103,21 +113,11 @@ int cmd_lls(int argc, char **argv) {
         }
     }
 
-    DIR *d = opendir(path);
-    if (!d) {
-        fprintf(stderr, "lls: cannot open '%s': %s\n", path, strerror(errno));
+    lls_opts_t o = { opt_long, opt_all };
+    int rc = host_dir_scan(path, lls_entry, &o);
+    if (rc < 0) {
+        fprintf(stderr, "lls: cannot open '%s': %s\n", path, strerror(-rc));
         return 1;
     }
-
-    struct dirent *de;
-    while ((de = readdir(d)) != NULL) {
-        const char *name = de->d_name;
-        if (!opt_all && name[0] == '.') continue; // skip dot files unless -a
-
-        if (opt_long) print_long(path, name);
-        else printf("%s\n", name);
-    }
-
-    closedir(d);
     return 0;
 }
@@ -10,10 +10,6 @@
 #include "vfs_stat.h"
 #include "debug.h"
 
-#ifndef PATH_MAX
-#define PATH_MAX 1024
-#endif
-
 static void print_usage(void) {
     puts("usage: ls [-l] [-a] [path]");
 }
@@ -59,11 +55,13 @@ int cmd_ls(int argc, char **argv)
         return 1;
     }
 
-    // Iterate directory entries using getdents64
-    uint8_t buf[4096];
+    // Iterate directory entries; -l asks for attributes in the same batch
+    // (getdents64_plus) instead of a vfs_stat() path walk per entry.
+    uint8_t buf[16384];
 
     for (;;) {
-        ssize_t n = vfs_getdents64(df, buf, sizeof buf);
+        ssize_t n = longfmt ? vfs_readdirplus(df, buf, sizeof buf)
+                            : vfs_getdents64(df, buf, sizeof buf);
         if (n < 0) {
             vfs_close(df);
             fprintf(stderr, "ls: read error on '%s'\n", path);
@@ -73,53 +71,57 @@ int cmd_ls(int argc, char **argv)
 
         size_t off = 0;
         while (off < (size_t)n) {
-            vfs_dirent64_t *de = (vfs_dirent64_t *)(buf + off);
-            const char *name = de->d_name;
+            const char *name;
+            uint16_t    reclen;
+            uint8_t     d_type;
+            const struct g_stat *st = NULL;
+
+            if (longfmt) {
+                const vfs_direntplus64_t *dp = (const vfs_direntplus64_t *)(buf + off);
+                name = dp->d_name; reclen = dp->d_reclen; d_type = dp->d_type;
+                if (dp->d_flags & VFS_DIRENTPLUS_STAT) st = &dp->d_stat;
+            } else {
+                const vfs_dirent64_t *de = (const vfs_dirent64_t *)(buf + off);
+                name = de->d_name; reclen = de->d_reclen; d_type = de->d_type;
+            }
+            off += reclen;
 
             // skip dot entries unless -a
             if (!show_all && (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)) {
-                off += de->d_reclen;
                 continue;
             }
 
             if (!longfmt) {
                 puts(name);
-            } else {
+            } else if (st) {
                 // long listing: perms, nlink, owner, group, size, name
-                char full[PATH_MAX];
-                if (strcmp(path, ".") == 0) snprintf(full, sizeof full, "%s", name);
-                else                         snprintf(full, sizeof full, "%s/%s", path, name);
-
-                struct g_stat st;
-                if (vfs_stat(full, &st) == 0) {
-                    char modebuf[11];
-                    fmt_mode(st.st_mode, modebuf);
-
-                    // placeholders for owner/group (we'll wire real values later)
-                    const char *owner = "-";
-                    const char *group = "-";
-					char when[20];
-					    struct tm *tm = localtime(&st.st_mtime);
-					    if (tm) strftime(when, sizeof when, "%Y-%m-%d %H:%M", tm);
-					    else    strcpy(when, "-");
-					
-					    printf("%s %2u %8s %8s %10llu %s %s\n",
-					           modebuf, 1u, owner, group,
-					           (unsigned long long)st.st_size,
-					           when,
-					           name);
-                } else {
-                    // stat failed: use dirent type as fallback for leading char
-                    char t = (de->d_type == VFS_DT_DIR) ? 'd'
-                           : (de->d_type == VFS_DT_REG) ? '-'
-                           : '?';
-                    // perms unknown → "---------" placeholder
-                    printf("%c%9s %2u %8s %8s %10s %s\n",
-                           t, "---------", 1u, "-", "-", "-", name);
-                }
+                char modebuf[11];
+                fmt_mode(st->st_mode, modebuf);
+
+                // placeholders for owner/group (we'll wire real values later)
+                const char *owner = "-";
+                const char *group = "-";
+                char when[20];
+                time_t mt = (time_t)st->st_mtime;
+                struct tm tmv;
+                struct tm *tm = localtime_r(&mt, &tmv);
+                if (tm) strftime(when, sizeof when, "%Y-%m-%d %H:%M", tm);
+                else    strcpy(when, "-");
+
+                printf("%s %2u %8s %8s %10llu %s %s\n",
+                       modebuf, 1u, owner, group,
+                       (unsigned long long)st->st_size,
+                       when,
+                       name);
+            } else {
+                // no attributes: use dirent type as fallback for leading char
+                char t = (d_type == VFS_DT_DIR) ? 'd'
+                       : (d_type == VFS_DT_REG) ? '-'
+                       : '?';
+                // perms unknown → "---------" placeholder
+                printf("%c%9s %2u %8s %8s %10s %s\n",
+                       t, "---------", 1u, "-", "-", "-", name);
             }
-
-            off += de->d_reclen;
         }
     }
 
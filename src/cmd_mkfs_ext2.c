@@ -1,5 +1,6 @@
 // src/cmd_mkfs_ext2.c
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -7,60 +8,27 @@
 
 #include "vblk.h"
 #include "diskio.h"
-
-/* --------------------------------------------------------------------------
-   Formatter core compatibility layer.
-   We don't know which symbol your mkfs core exposes, so declare a few
-   common candidates as WEAK. GCC/Clang will allow them to be NULL if
-   not provided, avoiding link errors. On MSVC you'd pick one and link that.
-   -------------------------------------------------------------------------- */
-#if defined(__GNUC__) || defined(__clang__)
-  #define WEAK __attribute__((weak))
-#else
-  #define WEAK
-#endif
-
-/* Most capable: accepts base key, byte offset, total bytes, and label. */
-extern int mkfs_ext2_core(const char *key, uint64_t off, uint64_t bytes, const char *label) WEAK;
-/* Alternate name some trees use, same signature as above. */
-extern int mkfs_ext2_make_at(const char *key, uint64_t off, uint64_t bytes, const char *label) WEAK;
-/* Older/simple signature: whole-device only (no offset). */
-extern int mkfs_ext2_make(const char *key, uint64_t bytes, const char *label) WEAK;
-
-static int call_ext2_mkfs(const char *key, uint64_t off, uint64_t bytes, const char *label) {
-#if defined(__GNUC__) || defined(__clang__)
-    if (mkfs_ext2_core)     return mkfs_ext2_core(key, off, bytes, label);
-    if (mkfs_ext2_make_at)  return mkfs_ext2_make_at(key, off, bytes, label);
-    if (mkfs_ext2_make) {
-        if (off != 0) {
-            fprintf(stderr, "mkfs.ext2: this build's formatter doesn't support nonzero offsets\n");
-            return -1;
-        }
-        return mkfs_ext2_make(key, bytes, label);
-    }
-    fprintf(stderr, "mkfs.ext2: no formatter core linked (mkfs_ext2_core/make_at/make missing)\n");
-    return -1;
-#else
-    /* Non-GNU toolchains: pick the symbol you actually have. */
-    return mkfs_ext2_core(key, off, bytes, label);
-#endif
-}
-
-/* -------------------------------------------------------------------------- */
+#include "ext2.h"
 
 static void usage(void){
-    printf("mkfs.ext2 <device> [--label NAME]\n");
+    printf("mkfs.ext2 <device> [-b 1024|2048|4096] [-i bytes-per-inode] [-I inode-size] [--label NAME]\n");
 }
 
 int cmd_mkfs_ext2(int argc, char **argv){
     if (argc < 2) { usage(); return 0; }
 
     const char *target = argv[1];
-    const char *label  = NULL;
+    ext2_mkfs_opts_t o = { 0 };
 
     for (int i=2; i<argc; ++i){
         if (strcmp(argv[i], "--label")==0 && i+1<argc) {
-            label = argv[++i];
+            o.label = argv[++i];
+        } else if (strcmp(argv[i], "-b")==0 && i+1<argc) {
+            o.block_size = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-i")==0 && i+1<argc) {
+            o.inode_ratio = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-I")==0 && i+1<argc) {
+            o.inode_size = (uint32_t)strtoul(argv[++i], NULL, 0);
         } else {
             fprintf(stderr, "mkfs.ext2: unknown option '%s'\n", argv[i]);
             return 0;
@@ -92,9 +60,9 @@ int cmd_mkfs_ext2(int argc, char **argv){
 
     /* NOTE: Pass uint64_t directly with PRIu64 (no casts) */
     printf("mkfs.ext2: formatting %s (key=%s, off=%" PRIu64 ", size=%" PRIu64 " bytes)%s%s\n",
-           target, key, off, len, label ? " label=" : "", label ? label : "");
+           target, key, off, len, o.label ? " label=" : "", o.label ? o.label : "");
 
-    int rc = call_ext2_mkfs(key, off, len, label ? label : "");
+    int rc = mkfs_ext2_format(key, off, len, &o);
     if (rc != 0) {
         fprintf(stderr, "mkfs.ext2: failed (rc=%d)\n", rc);
         return 0;
@@ -16,8 +16,11 @@
 static void usage(void) {
     printf(
         "usage: mount [-t <fstype>] [-o opts] <device> <mountpoint>\n"
+        "       mount -s                     # live VFS objects per mount\n"
         "  e.g.: mount -t fat -o ro /dev/a1 /mnt/a\n"
         "        mount /dev/b /mnt/iso        # auto-probe filesystem\n"
+        "        mount -t tmpfs none /tmp     # in-memory, no device\n"
+        "        mount -t overlay -o lowerdir=/mnt/iso,upperdir=/tmp none /work\n"
     );
 }
 
@@ -44,6 +47,20 @@ static const filesystem_type_t* autoprobe_fs(vblk_t *dev) {
     return ctx.found;
 }
 
+// Live slab objects charged to each mount, then the caches themselves
+static void print_object_stats(void) {
+    vfs_list_mount_objects();
+    vfs_slab_stats_t st[32];
+    int n = vfs_slab_get_stats(st, 32);
+    if (n == 0) return;
+    printf("\n%-12s %6s %8s %10s %10s %6s\n", "cache", "size", "live", "allocs", "frees", "chunks");
+    for (int i = 0; i < n; ++i) {
+        printf("%-12s %6zu %8llu %10llu %10llu %6llu\n", st[i].name, st[i].obj_size,
+               (unsigned long long)st[i].live, (unsigned long long)st[i].allocs,
+               (unsigned long long)st[i].frees, (unsigned long long)st[i].chunks);
+    }
+}
+
 // -----------------------------------------------------------------------------
 // Command
 // -----------------------------------------------------------------------------
@@ -53,6 +70,10 @@ int cmd_mount(int argc, char **argv) {
         vfs_list_mounts();  // provided by VFS, prints table or "(no mounts)"
         return 0;
     }
+    if (argc == 2 && !strcmp(argv[1], "-s")) {
+        print_object_stats();
+        return 0;
+    }
 
     const char *fstype = NULL;
     const char *opts   = NULL;
@@ -102,6 +123,16 @@ int cmd_mount(int argc, char **argv) {
         return 1;
     }
 
+    // Device-less filesystems (tmpfs): <device> is just a label
+    const filesystem_type_t *nodev = fstype ? vfs_find_fs(fstype) : NULL;
+    if (nodev && (nodev->fs_flags & VFS_FS_NODEV)) {
+        if (vfs_mount_dev(fstype, device, NULL, mntpt, opts ? opts : "") != 0) {
+            fprintf(stderr, "mount: failed to mount '%s' on '%s' as '%s'\n", device, mntpt, fstype);
+            return 1;
+        }
+        return 0;
+    }
+
     // Open device (retry without /dev/ prefix if needed)
     vblk_t *dev = vblk_open(device);
     if (!dev && strncmp(device, "/dev/", 5) == 0) {
@@ -3,7 +3,7 @@
 #include <string.h>
 #include <ctype.h>
 #include "genhd.h"   // block_rescan(), struct gendisk
-#include "vblk.h"    // g_vblk, g_vblk_count, vblk_by_name
+#include "vblk.h"    // vblk_count(), vblk_at(), vblk_by_name
 
 // Return 1 if 'name' is a child of 'parent' (e.g., "/dev/a1" of "/dev/a")
 static int is_child_of(const char *parent, const char *name) {
@@ -30,8 +30,8 @@ static void list_children_sorted(const char *parent_name) {
     // collect children
     struct item { const vblk_t *row; int idx; } items[256];
     int n = 0;
-    for (int i = 0; i < g_vblk_count && n < (int)(sizeof items / sizeof items[0]); ++i) {
-        const vblk_t *e = &g_vblk[i];
+    for (int i = 0; i < vblk_count() && n < (int)(sizeof items / sizeof items[0]); ++i) {
+        const vblk_t *e = vblk_at(i);
         if (!is_child_of(parent_name, e->name)) continue;
         items[n].row = e;
         items[n].idx = child_index(parent_name, e->name);
@@ -0,0 +1,370 @@
+// src/cmd_populate.c — copy a host directory tree into a mounted filesystem
+//
+// Usage: populate [-t threads] [-v] <hostdir> <mountpoint>
+//   Like `mke2fs -d`: the whole host tree is walked first (host_dir_scan,
+//   shared with lls) into a plan listing directories breadth-first and each
+//   directory's entries by name. The plan's block and inode needs are
+//   checked against statfs before anything is written; then every directory
+//   and (empty) file is created in plan order, so inodes are handed out in
+//   one pass, and the data follows in the same order. Reader threads load
+//   host files in POP_CHUNK pieces, up to POP_WINDOW pieces ahead, while the
+//   calling thread writes them strictly in plan order: the allocator then
+//   lays files out back to back and the image sees one sequential stream.
+//   Symlinks, devices, FIFOs and sockets are skipped (and counted).
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cmds.h"
+#include "fileutil.h"
+#include "gu_arena.h"
+#include "gu_sync.h"
+#include "vfs.h"
+#include "vfs_stat.h"
+
+#define POP_CHUNK       (1u << 20)      /* host read / image write unit */
+#define POP_WINDOW      64              /* chunks read ahead of the writer */
+#define POP_MAX_THREADS 32
+
+/* One directory or regular file of the plan. */
+typedef struct pop_entry {
+    const char *rel;            /* path below hostdir and mountpoint (arena) */
+    uint64_t    size;
+    uint32_t    mode;
+    bool        dir;
+} pop_entry_t;
+
+typedef struct pop_plan {
+    pop_entry_t *e;
+    size_t       n, cap;
+    uint64_t     bytes;
+    size_t       ndirs, skipped;
+    uint64_t     blocks;        /* estimated image blocks */
+    uint32_t     bs;            /* block size the estimate is for */
+    const char  *host;
+} pop_plan_t;
+
+/* One piece of a file, read by a worker and written by the caller. */
+typedef struct pop_chunk {
+    uint32_t entry;
+    uint32_t len;
+    uint64_t off;
+    uint8_t *buf;
+    int      err;               /* -errno from the host read */
+    bool     ready;
+} pop_chunk_t;
+
+typedef struct pop_pipe {
+    const pop_plan_t *plan;
+    pop_chunk_t      *c;
+    size_t            n;
+    size_t            next_read;    /* next chunk a worker claims */
+    size_t            next_write;   /* chunk the writer waits for */
+    bool              stop;
+    gu_mutex_t        lock;
+    gu_cond_t         readable, written;
+} pop_pipe_t;
+
+/* ---- planning ---- */
+
+static int pop_push(pop_plan_t *p, const pop_entry_t *e) {
+    if (p->n == p->cap) {
+        size_t cap = p->cap ? p->cap * 2 : 256;
+        pop_entry_t *ne = (pop_entry_t*)realloc(p->e, cap * sizeof *ne);
+        if (!ne) return -ENOMEM;
+        p->e = ne;
+        p->cap = cap;
+    }
+    p->e[p->n++] = *e;
+    return 0;
+}
+
+/* Indirect blocks ext2 needs to map nblk data blocks. */
+static uint64_t pop_ind_blocks(uint64_t nblk, uint64_t apb) {
+    if (nblk <= 12) return 0;
+    nblk -= 12;
+    uint64_t n = 1;                                         /* single */
+    if (nblk <= apb) return n;
+    nblk -= apb;
+    const uint64_t dbl = nblk < apb * apb ? nblk : apb * apb;
+    n += 1 + (dbl + apb - 1) / apb;                          /* double */
+    if (nblk <= apb * apb) return n;
+    nblk -= apb * apb;
+    return n + 1 + (nblk + apb * apb - 1) / (apb * apb) + (nblk + apb - 1) / apb;
+}
+
+typedef struct pop_scan {
+    pop_plan_t *plan;
+    const char *rel;            /* directory being scanned */
+    size_t      first;          /* its entries start here */
+    uint64_t    dirent_bytes;
+} pop_scan_t;
+
+static int pop_scan_entry(void *ctx, const char *dir, const char *name, const struct stat *st) {
+    pop_scan_t *s = (pop_scan_t*)ctx;
+    if (!strcmp(name, ".") || !strcmp(name, "..")) return 0;
+    if (strlen(name) > 255) { s->plan->skipped++; return 0; }
+    if (!st) {
+        fprintf(stderr, "populate: %s/%s: %s\n", dir, name, strerror(errno));
+        s->plan->skipped++;
+        return 0;
+    }
+    if (!S_ISDIR(st->st_mode) && !S_ISREG(st->st_mode)) { s->plan->skipped++; return 0; }
+
+    pop_entry_t e = {
+        .rel  = *s->rel ? gu_arena_printf("%s/%s", s->rel, name) : gu_arena_strdup(name),
+        .size = S_ISREG(st->st_mode) ? (uint64_t)st->st_size : 0,
+        .mode = (uint32_t)st->st_mode & 07777,
+        .dir  = S_ISDIR(st->st_mode),
+    };
+    if (!e.rel) return -ENOMEM;
+    s->dirent_bytes += (8u + strlen(name) + 3u) & ~3u;
+    return pop_push(s->plan, &e);
+}
+
+static int pop_cmp(const void *a, const void *b) {
+    return strcmp(((const pop_entry_t*)a)->rel, ((const pop_entry_t*)b)->rel);
+}
+
+/* Scan the host tree breadth first: the plan's entries are its own queue.
+   Block estimates assume block size p->bs. */
+static int pop_plan(pop_plan_t *p) {
+    const uint64_t bs = p->bs, apb = bs / 4;
+    const char *rel = "";
+    for (size_t next = 0;; ) {
+        const char *host = *rel ? gu_arena_printf("%s/%s", p->host, rel) : p->host;
+        pop_scan_t s = { .plan = p, .rel = rel, .first = p->n, .dirent_bytes = 24 };
+        int rc = host ? host_dir_scan(host, pop_scan_entry, &s) : -ENOMEM;
+        if (rc) {
+            fprintf(stderr, "populate: %s: %s\n", host ? host : rel, strerror(-rc));
+            return rc;
+        }
+        qsort(p->e + s.first, p->n - s.first, sizeof *p->e, pop_cmp);
+        /* names fill directory blocks only about 3/4 full once records are split */
+        p->blocks += (s.dirent_bytes * 4 / 3 + bs - 1) / bs;
+
+        while (next < p->n && !p->e[next].dir) {
+            const uint64_t nblk = (p->e[next].size + bs - 1) / bs;
+            p->blocks += nblk + pop_ind_blocks(nblk, apb);
+            p->bytes += p->e[next].size;
+            next++;
+        }
+        if (next == p->n) return 0;
+        p->ndirs++;
+        rel = p->e[next++].rel;
+    }
+}
+
+/* ---- data pipeline ---- */
+
+static void *pop_reader(void *arg) {
+    pop_pipe_t *pp = (pop_pipe_t*)arg;
+    char path[4096];
+    for (;;) {
+        gu_mutex_lock(&pp->lock);
+        while (!pp->stop && pp->next_read < pp->n && pp->next_read >= pp->next_write + POP_WINDOW)
+            gu_cond_wait(&pp->written, &pp->lock);
+        if (pp->stop || pp->next_read >= pp->n) { gu_mutex_unlock(&pp->lock); return NULL; }
+        pop_chunk_t *c = &pp->c[pp->next_read++];
+        gu_mutex_unlock(&pp->lock);
+
+        const pop_entry_t *e = &pp->plan->e[c->entry];
+        uint8_t *buf = (uint8_t*)malloc(c->len);
+        int err = 0;
+        uint32_t got = 0;
+        if (!buf) err = -ENOMEM;
+        else if (snprintf(path, sizeof path, "%s/%s", pp->plan->host, e->rel) >= (int)sizeof path)
+            err = -ENAMETOOLONG;
+        else {
+            int fd = open(path, O_RDONLY);
+            if (fd < 0) err = -errno;
+            while (fd >= 0 && got < c->len) {
+                ssize_t r = pread(fd, buf + got, c->len - got, (off_t)(c->off + got));
+                if (r < 0 && errno == EINTR) continue;
+                if (r < 0) { err = -errno; break; }
+                if (r == 0) break;                  /* shrank since the scan */
+                got += (uint32_t)r;
+            }
+            if (fd >= 0) close(fd);
+        }
+
+        gu_mutex_lock(&pp->lock);
+        c->buf = buf;
+        c->len = got;
+        c->err = err;
+        c->ready = true;
+        gu_cond_broadcast(&pp->readable);
+        gu_mutex_unlock(&pp->lock);
+    }
+}
+
+static const char *pop_dst(const char *mp, const char *rel) {
+    const size_t n = strlen(mp);
+    return gu_arena_printf(n && mp[n - 1] == '/' ? "%s%s" : "%s/%s", mp, rel);
+}
+
+/* Write chunks in order as the readers deliver them. 0 or -errno. */
+static int pop_write(pop_pipe_t *pp, const char *mp) {
+    struct file *f = NULL;
+    int rc = 0;
+    for (size_t i = 0; i < pp->n && rc == 0; ++i) {
+        pop_chunk_t *c = &pp->c[i];
+        gu_mutex_lock(&pp->lock);
+        while (!c->ready) gu_cond_wait(&pp->readable, &pp->lock);
+        pp->next_write = i + 1;
+        gu_cond_broadcast(&pp->written);
+        gu_mutex_unlock(&pp->lock);
+
+        const pop_entry_t *e = &pp->plan->e[c->entry];
+        if (c->off && !f) { free(c->buf); c->buf = NULL; continue; }   /* file ended early */
+        const gu_arena_mark_t m = gu_arena_mark();
+        const char *dst = pop_dst(mp, e->rel);
+        if (c->err) {
+            fprintf(stderr, "populate: %s/%s: %s\n", pp->plan->host, e->rel, strerror(-c->err));
+            rc = c->err;
+        } else if (c->off == 0 && (!dst || vfs_open(dst, VFS_O_WRONLY, 0, &f) != 0 || !f)) {
+            fprintf(stderr, "populate: cannot open '%s' for write\n", dst ? dst : e->rel);
+            f = NULL;
+            rc = -EIO;
+        }
+        for (uint32_t done = 0; rc == 0 && done < c->len; ) {
+            ssize_t w = vfs_pwrite(f, c->buf + done, c->len - done, c->off + done);
+            if (w <= 0) {
+                fprintf(stderr, "populate: write error on '%s'\n", dst);
+                rc = w < 0 ? (int)w : -EIO;
+            } else done += (uint32_t)w;
+        }
+        if (f && (rc || c->off + POP_CHUNK >= e->size || c->len < POP_CHUNK)) {
+            vfs_close(f);
+            f = NULL;
+        }
+        gu_arena_release(m);
+        free(c->buf);
+        c->buf = NULL;
+    }
+    if (f) vfs_close(f);
+    return rc;
+}
+
+/* ---- command ---- */
+
+int cmd_populate(int argc, char **argv) {
+    int threads = 0, verbose = 0, first = argc;
+    for (int i = 1; i < argc; ++i) {
+        if      (!strcmp(argv[i], "-t") && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))                 verbose = 1;
+        else { first = i; break; }
+    }
+    if (argc - first != 2 || threads < 0) {
+        fprintf(stderr, "usage: populate [-t threads] [-v] <hostdir> <mountpoint>\n");
+        return 2;
+    }
+    if (threads == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 8 ? 8 : (cpus > 0 ? (int)cpus : 4);
+    }
+    if (threads > POP_MAX_THREADS) threads = POP_MAX_THREADS;
+    const char *mp = argv[first + 1];
+
+    struct g_stat mst;
+    if (vfs_stat(mp, &mst) != 0 || !VFS_S_ISDIR(mst.st_mode)) {
+        fprintf(stderr, "populate: '%s' is not a directory\n", mp);
+        return 1;
+    }
+    struct g_statvfs sv;
+    const bool have_sv = vfs_statfs(mp, &sv) == 0 && sv.f_blocks && sv.f_bsize;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    /* 1. plan: the whole tree, and what it will take */
+    pop_plan_t plan = { .host = argv[first], .bs = have_sv ? (uint32_t)sv.f_bsize : 4096 };
+    int rc = pop_plan(&plan);
+    if (rc == 0 && have_sv && (plan.blocks > sv.f_bfree || plan.n > sv.f_ffree)) {
+        fprintf(stderr, "populate: %s needs about %llu blocks and %zu inodes; %s has %llu and %llu free\n",
+                plan.host, (unsigned long long)plan.blocks, plan.n, mp,
+                (unsigned long long)sv.f_bfree, (unsigned long long)sv.f_ffree);
+        rc = -ENOSPC;
+    }
+
+    /* 2. namespace, in plan order */
+    for (size_t i = 0; rc == 0 && i < plan.n; ++i) {
+        const pop_entry_t *e = &plan.e[i];
+        const gu_arena_mark_t m = gu_arena_mark();
+        const char *dst = pop_dst(mp, e->rel);
+        struct g_stat st;
+        if (!dst) rc = -ENOMEM;
+        else if (e->dir) {
+            if (vfs_mkdir(dst, e->mode) != 0 && (vfs_stat(dst, &st) != 0 || !VFS_S_ISDIR(st.st_mode))) {
+                fprintf(stderr, "populate: cannot create directory '%s'\n", dst);
+                rc = -EIO;
+            }
+        } else {
+            struct file *f = NULL;
+            if (vfs_open(dst, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC, e->mode, &f) != 0 || !f) {
+                fprintf(stderr, "populate: cannot create '%s'\n", dst);
+                rc = -EIO;
+            } else vfs_close(f);
+        }
+        if (verbose && rc == 0) printf("%s%s\n", dst, e->dir ? "/" : "");
+        gu_arena_release(m);
+    }
+
+    /* 3. data: readers run ahead, this thread writes in plan order */
+    pop_pipe_t pp = { .plan = &plan, .lock = GU_MUTEX_INIT,
+                      .readable = GU_COND_INIT, .written = GU_COND_INIT };
+    for (size_t i = 0; i < plan.n; ++i)
+        pp.n += plan.e[i].dir ? 0 : (size_t)((plan.e[i].size + POP_CHUNK - 1) / POP_CHUNK);
+    if (rc == 0 && pp.n && !(pp.c = (pop_chunk_t*)calloc(pp.n, sizeof *pp.c))) rc = -ENOMEM;
+    if (rc == 0 && pp.n) {
+        size_t k = 0;
+        for (size_t i = 0; i < plan.n; ++i) {
+            for (uint64_t off = 0; !plan.e[i].dir && off < plan.e[i].size; off += POP_CHUNK) {
+                const uint64_t left = plan.e[i].size - off;
+                pp.c[k++] = (pop_chunk_t){ .entry = (uint32_t)i, .off = off,
+                                           .len = left < POP_CHUNK ? (uint32_t)left : POP_CHUNK };
+            }
+        }
+        pthread_t tid[POP_MAX_THREADS];
+        int started = 0;
+        for (; started < threads; ++started)
+            if (pthread_create(&tid[started], NULL, pop_reader, &pp) != 0) break;
+        rc = started ? pop_write(&pp, mp) : -EAGAIN;
+
+        gu_mutex_lock(&pp.lock);
+        pp.stop = true;
+        gu_cond_broadcast(&pp.written);
+        gu_mutex_unlock(&pp.lock);
+        for (int i = 0; i < started; ++i) pthread_join(tid[i], NULL);
+        for (size_t i = 0; i < pp.n; ++i) free(pp.c[i].buf);
+        threads = started;
+    }
+    if (rc == 0) rc = vfs_sync();
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    free(pp.c);
+    free(plan.e);
+    if (rc) return 1;
+
+    const double s = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    const double mib = (double)plan.bytes / (1024.0 * 1024.0);
+    printf("populate: %zu dirs, %zu files, %.1f MiB in %.2f s (%.1f MiB/s, %d readers)",
+           plan.ndirs, plan.n - plan.ndirs, mib, s, s > 0 ? mib / s : 0.0, threads);
+    if (plan.skipped) printf("; skipped %zu (not a regular file or directory)", plan.skipped);
+    printf("\n");
+    return 0;
+}
@@ -32,14 +32,16 @@ static const Command g_cmds[] = {
     { "part",      cmd_part,      "part add <img|/dev/X> --index N --type 0x0C --start 1MiB --size 32MiB" },
     { "format",    cmd_format,    "format <img|/dev/X> --fat32 --label NAME" },
 	{ "mkdir",     cmd_mkdir,     "mkdir <path>" }, 
-    { "mkfs.ext2", cmd_mkfs_ext2, "mkfs.ext2 <dev> --part N [--label NAME]" },
+    { "mkfs.ext2", cmd_mkfs_ext2, "mkfs.ext2 <dev> [-b 1024|2048|4096] [-i bytes-per-inode] [-I inode-size] [--label NAME]" },
+    { "fsck.ext2", cmd_fsck_ext2, "fsck.ext2 -n [-t N] [--max-report N] <dev>  # read-only check, JSON report" },
 	{ "cd",        cmd_cd,        "cd [path]  (cd / if omitted; supports .., ., and cd -)" },
     { "mount",     cmd_mount,     "mount [-t ext2|iso9660] <dev> <mp> [--part N]" },
-    { "cp",        cmd_cp,        "cp <src> <dst>            # copy (ISO -> ext2 root for now)" },
+    { "cp",        cmd_cp,        "cp [--extents-only] <src> <dst>  # copy a file between any mounts; --extents-only: image-to-image or fail" },
+    { "populate",  cmd_populate,  "populate [-t N] [-v] <hostdir> <mp>  # copy a host tree in (mke2fs -d style)" },
     { "use",       cmd_use,       "use -i <image> <dev> | use # map/list devices (/dev/a, /dev/b, ...)" },
     { "do",        cmd_do,        "do <scriptfile>           # run commands from file" },
     { "help",      cmd_help,      "help                      # list commands" },
-	{ "echo",      cmd_echo,      "echo [-n] words... [ >|>> /path ]" },
+	{ "echo",      cmd_echo,      "echo [-n] [-a|-s N] words... [ >|>> /path ]" },
     { "mkfs.fat",  cmd_mkfs_fat,  "Format /dev/* as FAT12/16/32" },
     { "mkfs_vfat", cmd_mkfs_vfat, "Format /dev/* as FAT (VFAT defaults)" },
 	{ "lls",       cmd_lls,       "local listing" },
@@ -52,6 +54,10 @@ static const Command g_cmds[] = {
     { "exit",      cmd_exit,      "exit                      # quit REPL" },
 	{ "debug",     cmd_debug,     "debug [iso|vfs|all] [on|off|toggle]" },
 	{ "cat",       cmd_cat,       "cat <path> [path...]" },
+    { "stress",    cmd_stress,    "stress [-t N] [-n M] \"<cmd>\"... # run commands in N threads (%t = thread no.)" },
+    { "sync",      cmd_sync,      "sync [-v]                 # write dirty cached blocks back to the images" },
+    { "vfsstat",   cmd_vfsstat,   "vfsstat [-H] [-z] [mp]    # per-mount op counts, latencies, cache hit rates" },
+    { "holes",     cmd_holes,     "holes <path>              # data and hole ranges (SEEK_DATA/SEEK_HOLE)" },
     { "quit",      cmd_exit,      "quit                      # quit REPL" },  // alias
 };
 
@@ -0,0 +1,135 @@
+// src/cmd_stress.c — run command lines concurrently to exercise VFS locking
+//
+// Usage: stress [-t threads] [-n iterations] [-v] "<command>" ["<command>" ...]
+//   Every thread runs the whole list of commands, in order, n times. "%t" in
+//   a command is replaced by the thread number so threads can write to their
+//   own files (e.g. "cp /iso/BIG.BIN /t/big%t"). stdout is discarded while the
+//   threads run unless -v is given; errors still reach stderr.
+//   Build with `make tsan` to run the same workload under ThreadSanitizer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "cmds.h"
+#include "gu_sync.h"
+
+#define STRESS_MAX_THREADS 64
+#define STRESS_MAX_CMDS    16
+
+typedef struct {
+    int          id;
+    int          iters;
+    int          ncmds;
+    char *const *cmds;
+    long         ok, failed;
+} stress_worker_t;
+
+/* Copy 'tmpl' into out, replacing each "%t" with the thread number. */
+static void expand_line(const char *tmpl, int id, char *out, size_t cap) {
+    size_t j = 0;
+    for (const char *p = tmpl; *p && j + 1 < cap; ++p) {
+        if (p[0] == '%' && p[1] == 't') {
+            int n = snprintf(out + j, cap - j, "%d", id);
+            if (n < 0 || (size_t)n >= cap - j) break;
+            j += (size_t)n;
+            ++p;
+        } else {
+            out[j++] = *p;
+        }
+    }
+    out[j] = '\0';
+}
+
+static void *stress_worker(void *arg) {
+    stress_worker_t *w = (stress_worker_t*)arg;
+    char line[1024];
+    for (int it = 0; it < w->iters; ++it) {
+        for (int c = 0; c < w->ncmds; ++c) {
+            expand_line(w->cmds[c], w->id, line, sizeof line);
+            if (run_command_line(line) == 0) w->ok++;
+            else                              w->failed++;
+        }
+    }
+    return NULL;
+}
+
+int cmd_stress(int argc, char **argv) {
+    int threads = 4, iters = 10, verbose = 0, first = argc;
+    for (int i = 1; i < argc; ++i) {
+        if      (!strcmp(argv[i], "-t") && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc) iters   = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))                 verbose = 1;
+        else { first = i; break; }
+    }
+    int ncmds = argc - first;
+    if (ncmds <= 0 || threads <= 0 || iters <= 0) {
+        fprintf(stderr, "usage: stress [-t threads] [-n iterations] [-v] \"<command>\" [...]\n");
+        return 2;
+    }
+    if (threads > STRESS_MAX_THREADS) threads = STRESS_MAX_THREADS;
+    if (ncmds > STRESS_MAX_CMDS) {
+        fprintf(stderr, "stress: at most %d commands\n", STRESS_MAX_CMDS);
+        return 2;
+    }
+    for (int c = 0; c < ncmds; ++c) {
+        if (!strncmp(argv[first + c], "stress", 6) || !strncmp(argv[first + c], "exit", 4)) {
+            fprintf(stderr, "stress: '%s' can't be stressed\n", argv[first + c]);
+            return 2;
+        }
+    }
+
+    stress_worker_t w[STRESS_MAX_THREADS];
+    pthread_t tid[STRESS_MAX_THREADS];
+
+#if !defined(_WIN32)
+    int saved_stdout = -1;
+    if (!verbose) {
+        fflush(stdout);
+        int devnull = open("/dev/null", O_WRONLY);
+        saved_stdout = devnull >= 0 ? dup(STDOUT_FILENO) : -1;
+        if (saved_stdout >= 0) dup2(devnull, STDOUT_FILENO);
+        if (devnull >= 0) close(devnull);
+    }
+#else
+    (void)verbose;
+#endif
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int started = 0;
+    for (int i = 0; i < threads; ++i) {
+        w[i] = (stress_worker_t){ .id = i, .iters = iters, .ncmds = ncmds, .cmds = argv + first };
+        if (pthread_create(&tid[i], NULL, stress_worker, &w[i]) != 0) break;
+        started++;
+    }
+    long ok = 0, failed = 0;
+    for (int i = 0; i < started; ++i) {
+        pthread_join(tid[i], NULL);
+        ok += w[i].ok;
+        failed += w[i].failed;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+#if !defined(_WIN32)
+    if (saved_stdout >= 0) {
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    }
+#endif
+
+    double ms = (double)(t1.tv_sec - t0.tv_sec) * 1e3 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+    printf("stress: %d threads x %d iterations x %d commands: %ld ok, %ld failed (%.1f ms)\n",
+           started, iters, ncmds, ok, failed, ms);
+    return (failed || started != threads) ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+// src/cmd_sync.c — flush dirty cached blocks to the backing images
+// Usage:
+//   sync [-v]
+//
+// -v : report how much was written back
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vfs.h"
+#include "bcache.h"
+
+int cmd_sync(int argc, char **argv) {
+    int verbose = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-v") == 0) verbose = 1;
+        else { fprintf(stderr, "usage: sync [-v]\n"); return 1; }
+    }
+
+    bcache_stats_t before, after;
+    bcache_get_stats(&before);
+    int rc = vfs_sync();
+    bcache_get_stats(&after);
+
+    if (rc != 0) fprintf(stderr, "sync: write-back failed (%d)\n", rc);
+    if (verbose)
+        printf("sync: %llu blocks in %llu writes; %llu cached, %llu dirty\n",
+               (unsigned long long)(after.blocks_written - before.blocks_written),
+               (unsigned long long)(after.runs - before.runs),
+               (unsigned long long)after.blocks,
+               (unsigned long long)after.dirty_blocks);
+    return rc != 0;
+}
@@ -29,10 +29,10 @@ static int is_parent_row(const vblk_t *e) { return e->part_index == -1; }
 static void list_devices(void) {
 	DBG("list_devices:");
 	
-    if (g_vblk_count == 0) { printf("(no devices registered)\n"); return; }
+    if (vblk_count() == 0) { printf("(no devices registered)\n"); return; }
 
-    for (int i = 0; i < g_vblk_count; ++i) {
-        const vblk_t *p = &g_vblk[i];
+    for (int i = 0; i < vblk_count(); ++i) {
+        const vblk_t *p = vblk_at(i);
         if (!is_parent_row(p)) continue;
 
         const char *devkey = p->dev[0] ? p->dev : p->name;
@@ -52,8 +52,8 @@ static void list_devices(void) {
 
         struct item { const vblk_t *row; int idx; } items[256];
         int n = 0;
-        for (int j = 0; j < g_vblk_count && n < (int)(sizeof items / sizeof items[0]); ++j) {
-            const vblk_t *e = &g_vblk[j];
+        for (int j = 0; j < vblk_count() && n < (int)(sizeof items / sizeof items[0]); ++j) {
+            const vblk_t *e = vblk_at(j);
             size_t plen = strlen(p->name);
             if (strncmp(e->name, p->name, plen) != 0) continue;
             if (e->name[plen] == '\0') continue; // parent
@@ -115,10 +115,7 @@ static int handle_use_attach(const char *image_path, const char *devname) {
     }
 
     /* Re-read the parent row we just registered so size reflects any updates from add_disk() */
-    const vblk_t *par = NULL;
-    for (int i = 0; i < g_vblk_count; ++i) {
-        if (strcmp(g_vblk[i].name, parent.name) == 0) { par = &g_vblk[i]; break; }
-    }
+    const vblk_t *par = vblk_by_name(parent.name);
     if (!par) par = &parent; /* fallback */
 
     const char *devkey = par->dev[0] ? par->dev : par->name;
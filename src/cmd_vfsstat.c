@@ -0,0 +1,156 @@
+// src/cmd_vfsstat.c — per-mount VFS operation counts, latencies and cache hit rates
+// Usage:
+//   vfsstat [-H] [-z] [mountpoint]
+//
+// -H : also print each operation's latency histogram
+// -z : reset the counters after printing
+//
+// Times nest (an open includes its lookups, a read the page cache misses),
+// so compare an operation's total time with the script's run time rather
+// than summing the column.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vfs.h"
+#include "bcache.h"
+#include "gu_arena.h"
+
+typedef struct {
+    const char *only;    /* mountpoint filter or NULL */
+    int hist, reset, shown;
+} vs_ctx_t;
+
+/* 1536 -> "1.5us"; latencies are bucket bounds, so one decimal is plenty. */
+static const char *fmt_ns(uint64_t ns, char *buf, size_t cap) {
+    if      (ns < 1000ull)        snprintf(buf, cap, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000ull)     snprintf(buf, cap, "%.1fus", (double)ns / 1e3);
+    else if (ns < 1000000000ull)  snprintf(buf, cap, "%.1fms", (double)ns / 1e6);
+    else                          snprintf(buf, cap, "%.1fs",  (double)ns / 1e9);
+    return buf;
+}
+
+static double pct(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+static void print_hist(const vfs_op_stats_t *o) {
+    uint64_t peak = 0;
+    for (int b = 0; b < VFS_OPSTAT_BUCKETS; ++b) if (o->hist[b] > peak) peak = o->hist[b];
+    for (int b = 0; b < VFS_OPSTAT_BUCKETS; ++b) {
+        if (!o->hist[b]) continue;
+        char lo[16], hi[16];
+        int bar = (int)((o->hist[b] * 40 + peak - 1) / peak);
+        printf("      %8s .. %-8s %10llu %.*s\n",
+               fmt_ns((uint64_t)1 << b, lo, sizeof lo), fmt_ns((uint64_t)2 << b, hi, sizeof hi),
+               (unsigned long long)o->hist[b], bar,
+               "########################################");
+    }
+}
+
+static void print_ops(const vfs_sb_stats_t *st, int hist) {
+    uint64_t calls = 0;
+    for (int op = 0; op < VFS_OP_NR; ++op) calls += st->op[op].calls;
+    if (!calls) { puts("  (no calls)"); return; }
+    printf("  %-9s %10s %7s %12s %10s %9s %9s %9s\n",
+           "op", "calls", "errors", "bytes", "total", "avg", "p50", "p99");
+    for (int op = 0; op < VFS_OP_NR; ++op) {
+        const vfs_op_stats_t *o = &st->op[op];
+        if (!o->calls) continue;
+        char tot[16], avg[16], p50[16], p99[16], bytes[24] = "-";
+        if (op == VFS_OP_READ || op == VFS_OP_WRITE)
+            snprintf(bytes, sizeof bytes, "%llu", (unsigned long long)o->bytes);
+        printf("  %-9s %10llu %7llu %12s %10s %9s %9s %9s\n", vfs_op_name((vfs_op_t)op),
+               (unsigned long long)o->calls, (unsigned long long)o->errors, bytes,
+               fmt_ns(o->ns, tot, sizeof tot), fmt_ns(o->ns / o->calls, avg, sizeof avg),
+               fmt_ns(vfs_op_stats_quantile(o, 0.50), p50, sizeof p50),
+               fmt_ns(vfs_op_stats_quantile(o, 0.99), p99, sizeof p99));
+        if (hist) print_hist(o);
+    }
+}
+
+static int mount_cb(const char *mp, const char *fstype, superblock_t *sb, void *user) {
+    vs_ctx_t *ctx = (vs_ctx_t*)user;
+    if (ctx->only && strcmp(ctx->only, mp) != 0) return 0;
+    ctx->shown++;
+    if (!sb) return 0;
+
+    vfs_sb_stats_t st;
+    vfs_sb_stats_get(sb, &st);
+    const uint64_t ig = st.icache_hits + st.icache_misses;
+    printf("%s (%s)  inode cache %llu/%llu hits (%.1f%%)\n", mp, fstype,
+           (unsigned long long)st.icache_hits, (unsigned long long)ig, pct(st.icache_hits, ig));
+    print_ops(&st, ctx->hist);
+    if (ctx->reset) vfs_sb_stats_reset(sb);
+    return 0;
+}
+
+static void print_caches(void) {
+    vfs_pagecache_stats_t pc;
+    bcache_stats_t bc;
+    vfs_mmap_stats_t mm;
+    gu_arena_stats_t ar;
+    vfs_dindex_stats_t dx;
+    vfs_intern_stats_t in;
+    vfs_pagecache_get_stats(&pc);
+    bcache_get_stats(&bc);
+    vfs_mmap_get_stats(&mm);
+    gu_arena_get_stats(&ar);
+    vfs_dindex_get_stats(&dx);
+    vfs_intern_get_stats(&in);
+
+    printf("\ninode cache  %zu inodes\n", vfs_inode_cache_count());
+    printf("dir index    %llu dirs, %llu names, %llu bytes; %llu built, %llu evicted\n",
+           (unsigned long long)dx.indexes, (unsigned long long)dx.entries,
+           (unsigned long long)dx.bytes, (unsigned long long)dx.builds,
+           (unsigned long long)dx.evictions);
+    printf("names        %llu interned, %llu bytes, %llu slots\n",
+           (unsigned long long)in.atoms, (unsigned long long)in.bytes,
+           (unsigned long long)in.slots);
+    printf("page cache   %llu pages, %llu/%llu hits (%.1f%%), %llu readahead, %llu evicted\n",
+           (unsigned long long)pc.pages, (unsigned long long)pc.hits,
+           (unsigned long long)(pc.hits + pc.misses), pct(pc.hits, pc.hits + pc.misses),
+           (unsigned long long)pc.readahead, (unsigned long long)pc.evictions);
+    printf("block cache  %llu blocks (%llu dirty), %llu/%llu hits (%.1f%%), "
+           "%llu blocks written in %llu runs\n",
+           (unsigned long long)bc.blocks, (unsigned long long)bc.dirty_blocks,
+           (unsigned long long)bc.hits, (unsigned long long)(bc.hits + bc.misses),
+           pct(bc.hits, bc.hits + bc.misses),
+           (unsigned long long)bc.blocks_written, (unsigned long long)bc.runs);
+    printf("mmap         %llu direct, %llu copied, %llu live (%llu bytes)\n",
+           (unsigned long long)mm.direct, (unsigned long long)mm.copied,
+           (unsigned long long)mm.live, (unsigned long long)mm.live_bytes);
+    printf("arena        %llu allocs, %llu bytes held, %llu high water\n",
+           (unsigned long long)ar.allocs, (unsigned long long)ar.chunk_bytes,
+           (unsigned long long)ar.high_water);
+}
+
+int cmd_vfsstat(int argc, char **argv) {
+    vs_ctx_t ctx = {0};
+    for (int i = 1; i < argc; ++i) {
+        if      (strcmp(argv[i], "-H") == 0) ctx.hist = 1;
+        else if (strcmp(argv[i], "-z") == 0) ctx.reset = 1;
+        else if (argv[i][0] != '-' && !ctx.only) ctx.only = argv[i];
+        else { fprintf(stderr, "usage: vfsstat [-H] [-z] [mountpoint]\n"); return 1; }
+    }
+
+    (void)vfs_for_each_mount(mount_cb, &ctx);
+    if (ctx.only) {
+        if (!ctx.shown) { fprintf(stderr, "vfsstat: %s: not a mountpoint\n", ctx.only); return 1; }
+        return 0;
+    }
+    if (!ctx.shown) puts("(no mounts)");
+
+    /* calls that never reached a mount: bad paths and the like */
+    vfs_sb_stats_t st;
+    vfs_sb_stats_get(NULL, &st);
+    uint64_t lost = 0;
+    for (int op = 0; op < VFS_OP_NR; ++op) lost += st.op[op].calls;
+    if (lost) {
+        printf("(no mount)\n");
+        print_ops(&st, ctx.hist);
+        if (ctx.reset) vfs_sb_stats_reset(NULL);
+    }
+    print_caches();
+    return 0;
+}
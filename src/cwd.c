@@ -4,7 +4,8 @@
 
 #include "cwd.h"
 
-static char g_cwd[256] = "/";
+/* per thread: each embedding thread (or stress worker) has its own cwd */
+static _Thread_local char g_cwd[256] = "/";
 
 const char* cwd_get(void) {
     return g_cwd;
@@ -1,8 +1,26 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE             /* copy_file_range(2) */
+#endif
+
 #include "diskio.h"
+#include "bcache.h"
+#include "gu_sync.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/stat.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>           /* diskio_map_range */
+#endif
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/fs.h>           /* FICLONERANGE */
+#endif
+
 /* ========================= existing file_* I/O ========================= */
 
 bool file_pread(void *buf, size_t n, size_t off, const char *path) {
@@ -11,6 +29,7 @@ bool file_pread(void *buf, size_t n, size_t off, const char *path) {
     if (fseek(f, (long)off, SEEK_SET) != 0) { fclose(f); return false; }
     size_t got = fread(buf, 1, n, f);
     fclose(f);
+    if (got == n) bcache_overlay(path, off, buf, n);    /* dirty cached blocks win */
     return got == n;
 }
 
@@ -21,6 +40,7 @@ bool file_pwrite(const void *buf, size_t n, size_t off, const char *path) {
     if (fseek(f, (long)off, SEEK_SET) != 0) { fclose(f); return false; }
     size_t put = fwrite(buf, 1, n, f);
     fclose(f);
+    if (put == n) bcache_update(path, off, buf, n);
     return put == n;
 }
 
@@ -45,15 +65,34 @@ typedef struct {
     char path[DISKIO_PATH_MAX]; /* backing file path */
 } diskio_map_entry_t;
 
-static diskio_map_entry_t g_map[DISKIO_MAX_MAP];
-static int g_map_count = 0;
+/* Entries are immutable once published and never freed: diskio_resolve()
+   hands out entry->path without holding anything, so a concurrent re-attach
+   or detach only swaps/clears the slot pointer. Writers serialise on
+   g_map_lock. The stdio backend below opens a private FILE per request, so
+   I/O itself needs no per-device serialisation. */
+static diskio_map_entry_t *_Atomic g_map[DISKIO_MAX_MAP];
+static _Atomic int g_map_count = 0;     /* slots ever used (high-water mark) */
+static gu_mutex_t  g_map_lock = GU_MUTEX_INIT;
 
 static int map_find_index(const char *devkey) {
-    for (int i = 0; i < g_map_count; ++i)
-        if (strcmp(g_map[i].key, devkey) == 0) return i;
+    const int n = atomic_load_explicit(&g_map_count, memory_order_acquire);
+    for (int i = 0; i < n; ++i) {
+        diskio_map_entry_t *e = atomic_load_explicit(&g_map[i], memory_order_acquire);
+        if (e && strcmp(e->key, devkey) == 0) return i;
+    }
     return -1;
 }
 
+/* Whether any attached devkey still maps to path (g_map_lock held). */
+static bool path_in_use(const char *path) {
+    const int n = atomic_load_explicit(&g_map_count, memory_order_relaxed);
+    for (int i = 0; i < n; ++i) {
+        diskio_map_entry_t *e = atomic_load_explicit(&g_map[i], memory_order_relaxed);
+        if (e && strcmp(e->path, path) == 0) return true;
+    }
+    return false;
+}
+
 static int is_devkey(const char *s) {
     return s && s[0]=='/' && s[1]=='d' && s[2]=='e' && s[3]=='v' && s[4]=='/';
 }
@@ -68,29 +107,51 @@ bool diskio_attach_image(const char *devkey, const char *path, uint64_t *bytes_o
         return false;
     }
 
+    diskio_map_entry_t *e = (diskio_map_entry_t*)malloc(sizeof *e);
+    if (!e) return false;
+    snprintf(e->key,  sizeof e->key,  "%.*s",  (int)sizeof e->key  - 1, devkey);
+    snprintf(e->path, sizeof e->path, "%.*s",  (int)sizeof e->path - 1, path);
+
+    gu_mutex_lock(&g_map_lock);
     int idx = map_find_index(devkey);
     if (idx < 0) {
-        if (g_map_count >= DISKIO_MAX_MAP) return false;
-        idx = g_map_count++;
+        const int n = atomic_load_explicit(&g_map_count, memory_order_relaxed);
+        for (int i = 0; i < n && idx < 0; ++i)
+            if (!atomic_load_explicit(&g_map[i], memory_order_relaxed)) idx = i;   /* reuse a detached slot */
+        if (idx < 0 && n < DISKIO_MAX_MAP) idx = n;
+    }
+    if (idx < 0) {
+        gu_mutex_unlock(&g_map_lock);
+        free(e);
+        return false;
     }
-    snprintf(g_map[idx].key,  sizeof g_map[idx].key,  "%.*s",  (int)sizeof g_map[idx].key  - 1, devkey);
-    snprintf(g_map[idx].path, sizeof g_map[idx].path, "%.*s",  (int)sizeof g_map[idx].path - 1, path);
+    diskio_map_entry_t *old = atomic_exchange_explicit(&g_map[idx], e, memory_order_acq_rel);
+    if (idx == atomic_load_explicit(&g_map_count, memory_order_relaxed))
+        atomic_store_explicit(&g_map_count, idx + 1, memory_order_release);
+    const bool release = old && !path_in_use(old->path);
+    gu_mutex_unlock(&g_map_lock);
+    if (release) (void)bcache_release(old->path);   /* the image it named is closed */
 
     if (bytes_out) *bytes_out = sz;
     return true;
 }
 
 bool diskio_detach(const char *devkey) {
+    gu_mutex_lock(&g_map_lock);
     int idx = map_find_index(devkey);
-    if (idx < 0) return false;
-    for (int i = idx + 1; i < g_map_count; ++i) g_map[i-1] = g_map[i];
-    --g_map_count;
-    return true;
+    diskio_map_entry_t *old = idx >= 0 ? atomic_exchange_explicit(&g_map[idx], NULL, memory_order_acq_rel) : NULL;
+    const bool release = old && !path_in_use(old->path);
+    gu_mutex_unlock(&g_map_lock);
+    if (release) (void)bcache_release(old->path);
+    return idx >= 0;
 }
 
 const char *diskio_resolve(const char *devkey) {
     int idx = map_find_index(devkey);
-    if (idx >= 0) return g_map[idx].path;
+    if (idx >= 0) {
+        diskio_map_entry_t *e = atomic_load_explicit(&g_map[idx], memory_order_acquire);
+        if (e) return e->path;
+    }
 
     /* SAFETY: never treat /dev/ as a host path */
     if (is_devkey(devkey)) return NULL;
@@ -119,8 +180,215 @@ bool diskio_pwrite(const char *devkey, uint64_t off, const void *src, uint32_t l
     return file_pwrite(src, (size_t)len, (size_t)off, path);
 }
 
+/* Same as above, but through the block cache: reads are served from memory
+   when possible and writes are left dirty for the writeback thread. */
+bool diskio_pread_cached(const char *devkey, uint64_t off, void *dst, uint32_t len) {
+    if (!dst) return false;
+    const char *path = diskio_resolve(devkey);
+    if (!path) {
+        fprintf(stderr, "diskio_pread: unmapped devkey '%s'\n", devkey ? devkey : "(null)");
+        return false;
+    }
+    return bcache_read(path, off, dst, len);
+}
+
+bool diskio_pwrite_cached(const char *devkey, uint64_t off, const void *src, uint32_t len) {
+    if (!src) return false;
+    const char *path = diskio_resolve(devkey);
+    if (!path) {
+        fprintf(stderr, "diskio_pwrite: unmapped devkey '%s'\n", devkey ? devkey : "(null)");
+        return false;
+    }
+    return bcache_write(path, off, src, len);
+}
+
+int diskio_sync(const char *devkey) {
+    if (!devkey) return bcache_sync(NULL);
+    const char *path = diskio_resolve(devkey);
+    return path ? bcache_sync(path) : -ENODEV;
+}
+
 uint64_t diskio_size_bytes(const char *devkey) {
     const char *path = diskio_resolve(devkey);
     if (!path) return 0;
     return filesize_bytes(path);
-}
\ No newline at end of file
+}
+/* ====================== read-only image mappings ======================= */
+
+#if !defined(_WIN32)
+static size_t host_page_size(void) {
+    long ps = sysconf(_SC_PAGESIZE);
+    return ps > 0 ? (size_t)ps : 4096u;
+}
+#endif
+
+/* mmap(2) wants a page-aligned file offset: map from the page holding 'off'
+   and hand back a pointer into it. The mapping is shared, so it keeps
+   seeing the image (and cache write-back) for as long as it lives. */
+const void *diskio_map_range(const char *devkey, uint64_t off, size_t len) {
+#if !defined(_WIN32)
+    const char *path = diskio_resolve(devkey);
+    if (!path || len == 0) return NULL;
+    if (off + len > filesize_bytes(path)) return NULL;
+    if (bcache_sync(path) != 0) return NULL;            /* dirty blocks first */
+
+    const size_t ps = host_page_size();
+    const uint64_t base = off & ~(uint64_t)(ps - 1);
+    const size_t lead = (size_t)(off - base);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    void *p = mmap(NULL, lead + len, PROT_READ, MAP_SHARED, fd, (off_t)base);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    return (const uint8_t*)p + lead;
+#else
+    (void)devkey; (void)off; (void)len;
+    return NULL;
+#endif
+}
+
+void diskio_unmap_range(const void *addr, size_t len) {
+#if !defined(_WIN32)
+    if (!addr) return;
+    const size_t lead = (size_t)((uintptr_t)addr & (host_page_size() - 1));
+    (void)munmap((void*)((uintptr_t)addr - lead), lead + len);
+#else
+    (void)addr; (void)len;
+#endif
+}
+
+/* ====================== host-side range copy ======================= */
+
+#ifndef DISKIO_COPY_BUF
+#define DISKIO_COPY_BUF (1u << 20)
+#endif
+
+/* Portable fallback: big chunks through a heap buffer. */
+static bool copy_range_buffered(const char *sp, uint64_t so, const char *dp, uint64_t dof, uint64_t len) {
+    size_t cap = len < DISKIO_COPY_BUF ? (size_t)len : DISKIO_COPY_BUF;
+    uint8_t *buf = (uint8_t*)malloc(cap ? cap : 1);
+    if (!buf) return false;
+    bool ok = true;
+    while (len && ok) {
+        size_t n = len < cap ? (size_t)len : cap;
+        ok = file_pread(buf, n, (size_t)so, sp) && file_pwrite(buf, n, (size_t)dof, dp);
+        so += n; dof += n; len -= n;
+    }
+    free(buf);
+    return ok;
+}
+
+#if defined(__linux__)
+/* Try a reflink first (shares blocks on btrfs/xfs/...; needs fs-block
+   alignment), then in-kernel copy_file_range. Returns bytes moved; the
+   caller finishes whatever is left the slow way. */
+static uint64_t copy_range_kernel(int sfd, uint64_t so, int dfd, uint64_t dof, uint64_t len,
+                                  diskio_copy_how_t *how) {
+#ifdef FICLONERANGE
+    struct file_clone_range cr = {
+        .src_fd = sfd, .src_offset = so, .src_length = len, .dest_offset = dof,
+    };
+    if (ioctl(dfd, FICLONERANGE, &cr) == 0) { *how = DISKIO_COPY_CLONE; return len; }
+#endif
+    uint64_t done = 0;
+    loff_t si = (loff_t)so, di = (loff_t)dof;
+    while (done < len) {
+        size_t want = (len - done) > (1u << 30) ? (1u << 30) : (size_t)(len - done);
+        ssize_t n = copy_file_range(sfd, &si, dfd, &di, want, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;    /* EXDEV/ENOSYS/EINVAL or short source: fall back */
+        done += (uint64_t)n;
+    }
+    if (done) *how = DISKIO_COPY_KERNEL;
+    return done;
+}
+#endif
+
+bool diskio_copy_range(const char *src_key, uint64_t src_off,
+                       const char *dst_key, uint64_t dst_off,
+                       uint64_t len, diskio_copy_how_t *how_out)
+{
+    diskio_copy_how_t how = DISKIO_COPY_BUFFERED;
+    const char *sp = diskio_resolve(src_key);
+    const char *dp = diskio_resolve(dst_key);
+    if (!sp || !dp) {
+        fprintf(stderr, "diskio_copy_range: unmapped devkey '%s' or '%s'\n",
+                src_key ? src_key : "(null)", dst_key ? dst_key : "(null)");
+        return false;
+    }
+    if (len == 0) { if (how_out) *how_out = how; return true; }
+
+    /* overlapping ranges of one image would need memmove semantics */
+    bool same = strcmp(sp, dp) == 0;
+    if (same && src_off < dst_off + len && dst_off < src_off + len) return false;
+
+    /* the host copies what is on disk, so get dirty blocks there first */
+    if (bcache_sync(sp) != 0 || (!same && bcache_sync(dp) != 0)) return false;
+    const uint64_t inval_off = dst_off, inval_len = len;
+
+#if defined(__linux__)
+    int sfd = open(sp, O_RDONLY);
+    int dfd = sfd >= 0 ? open(dp, O_WRONLY) : -1;
+    if (sfd >= 0 && dfd >= 0) {
+        uint64_t done = copy_range_kernel(sfd, src_off, dfd, dst_off, len, &how);
+        src_off += done; dst_off += done; len -= done;
+    }
+    if (dfd >= 0) close(dfd);
+    if (sfd >= 0) close(sfd);
+#endif
+
+    bool ok = len == 0 || copy_range_buffered(sp, src_off, dp, dst_off, len);
+    bcache_invalidate(dp, inval_off, inval_len);
+    if (how_out) *how_out = how;
+    return ok;
+}
+
+#ifndef DISKIO_ZERO_BUF
+#define DISKIO_ZERO_BUF (1u << 20)
+#endif
+
+/* Zero [off, off+len): punch a hole, else (unless punch_only) have the
+   kernel zero it, else write zeros. */
+static bool zero_range(const char *devkey, uint64_t off, uint64_t len, bool punch_only) {
+    const char *path = diskio_resolve(devkey);
+    if (!path) {
+        fprintf(stderr, "diskio_zero_range: unmapped devkey '%s'\n", devkey ? devkey : "(null)");
+        return false;
+    }
+    if (len == 0) return true;
+    bcache_invalidate(path, off, len);          /* writes dirty blocks first, so ours land last */
+
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    int fd = open(path, O_WRONLY);
+    if (fd >= 0) {
+        bool done = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)off, (off_t)len) == 0;
+#ifdef FALLOC_FL_ZERO_RANGE
+        if (!done && !punch_only)
+            done = fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, (off_t)off, (off_t)len) == 0;
+#endif
+        close(fd);
+        if (done) return true;
+    }
+#endif
+    if (punch_only) return false;
+
+    size_t cap = len < DISKIO_ZERO_BUF ? (size_t)len : DISKIO_ZERO_BUF;
+    uint8_t *zero = (uint8_t*)calloc(1, cap);
+    if (!zero) return false;
+    bool ok = true;
+    while (len && ok) {
+        size_t n = len < cap ? (size_t)len : cap;
+        ok = file_pwrite(zero, n, (size_t)off, path);
+        off += n; len -= n;
+    }
+    free(zero);
+    return ok;
+}
+
+bool diskio_discard(const char *devkey, uint64_t off, uint64_t len) {
+    return zero_range(devkey, off, len, true);
+}
+
+bool diskio_zero_range(const char *devkey, uint64_t off, uint64_t len) {
+    return zero_range(devkey, off, len, false);
+}
@@ -0,0 +1,119 @@
+// src/ext2_bitmap.c — searching and updating ext2 block/inode bitmaps
+//
+// A bitmap is handled as an array of 64-bit words (bit i is bit i%64 of
+// word i/64, which is the on-disk byte order on a little-endian host), so a
+// search tests 64 bits per step and finds the bit inside a word with one
+// count-trailing-zeros. Long stretches of full (or empty) words are skipped
+// 256 bits at a time with AVX2 when the CPU has it.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ext2.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define EXT2_BITMAP_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+static inline unsigned ctz64(uint64_t w)      { return (unsigned)__builtin_ctzll(w); }
+static inline unsigned popcount64(uint64_t w) { return (unsigned)__builtin_popcountll(w); }
+#else
+static inline unsigned ctz64(uint64_t w) {
+    unsigned n = 0;
+    while (!(w & 1u)) { w >>= 1; n++; }
+    return n;
+}
+static inline unsigned popcount64(uint64_t w) {
+    w = w - ((w >> 1) & 0x5555555555555555ull);
+    w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (unsigned)((w * 0x0101010101010101ull) >> 56);
+}
+#endif
+
+/* First word at or after w (below n) that is not 'pat'. */
+static size_t skip_words_scalar(const uint64_t *map, size_t w, size_t n, uint64_t pat) {
+    while (w < n && map[w] == pat) w++;
+    return w;
+}
+
+#ifdef EXT2_BITMAP_AVX2
+__attribute__((target("avx2")))
+static size_t skip_words_avx2(const uint64_t *map, size_t w, size_t n, uint64_t pat) {
+    const __m256i p = _mm256_set1_epi64x((long long)pat);
+    for (; w + 4 <= n; w += 4) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(map + w));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, p)) != -1) break;
+    }
+    return skip_words_scalar(map, w, n, pat);
+}
+#endif
+
+static size_t skip_words(const uint64_t *map, size_t w, size_t n, uint64_t pat) {
+#ifdef EXT2_BITMAP_AVX2
+    if (n - w >= 8 && __builtin_cpu_supports("avx2")) return skip_words_avx2(map, w, n, pat);
+#endif
+    return skip_words_scalar(map, w, n, pat);
+}
+
+/* First bit at or after 'from' (below nbits) equal to 'one', else nbits. */
+static uint32_t next_bit(const uint64_t *map, uint32_t from, uint32_t nbits, bool one) {
+    if (from >= nbits) return nbits;
+    const size_t nwords = ((size_t)nbits + 63) / 64;
+    const uint64_t flip = one ? 0 : ~0ull;          /* search for set bits in map ^ flip */
+    size_t w = from / 64;
+    uint64_t word = (map[w] ^ flip) & (~0ull << (from % 64));
+    while (!word) {
+        w = skip_words(map, w + 1, nwords, flip);
+        if (w >= nwords) return nbits;
+        word = map[w] ^ flip;
+    }
+    const uint64_t at = (uint64_t)w * 64 + ctz64(word);
+    return at < nbits ? (uint32_t)at : nbits;
+}
+
+uint32_t ext2_bitmap_next_zero(const uint64_t *map, uint32_t from, uint32_t nbits) {
+    return next_bit(map, from, nbits, false);
+}
+
+uint32_t ext2_bitmap_zero_run(const uint64_t *map, uint32_t from, uint32_t nbits, uint32_t max) {
+    if (from >= nbits) return 0;
+    const uint32_t end = (max < nbits - from) ? from + max : nbits;
+    return next_bit(map, from, end, true) - from;
+}
+
+void ext2_bitmap_set_range(uint64_t *map, uint32_t from, uint32_t n) {
+    while (n) {
+        const uint32_t bit = from % 64;
+        const uint32_t take = (n < 64 - bit) ? n : 64 - bit;
+        const uint64_t mask = (take == 64 ? ~0ull : ((1ull << take) - 1)) << bit;
+        map[from / 64] |= mask;
+        from += take;
+        n -= take;
+    }
+}
+
+uint32_t ext2_bitmap_clear_range(uint64_t *map, uint32_t from, uint32_t n) {
+    uint32_t was = 0;
+    while (n) {
+        const uint32_t bit = from % 64;
+        const uint32_t take = (n < 64 - bit) ? n : 64 - bit;
+        const uint64_t mask = (take == 64 ? ~0ull : ((1ull << take) - 1)) << bit;
+        was += popcount64(map[from / 64] & mask);
+        map[from / 64] &= ~mask;
+        from += take;
+        n -= take;
+    }
+    return was;
+}
+
+uint32_t ext2_bitmap_count(const uint64_t *map, uint32_t nbits) {
+    uint32_t n = 0;
+    const size_t full = nbits / 64;
+    for (size_t w = 0; w < full; ++w) n += popcount64(map[w]);
+    if (nbits % 64) n += popcount64(map[full] & ((1ull << (nbits % 64)) - 1));
+    return n;
+}
@@ -0,0 +1,658 @@
+// src/ext2_fsck.c — read-only ext2 consistency check (fsck.ext2 -n)
+//
+// The passes are e2fsck's, without the repairs:
+//   1. inodes: a pool of threads takes block groups one at a time and reads
+//      each group's inode table in large sequential slices. Every inode in
+//      use has its block tree walked; the blocks it owns are set in a
+//      per-group bitset of blocks found (an atomic OR, so a block claimed
+//      twice is caught by whichever thread gets there second), and its
+//      i_blocks, i_size and inode bitmap bit are checked.
+//   2. directories: the same threads go through the directories pass 1
+//      found, checking every record and taking one off the target's link
+//      count for each name that points at it.
+//   4. link counts: whatever is left of a count is an error.
+//   5. bitmaps and counts: the blocks found are compared with the on-disk
+//      block bitmaps, and free and directory counts with the descriptors
+//      and the superblock.
+// Memory is one bit per block and two per inode, kept per group, plus a
+// 16-bit count per inode. The report is a single JSON object.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "diskio.h"
+#include "ext2.h"
+#include "gu_sync.h"
+
+#define FSCK_ITAB_SLICE  (1u << 20)     /* inode table bytes per read */
+#define FSCK_MAX_THREADS 64
+#define FSCK_NO_GROUP    UINT32_MAX
+
+typedef enum {
+    P_BAD_GROUP_DESC, P_ROOT,
+    P_BAD_BLOCK, P_DUP_BLOCK, P_I_BLOCKS, P_I_SIZE, P_EMPTY_DIR,
+    P_BAD_DIRENT, P_BAD_DOT, P_BAD_DOTDOT, P_DIRENT_UNUSED_INODE, P_FILE_TYPE,
+    P_LINK_COUNT, P_UNATTACHED_INODE,
+    P_INODE_NOT_MARKED, P_INODE_MARKED_UNUSED, P_BLOCK_USED_UNMARKED, P_BLOCK_MARKED_UNUSED,
+    P_GROUP_FREE_BLOCKS, P_GROUP_FREE_INODES, P_GROUP_DIRS, P_FREE_BLOCKS, P_FREE_INODES,
+    P_COUNT
+} fsck_code_t;
+
+static const struct { const char *name; unsigned pass; } k_code[P_COUNT] = {
+    [P_BAD_GROUP_DESC]      = { "bad_group_desc",      0 },
+    [P_ROOT]                = { "root_not_directory",  1 },
+    [P_BAD_BLOCK]           = { "bad_block",           1 },
+    [P_DUP_BLOCK]           = { "dup_block",           1 },
+    [P_I_BLOCKS]            = { "i_blocks",            1 },
+    [P_I_SIZE]              = { "i_size",              1 },
+    [P_EMPTY_DIR]           = { "zero_length_dir",     1 },
+    [P_BAD_DIRENT]          = { "bad_dirent",          2 },
+    [P_BAD_DOT]             = { "bad_dot",             2 },
+    [P_BAD_DOTDOT]          = { "bad_dotdot",          2 },
+    [P_DIRENT_UNUSED_INODE] = { "dirent_unused_inode", 2 },
+    [P_FILE_TYPE]           = { "file_type",           2 },
+    [P_LINK_COUNT]          = { "link_count",          4 },
+    [P_UNATTACHED_INODE]    = { "unattached_inode",    4 },
+    [P_INODE_NOT_MARKED]    = { "inode_not_marked",    5 },
+    [P_INODE_MARKED_UNUSED] = { "inode_marked_unused", 5 },
+    [P_BLOCK_USED_UNMARKED] = { "block_used_unmarked", 5 },
+    [P_BLOCK_MARKED_UNUSED] = { "block_marked_unused", 5 },
+    [P_GROUP_FREE_BLOCKS]   = { "group_free_blocks",   5 },
+    [P_GROUP_FREE_INODES]   = { "group_free_inodes",   5 },
+    [P_GROUP_DIRS]          = { "group_dirs",          5 },
+    [P_FREE_BLOCKS]         = { "free_blocks",         5 },
+    [P_FREE_INODES]         = { "free_inodes",         5 },
+};
+
+#define FSCK_FOUND    1u
+#define FSCK_EXPECTED 2u
+#define FSCK_VALUES   (FSCK_FOUND | FSCK_EXPECTED)
+
+/* One finding; fields that don't apply are FSCK_NO_GROUP / 0 / not in 'has'. */
+typedef struct fsck_problem {
+    fsck_code_t code;
+    uint32_t    group, ino;
+    uint32_t    blk;
+    unsigned    has;
+    int64_t     found, expected;
+    char       *name;
+} fsck_problem_t;
+
+typedef struct fsck {
+    const char *key;
+    uint64_t    off;
+    ext2_superblock sb;
+    ext2_group_desc *gd;
+    bool       *bad_gd;         /* descriptor points outside the fs: group skipped */
+    uint32_t    bs, ngroups, bpg, ipg, isz, apb, first_ino;
+    uint32_t    bwords, iwords; /* bitset words per group */
+    bool        filetype;
+    uint64_t   *found;          /* blocks owned by something, bwords per group */
+    uint64_t   *live, *dirs;    /* inodes in use / directories, iwords per group */
+    uint16_t   *links;          /* i_links_count minus names seen, mod 2^16 */
+    int         pass;
+    uint32_t    next;           /* next group for a worker (atomic) */
+    uint64_t    free_blocks, free_inodes, used_dirs;   /* pass 5 totals (atomic) */
+    bool        io_error;
+    gu_mutex_t  lock;           /* the problem list */
+    fsck_problem_t *p;
+    size_t      np, max_report;
+    uint64_t    total, by_code[P_COUNT];
+} fsck_t;
+
+typedef struct fsck_thr {
+    fsck_t   *c;
+    uint8_t  *itab;             /* FSCK_ITAB_SLICE */
+    uint32_t *ind[3];           /* one indirect block per level */
+    uint8_t  *blk;              /* a directory or bitmap block */
+} fsck_thr_t;
+
+static void report(fsck_t *c, fsck_problem_t p) {
+    gu_mutex_lock(&c->lock);
+    c->total++;
+    c->by_code[p.code]++;
+    if (c->np < c->max_report) c->p[c->np++] = p;
+    else free(p.name);
+    gu_mutex_unlock(&c->lock);
+}
+
+static void io_failed(fsck_t *c, uint32_t blk) {
+    fprintf(stderr, "fsck.ext2: read error at block %u\n", blk);
+    __atomic_store_n(&c->io_error, true, __ATOMIC_RELAXED);
+}
+
+static bool read_blocks(fsck_t *c, uint32_t blk, void *dst, uint32_t len) {
+    if (diskio_pread(c->key, c->off + (uint64_t)blk * c->bs, dst, len)) return true;
+    io_failed(c, blk);
+    return false;
+}
+
+static inline bool bit(const uint64_t *map, uint32_t i) { return (map[i / 64] >> (i % 64)) & 1u; }
+static inline void set_bit(uint64_t *map, uint32_t i)   { map[i / 64] |= 1ull << (i % 64); }
+
+static inline uint64_t *group_inodes(const fsck_t *c, uint64_t *set, uint32_t g) { return set + (size_t)g * c->iwords; }
+
+static bool inode_bit(const fsck_t *c, const uint64_t *set, uint32_t ino) {
+    const uint32_t g = (ino - 1) / c->ipg, i = (ino - 1) % c->ipg;
+    return bit(set + (size_t)g * c->iwords, i);
+}
+
+static uint32_t group_blocks(const fsck_t *c, uint32_t g) {
+    const uint32_t left = c->sb.s_blocks_count - c->sb.s_first_data_block - g * c->bpg;
+    return left < c->bpg ? left : c->bpg;
+}
+
+static inline bool block_ok(const fsck_t *c, uint32_t blk) {
+    return blk >= c->sb.s_first_data_block && blk < c->sb.s_blocks_count;
+}
+
+/* Mark blk as owned (by inode ino; 0: filesystem metadata). false if it
+   already was, which is reported unless 'shared' (xattr blocks may be). */
+static bool claim(fsck_t *c, uint32_t blk, uint32_t ino, bool shared) {
+    const uint32_t rel = blk - c->sb.s_first_data_block;
+    const uint32_t g = rel / c->bpg, i = rel % c->bpg;
+    uint64_t *w = &c->found[(size_t)g * c->bwords + i / 64];
+    const uint64_t m = 1ull << (i % 64);
+    if (!(__atomic_fetch_or(w, m, __ATOMIC_RELAXED) & m)) return true;
+    if (!shared)
+        report(c, (fsck_problem_t){ .code = P_DUP_BLOCK, .group = FSCK_NO_GROUP, .ino = ino, .blk = blk });
+    return false;
+}
+
+/* ---- block trees ---- */
+
+typedef bool (*fsck_blk_fn)(fsck_thr_t *t, void *arg, uint64_t lblk, uint32_t pblk, bool meta);
+
+/* Visit blk (an indirect block of 'level', or data at level 0, holding
+   logical blocks from lblk) and everything under it. Pointers outside the
+   filesystem are skipped, and reported when 'loud'. false: stop. */
+static bool walk(fsck_thr_t *t, uint32_t ino, uint32_t blk, unsigned level, uint64_t lblk,
+                 bool loud, fsck_blk_fn fn, void *arg) {
+    fsck_t *c = t->c;
+    if (!block_ok(c, blk)) {
+        if (loud) report(c, (fsck_problem_t){ .code = P_BAD_BLOCK, .group = FSCK_NO_GROUP, .ino = ino, .blk = blk });
+        return true;
+    }
+    if (!fn(t, arg, lblk, blk, level > 0)) return false;
+    if (level == 0) return true;
+    uint32_t *tab = t->ind[level - 1];
+    if (!read_blocks(c, blk, tab, c->bs)) return false;
+    uint64_t per = 1;
+    for (unsigned k = 1; k < level; ++k) per *= c->apb;
+    for (uint32_t s = 0; s < c->apb; ++s)
+        if (tab[s] && !walk(t, ino, tab[s], level - 1, lblk + s * per, loud, fn, arg)) return false;
+    return true;
+}
+
+static bool walk_inode(fsck_thr_t *t, uint32_t ino, const ext2_inode *di, bool loud, fsck_blk_fn fn, void *arg) {
+    for (uint32_t i = 0; i < EXT2_NDIR_BLOCKS; ++i)
+        if (di->i_block[i] && !walk(t, ino, di->i_block[i], 0, i, loud, fn, arg)) return false;
+    uint64_t base = EXT2_NDIR_BLOCKS, span = t->c->apb;
+    for (unsigned d = 0; d < 3; ++d, base += span, span *= t->c->apb) {
+        const uint32_t blk = di->i_block[EXT2_IND_BLOCK + d];
+        if (blk && !walk(t, ino, blk, d + 1, base, loud, fn, arg)) return false;
+    }
+    return true;
+}
+
+/* Only directories, regular files and slow symlinks have a block tree. */
+static bool has_blocks(const ext2_inode *di) {
+    switch (di->i_mode & 0170000) {
+    case 0040000: case 0100000: return true;
+    case 0120000: return di->i_blocks != 0 && di->i_blocks != (di->i_file_acl ? 1u : 0u);
+    default:      return di->i_mode == 0;           /* reserved inodes (bad blocks) */
+    }
+}
+
+/* ---- pass 1: inodes ---- */
+
+typedef struct p1_inode {
+    uint32_t ino;
+    uint64_t nblk, last;
+    bool     any;
+} p1_inode_t;
+
+static bool p1_block(fsck_thr_t *t, void *arg, uint64_t lblk, uint32_t pblk, bool meta) {
+    p1_inode_t *a = (p1_inode_t*)arg;
+    a->nblk++;
+    if (!meta && (!a->any || lblk > a->last)) { a->last = lblk; a->any = true; }
+    (void)claim(t->c, pblk, a->ino, false);
+    return true;
+}
+
+static void check_inode(fsck_thr_t *t, uint32_t ino, const ext2_inode *di, bool marked) {
+    fsck_t *c = t->c;
+    const uint32_t g = (ino - 1) / c->ipg, i = (ino - 1) % c->ipg;
+    const bool reserved = ino < c->first_ino && ino != EXT2_ROOT_INO;
+    const bool live = di->i_mode && di->i_links_count && !di->i_dtime;
+    const bool isdir = (di->i_mode & 0170000) == 0040000;
+
+    if (ino == EXT2_ROOT_INO && !(live && isdir))
+        report(c, (fsck_problem_t){ .code = P_ROOT, .group = g, .ino = ino });
+    if (!reserved && live != marked)
+        report(c, (fsck_problem_t){ .code = live ? P_INODE_NOT_MARKED : P_INODE_MARKED_UNUSED,
+                                    .group = g, .ino = ino });
+    /* reserved inodes count as in use whatever they hold */
+    if (!live && !reserved) return;
+    set_bit(group_inodes(c, c->live, g), i);
+    if (live && isdir) set_bit(group_inodes(c, c->dirs, g), i);
+    c->links[ino - 1] = live ? di->i_links_count : 0;
+
+    if (ino == EXT2_RESIZE_INO && (c->sb.s_feature_compat & EXT2_FEATURE_COMPAT_RESIZE_INODE)) {
+        /* its tree maps the reserved GDT blocks, already counted as metadata */
+        if (block_ok(c, di->i_block[EXT2_DIND_BLOCK])) (void)claim(c, di->i_block[EXT2_DIND_BLOCK], ino, false);
+        return;
+    }
+    if (reserved && !di->i_blocks) return;
+
+    p1_inode_t a = { .ino = ino };
+    if (has_blocks(di) && !walk_inode(t, ino, di, true, p1_block, &a)) return;
+    if (di->i_file_acl) {
+        if (!block_ok(c, di->i_file_acl))
+            report(c, (fsck_problem_t){ .code = P_BAD_BLOCK, .group = g, .ino = ino, .blk = di->i_file_acl });
+        else {
+            (void)claim(c, di->i_file_acl, ino, true);
+            a.nblk++;
+        }
+    }
+    const uint64_t want = a.nblk * (c->bs / 512u);
+    if (want != di->i_blocks)
+        report(c, (fsck_problem_t){ .code = P_I_BLOCKS, .group = g, .ino = ino,
+                                    .has = FSCK_VALUES, .found = di->i_blocks, .expected = (int64_t)want });
+    if (!a.any) {
+        if (isdir && live) report(c, (fsck_problem_t){ .code = P_EMPTY_DIR, .group = g, .ino = ino });
+        return;
+    }
+    const uint64_t need = (a.last + 1) * c->bs;
+    if (isdir && (di->i_size % c->bs || di->i_size < need))
+        report(c, (fsck_problem_t){ .code = P_I_SIZE, .group = g, .ino = ino,
+                                    .has = FSCK_VALUES, .found = di->i_size, .expected = (int64_t)need });
+    if ((di->i_mode & 0170000) == 0100000) {
+        const uint64_t size = di->i_size | ((uint64_t)di->i_dir_acl << 32);
+        if ((size + c->bs - 1) / c->bs < a.last + 1)
+            report(c, (fsck_problem_t){ .code = P_I_SIZE, .group = g, .ino = ino,
+                                        .has = FSCK_VALUES, .found = (int64_t)size, .expected = (int64_t)need });
+    }
+}
+
+/* The slice of group g's inode table holding inode index i; t->itab then
+   covers indexes from *base on. */
+static const ext2_inode *table_inode(fsck_thr_t *t, uint32_t g, uint32_t i, uint32_t *base, bool *loaded) {
+    fsck_t *c = t->c;
+    const uint32_t per = FSCK_ITAB_SLICE / c->isz;
+    if (!*loaded || i < *base || i >= *base + per) {
+        *base = i - i % per;
+        const uint32_t n = c->ipg - *base < per ? c->ipg - *base : per;
+        const uint64_t at = (uint64_t)c->gd[g].bg_inode_table * c->bs + (uint64_t)*base * c->isz;
+        if (!diskio_pread(c->key, c->off + at, t->itab, n * c->isz)) {
+            io_failed(c, c->gd[g].bg_inode_table);
+            *loaded = false;
+            return NULL;
+        }
+        *loaded = true;
+    }
+    return (const ext2_inode*)(t->itab + (size_t)(i - *base) * c->isz);
+}
+
+static void pass1_group(fsck_thr_t *t, uint32_t g) {
+    fsck_t *c = t->c;
+    uint64_t *imap = (uint64_t*)t->blk;
+    if (!read_blocks(c, c->gd[g].bg_inode_bitmap, imap, c->bs)) return;
+    uint32_t base = 0;
+    bool loaded = false;
+    for (uint32_t i = 0; i < c->ipg; ++i) {
+        const ext2_inode *di = table_inode(t, g, i, &base, &loaded);
+        if (!di) return;
+        check_inode(t, g * c->ipg + i + 1, di, bit(imap, i));
+    }
+}
+
+/* ---- pass 2: directories ---- */
+
+typedef struct p2_dir { uint32_t ino; } p2_dir_t;
+
+static char *dup_name(const ext2_dirent *de) {
+    char *s = (char*)malloc((size_t)de->name_len + 1);
+    if (s) { memcpy(s, de->name, de->name_len); s[de->name_len] = '\0'; }
+    return s;
+}
+
+static void check_dir_block(fsck_thr_t *t, uint32_t dir, uint64_t lblk, uint32_t pblk) {
+    fsck_t *c = t->c;
+    const uint32_t bs = c->bs;
+    for (uint32_t off = 0, k = 0; off < bs; ++k) {
+        const ext2_dirent *de = (const ext2_dirent*)(t->blk + off);
+        const uint32_t rec = (de->rec_len == 65535 && bs == 65536) ? 65536 : de->rec_len;
+        if (bs - off < 8 || rec < 8 || rec % 4 || rec > bs - off || de->name_len + 8u > rec) {
+            report(c, (fsck_problem_t){ .code = P_BAD_DIRENT, .group = FSCK_NO_GROUP, .ino = dir, .blk = pblk,
+                                        .has = FSCK_FOUND, .found = off });
+            return;
+        }
+        const bool dot = de->name_len == 1 && de->name[0] == '.';
+        const bool dotdot = de->name_len == 2 && de->name[0] == '.' && de->name[1] == '.';
+        if (lblk == 0 && k == 0 && !(dot && de->inode == dir))
+            report(c, (fsck_problem_t){ .code = P_BAD_DOT, .group = FSCK_NO_GROUP, .ino = dir,
+                                        .has = FSCK_VALUES, .found = de->inode, .expected = dir });
+        if (lblk == 0 && k == 1 && !(dotdot && de->inode && (dir != EXT2_ROOT_INO || de->inode == dir)))
+            report(c, (fsck_problem_t){ .code = P_BAD_DOTDOT, .group = FSCK_NO_GROUP, .ino = dir,
+                                        .has = FSCK_FOUND, .found = de->inode });
+        if (de->inode) {
+            if (de->inode > c->sb.s_inodes_count || !inode_bit(c, c->live, de->inode)) {
+                report(c, (fsck_problem_t){ .code = P_DIRENT_UNUSED_INODE, .group = FSCK_NO_GROUP, .ino = dir,
+                                            .has = FSCK_FOUND, .found = de->inode, .name = dup_name(de) });
+            } else {
+                __atomic_fetch_sub(&c->links[de->inode - 1], (uint16_t)1, __ATOMIC_RELAXED);
+                const bool isdir = inode_bit(c, c->dirs, de->inode);
+                if (c->filetype && de->file_type && (de->file_type == EXT2_FT_DIR) != isdir)
+                    report(c, (fsck_problem_t){ .code = P_FILE_TYPE, .group = FSCK_NO_GROUP, .ino = dir,
+                                                .has = FSCK_VALUES, .found = de->file_type,
+                                                .expected = isdir ? EXT2_FT_DIR : EXT2_FT_REG_FILE,
+                                                .name = dup_name(de) });
+            }
+        }
+        off += rec;
+    }
+}
+
+static bool p2_block(fsck_thr_t *t, void *arg, uint64_t lblk, uint32_t pblk, bool meta) {
+    if (meta) return true;
+    if (!read_blocks(t->c, pblk, t->blk, t->c->bs)) return false;
+    check_dir_block(t, ((p2_dir_t*)arg)->ino, lblk, pblk);
+    return true;
+}
+
+static void pass2_group(fsck_thr_t *t, uint32_t g) {
+    fsck_t *c = t->c;
+    const uint64_t *dirs = group_inodes(c, c->dirs, g);
+    uint32_t base = 0;
+    bool loaded = false;
+    for (uint32_t w = 0; w < c->iwords; ++w) {
+        for (uint64_t m = dirs[w]; m; m &= m - 1) {
+            const uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(m);
+            ext2_inode di;
+            const ext2_inode *p = table_inode(t, g, i, &base, &loaded);
+            if (!p) return;
+            memcpy(&di, p, sizeof di);
+            p2_dir_t a = { .ino = g * c->ipg + i + 1 };
+            if (!walk_inode(t, a.ino, &di, false, p2_block, &a)) return;
+        }
+    }
+}
+
+/* ---- passes 4 and 5: link counts, bitmaps, counts ---- */
+
+static void pass5_group(fsck_thr_t *t, uint32_t g) {
+    fsck_t *c = t->c;
+    const uint64_t *live = group_inodes(c, c->live, g);
+    uint32_t base = 0;
+    bool loaded = false;
+    for (uint32_t w = 0; w < c->iwords; ++w) {
+        for (uint64_t m = live[w]; m; m &= m - 1) {
+            const uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(m);
+            const uint32_t ino = g * c->ipg + i + 1;
+            const uint16_t left = c->links[ino - 1];
+            if (!left || (ino < c->first_ino && ino != EXT2_ROOT_INO)) continue;
+            const ext2_inode *di = table_inode(t, g, i, &base, &loaded);
+            if (!di) return;
+            const uint16_t seen = (uint16_t)(di->i_links_count - left);
+            report(c, (fsck_problem_t){ .code = seen ? P_LINK_COUNT : P_UNATTACHED_INODE, .group = g, .ino = ino,
+                                        .has = FSCK_VALUES, .found = di->i_links_count, .expected = seen });
+        }
+    }
+
+    const uint32_t nbits = group_blocks(c, g);
+    const uint32_t first = c->sb.s_first_data_block + g * c->bpg;
+    const uint64_t *found = c->found + (size_t)g * c->bwords;
+    uint64_t *disk = (uint64_t*)t->blk;
+    if (!read_blocks(c, c->gd[g].bg_block_bitmap, disk, c->bs)) return;
+    uint32_t extra = 0, missing = 0, first_extra = 0, first_missing = 0;
+    for (uint32_t w = 0; w * 64 < nbits; ++w) {
+        uint64_t mask = nbits - w * 64 >= 64 ? ~0ull : (1ull << (nbits - w * 64)) - 1;
+        const uint64_t x = disk[w] & ~found[w] & mask, y = found[w] & ~disk[w] & mask;
+        if (x && !extra++)   first_extra   = first + w * 64 + (uint32_t)__builtin_ctzll(x);
+        if (y && !missing++) first_missing = first + w * 64 + (uint32_t)__builtin_ctzll(y);
+        extra   += x ? (uint32_t)__builtin_popcountll(x) - 1 : 0;
+        missing += y ? (uint32_t)__builtin_popcountll(y) - 1 : 0;
+    }
+    if (extra)
+        report(c, (fsck_problem_t){ .code = P_BLOCK_MARKED_UNUSED, .group = g, .blk = first_extra,
+                                    .has = FSCK_VALUES, .found = extra, .expected = 0 });
+    if (missing)
+        report(c, (fsck_problem_t){ .code = P_BLOCK_USED_UNMARKED, .group = g, .blk = first_missing,
+                                    .has = FSCK_VALUES, .found = missing, .expected = 0 });
+
+    const uint32_t free_b = nbits - ext2_bitmap_count(found, nbits);
+    const uint32_t free_i = c->ipg - ext2_bitmap_count(live, c->ipg);
+    const uint32_t ndirs  = ext2_bitmap_count(group_inodes(c, c->dirs, g), c->ipg);
+    if (free_b != c->gd[g].bg_free_blocks_count)
+        report(c, (fsck_problem_t){ .code = P_GROUP_FREE_BLOCKS, .group = g,
+                                    .has = FSCK_VALUES, .found = c->gd[g].bg_free_blocks_count, .expected = free_b });
+    if (free_i != c->gd[g].bg_free_inodes_count)
+        report(c, (fsck_problem_t){ .code = P_GROUP_FREE_INODES, .group = g,
+                                    .has = FSCK_VALUES, .found = c->gd[g].bg_free_inodes_count, .expected = free_i });
+    if (ndirs != c->gd[g].bg_used_dirs_count)
+        report(c, (fsck_problem_t){ .code = P_GROUP_DIRS, .group = g,
+                                    .has = FSCK_VALUES, .found = c->gd[g].bg_used_dirs_count, .expected = ndirs });
+    __atomic_fetch_add(&c->free_blocks, free_b, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->free_inodes, free_i, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->used_dirs, ndirs, __ATOMIC_RELAXED);
+}
+
+/* ---- driver ---- */
+
+static void *worker(void *arg) {
+    fsck_thr_t *t = (fsck_thr_t*)arg;
+    fsck_t *c = t->c;
+    for (;;) {
+        const uint32_t g = __atomic_fetch_add(&c->next, 1u, __ATOMIC_RELAXED);
+        if (g >= c->ngroups || __atomic_load_n(&c->io_error, __ATOMIC_RELAXED)) break;
+        if (c->bad_gd[g]) continue;
+        if      (c->pass == 1) pass1_group(t, g);
+        else if (c->pass == 2) pass2_group(t, g);
+        else                   pass5_group(t, g);
+    }
+    return NULL;
+}
+
+static void run_pass(fsck_t *c, fsck_thr_t *t, unsigned n, int pass) {
+    pthread_t tid[FSCK_MAX_THREADS];
+    unsigned started = 0;
+    c->pass = pass;
+    c->next = 0;
+    for (unsigned i = 1; i < n; ++i, ++started)
+        if (pthread_create(&tid[i - 1], NULL, worker, &t[i]) != 0) break;
+    worker(&t[0]);
+    for (unsigned i = 0; i < started; ++i) pthread_join(tid[i], NULL);
+}
+
+/* Superblock and descriptors; a message for the report, or NULL. */
+static const char *load(fsck_t *c, uint64_t bytes) {
+    ext2_superblock *s = &c->sb;
+    if (!diskio_pread(c->key, c->off + EXT2_SUPER_OFFSET, s, sizeof *s)) return "cannot read the superblock";
+    if (s->s_magic != EXT2_SUPER_MAGIC) return "no ext2 superblock";
+    if (s->s_log_block_size > 6 || !s->s_blocks_per_group || !s->s_inodes_per_group ||
+        s->s_first_data_block >= s->s_blocks_count) return "implausible superblock";
+    if (s->s_rev_level >= 1 && (s->s_feature_incompat & ~EXT2_FEATURE_INCOMPAT_FILETYPE))
+        return "unsupported incompatible features";
+    c->bs  = 1024u << s->s_log_block_size;
+    c->bpg = s->s_blocks_per_group;
+    c->ipg = s->s_inodes_per_group;
+    c->isz = s->s_rev_level >= 1 ? s->s_inode_size : EXT2_GOOD_OLD_INODE_SIZE;
+    c->apb = c->bs / 4;
+    c->first_ino = s->s_rev_level >= 1 && s->s_first_ino ? s->s_first_ino : EXT2_GOOD_OLD_FIRST_INO;
+    c->filetype = s->s_rev_level >= 1 && (s->s_feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE);
+    if (c->isz < EXT2_GOOD_OLD_INODE_SIZE || c->isz > c->bs || (c->isz & (c->isz - 1)))
+        return "bad inode size";
+    if (c->bpg > 8 * c->bs || c->ipg > 8 * c->bs) return "groups larger than a bitmap";
+    c->ngroups = (s->s_blocks_count - s->s_first_data_block + c->bpg - 1) / c->bpg;
+    if ((uint64_t)c->ngroups * c->ipg != s->s_inodes_count) return "inode count does not match the groups";
+    if ((uint64_t)s->s_blocks_count * c->bs > bytes) return "filesystem larger than the device";
+    c->bwords = (c->bpg + 63) / 64;
+    c->iwords = (c->ipg + 63) / 64;
+
+    const uint32_t gdt_bytes = c->ngroups * (uint32_t)sizeof *c->gd;
+    c->gd     = (ext2_group_desc*)malloc(((size_t)gdt_bytes + c->bs - 1) / c->bs * c->bs);
+    c->bad_gd = (bool*)calloc(c->ngroups, sizeof *c->bad_gd);
+    c->found  = (uint64_t*)calloc((size_t)c->ngroups * c->bwords, sizeof *c->found);
+    c->live   = (uint64_t*)calloc((size_t)c->ngroups * c->iwords, sizeof *c->live);
+    c->dirs   = (uint64_t*)calloc((size_t)c->ngroups * c->iwords, sizeof *c->dirs);
+    c->links  = (uint16_t*)calloc(s->s_inodes_count, sizeof *c->links);
+    if (!c->gd || !c->bad_gd || !c->found || !c->live || !c->dirs || !c->links) return "out of memory";
+    if (!diskio_pread(c->key, c->off + (uint64_t)(s->s_first_data_block + 1) * c->bs, c->gd, gdt_bytes))
+        return "cannot read the group descriptors";
+    return NULL;
+}
+
+/* Blocks every group starts with, and where its descriptor says its bitmaps
+   and inode table are. A descriptor pointing outside the group's fs makes
+   the group unusable for the passes. */
+static void claim_metadata(fsck_t *c) {
+    const bool sparse = c->sb.s_rev_level >= 1 && (c->sb.s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER);
+    const uint32_t gdtb = (c->ngroups * (uint32_t)sizeof *c->gd + c->bs - 1) / c->bs;
+    const uint32_t rsv = (c->sb.s_feature_compat & EXT2_FEATURE_COMPAT_RESIZE_INODE) ? c->sb.s_reserved_gdt_blocks : 0;
+    const uint32_t itb = (uint32_t)(((uint64_t)c->ipg * c->isz + c->bs - 1) / c->bs);
+    for (uint32_t g = 0; g < c->ngroups; ++g) {
+        const ext2_group_desc *d = &c->gd[g];
+        if (!block_ok(c, d->bg_block_bitmap) || !block_ok(c, d->bg_inode_bitmap) ||
+            !block_ok(c, d->bg_inode_table) || (uint64_t)d->bg_inode_table + itb > c->sb.s_blocks_count) {
+            c->bad_gd[g] = true;
+            report(c, (fsck_problem_t){ .code = P_BAD_GROUP_DESC, .group = g });
+            continue;
+        }
+        const uint32_t start = c->sb.s_first_data_block + g * c->bpg;
+        if (ext2_group_has_super(g, sparse))
+            for (uint32_t b = start; b < start + 1 + gdtb + rsv && b < c->sb.s_blocks_count; ++b)
+                (void)claim(c, b, 0, false);
+        (void)claim(c, d->bg_block_bitmap, 0, false);
+        (void)claim(c, d->bg_inode_bitmap, 0, false);
+        for (uint32_t b = 0; b < itb; ++b) (void)claim(c, d->bg_inode_table + b, 0, false);
+    }
+}
+
+static int problem_cmp(const void *a, const void *b) {
+    const fsck_problem_t *x = (const fsck_problem_t*)a, *y = (const fsck_problem_t*)b;
+    if (k_code[x->code].pass != k_code[y->code].pass) return k_code[x->code].pass < k_code[y->code].pass ? -1 : 1;
+    if (x->code  != y->code)  return x->code  < y->code  ? -1 : 1;
+    if (x->group != y->group) return x->group < y->group ? -1 : 1;
+    if (x->ino   != y->ino)   return x->ino   < y->ino   ? -1 : 1;
+    if (x->blk   != y->blk)   return x->blk   < y->blk   ? -1 : 1;
+    return 0;
+}
+
+static void json_str(FILE *out, const char *s, size_t n) {
+    fputc('"', out);
+    for (size_t i = 0; i < n && s[i]; ++i) {
+        const unsigned char ch = (unsigned char)s[i];
+        if (ch == '"' || ch == '\\') fprintf(out, "\\%c", ch);
+        else if (ch < 0x20 || ch >= 0x7f) fprintf(out, "\\u%04x", ch);
+        else fputc(ch, out);
+    }
+    fputc('"', out);
+}
+
+static void print_report(const fsck_t *c, FILE *out, unsigned threads, double secs, const char *error) {
+    fprintf(out, "{\n  \"filesystem\": {");
+    if (c->bs) {
+        fprintf(out, "\"block_size\": %u, \"blocks\": %u, \"inodes\": %u, \"groups\": %u, \"label\": ",
+                c->bs, c->sb.s_blocks_count, c->sb.s_inodes_count, c->ngroups);
+        json_str(out, c->sb.s_volume_name, sizeof c->sb.s_volume_name);
+    }
+    fprintf(out, "},\n  \"threads\": %u,\n  \"seconds\": %.3f,\n", threads, secs);
+    if (error) {
+        fprintf(out, "  \"error\": ");
+        json_str(out, error, strlen(error));
+        fprintf(out, ",\n  \"clean\": false\n}\n");
+        return;
+    }
+    fprintf(out, "  \"blocks_used\": %llu,\n  \"inodes_used\": %llu,\n  \"directories\": %llu,\n",
+            (unsigned long long)(c->sb.s_blocks_count - c->free_blocks),
+            (unsigned long long)(c->sb.s_inodes_count - c->free_inodes),
+            (unsigned long long)c->used_dirs);
+    fprintf(out, "  \"clean\": %s,\n  \"problems_total\": %llu,\n  \"problems_by_code\": {",
+            c->total ? "false" : "true", (unsigned long long)c->total);
+    bool first = true;
+    for (int k = 0; k < P_COUNT; ++k) {
+        if (!c->by_code[k]) continue;
+        fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", k_code[k].name, (unsigned long long)c->by_code[k]);
+        first = false;
+    }
+    fprintf(out, "},\n  \"problems\": [");
+    for (size_t i = 0; i < c->np; ++i) {
+        const fsck_problem_t *p = &c->p[i];
+        fprintf(out, "%s\n    {\"pass\": %u, \"code\": \"%s\"", i ? "," : "", k_code[p->code].pass, k_code[p->code].name);
+        if (p->group != FSCK_NO_GROUP) fprintf(out, ", \"group\": %u", p->group);
+        if (p->ino) fprintf(out, ", \"inode\": %u", p->ino);
+        if (p->blk) fprintf(out, ", \"block\": %u", p->blk);
+        if (p->name) { fprintf(out, ", \"name\": "); json_str(out, p->name, strlen(p->name)); }
+        if (p->has & FSCK_FOUND)    fprintf(out, ", \"found\": %lld", (long long)p->found);
+        if (p->has & FSCK_EXPECTED) fprintf(out, ", \"expected\": %lld", (long long)p->expected);
+        fputc('}', out);
+    }
+    fprintf(out, "%s],\n  \"truncated\": %s\n}\n", c->np ? "\n  " : "", c->total > c->np ? "true" : "false");
+}
+
+int ext2_fsck(const char *key, uint64_t off, uint64_t bytes, const ext2_fsck_opts_t *o, FILE *out) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    fsck_t c = { .key = key, .off = off, .lock = GU_MUTEX_INIT };
+    c.max_report = o && o->max_report ? o->max_report : 100;
+    unsigned n = o && o->threads ? o->threads : 0;
+
+    const char *error = load(&c, bytes);
+    if (!error && !(c.p = (fsck_problem_t*)calloc(c.max_report, sizeof *c.p))) error = "out of memory";
+    if (n == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = cpus > 8 ? 8 : (cpus > 0 ? (unsigned)cpus : 1);
+    }
+    if (n > FSCK_MAX_THREADS) n = FSCK_MAX_THREADS;
+    if (!error && n > c.ngroups) n = c.ngroups;
+
+    fsck_thr_t *t = error ? NULL : (fsck_thr_t*)calloc(n, sizeof *t);
+    if (!error && !t) error = "out of memory";
+    for (unsigned i = 0; !error && i < n; ++i) {
+        t[i].c = &c;
+        t[i].itab = (uint8_t*)malloc(FSCK_ITAB_SLICE);
+        t[i].blk  = (uint8_t*)malloc(c.bs);
+        for (int l = 0; l < 3; ++l) t[i].ind[l] = (uint32_t*)malloc(c.bs);
+        if (!t[i].itab || !t[i].blk || !t[i].ind[0] || !t[i].ind[1] || !t[i].ind[2]) error = "out of memory";
+    }
+    if (!error) {
+        claim_metadata(&c);
+        run_pass(&c, t, n, 1);
+        if (!c.io_error) run_pass(&c, t, n, 2);
+        if (!c.io_error) run_pass(&c, t, n, 5);
+        if (c.io_error) error = "read error";
+    }
+    if (!error) {
+        if (c.free_blocks != c.sb.s_free_blocks_count)
+            report(&c, (fsck_problem_t){ .code = P_FREE_BLOCKS, .group = FSCK_NO_GROUP, .has = FSCK_VALUES,
+                                         .found = c.sb.s_free_blocks_count, .expected = (int64_t)c.free_blocks });
+        if (c.free_inodes != c.sb.s_free_inodes_count)
+            report(&c, (fsck_problem_t){ .code = P_FREE_INODES, .group = FSCK_NO_GROUP, .has = FSCK_VALUES,
+                                         .found = c.sb.s_free_inodes_count, .expected = (int64_t)c.free_inodes });
+        qsort(c.p, c.np, sizeof *c.p, problem_cmp);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    const double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    print_report(&c, out, error ? 0 : n, secs, error);
+
+    for (unsigned i = 0; t && i < n; ++i) {
+        free(t[i].itab);
+        free(t[i].blk);
+        for (int l = 0; l < 3; ++l) free(t[i].ind[l]);
+    }
+    free(t);
+    for (size_t i = 0; i < c.np; ++i) free(c.p[i].name);
+    free(c.p);
+    free(c.gd); free(c.bad_gd); free(c.found); free(c.live); free(c.dirs); free(c.links);
+    if (error) return 8;
+    return c.total ? 4 : 0;
+}
@@ -0,0 +1,143 @@
+// src/ext2_hash.c — htree (dir_index) directory name hashes
+//
+// The three hashes ext2/3/4 use to place names in an indexed directory:
+// the legacy "dx_hack" hash, half-MD4 and TEA, each in the signed-char and
+// unsigned-char flavours. They must match the on-disk format bit for bit,
+// so this follows the reference implementation rather than any cleverer
+// formulation.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ext2.h"
+
+#define HTREE_EOF_32 0x7fffffffu
+
+static inline uint32_t rol32(uint32_t w, unsigned s) { return (w << s) | (w >> (32 - s)); }
+
+static uint32_t dx_hack_hash(const char *name, size_t len, bool is_unsigned) {
+    uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+    for (size_t i = 0; i < len; ++i) {
+        int c = is_unsigned ? (int)(unsigned char)name[i] : (int)(signed char)name[i];
+        hash = hash1 + (hash0 ^ (uint32_t)(c * 7152373));
+        if (hash & 0x80000000u) hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+/* Pack up to num*4 bytes of the name into num words, padded with the length. */
+static void str2hashbuf(const char *msg, size_t len, uint32_t *buf, int num, bool is_unsigned) {
+    uint32_t pad = (uint32_t)len | ((uint32_t)len << 8);
+    pad |= pad << 16;
+    uint32_t val = pad;
+    if (len > (size_t)num * 4) len = (size_t)num * 4;
+    for (size_t i = 0; i < len; ++i) {
+        int c = is_unsigned ? (int)(unsigned char)msg[i] : (int)(signed char)msg[i];
+        val = (uint32_t)c + (val << 8);
+        if ((i % 4) == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+    if (--num >= 0) *buf++ = val;
+    while (--num >= 0) *buf++ = pad;
+}
+
+static void tea_transform(uint32_t buf[4], const uint32_t in[4]) {
+    uint32_t sum = 0, b0 = buf[0], b1 = buf[1];
+    const uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+    for (int n = 0; n < 16; ++n) {
+        sum += 0x9E3779B9u;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    }
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define ROUND(f, a, b, c, d, x, s) (a += f(b, c, d) + (x), a = rol32(a, s))
+#define K1 0u
+#define K2 013240474631u
+#define K3 015666365641u
+
+static void half_md4_transform(uint32_t buf[4], const uint32_t in[8]) {
+    uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    ROUND(F, a, b, c, d, in[0] + K1,  3);
+    ROUND(F, d, a, b, c, in[1] + K1,  7);
+    ROUND(F, c, d, a, b, in[2] + K1, 11);
+    ROUND(F, b, c, d, a, in[3] + K1, 19);
+    ROUND(F, a, b, c, d, in[4] + K1,  3);
+    ROUND(F, d, a, b, c, in[5] + K1,  7);
+    ROUND(F, c, d, a, b, in[6] + K1, 11);
+    ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+    ROUND(G, a, b, c, d, in[1] + K2,  3);
+    ROUND(G, d, a, b, c, in[3] + K2,  5);
+    ROUND(G, c, d, a, b, in[5] + K2,  9);
+    ROUND(G, b, c, d, a, in[7] + K2, 13);
+    ROUND(G, a, b, c, d, in[0] + K2,  3);
+    ROUND(G, d, a, b, c, in[2] + K2,  5);
+    ROUND(G, c, d, a, b, in[4] + K2,  9);
+    ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+    ROUND(H, a, b, c, d, in[3] + K3,  3);
+    ROUND(H, d, a, b, c, in[7] + K3,  9);
+    ROUND(H, c, d, a, b, in[2] + K3, 11);
+    ROUND(H, b, c, d, a, in[6] + K3, 15);
+    ROUND(H, a, b, c, d, in[1] + K3,  3);
+    ROUND(H, d, a, b, c, in[5] + K3,  9);
+    ROUND(H, c, d, a, b, in[0] + K3, 11);
+    ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+bool ext2_dirhash(const char *name, size_t len, unsigned version,
+                  const uint32_t seed[4], uint32_t *hash) {
+    if (!name || !hash) return false;
+    uint32_t buf[4] = { 0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u };
+    if (seed && (seed[0] | seed[1] | seed[2] | seed[3])) memcpy(buf, seed, sizeof buf);
+
+    uint32_t in[8], h;
+    const bool is_unsigned = version >= EXT2_DX_HASH_LEGACY_UNSIGNED;
+    switch (version) {
+    case EXT2_DX_HASH_LEGACY:
+    case EXT2_DX_HASH_LEGACY_UNSIGNED:
+        h = dx_hack_hash(name, len, is_unsigned);
+        break;
+    case EXT2_DX_HASH_HALF_MD4:
+    case EXT2_DX_HASH_HALF_MD4_UNSIGNED:
+        for (size_t at = 0; at < len; at += 32) {
+            str2hashbuf(name + at, len - at, in, 8, is_unsigned);
+            half_md4_transform(buf, in);
+        }
+        h = buf[1];
+        break;
+    case EXT2_DX_HASH_TEA:
+    case EXT2_DX_HASH_TEA_UNSIGNED:
+        for (size_t at = 0; at < len; at += 16) {
+            str2hashbuf(name + at, len - at, in, 4, is_unsigned);
+            tea_transform(buf, in);
+        }
+        h = buf[0];
+        break;
+    default:
+        return false;
+    }
+    h &= ~1u;
+    if (h == (HTREE_EOF_32 << 1)) h = (HTREE_EOF_32 - 1) << 1;
+    *hash = h;
+    return true;
+}
@@ -6,6 +6,8 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
 
 #include "fileutil.h"
 
@@ -100,4 +102,24 @@ int file_ensure_size(const char *path, uint64_t size_bytes) {
     fflush(fp);
     fclose(fp);
     return 0;
-}
\ No newline at end of file
+}
+
+int host_dir_scan(const char *dir, host_dir_fn fn, void *ctx) {
+    DIR *d = opendir(dir);
+    if (!d) return -errno;
+    int rc = 0;
+    char path[4096];
+    struct dirent *de;
+    while (rc == 0 && (de = readdir(d)) != NULL) {
+        struct stat st;
+        const struct stat *sp = NULL;
+        if (snprintf(path, sizeof path, "%s/%s", dir, de->d_name) < (int)sizeof path) {
+            if (lstat(path, &st) == 0) sp = &st;
+        } else {
+            errno = ENAMETOOLONG;
+        }
+        rc = fn(ctx, dir, de->d_name, sp);
+    }
+    closedir(d);
+    return rc;
+}
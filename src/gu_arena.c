@@ -0,0 +1,151 @@
+// src/gu_arena.c — per-thread bump allocator (see include/gu_arena.h)
+//
+// Chunks form a singly linked list in allocation order. The bump pointer is
+// (cur, off); when cur is full the next chunk is reused if it is big enough,
+// otherwise a fresh chunk is spliced in after cur. A mark is just a copy of
+// (cur, off), so releasing is two stores.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "gu_arena.h"
+
+#define ARENA_ALIGN   alignof(max_align_t)
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t              cap;
+    size_t              base;   /* bytes in all chunks before this one */
+    alignas(max_align_t) unsigned char data[];
+} arena_chunk_t;
+
+typedef struct arena {
+    arena_chunk_t *head, *cur;
+    size_t         off;
+    bool           armed;
+} arena_t;
+
+static _Thread_local arena_t t_arena;
+
+static _Atomic uint64_t g_chunks, g_chunk_bytes, g_allocs, g_high_water;
+static pthread_key_t    g_arena_key;
+static pthread_once_t   g_arena_once = PTHREAD_ONCE_INIT;
+
+static void arena_thread_exit(void *unused) {
+    (void)unused;
+    arena_chunk_t *c = t_arena.head;
+    while (c) {
+        arena_chunk_t *next = c->next;
+        atomic_fetch_sub_explicit(&g_chunk_bytes, c->cap, memory_order_relaxed);
+        free(c);
+        c = next;
+    }
+    t_arena.head = t_arena.cur = NULL;
+    t_arena.off = 0;
+}
+
+static void arena_key_init(void) { (void)pthread_key_create(&g_arena_key, arena_thread_exit); }
+
+static void note_high_water(size_t used) {
+    uint64_t hw = atomic_load_explicit(&g_high_water, memory_order_relaxed);
+    while (used > hw &&
+           !atomic_compare_exchange_weak_explicit(&g_high_water, &hw, used,
+                                                  memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+/* Make cur a chunk with room for n bytes at off. */
+static bool arena_advance(arena_t *a, size_t n) {
+    arena_chunk_t *next = a->cur ? a->cur->next : a->head;
+    if (next && next->cap >= n) {
+        a->cur = next;
+        a->off = 0;
+        return true;
+    }
+    size_t cap = n > GU_ARENA_CHUNK ? ARENA_ROUND(n) : GU_ARENA_CHUNK;
+    arena_chunk_t *c = (arena_chunk_t*)malloc(sizeof *c + cap);
+    if (!c) return false;
+    if (!a->armed) {
+        pthread_once(&g_arena_once, arena_key_init);
+        (void)pthread_setspecific(g_arena_key, &t_arena);
+        a->armed = true;
+    }
+    c->cap = cap;
+    if (a->cur) {
+        c->next = a->cur->next;
+        a->cur->next = c;
+        c->base = a->cur->base + a->cur->cap;
+    } else {
+        c->next = a->head;
+        a->head = c;
+        c->base = 0;
+    }
+    a->cur = c;
+    a->off = 0;
+    atomic_fetch_add_explicit(&g_chunks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_chunk_bytes, cap, memory_order_relaxed);
+    return true;
+}
+
+void *gu_arena_alloc(size_t n) {
+    arena_t *a = &t_arena;
+    n = ARENA_ROUND(n ? n : 1);
+    if (!a->cur || a->cur->cap - a->off < n) {
+        if (!arena_advance(a, n)) return NULL;
+    }
+    void *p = a->cur->data + a->off;
+    a->off += n;
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    note_high_water(a->cur->base + a->off);
+    return p;
+}
+
+char *gu_arena_strndup(const char *s, size_t n) {
+    if (!s) return NULL;
+    const char *z = (const char*)memchr(s, '\0', n);
+    size_t len = z ? (size_t)(z - s) : n;
+    char *p = (char*)gu_arena_alloc(len + 1);
+    if (!p) return NULL;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+char *gu_arena_strdup(const char *s) {
+    return s ? gu_arena_strndup(s, strlen(s)) : NULL;
+}
+
+char *gu_arena_printf(const char *fmt, ...) {
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    char *p = n >= 0 ? (char*)gu_arena_alloc((size_t)n + 1) : NULL;
+    if (p) vsnprintf(p, (size_t)n + 1, fmt, ap2);
+    va_end(ap2);
+    return p;
+}
+
+gu_arena_mark_t gu_arena_mark(void) {
+    return (gu_arena_mark_t){ .chunk = t_arena.cur, .off = t_arena.off };
+}
+
+void gu_arena_release(gu_arena_mark_t m) {
+    t_arena.cur = (arena_chunk_t*)m.chunk;
+    t_arena.off = m.off;
+}
+
+void gu_arena_get_stats(gu_arena_stats_t *out) {
+    if (!out) return;
+    out->chunks      = atomic_load_explicit(&g_chunks, memory_order_relaxed);
+    out->chunk_bytes = atomic_load_explicit(&g_chunk_bytes, memory_order_relaxed);
+    out->allocs      = atomic_load_explicit(&g_allocs, memory_order_relaxed);
+    out->high_water  = atomic_load_explicit(&g_high_water, memory_order_relaxed);
+}
@@ -0,0 +1,35 @@
+// src/gu_sync.c — grace periods for the lock-free lookup tables
+//
+// Readers announce themselves in the counter selected by the low bit of the
+// current epoch. A writer flips the epoch and waits for the old counter to
+// drain; any reader that raced with the flip notices the epoch changed,
+// backs out and re-enters under the new epoch, so once the old counter is
+// zero nobody can still hold a pointer that was unpublished before the flip.
+
+#include <sched.h>
+
+#include "gu_sync.h"
+
+static _Atomic unsigned g_rcu_epoch;
+static _Atomic long     g_rcu_readers[2];
+static gu_mutex_t       g_rcu_sync_lock = GU_MUTEX_INIT;
+
+unsigned gu_rcu_read_lock(void) {
+    for (;;) {
+        unsigned e = atomic_load(&g_rcu_epoch);
+        atomic_fetch_add(&g_rcu_readers[e & 1u], 1);
+        if (atomic_load(&g_rcu_epoch) == e) return e;
+        atomic_fetch_sub(&g_rcu_readers[e & 1u], 1);
+    }
+}
+
+void gu_rcu_read_unlock(unsigned token) {
+    atomic_fetch_sub(&g_rcu_readers[token & 1u], 1);
+}
+
+void gu_rcu_synchronize(void) {
+    gu_mutex_lock(&g_rcu_sync_lock);
+    unsigned e = atomic_fetch_add(&g_rcu_epoch, 1u);
+    while (atomic_load(&g_rcu_readers[e & 1u]) != 0) sched_yield();
+    gu_mutex_unlock(&g_rcu_sync_lock);
+}
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
 #include "debug.h"
 #include "vfs.h"
@@ -115,6 +116,10 @@ static int repl_loop(void) {
 // ---------- CLI entry ----------
 int main(int argc, char **argv) {
 
+    /* Load the zone once up front; mktime/localtime_r called from several
+       threads then only ever read it. */
+    tzset();
+
     /* Initialize VFS early: */
     (void)vfs_init();
 
@@ -104,23 +104,8 @@ bool iso_read_sector(const iso9660_t *iso, uint32_t lba, void *dst)
 {
     if (!iso || !iso->dev || !dst) return false;
 
-    /* Be robust before mount sets dev->block_bytes=2048.
-       Fall back to 512 if unset. */
-    uint32_t dev_bs = iso->dev->block_bytes ? iso->dev->block_bytes : 512u;
-
-    if (dev_bs == 2048u) {
-        /* 1 device block == 2048 bytes */
-        return vblk_read_blocks(iso->dev, lba, 1, dst);
-    }
-
-    /* If device block size divides 2048, read the ratio of blocks. */
-    if ((2048u % dev_bs) == 0) {
-        uint32_t ratio = ISO_SECTOR_SIZE / dev_bs;           /* e.g., 2048/512 = 4 */
-        uint64_t dev_lba = (uint64_t)lba * ratio;            /* map ISO LBA -> device LBA */
-        return vblk_read_blocks(iso->dev, dev_lba, ratio, dst);
-    }
-
-    /* Fallback: byte-addressed read if sizes don’t align cleanly. */
+    /* Byte-addressed: the vblk row is shared (and may be mounted several
+       times at once), so its geometry is never adopted or relied upon. */
     return vblk_read_bytes(iso->dev, (uint64_t)lba * ISO_SECTOR_SIZE, ISO_SECTOR_SIZE, dst);
 }
 
@@ -227,11 +212,6 @@ bool iso_mount(vblk_t *dev, iso9660_t *out)
     // Log in the same style you were already using
     DBG("mount: Primary, root=[lba=%u size=%u] bs=%u", out->root_lba, out->root_size, out->block_size);
 
-    // Adopt CD geometry on the vblk so subsequent reads can do "count=1"
-    dev->block_bytes = ISO_SECTOR_SIZE;
-    dev->ro          = true;
-    DBG("mount: mounted; set vblk '%s' block_bytes=%u ro=%d", dev->dev, dev->block_bytes, dev->ro ? 1 : 0);
-
     DBG("iso_mount: success");
     return true;
 }
@@ -258,7 +238,7 @@ bool iso_read_file_by_path(iso9660_t *iso,
 		uint8_t  flags    = 0;
 
 		int found = iso_walk_component(iso, dir_lba, dir_sz, last,
-									   &file_lba, &file_sz, &flags, NULL);
+									   &file_lba, &file_sz, &flags, NULL, NULL);
 		if (found != 1) return false;          // 1=found, 0=not found, -1=error
 		if (flags & 0x02) {                    // directory bit -> not a regular file
 			// optional: only if your callers check errno
@@ -272,7 +252,7 @@ bool iso_read_file_by_path(iso9660_t *iso,
 	uint8_t  flags    = 0;
 
 	int found = iso_walk_component(iso, dir_lba, dir_sz, last,
-								   &file_lba, &file_sz, &flags, NULL);
+								   &file_lba, &file_sz, &flags, NULL, NULL);
 	if (found != 1) return false;          // 1=found, 0=not found, -1=error
 	if (flags & 0x02) {                    // directory bit -> not a regular file
 		// optional: only if your callers check errno
@@ -329,7 +309,7 @@ bool iso_stat_path(iso9660_t *iso, const char *path,
 	uint8_t  flags = 0;
 
 	int found = iso_walk_component(iso, dir_lba, dir_sz, last,
-								   &lba, &size, &flags, NULL);
+								   &lba, &size, &flags, NULL, NULL);
 	if (found != 1) return false;
 
 	*out_lba    = lba;
@@ -374,7 +354,7 @@ bool iso_lookup_dir(iso9660_t *iso,
         // Look up the next component inside the current directory
         uint32_t child_lba = 0, child_size = 0; uint8_t flags = 0;
 		time_t mtime = 0;
-        int found = iso_walk_component(iso, cur_lba, cur_size, comp, &child_lba, &child_size, &flags, &mtime);
+        int found = iso_walk_component(iso, cur_lba, cur_size, comp, &child_lba, &child_size, &flags, &mtime, NULL);
         if (found != 1) return false;          // not found or error
         if (!(flags & 0x02)) return false;     // must be a directory
 
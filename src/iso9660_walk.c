@@ -39,36 +39,39 @@ static int names_equal_ci(const char *a, const char *b) {
     return *a == '\0' && *b == '\0';
 }
 
-static time_t iso_recdate_to_time(const uint8_t rec[7]) {
-    struct tm t;
-    t.tm_year = rec[0];          // years since 1900
-    t.tm_mon  = (rec[1] ? rec[1] - 1 : 0); // 1..12 -> 0..11
-    t.tm_mday = rec[2];
-    t.tm_hour = rec[3];
-    t.tm_min  = rec[4];
-    t.tm_sec  = rec[5];
-    t.tm_isdst = -1;
-
-    /* Treat fields as local time; ignore tz byte for now (rec[6]).
-       We can refine with a true UTC conversion later if needed. */
-    return mktime(&t);
+/* Days since 1970-01-01 for a proleptic Gregorian date (m 1..12). */
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+/* Directory-record date (ECMA-119 9.1.5): local time plus its offset from
+   GMT in 15-minute units. Pure arithmetic, so it is safe to call from any
+   thread (mktime may reload the zone under a libc-internal lock). */
+time_t iso_recdate_to_time(const uint8_t rec[7]) {
+    unsigned mon = rec[1] ? rec[1] : 1;
+    unsigned day = rec[2] ? rec[2] : 1;
+    if (mon > 12) mon = 12;
+    int64_t days = days_from_civil(1900 + (int64_t)rec[0], mon, day);
+    int64_t secs = days * 86400 + rec[3] * 3600 + rec[4] * 60 + rec[5];
+    secs -= (int64_t)(int8_t)rec[6] * 15 * 60;
+    return (time_t)secs;
 }
 
 /**
- * Scan a single ISO9660 directory (at dir_lba, length dir_size bytes) for one component name.
- * If found, outputs the child's extent LBA/size/flags and returns 1.
- * If not found, returns 0. On read/parse error, returns -1.
+ * Visit every record of one ISO9660 directory (at dir_lba, dir_size bytes)
+ * except "." and "..", in on-disc order. The record passed to cb is only
+ * valid during the call. Returns 1 if cb stopped the walk (nonzero return),
+ * 0 after the last record, -1 on read/parse error.
  */
-int iso_walk_component(const iso9660_t  *iso,
-                          uint32_t dir_lba,
-                          uint32_t dir_size,
-                          const char *want,
-                          uint32_t *out_lba,
-                          uint32_t *out_size,
-                          uint8_t  *out_flags,
-						  time_t *out_mtime)
+int iso_walk_dir(const iso9660_t *iso, uint32_t dir_lba, uint32_t dir_size,
+                 iso_rec_cb cb, void *user)
 {
-    if (!iso || !iso->dev || !want) return -1;
+    if (!iso || !iso->dev || !cb) return -1;
 
     const uint32_t bs = 2048u;
 
@@ -83,12 +86,15 @@ int iso_walk_component(const iso9660_t  *iso,
             return -1;
         }
 
+        /* records never cross a sector; the zero fill after the last one
+           still counts against dir_size */
+        const uint32_t limit = bytes_left < bs ? bytes_left : bs;
         uint32_t in = 0;
-        while (in < bs && bytes_left > 0) {
+        while (in < limit) {
             uint8_t rec_len = sec[in + 0];
             if (rec_len == 0) break; // end of records in this sector
 
-            if (in + rec_len > bs) {
+            if (in + rec_len > limit) {
                 DBG("iso: truncated dirent (rec_len=%u beyond sector)", (unsigned)rec_len);
                 return -1;
             }
@@ -121,21 +127,66 @@ int iso_walk_component(const iso9660_t  *iso,
                 (unsigned)flags, (flags & 0x02) ? "DIR" : "FILE",
                 (unsigned)child_lba, (unsigned)child_size, (unsigned)rec_len, (unsigned)off_in_dir);
 
-            if (!is_dot && !is_dotdot && names_equal_ci(clean, want)) {
-                if (out_lba)   *out_lba   = child_lba;
-                if (out_size)  *out_size  = child_size;
-                if (out_flags) *out_flags = flags;
-				if (out_mtime) *out_mtime = iso_recdate_to_time(rec + 18); 
-                return 1; // found
+            if (!is_dot && !is_dotdot) {
+                const iso_rec_t r = {
+                    .name    = clean,
+                    .lba     = child_lba,
+                    .size    = child_size,
+                    .flags   = flags,
+                    .rec     = rec,
+                    .rec_pos = (uint64_t)cur_lba * bs + in,
+                };
+                if (cb(&r, user)) return 1;
             }
 
             in += rec_len;
             off_in_dir += rec_len;
-            if (bytes_left >= rec_len) bytes_left -= rec_len; else bytes_left = 0;
         }
 
+        bytes_left -= limit;
         cur_lba++;
     }
 
-    return 0; // not found
-}
\ No newline at end of file
+    return 0;
+}
+
+typedef struct {
+    const char *want;
+    uint32_t   *out_lba, *out_size;
+    uint8_t    *out_flags;
+    time_t     *out_mtime;
+    uint64_t   *out_rec_pos;
+} walk_want_t;
+
+static int want_cb(const iso_rec_t *r, void *user) {
+    walk_want_t *w = (walk_want_t*)user;
+    if (!names_equal_ci(r->name, w->want)) return 0;
+    if (w->out_lba)     *w->out_lba     = r->lba;
+    if (w->out_size)    *w->out_size    = r->size;
+    if (w->out_flags)   *w->out_flags   = r->flags;
+    if (w->out_mtime)   *w->out_mtime   = iso_recdate_to_time(r->rec + 18);
+    if (w->out_rec_pos) *w->out_rec_pos = r->rec_pos;
+    return 1;
+}
+
+/**
+ * Scan a single ISO9660 directory (at dir_lba, length dir_size bytes) for one component name.
+ * If found, outputs the child's extent LBA/size/flags and returns 1.
+ * out_rec_pos (optional) receives the absolute byte offset of the matching
+ * directory record, which is unique per entry even for zero-length files.
+ * If not found, returns 0. On read/parse error, returns -1.
+ */
+int iso_walk_component(const iso9660_t  *iso,
+                          uint32_t dir_lba,
+                          uint32_t dir_size,
+                          const char *want,
+                          uint32_t *out_lba,
+                          uint32_t *out_size,
+                          uint8_t  *out_flags,
+						  time_t *out_mtime,
+                          uint64_t *out_rec_pos)
+{
+    if (!iso || !iso->dev || !want) return -1;
+    walk_want_t w = { want, out_lba, out_size, out_flags, out_mtime, out_rec_pos };
+    return iso_walk_dir(iso, dir_lba, dir_size, want_cb, &w);
+}
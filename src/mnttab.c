@@ -1,23 +1,31 @@
 #include <stdio.h>
 #include <string.h>
 #include "mnttab.h"
+#include "gu_sync.h"
 
+/* Append-only: a row is filled before the count that covers it is published,
+   so readers need no lock. */
 static MountEntry g_mnt[16];
-static int g_nmnt = 0;
+static _Atomic int g_nmnt = 0;
+static gu_mutex_t  g_mnt_lock = GU_MUTEX_INIT;
 
 bool mnttab_add(const char *dev, int part_index, const char *fstype, const char *mpoint) {
     if (!dev || !mpoint) return false;
-    if (g_nmnt >= (int)(sizeof g_mnt/sizeof g_mnt[0])) return false;
-    snprintf(g_mnt[g_nmnt].dev, sizeof g_mnt[0].dev, "%s", dev);
-    g_mnt[g_nmnt].part_index = part_index;
-    snprintf(g_mnt[g_nmnt].fstype, sizeof g_mnt[0].fstype, "%s", fstype ? fstype : "");
-    snprintf(g_mnt[g_nmnt].mpoint, sizeof g_mnt[0].mpoint, "%s", mpoint);
-    g_nmnt++;
+    gu_mutex_lock(&g_mnt_lock);
+    const int n = atomic_load_explicit(&g_nmnt, memory_order_relaxed);
+    if (n >= (int)(sizeof g_mnt/sizeof g_mnt[0])) { gu_mutex_unlock(&g_mnt_lock); return false; }
+    snprintf(g_mnt[n].dev, sizeof g_mnt[0].dev, "%s", dev);
+    g_mnt[n].part_index = part_index;
+    snprintf(g_mnt[n].fstype, sizeof g_mnt[0].fstype, "%s", fstype ? fstype : "");
+    snprintf(g_mnt[n].mpoint, sizeof g_mnt[0].mpoint, "%s", mpoint);
+    atomic_store_explicit(&g_nmnt, n + 1, memory_order_release);
+    gu_mutex_unlock(&g_mnt_lock);
     return true;
 }
 
 void mnttab_list(void) { // legacy/simple
-    for (int i=0;i<g_nmnt;i++) {
+    const int n = mnttab_count();
+    for (int i=0;i<n;i++) {
         const MountEntry *m = &g_mnt[i];
         printf("%-8s  %-8s  part=%d  fstype=%s\n",
                m->dev, m->mpoint, m->part_index, m->fstype[0] ? m->fstype : "-");
@@ -25,12 +33,13 @@ void mnttab_list(void) { // legacy/simple
 }
 
 const MountEntry* mnttab_find_by_mpoint(const char *mp) {
-    for (int i=0;i<g_nmnt;i++) if (strcmp(g_mnt[i].mpoint, mp)==0) return &g_mnt[i];
+    const int n = mnttab_count();
+    for (int i=0;i<n;i++) if (strcmp(g_mnt[i].mpoint, mp)==0) return &g_mnt[i];
     return NULL;
 }
 
 // NEW:
-int mnttab_count(void) { return g_nmnt; }
+int mnttab_count(void) { return atomic_load_explicit(&g_nmnt, memory_order_acquire); }
 const MountEntry* mnttab_get(int index) {
-    return (index >= 0 && index < g_nmnt) ? &g_mnt[index] : NULL;
+    return (index >= 0 && index < mnttab_count()) ? &g_mnt[index] : NULL;
 }
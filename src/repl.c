@@ -7,6 +7,7 @@
 
 #include "cmds.h"
 #include "helper.h"
+#include "gu_arena.h"
 
 static int s_exit_requested = 0;
 static int g_debug = 0;
@@ -24,17 +25,24 @@ void guppy_clear_exit_request(void){ s_exit_requested = 0; }
 // split_argv(...) should already exist; if not, keep yours here
 // int split_argv(char *buf, char **argv, int max);
 
+/* Everything a command (or the VFS on its behalf) takes from the arena is
+   dropped in one go when it returns; see gu_arena.h. */
+static int dispatch_line(char *buf);
+
 int run_command_line(const char *line_in) {
     if (!line_in) return 0;
+    gu_arena_mark_t mark = gu_arena_mark();
+    char *buf = gu_arena_strdup(line_in);       // local mutable copy
+    int rc = buf ? dispatch_line(buf) : 1;
+    gu_arena_release(mark);
+    return rc;
+}
 
-    // local mutable copy
-    char buf[1024];
-    strncpy(buf, line_in, sizeof buf - 1);
-    buf[sizeof buf - 1] = '\0';
+static int dispatch_line(char *buf) {
     rstrip_crlf(buf);
 
     // built-in debug toggles (not in registry)
-    if (!g_debug) g_debug = is_true(getenv("GUPPY_DEBUG"));
+    if (!g_debug && is_true(getenv("GUPPY_DEBUG"))) g_debug = 1;
     if (strcmp(buf, "debug on") == 0){ g_debug = 1; fprintf(stderr, "[dbg] on\n"); return 0; }
     if (strcmp(buf, "debug off")== 0){ g_debug = 0; fprintf(stderr, "[dbg] off\n"); return 0; }
 
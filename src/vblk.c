@@ -5,10 +5,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <stdlib.h>
 
 #include "debug.h"
 #include "vblk.h"
 #include "diskio.h"
+#include "gu_sync.h"
 
 #ifndef VBLK_MAX
 #define VBLK_MAX 256
@@ -23,15 +25,33 @@ extern bool diskio_pread(const char *devkey, uint64_t off, void *dst, uint32_t l
 
 /*------------------------------------------------------------------------------*
  * Global registry
+ *
+ * Lock-free for readers: rows are immutable once published and are never
+ * freed, so a vblk_t* handed out (e.g. a mounted superblock's bdev) stays
+ * valid. Re-registering a name publishes a fresh row in the same slot; the
+ * old row is kept alive for whoever still holds it. Writers serialise on
+ * g_vblk_lock and publish with release stores.
  *------------------------------------------------------------------------------*/
-vblk_t g_vblk[VBLK_MAX];
-int    g_vblk_count = 0;
+static vblk_t *_Atomic g_vblk[VBLK_MAX];
+static _Atomic int     g_vblk_count = 0;
+static gu_mutex_t      g_vblk_lock = GU_MUTEX_INIT;
 
-static const vblk_t *find_by_name(const char *name, int *out_index) {
-    for (int i = 0; i < g_vblk_count; ++i) {
-        if (strcmp(g_vblk[i].name, name) == 0) {
+int vblk_count(void) {
+    return atomic_load_explicit(&g_vblk_count, memory_order_acquire);
+}
+
+vblk_t *vblk_at(int index) {
+    if (index < 0 || index >= vblk_count()) return NULL;
+    return atomic_load_explicit(&g_vblk[index], memory_order_acquire);
+}
+
+static vblk_t *find_by_name(const char *name, int *out_index) {
+    const int n = vblk_count();
+    for (int i = 0; i < n; ++i) {
+        vblk_t *e = vblk_at(i);
+        if (e && strcmp(e->name, name) == 0) {
             if (out_index) *out_index = i;
-            return &g_vblk[i];
+            return e;
         }
     }
     if (out_index) *out_index = -1;
@@ -45,21 +65,29 @@ const vblk_t *vblk_by_name(const char *name) {
 int vblk_register(const vblk_t *entry) {
     if (!entry || entry->name[0] == '\0') return -1;
 
+    vblk_t *row = (vblk_t*)malloc(sizeof *row);
+    if (!row) return -1;
+    *row = *entry;
+
+    gu_mutex_lock(&g_vblk_lock);
     int idx = -1;
-    const vblk_t *existing = find_by_name(entry->name, &idx);
-    if (existing) {
-        g_vblk[idx] = *entry;  // replace in place
-        return idx;
+    if (find_by_name(entry->name, &idx)) {
+        atomic_store_explicit(&g_vblk[idx], row, memory_order_release);  // replace; old row stays valid
+    } else if (vblk_count() < VBLK_MAX) {
+        idx = vblk_count();
+        atomic_store_explicit(&g_vblk[idx], row, memory_order_release);
+        atomic_store_explicit(&g_vblk_count, idx + 1, memory_order_release);
+    } else {
+        free(row);
     }
-
-    if (g_vblk_count >= VBLK_MAX) return -1;
-    g_vblk[g_vblk_count] = *entry;
-    return g_vblk_count++;
+    gu_mutex_unlock(&g_vblk_lock);
+    return idx;
 }
 
 void vblk_clear(void) {
-    memset(g_vblk, 0, sizeof(g_vblk));
-    g_vblk_count = 0;
+    gu_mutex_lock(&g_vblk_lock);
+    atomic_store_explicit(&g_vblk_count, 0, memory_order_release);
+    gu_mutex_unlock(&g_vblk_lock);
 }
 
 /*------------------------------------------------------------------------------*
@@ -109,6 +137,37 @@ bool vblk_read_blocks(vblk_t *dev, uint64_t lba, uint32_t count, void *dst)
     return true;
 }
 
+/* Copy 'len' bytes from src@soff to dst@doff (offsets relative to each vblk)
+   directly between the backing images. */
+bool vblk_copy_range(vblk_t *src, uint64_t soff, vblk_t *dst, uint64_t doff, uint64_t len)
+{
+    if (!src || !dst) return false;
+    if (dst->ro) {
+        DBG("vblk_copy_range: destination %s is read-only", dst->name);
+        return false;
+    }
+    uint64_t slim = part_bytes_limit(src), dlim = part_bytes_limit(dst);
+    if (soff > slim || len > slim - soff || doff > dlim || len > dlim - doff) return false;
+
+    const char *skey = src->dev[0] ? src->dev : src->name;
+    const char *dkey = dst->dev[0] ? dst->dev : dst->name;
+    diskio_copy_how_t how;
+    bool ok = diskio_copy_range(skey, src->lba_start * (uint64_t)LSEC + soff,
+                                dkey, dst->lba_start * (uint64_t)LSEC + doff, len, &how);
+    DBG("vblk_copy_range: %s@%" PRIu64 " -> %s@%" PRIu64 " len=%" PRIu64 " how=%d ok=%d",
+        skey, soff, dkey, doff, len, (int)how, (int)ok);
+    return ok;
+}
+
+const void *vblk_map_range(vblk_t *dev, uint64_t off, size_t len)
+{
+    if (!dev || len == 0) return NULL;
+    uint64_t lim = part_bytes_limit(dev);
+    if (off > lim || len > lim - off) return NULL;
+    const char *key = dev->dev[0] ? dev->dev : dev->name;
+    return diskio_map_range(key, dev->lba_start * (uint64_t)LSEC + off, len);
+}
+
 bool vblk_resolve_to_base(const char *name,
                           char *key_out, size_t key_sz,
                           uint64_t *base_off_bytes,
@@ -149,9 +208,10 @@ vblk_t *vblk_open(const char *key) {
     if (!key || !*key) return NULL;
 
     /* 1) Try exact match on internal key (name) OR display path (dev) */
-    for (int i = 0; i < g_vblk_count; ++i) {
-        vblk_t *e = &g_vblk[i];
-        if (!e->name[0]) continue;
+    const int n = vblk_count();
+    for (int i = 0; i < n; ++i) {
+        vblk_t *e = vblk_at(i);
+        if (!e || !e->name[0]) continue;
 
         if (strcmp(e->name, key) == 0 || (e->dev[0] && strcmp(e->dev, key) == 0)) {
             if (e->lba_size == 0) { DBG("vblk_open: reject '%s' (size=0)", key); return NULL; }
@@ -164,9 +224,9 @@ vblk_t *vblk_open(const char *key) {
     const char *base = base_of(key);
     if (base != key) {
         DBG("vblk_open: retry with base='%s'", base);
-        for (int i = 0; i < g_vblk_count; ++i) {
-            vblk_t *e = &g_vblk[i];
-            if (strcmp(e->name, base) == 0) {
+        for (int i = 0; i < n; ++i) {
+            vblk_t *e = vblk_at(i);
+            if (e && strcmp(e->name, base) == 0) {
                 if (e->lba_size == 0) { DBG("vblk_open: reject base '%s' (size=0)", base); return NULL; }
                 DBG("vblk_open: hit name='%s' dev='%s' size=%" PRIu64, e->name, e->dev, e->lba_size);
                 return e;
@@ -9,6 +9,8 @@
 #include "debug.h"
 #include "vfs.h"
 #include "vfs_stat.h"
+#include "gu_arena.h"
+#include "diskio.h"
 
 
 #include <stdio.h>
@@ -22,43 +24,55 @@
 
 /* ---------- Feature toggles ---------- */
 #ifndef VFS_HAVE_CREATE_OP
-#define VFS_HAVE_CREATE_OP 0
+#define VFS_HAVE_CREATE_OP 1
 #endif
 
 #ifndef VFS_MAX_FS_TYPES
 #define VFS_MAX_FS_TYPES 32
 #endif
 
-#ifndef VFS_MAX_MOUNTS
-#define VFS_MAX_MOUNTS   32
-#endif
-
 #ifndef VFS_PATH_MAX
 #define VFS_PATH_MAX     1024
 #endif
 
-/* ---------- Filesystem registry ---------- */
+/* ---------- Filesystem registry ----------
+ * Append-only: an entry is written before the count that covers it is
+ * published, so lookups run without the lock. */
 typedef struct { const char *name; const filesystem_type_t *fs; } fs_entry_t;
-static fs_entry_t g_fs[VFS_MAX_FS_TYPES];
-static int g_fs_n = 0;
+static fs_entry_t  g_fs[VFS_MAX_FS_TYPES];
+static _Atomic int g_fs_n = 0;
+static gu_mutex_t  g_fs_lock = GU_MUTEX_INIT;
+
+static int fs_count(void) { return atomic_load_explicit(&g_fs_n, memory_order_acquire); }
+
+static int fs_append(const char *name, const filesystem_type_t *fst) {
+    const int n = atomic_load_explicit(&g_fs_n, memory_order_relaxed);
+    if (n >= VFS_MAX_FS_TYPES) return -1;
+    g_fs[n] = (fs_entry_t){ name, fst };
+    atomic_store_explicit(&g_fs_n, n + 1, memory_order_release);
+    return 0;
+}
 
 int vfs_register(const filesystem_type_t *fst) {
     if (!fst || !fst->name) return -1;
-    if (g_fs_n >= VFS_MAX_FS_TYPES) return -1;
+    gu_mutex_lock(&g_fs_lock);
     /* dedupe by name (case-insensitive) */
-    for (int i = 0; i < g_fs_n; ++i) {
-        if (strcasecmp(g_fs[i].name, fst->name) == 0) return 0;
+    const int n = fs_count();
+    for (int i = 0; i < n; ++i) {
+        if (strcasecmp(g_fs[i].name, fst->name) == 0) { gu_mutex_unlock(&g_fs_lock); return 0; }
     }
-    g_fs[g_fs_n++] = (fs_entry_t){ fst->name, fst };
+    int rc = fs_append(fst->name, fst);
+    gu_mutex_unlock(&g_fs_lock);
 #ifdef DEBUG
-    DBG("vfs: registered '%s'", fst->name);
+    if (rc == 0) DBG("vfs: registered '%s'", fst->name);
 #endif
-    return 0;
+    return rc;
 }
 
 int vfs_for_each_fs(vfs_fs_iter_cb cb, void *user) {
     if (!cb) return -1;
-    for (int i = 0; i < g_fs_n; ++i) {
+    const int n = fs_count();
+    for (int i = 0; i < n; ++i) {
         int r = cb(g_fs[i].fs, user);
         if (r) return r;
     }
@@ -67,12 +81,13 @@ int vfs_for_each_fs(vfs_fs_iter_cb cb, void *user) {
 
 int vfs_register_alias(const char *alias, const filesystem_type_t *target) {
     if (!alias || !target) return -1;
-    if (g_fs_n >= VFS_MAX_FS_TYPES) return -1;
-    g_fs[g_fs_n++] = (fs_entry_t){ alias, target };
+    gu_mutex_lock(&g_fs_lock);
+    int rc = fs_append(alias, target);
+    gu_mutex_unlock(&g_fs_lock);
 #ifdef DEBUG
-    DBG("vfs: alias '%s' -> '%s'", alias, target->name ? target->name : "?");
+    if (rc == 0) DBG("vfs: alias '%s' -> '%s'", alias, target->name ? target->name : "?");
 #endif
-    return 0;
+    return rc;
 }
 
 static int ci_cmp(char a, char b) {
@@ -83,7 +98,8 @@ static int ci_cmp(char a, char b) {
 
 const filesystem_type_t* vfs_find_fs(const char *name) {
     if (!name) return NULL;
-    for (int i = 0; i < g_fs_n; ++i) {
+    const int n = fs_count();
+    for (int i = 0; i < n; ++i) {
         const char *a = g_fs[i].name, *b = name;
         while (*a && *b && ci_cmp(*a, *b) == 0) { ++a; ++b; }
         if (*a == '\0' && *b == '\0') return g_fs[i].fs;
@@ -91,18 +107,69 @@ const filesystem_type_t* vfs_find_fs(const char *name) {
     return NULL;
 }
 
-/* ---------- Mount table (single source of truth) ---------- */
+/* ---------- Mount table (single source of truth) ----------
+ * Mounts hang off a component trie rooted at "/": resolving a path walks one
+ * trie node per component and remembers the deepest node carrying a mount,
+ * so routing costs O(path depth) however many mounts exist. A separate list
+ * keeps mount order for listings.
+ *
+ * Readers walk the trie inside a gu_rcu read section without locking: each
+ * node's children are an immutable array sorted by hash that writers replace
+ * wholesale (copy-on-write), and node->mnt is swapped atomically. Writers
+ * serialise on g_mnt_lock and free anything they unpublished only after
+ * gu_rcu_synchronize(). A reader leaves the section holding a reference on
+ * the mount it found; the table's own reference is dropped by umount, and
+ * the last put tears the superblock down. */
 typedef struct mount_rec {
-    char          mp[VFS_PATH_MAX]; /* normalized mountpoint */
+    char         *mp;               /* normalized mountpoint */
     superblock_t *sb;
     /* user-visible metadata */
     char          src[64];          /* "/dev/a1" */
     char          fstype[16];       /* "ext2", "fat", ... */
     char          opts[64];         /* "rw", "ro,noexec", ... */
+    struct mnt_node  *node;         /* trie node this mount hangs on */
+    struct mount_rec *next;         /* mount order */
+    _Atomic int   refs;             /* table + walks + open files */
+    bool          keep_sb;          /* unrecorded only: caller still owns sb */
 } mount_rec_t;
 
-static mount_rec_t g_mnt[VFS_MAX_MOUNTS];
-static int         g_mnt_n = 0;
+typedef struct mnt_kids {
+    size_t           n;
+    struct mnt_node *v[];           /* sorted by hash */
+} mnt_kids_t;
+
+typedef struct mnt_node {
+    vfs_atom_t        name;         /* interned component; NULL for the root */
+    struct mnt_node  *parent;
+    mnt_kids_t *_Atomic  kids;      /* NULL when childless */
+    mount_rec_t *_Atomic mnt;       /* mount rooted exactly here, or NULL */
+} mnt_node_t;
+
+static mnt_node_t   g_mroot;        /* "/" */
+static mount_rec_t *g_mnt_head = NULL, *g_mnt_tail = NULL;
+static int          g_mnt_n = 0;
+static gu_mutex_t   g_mnt_lock = GU_MUTEX_INIT;
+
+static mount_rec_t *mnt_get(mount_rec_t *m) {
+    if (m) atomic_fetch_add_explicit(&m->refs, 1, memory_order_relaxed);
+    return m;
+}
+
+static void mnt_put(mount_rec_t *m) {
+    if (!m || atomic_fetch_sub_explicit(&m->refs, 1, memory_order_acq_rel) != 1) return;
+    superblock_t *sb = m->sb;
+    DBG("vfs: last reference to '%s' dropped%s", m->mp, m->keep_sb ? "" : "; killing sb");
+    if (sb && !m->keep_sb) {
+        gu_write_lock(&sb->s_lock);
+        if (sb->s_op && sb->s_op->syncfs) (void)sb->s_op->syncfs(sb);
+        gu_rw_unlock(&sb->s_lock);
+        gu_rwlock_destroy(&sb->s_lock);
+        if (sb->s_op && sb->s_op->kill_sb) sb->s_op->kill_sb(sb);
+        else if (sb->fs_type && sb->fs_type->umount) sb->fs_type->umount(sb);
+    }
+    free(m->mp);
+    free(m);
+}
 
 /* Normalize path: convert '\' to '/', collapse '//' and trim trailing '/', keep "/" */
 static void vfs_normalize_path(const char *in, char *out, size_t cap) {
@@ -119,50 +186,170 @@ static void vfs_normalize_path(const char *in, char *out, size_t cap) {
     while (n > 1 && out[n-1] == '/') { out[n-1] = '\0'; --n; }
 }
 
-/* Longest-prefix match mount */
-static int vfs_find_mount_for(const char *path_norm) {
-    int best = -1; size_t best_len = 0;
-    for (int i = 0; i < g_mnt_n; ++i) {
-        const char *mp = g_mnt[i].mp;
-        size_t mlen = strlen(mp);
-        if (mlen == 1 && mp[0] == '/') {
-            if (best == -1) { best = i; best_len = 1; }
-            continue;
-        }
-        if (strncmp(path_norm, mp, mlen) == 0) {
-            if (path_norm[mlen] == '\0' || path_norm[mlen] == '/') {
-                if (mlen > best_len) { best = i; best_len = mlen; }
-            }
+/* Split off the next component of a normalized path: returns its start
+   (leading '/' skipped) and length, or NULL at the end. */
+static const char *mnt_comp(const char *p, size_t *len) {
+    while (*p == '/') ++p;
+    if (!*p) return NULL;
+    const char *e = p;
+    while (*e && *e != '/') ++e;
+    *len = (size_t)(e - p);
+    return p;
+}
+
+/* Children are matched by atom identity; the atom's hash orders them. */
+static mnt_node_t *mnode_child(const mnt_node_t *n, vfs_atom_t name) {
+    const mnt_kids_t *k = atomic_load_explicit(&((mnt_node_t*)n)->kids, memory_order_acquire);
+    if (!k || !name) return NULL;
+    const uint32_t h = name->hash;
+    size_t lo = 0, hi = k->n;
+    while (lo < hi) {                       /* first slot with hash >= h */
+        size_t mid = (lo + hi) / 2;
+        if (k->v[mid]->name->hash < h) lo = mid + 1; else hi = mid;
+    }
+    for (; lo < k->n && k->v[lo]->name->hash == h; ++lo)
+        if (k->v[lo]->name == name) return k->v[lo];
+    return NULL;
+}
+
+/* Publish a copy of n's child array with c inserted (c != NULL) or 'drop'
+   removed. Writer only; the old array is freed after a grace period. */
+static bool mnode_replace_kids(mnt_node_t *n, mnt_node_t *c, mnt_node_t *drop) {
+    mnt_kids_t *old = atomic_load_explicit(&n->kids, memory_order_relaxed);
+    size_t on = old ? old->n : 0;
+    size_t nn = c ? on + 1 : on - 1;
+    mnt_kids_t *nk = NULL;
+    if (nn) {
+        nk = (mnt_kids_t*)malloc(sizeof *nk + nn * sizeof nk->v[0]);
+        if (!nk) return false;
+        size_t j = 0;
+        for (size_t i = 0; i < on; ++i) {
+            if (old->v[i] == drop) continue;
+            if (c && c->name->hash < old->v[i]->name->hash) { nk->v[j++] = c; c = NULL; }
+            nk->v[j++] = old->v[i];
         }
+        if (c) nk->v[j++] = c;
+        nk->n = nn;
     }
-    return best;
+    atomic_store_explicit(&n->kids, nk, memory_order_release);
+    if (old) { gu_rcu_synchronize(); free(old); }
+    return true;
 }
 
-static void vfs_mount_relative(const char *path_norm, const mount_rec_t *m, char *rel, size_t cap) {
-    size_t ml = strlen(m->mp);
-    const char *p = (ml == 1 && m->mp[0] == '/') ? path_norm : path_norm + ml;
-    while (*p == '/') ++p;
-    strncpy(rel, p, cap); rel[cap-1] = '\0';
+/* Find or create the child 'name' under n (writer). */
+static mnt_node_t *mnode_get(mnt_node_t *n, vfs_atom_t name) {
+    if (!name) return NULL;                 /* too long, or out of memory */
+    mnt_node_t *c = mnode_child(n, name);
+    if (c) return c;
+
+    c = (mnt_node_t*)calloc(1, sizeof *c);
+    if (!c) return NULL;
+    c->name = name; c->parent = n;
+    if (!mnode_replace_kids(n, c, NULL)) { free(c); return NULL; }
+    return c;
+}
+
+/* Free now-useless nodes from n up towards the root (writer). */
+static void mnode_prune(mnt_node_t *n) {
+    while (n && n != &g_mroot && !atomic_load_explicit(&n->mnt, memory_order_relaxed) &&
+           !atomic_load_explicit(&n->kids, memory_order_relaxed)) {
+        mnt_node_t *par = n->parent;
+        /* replace_kids waits out a grace period, so no reader stands on n */
+        if (!mnode_replace_kids(par, NULL, n)) return;   /* keep the node; harmless */
+        free(n);
+        n = par;
+    }
+}
+
+/* Exact trie node for a normalized mountpoint (create=true builds the path). */
+static mnt_node_t *mnode_lookup(const char *mp_norm, bool create) {
+    mnt_node_t *n = &g_mroot;
+    size_t len;
+    for (const char *c = mnt_comp(mp_norm, &len); c; c = mnt_comp(c + len, &len)) {
+        mnt_node_t *next = create ? mnode_get(n, vfs_intern(c, len))
+                                  : mnode_child(n, vfs_intern_find(c, len));
+        if (!next) return NULL;
+        n = next;
+    }
+    return n;
+}
+
+/* Writer-side exact lookup (g_mnt_lock held). */
+static mount_rec_t *mount_at(const char *mp_norm) {
+    mnt_node_t *n = mnode_lookup(mp_norm, false);
+    return n ? atomic_load_explicit(&n->mnt, memory_order_relaxed) : NULL;
+}
+
+/* Unhook a record from the trie and the order list (g_mnt_lock held; does
+   not drop the table's reference). */
+static void mount_unlink(mount_rec_t *m) {
+    mount_rec_t **pp = &g_mnt_head, *prev = NULL;
+    while (*pp && *pp != m) { prev = *pp; pp = &(*pp)->next; }
+    if (*pp) *pp = m->next;
+    if (g_mnt_tail == m) g_mnt_tail = prev;
+    g_mnt_n--;
+    atomic_store_explicit(&m->node->mnt, NULL, memory_order_release);
+    mnode_prune(m->node);
+    m->node = NULL;
+}
+
+/* Longest-prefix match mount, returned with a reference the caller drops
+   with mnt_put(). *rel_out points into path_norm just past the mountpoint
+   (no leading '/'). Relative paths route to the root mount. */
+static mount_rec_t *vfs_find_mount_for(const char *path_norm, const char **rel_out) {
+    unsigned rcu = gu_rcu_read_lock();
+    mount_rec_t *best = atomic_load_explicit(&g_mroot.mnt, memory_order_acquire);
+    const char *rel = path_norm;
+
+    if (path_norm[0] == '/') {
+        const mnt_node_t *n = &g_mroot;
+        size_t len;
+        for (const char *c = mnt_comp(path_norm, &len); c; c = mnt_comp(c + len, &len)) {
+            /* a name nobody interned cannot be a trie node */
+            n = mnode_child(n, vfs_intern_find(c, len));
+            if (!n) break;
+            mount_rec_t *m = atomic_load_explicit(&((mnt_node_t*)n)->mnt, memory_order_acquire);
+            if (m) { best = m; rel = c + len; }
+        }
+    }
+    mnt_get(best);       /* safe: records are freed only after a grace period */
+    gu_rcu_read_unlock(rcu);
+
+    while (*rel == '/') ++rel;
+    *rel_out = rel;
+    return best;
 }
 
 /* ---------- Path walk ---------- */
 typedef struct path_res {
     inode_t *dir;
     inode_t *node;
-    char     leaf[256];
+    const char *leaf;               /* missing last component (in leaf_buf), else NULL */
     mount_rec_t *mnt;
+    char leaf_buf[VFS_ATOM_MAX_LEN + 1];
 } path_res_t;
 
-/* Tokenize a relative path into components */
-static const char* comp_next(const char *s, char name[256]) {
-    size_t j = 0;
-    while (*s && *s != '/' && j + 1 < 256) name[j++] = *s++;
-    name[j] = '\0';
-    while (*s == '/') ++s;
-    return s;
+/* Drop the inode and mount references a successful walk handed back. */
+static void path_res_put(path_res_t *r) {
+    if (!r) return;
+    vfs_iput(r->node);
+    vfs_iput(r->dir);
+    mnt_put(r->mnt);
+    r->node = r->dir = NULL;
+    r->mnt = NULL;
+}
+
+/* Every driver lookup goes through here so it is timed per superblock. */
+static int drv_lookup(inode_t *dir, const char *name, inode_t **out) {
+    const uint64_t t0 = vfs_op_begin();
+    int rc = dir->i_op->lookup(dir, name, out);
+    vfs_op_end(dir->i_sb, VFS_OP_LOOKUP, t0, rc != 0 ? -1 : 0);
+    return rc;
 }
 
-static int vfs_walk_rel(mount_rec_t *mnt, const char *rel, path_res_t *out)
+/* Walk 'rel' below the mount root (caller holds the sb lock shared). On
+   success out->dir and out->node (if found) each carry one inode reference. */
+static int walk_rel_locked(mount_rec_t *mnt, const char *rel, path_res_t *out)
 {
     DBG("vfs_walk_rel: Start path=\"%s\" on mount=\"%s\"",
         rel ? rel : "(null)", mnt ? mnt->mp : "(mnt NULL)");
@@ -171,43 +358,42 @@ static int vfs_walk_rel(mount_rec_t *mnt, const char *rel, path_res_t *out)
         return -1;
     }
 
-    inode_t *cur = mnt->sb->root;
-
-    /* Keep a tiny parent stack so '..' can walk up. */
+    /* Keep a tiny parent stack so '..' can walk up. Every slot owns a ref. */
     enum { PARENT_STACK_MAX = 64 };
     inode_t *stack[PARENT_STACK_MAX];
     int depth = 0;                  /* number of parents on stack */
-    stack[depth++] = cur;           /* stack[0] is the root itself */
-
-    char leaf[256] = {0};
+    stack[depth++] = vfs_ihold(mnt->sb->root);  /* stack[0] is the root itself */
+    inode_t *cur = stack[0];
 
     if (!rel || *rel == '\0') {
-        out->dir  = cur;
+        out->dir  = vfs_ihold(cur);
         out->node = cur;
-        out->leaf[0] = '\0';
+        out->leaf = NULL;
         out->mnt  = mnt;
         DBG("vfs_walk_rel: Path is mount root (inode=%p)", (void*)cur);
         return 0;
     }
 
-    char comp[256];
-    const char *p = rel;
-    while (*p) {
-        p = comp_next(p, comp);
-        if (comp[0] == '\0') {
-            /* Trailing slash or empty segment: nothing to do */
-            continue;
-        }
+    /* Components are sliced out of 'rel' in place (empty segments skipped)
+       and copied into name_buf for the driver. They are not interned:
+       drivers take plain strings, so an atom would only cost a hash, and
+       looking up new or missing names must not grow the table. A missing
+       leaf is kept in out->leaf_buf. */
+    char name_buf[VFS_ATOM_MAX_LEN + 1];
+    size_t len;
+    for (const char *c = mnt_comp(rel, &len); c; c = mnt_comp(c + len, &len)) {
+        const char *p = c + len;        /* rest of the path */
+        while (*p == '/') ++p;
 
         /* VFS-level handling of dot components */
-        if (comp[0] == '.' && comp[1] == '\0') {
+        if (len == 1 && c[0] == '.') {
             DBG("vfs_walk_rel: component '.' -> stay at %p", (void*)cur);
             continue;
         }
-        if (comp[0] == '.' && comp[1] == '.' && comp[2] == '\0') {
+        if (len == 2 && c[0] == '.' && c[1] == '.') {
             if (depth > 1) {
                 /* Pop to parent (do not pop past root) */
-                depth--;
+                vfs_iput(stack[--depth]);
                 cur = stack[depth - 1];
             }
             DBG("vfs_walk_rel: component '..' -> now at %p (depth=%d)",
@@ -215,74 +401,116 @@ static int vfs_walk_rel(mount_rec_t *mnt, const char *rel, path_res_t *out)
             continue;
         }
 
-        DBG("vfs_walk_rel: [%p] lookup \"%s\"", (void*)cur, comp);
+        if (len > VFS_ATOM_MAX_LEN) {
+            DBG("vfs_walk_rel: ERROR - component of %zu bytes is too long", len);
+            goto fail;
+        }
+        memcpy(name_buf, c, len);
+        name_buf[len] = '\0';
+        DBG("vfs_walk_rel: [%p] lookup \"%s\"", (void*)cur, name_buf);
         if (!cur->i_op || !cur->i_op->lookup) {
             DBG("vfs_walk_rel: ERROR - current inode has no lookup (not a dir?)");
-            return -1;
+            goto fail;
         }
 
         inode_t *next = NULL;
-        int rc = cur->i_op->lookup(cur, comp, &next);
+        int rc = drv_lookup(cur, name_buf, &next);
         DBG("vfs_walk_rel:    lookup returned rc=%d, next=%p", rc, (void*)next);
-        if (rc != 0) {
-            DBG("vfs_walk_rel: ERROR - lookup failed for \"%s\" (rc=%d)", comp, rc);
-            return -1;
+        if (rc != 0 && !(rc < 0 && -rc == ENOENT)) {
+            DBG("vfs_walk_rel: ERROR - lookup failed for \"%s\" (rc=%d)", name_buf, rc);
+            goto fail;
         }
         if (!next) {
             /* Component not found in this directory */
-            strncpy(leaf, comp, sizeof leaf);
-            leaf[sizeof leaf - 1] = '\0';
-            out->dir  = cur;
+            if (*p) {
+                DBG("vfs_walk_rel: \"%s\" missing mid-path", name_buf);
+                goto fail;
+            }
+            out->dir  = vfs_ihold(cur);
             out->node = NULL;
             out->mnt  = mnt;
-            strncpy(out->leaf, leaf, sizeof out->leaf);
-            out->leaf[sizeof out->leaf - 1] = '\0';
+            memcpy(out->leaf_buf, name_buf, len + 1);
+            out->leaf = out->leaf_buf;
+            while (depth > 0) vfs_iput(stack[--depth]);
             DBG("vfs_walk_rel: \"%s\" not found under dir %p; stopping",
-                comp, (void*)cur);
+                name_buf, (void*)cur);
             return 0;
         }
 
-        /* Descend: push current as parent if room remains */
-        if (depth < PARENT_STACK_MAX) stack[depth++] = next;
+        /* Descend: push as parent; a full stack forgets the deepest parent */
+        if (depth == PARENT_STACK_MAX) vfs_iput(stack[--depth]);
+        stack[depth++] = next;
         cur = next;
 
         DBG("vfs_walk_rel: --> Found \"%s\" inode=%p%s",
-            comp, (void*)cur,
+            name_buf, (void*)cur,
             (cur->i_op && cur->i_op->lookup) ? " [DIR]" : " [FILE]");
     }
 
     /* Fully resolved. Parent is the previous element on the stack (or self at root). */
-    inode_t *parent = (depth > 1) ? stack[depth - 2] : cur;
-
-    out->dir  = parent;
-    out->node = cur;
-    out->leaf[0] = '\0';
+    out->node = stack[--depth];
+    out->dir  = (depth > 0) ? stack[--depth] : vfs_ihold(out->node);
+    out->leaf = NULL;
     out->mnt  = mnt;
+    while (depth > 0) vfs_iput(stack[--depth]);
 
-    DBG("vfs_walk_rel: DONE. Final node=%p (parent=%p, depth=%d)",
-        (void*)out->node, (void*)out->dir, depth);
+    DBG("vfs_walk_rel: DONE. Final node=%p (parent=%p)",
+        (void*)out->node, (void*)out->dir);
     return 0;
+
+fail:
+    while (depth > 0) vfs_iput(stack[--depth]);
+    return -1;
+}
+
+static int vfs_walk_rel(mount_rec_t *mnt, const char *rel, path_res_t *out) {
+    if (!mnt || !mnt->sb) return -1;
+    gu_read_lock(&mnt->sb->s_lock);
+    int rc = walk_rel_locked(mnt, rel, out);
+    gu_rw_unlock(&mnt->sb->s_lock);
+    return rc;
 }
 
+/* Resolve a path. On success 'out' owns a mount reference plus the walk's
+   inode references; release everything with path_res_put(). */
 static int vfs_resolve_path(const char *path, path_res_t *out) {
     if (!path || !*path) return -1;
-    char norm[VFS_PATH_MAX];
-    vfs_normalize_path(path, norm, sizeof norm);
-    int mi = vfs_find_mount_for(norm);
-    if (mi < 0) return -1;
-    char rel[VFS_PATH_MAX];
-    vfs_mount_relative(norm, &g_mnt[mi], rel, sizeof rel);
-    return vfs_walk_rel(&g_mnt[mi], rel, out);
+    /* normalizing never lengthens a path; the copy is scratch for the walk */
+    gu_arena_mark_t mark = gu_arena_mark();
+    size_t cap = strlen(path) + 2;
+    if (cap > VFS_PATH_MAX) cap = VFS_PATH_MAX;
+    char *norm = (char*)gu_arena_alloc(cap);
+    int rc = -1;
+    if (norm) {
+        vfs_normalize_path(path, norm, cap);
+        const char *rel = NULL;
+        mount_rec_t *m = vfs_find_mount_for(norm, &rel);
+        if (m && vfs_walk_rel(m, rel, out) == 0) rc = 0;
+        else mnt_put(m);
+    }
+    gu_arena_release(mark);
+    return rc;
 }
 
+/* Superblock lock helpers for a file's or inode's superblock. */
+static inline void sb_read_lock(const inode_t *i)  { if (i && i->i_sb) gu_read_lock(&i->i_sb->s_lock); }
+static inline void sb_write_lock(const inode_t *i) { if (i && i->i_sb) gu_write_lock(&i->i_sb->s_lock); }
+static inline void sb_unlock(const inode_t *i)     { if (i && i->i_sb) gu_rw_unlock(&i->i_sb->s_lock); }
+
 /* ---------- Router: mount / umount / list ---------- */
+static const char *mount_fstype_name(const mount_rec_t *m) {
+    if (m->fstype[0]) return m->fstype;
+    if (m->sb && m->sb->fs_type && m->sb->fs_type->name) return m->sb->fs_type->name;
+    return "-";
+}
+
 int vfs_mount_dev(const char *fstype,
                   const char *src,
                   vblk_t *dev,
                   const char *mountpoint,
                   const char *opts)
 {
-    if (!fstype || !src || !dev || !mountpoint) {
+    if (!fstype || !src || !mountpoint) {
         DBG("vfs: mount: invalid args fstype=%p src=%p dev=%p mp=%p", (void*)fstype, (void*)src, (void*)dev, (void*)mountpoint);
         return -1;
     }
@@ -292,23 +520,28 @@ int vfs_mount_dev(const char *fstype,
         DBG("vfs: mount: unknown fs '%s' or missing mount()", fstype ? fstype : "(null)");
         return -1;
     }
+    if (!dev && !(fs->fs_flags & VFS_FS_NODEV)) {
+        DBG("vfs: mount: '%s' needs a block device", fstype);
+        return -1;
+    }
 
     char mp[VFS_PATH_MAX];
     vfs_normalize_path(mountpoint, mp, sizeof mp);
 
-    /* deny duplicate mountpoint */
-    for (int i = 0; i < g_mnt_n; ++i) {
-        if (strcmp(g_mnt[i].mp, mp) == 0) {
-            DBG("vfs: mount: mountpoint '%s' already in use", mp);
-            return -1;
-        }
-    }
-
-    if (g_mnt_n >= VFS_MAX_MOUNTS) {
-        DBG("vfs: mount: mount table full (%d >= %d)", g_mnt_n, VFS_MAX_MOUNTS);
+    /* cheap early check; repeated under the lock before publishing */
+    gu_mutex_lock(&g_mnt_lock);
+    bool busy = mount_at(mp) != NULL;
+    gu_mutex_unlock(&g_mnt_lock);
+    if (busy) {
+        DBG("vfs: mount: mountpoint '%s' already in use", mp);
         return -1;
     }
 
+    mount_rec_t *m = (mount_rec_t*)calloc(1, sizeof *m);
+    char *mp_copy = (char*)malloc(strlen(mp) + 1);
+    if (!m || !mp_copy) { free(m); free(mp_copy); return -1; }
+    strcpy(mp_copy, mp);
+
     superblock_t *sb = NULL;
     const char *mopts = (opts && *opts) ? opts : "";
     int rc = fs->mount(dev, mopts, &sb);
@@ -316,18 +549,21 @@ int vfs_mount_dev(const char *fstype,
 
     if (rc != 0 || !sb) {
         DBG("vfs: mount failed: rc=%d sb=%p", rc, (void*)sb);
+        free(m); free(mp_copy);
         return -1;
     }
     if (!sb->root) {
         DBG("vfs: mount: filesystem returned NULL root");
         if (sb->s_op && sb->s_op->kill_sb) sb->s_op->kill_sb(sb);
+        free(m); free(mp_copy);
         return -1;
     }
+    gu_rwlock_init(&sb->s_lock);
 
     /* record */
-    mount_rec_t *m = &g_mnt[g_mnt_n++];
-    strncpy(m->mp, mp, sizeof m->mp); m->mp[sizeof m->mp - 1] = '\0';
-    m->sb = sb;
+    m->mp   = mp_copy;
+    m->sb   = sb;
+    atomic_init(&m->refs, 1);       /* the table's reference */
     snprintf(m->src,    sizeof m->src,    "%s", src);
     snprintf(m->fstype, sizeof m->fstype, "%s", fstype);
 
@@ -335,44 +571,124 @@ int vfs_mount_dev(const char *fstype,
     const bool ro = (sb->s_flags & VFS_SB_RDONLY) != 0;
     snprintf(m->opts, sizeof m->opts, "%s", (opts && *opts) ? opts : (ro ? "ro" : "rw"));
 
+    gu_mutex_lock(&g_mnt_lock);
+    mnt_node_t *node = mount_at(mp) ? NULL : mnode_lookup(mp, true);
+    if (node) {
+        m->node = node;
+        if (g_mnt_tail) g_mnt_tail->next = m; else g_mnt_head = m;
+        g_mnt_tail = m;
+        g_mnt_n++;
+        atomic_store_explicit(&node->mnt, m, memory_order_release);   /* publish */
+    }
+    gu_mutex_unlock(&g_mnt_lock);
+
+    if (!node) {
+        DBG("vfs: mount: '%s' busy or out of memory building trie", mp);
+        mnt_put(m);             /* kills the sb we just built */
+        return -1;
+    }
+
     DBG("vfs: mount '%s' on '%s' type='%s' opts='%s' (root=%p)",
         m->src, m->mp, m->fstype, m->opts, (void*)sb->root);
 
     return 0;
 }
 
-int vfs_umount(const char *mountpoint) {
-    if (!mountpoint) return -1;
+/* Unpublish the mount at 'mp' and hand back the table's reference; the
+   caller drops it once no reader can still be finding it. */
+static mount_rec_t *mount_detach(const char *mountpoint) {
     char mp[VFS_PATH_MAX];
     vfs_normalize_path(mountpoint, mp, sizeof mp);
 
-    for (int i = 0; i < g_mnt_n; ++i) {
-        if (strcmp(g_mnt[i].mp, mp) == 0) {
-            superblock_t *sb = g_mnt[i].sb;
-            for (int j = i + 1; j < g_mnt_n; ++j) g_mnt[j - 1] = g_mnt[j];
-            g_mnt_n--;
+    gu_mutex_lock(&g_mnt_lock);
+    mount_rec_t *m = mount_at(mp);
+    if (m) mount_unlink(m);
+    gu_mutex_unlock(&g_mnt_lock);
+    if (m) gu_rcu_synchronize();
+    return m;
+}
 
-            if (sb) {
-                if (sb->s_op && sb->s_op->syncfs) (void)sb->s_op->syncfs(sb);
-                if (sb->s_op && sb->s_op->kill_sb) sb->s_op->kill_sb(sb);
-                else if (sb->fs_type && sb->fs_type->umount) sb->fs_type->umount(sb);
-            }
-            return 0;
-        }
-    }
-    return -1;
+/* Lazy: the mountpoint disappears now; walks and open files that still pin
+   the mount keep the superblock alive until they finish. */
+int vfs_umount(const char *mountpoint) {
+    if (!mountpoint) return -1;
+    mount_rec_t *m = mount_detach(mountpoint);
+    if (!m) return -1;
+    mnt_put(m);
+    return 0;
 }
 
 void vfs_list_mounts(void) {
-    if (g_mnt_n == 0) { puts("(no mounts)"); return; }
-    for (int i = 0; i < g_mnt_n; ++i) {
+    gu_mutex_lock(&g_mnt_lock);
+    if (g_mnt_n == 0) puts("(no mounts)");
+    for (const mount_rec_t *m = g_mnt_head; m; m = m->next) {
         printf("%-10s %-6s %-12s %s\n",
-               g_mnt[i].src[0] ? g_mnt[i].src : "-",
-               g_mnt[i].fstype[0] ? g_mnt[i].fstype :
-                 (g_mnt[i].sb && g_mnt[i].sb->fs_type && g_mnt[i].sb->fs_type->name ? g_mnt[i].sb->fs_type->name : "-"),
-               g_mnt[i].mp,
-               g_mnt[i].opts[0] ? g_mnt[i].opts : "-");
+               m->src[0] ? m->src : "-",
+               mount_fstype_name(m),
+               m->mp,
+               m->opts[0] ? m->opts : "-");
     }
+    gu_mutex_unlock(&g_mnt_lock);
+}
+
+void vfs_list_mount_objects(void) {
+    gu_mutex_lock(&g_mnt_lock);
+    if (g_mnt_n == 0) puts("(no mounts)");
+    for (const mount_rec_t *m = g_mnt_head; m; m = m->next) {
+        vfs_slab_stats_t st[32];
+        int n = vfs_slab_owner_stats(m->sb ? m->sb->s_slab : NULL, st, 32);
+        uint64_t total = 0;
+        for (int i = 0; i < n; ++i) total += st[i].live;
+        printf("%-12s %-8s %6llu", m->mp, mount_fstype_name(m), (unsigned long long)total);
+        for (int i = 0; i < n; ++i) printf("  %s=%llu", st[i].name, (unsigned long long)st[i].live);
+        putchar('\n');
+    }
+    gu_mutex_unlock(&g_mnt_lock);
+}
+
+/* Every mount in order into *out, each with a reference the caller drops
+   with mnt_put; free() the array. Returns the count, or -ENOMEM. */
+static int mount_snapshot(mount_rec_t ***out) {
+    int n = 0;
+    gu_mutex_lock(&g_mnt_lock);
+    mount_rec_t **v = (mount_rec_t**)malloc((size_t)(g_mnt_n ? g_mnt_n : 1) * sizeof *v);
+    if (v)
+        for (mount_rec_t *m = g_mnt_head; m; m = m->next) v[n++] = mnt_get(m);
+    gu_mutex_unlock(&g_mnt_lock);
+    *out = v;
+    return v ? n : -ENOMEM;
+}
+
+/* Write back every mounted filesystem, then whatever else the block cache
+   still holds dirty (images written outside a mount, e.g. by mkfs). */
+int vfs_sync(void) {
+    mount_rec_t **v;
+    int n = mount_snapshot(&v), rc = n < 0 ? n : 0;
+    for (int i = 0; i < n; ++i) {
+        superblock_t *sb = v[i]->sb;
+        if (sb && sb->s_op && sb->s_op->syncfs) {
+            gu_write_lock(&sb->s_lock);
+            int r = sb->s_op->syncfs(sb);
+            gu_rw_unlock(&sb->s_lock);
+            if (r < 0 && rc == 0) rc = r;
+        }
+        mnt_put(v[i]);
+    }
+    free(v);
+    int r = diskio_sync(NULL);
+    return rc ? rc : r;
+}
+
+int vfs_for_each_mount(vfs_mount_iter_cb cb, void *user) {
+    if (!cb) return -1;
+    mount_rec_t **v;
+    int n = mount_snapshot(&v), rc = n < 0 ? n : 0;
+    for (int i = 0; i < n; ++i) {
+        if (rc == 0) rc = cb(v[i]->mp, mount_fstype_name(v[i]), v[i]->sb, user);
+        mnt_put(v[i]);
+    }
+    free(v);
+    return rc;
 }
 
 /* Compatibility helpers for UI */
@@ -382,107 +698,382 @@ int  vfs_register_mount(const char *src, const char *fstype,
     if (!src || !fstype || !target) return -1;
     char mp[VFS_PATH_MAX];
     vfs_normalize_path(target, mp, sizeof mp);
-    for (int i = 0; i < g_mnt_n; ++i) {
-        if (strcmp(g_mnt[i].mp, mp) == 0) {
-            snprintf(g_mnt[i].src,    sizeof g_mnt[i].src,    "%s", src);
-            snprintf(g_mnt[i].fstype, sizeof g_mnt[i].fstype, "%s", fstype);
-            snprintf(g_mnt[i].opts,   sizeof g_mnt[i].opts,   "%s", (opts && *opts) ? opts : "rw");
-            return 0;
-        }
+    gu_mutex_lock(&g_mnt_lock);
+    mount_rec_t *m = mount_at(mp);
+    if (m) {
+        snprintf(m->src,    sizeof m->src,    "%s", src);
+        snprintf(m->fstype, sizeof m->fstype, "%s", fstype);
+        snprintf(m->opts,   sizeof m->opts,   "%s", (opts && *opts) ? opts : "rw");
     }
-    return -2;
+    gu_mutex_unlock(&g_mnt_lock);
+    return m ? 0 : -2;
 }
 
 int  vfs_unrecord_mount_by_target(const char *target)
 {
     if (!target) return -1;
-    char mp[VFS_PATH_MAX];
-    vfs_normalize_path(target, mp, sizeof mp);
-    for (int i = 0; i < g_mnt_n; ++i) {
-        if (strcmp(g_mnt[i].mp, mp) == 0) {
-            for (int j = i + 1; j < g_mnt_n; ++j) g_mnt[j - 1] = g_mnt[j];
-            g_mnt_n--;
-            return 0;
-        }
-    }
-    return -2;
+    mount_rec_t *m = mount_detach(target);
+    if (!m) return -2;
+    m->keep_sb = true;
+    mnt_put(m);
+    return 0;
 }
 
-int  vfs_mount_count(void) { return g_mnt_n; }
+int  vfs_mount_count(void) {
+    gu_mutex_lock(&g_mnt_lock);
+    int n = g_mnt_n;
+    gu_mutex_unlock(&g_mnt_lock);
+    return n;
+}
 
 const vfs_mount_t *vfs_mount_get(int index)
 {
-    static vfs_mount_t view;
-    if (index < 0 || index >= g_mnt_n) return NULL;
-    snprintf(view.src,    sizeof view.src,    "%s", g_mnt[index].src[0] ? g_mnt[index].src : "-");
-    snprintf(view.fstype, sizeof view.fstype, "%s",
-        g_mnt[index].fstype[0] ? g_mnt[index].fstype :
-        (g_mnt[index].sb && g_mnt[index].sb->fs_type && g_mnt[index].sb->fs_type->name ? g_mnt[index].sb->fs_type->name : "-"));
-    snprintf(view.target, sizeof view.target, "%s", g_mnt[index].mp);
-    snprintf(view.opts,   sizeof view.opts,   "%s", g_mnt[index].opts[0] ? g_mnt[index].opts : "-");
-    return &view;
+    static _Thread_local vfs_mount_t view;
+    const vfs_mount_t *ret = NULL;
+    gu_mutex_lock(&g_mnt_lock);
+    const mount_rec_t *m = (index >= 0 && index < g_mnt_n) ? g_mnt_head : NULL;
+    while (m && index-- > 0) m = m->next;
+    if (m) {
+        snprintf(view.src,    sizeof view.src,    "%s", m->src[0] ? m->src : "-");
+        snprintf(view.fstype, sizeof view.fstype, "%s", mount_fstype_name(m));
+        snprintf(view.target, sizeof view.target, "%s", m->mp);
+        snprintf(view.opts,   sizeof view.opts,   "%s", m->opts[0] ? m->opts : "-");
+        ret = &view;
+    }
+    gu_mutex_unlock(&g_mnt_lock);
+    return ret;
 }
 
 /* ---------- File-level ops ---------- */
+/* Charge a failed open to the mount it got to, then drop the walk. */
+static int open_fail(path_res_t *r, uint64_t t0) {
+    vfs_op_end(r->mnt ? r->mnt->sb : NULL, VFS_OP_OPEN, t0, -1);
+    path_res_put(r);
+    return -1;
+}
+
 int vfs_open(const char *path, int flags, uint32_t mode, struct file **out) {
     if (!out) return -1;
     *out = NULL;
 
+    const uint64_t t0 = vfs_op_begin();
     path_res_t r;
-    if (vfs_resolve_path(path, &r) != 0) return -1;
-    if (!r.dir || !r.dir->i_op) return -1;
+    if (vfs_resolve_path(path, &r) != 0) { vfs_op_end(NULL, VFS_OP_OPEN, t0, -1); return -1; }
+    if (!r.dir || !r.dir->i_op) return open_fail(&r, t0);
 
-    inode_t *target = r.node;
+    const bool wr = (flags & (VFS_O_ACCMODE | VFS_O_CREAT | VFS_O_TRUNC)) != 0;
+    if (wr) sb_write_lock(r.dir); else sb_read_lock(r.dir);
 
 #if VFS_HAVE_CREATE_OP
-    if (!target && (flags & VFS_O_CREAT)) {
-        if (!r.dir->i_op->create) return -1;
-        if (r.leaf[0] == '\0')    return -1;
-        if (r.dir->i_op->create(r.dir, r.leaf, mode, &target) != 0 || !target) return -1;
-    }
-#else
-    if (!target) {
-        if (flags & VFS_O_CREAT) return -1;
-        return -1;
+    if (!r.node && (flags & VFS_O_CREAT)) {
+        /* the walk dropped the lock: someone may have created it meanwhile */
+        if (!r.leaf || !r.dir->i_op->lookup ||
+            drv_lookup(r.dir, r.leaf, &r.node) != 0) r.node = NULL;
+        if (!r.node &&
+            (!r.dir->i_op->create || !r.leaf ||
+             r.dir->i_op->create(r.dir, r.leaf, mode, &r.node) != 0 || !r.node)) {
+            sb_unlock(r.dir);
+            return open_fail(&r, t0);
+        }
     }
 #endif
 
-    if ((flags & VFS_O_DIRECTORY) && !VFS_S_ISDIR(target->i_mode)) return -1;
-    if (!target->i_fop || !target->i_fop->open) return -1;
-
+    inode_t *target = r.node;
     struct file *f = NULL;
-    if (target->i_fop->open(target, &f, flags, mode) != 0 || !f) return -1;
+    if (!target ||
+        ((flags & VFS_O_DIRECTORY) && !VFS_S_ISDIR(target->i_mode)) ||
+        !target->i_fop || !target->i_fop->open ||
+        target->i_fop->open(target, &f, flags, mode) != 0 || !f) {
+        sb_unlock(r.dir);
+        return open_fail(&r, t0);
+    }
 
     if ((flags & VFS_O_TRUNC) && r.dir->i_op && r.dir->i_op->truncate && VFS_S_ISREG(target->i_mode)) {
         (void)r.dir->i_op->truncate(target, 0);
+        vfs_pagecache_truncate(target);
     }
-
+    sb_unlock(r.dir);
+
+    /* the open file keeps the walk's references on its inode and mount */
+    f->f_mnt = r.mnt;
+    r.node = NULL;
+    r.mnt  = NULL;
+    path_res_put(&r);
+    vfs_op_end(f->f_mnt ? f->f_mnt->sb : NULL, VFS_OP_OPEN, t0, 0);
     *out = f;
     return 0;
 }
 
 int vfs_close(struct file *f) {
     if (!f) return 0;
-    if (f->f_op && f->f_op->release) return f->f_op->release(f);
-    return 0;
+    inode_t *inode = f->f_inode;
+    mount_rec_t *mnt = f->f_mnt;
+    const bool wr = (f->f_flags & VFS_O_ACCMODE) != VFS_O_RDONLY;
+    int rc = 0;
+    if (wr) sb_write_lock(inode); else sb_read_lock(inode);
+    if (f->f_op && f->f_op->release) rc = f->f_op->release(f);
+    else vfs_free_file(f);
+    sb_unlock(inode);
+    vfs_iput(inode);
+    mnt_put(mnt);
+    return rc;
+}
+
+int vfs_fsync(struct file *f) {
+    if (!f) return -EINVAL;
+    if (!f->f_op || !f->f_op->fsync) return 0;
+    sb_write_lock(f->f_inode);
+    int rc = f->f_op->fsync(f);
+    sb_unlock(f->f_inode);
+    return rc;
+}
+
+/* Every read/write entry point funnels through these with an explicit
+   position; only vfs_read/vfs_write hand in &f->f_pos. */
+static ssize_t file_read_at(struct file *f, void *buf, size_t n, uint64_t *pos) {
+    inode_t *inode = f->f_inode;
+    const uint64_t t0 = vfs_op_begin();
+    ssize_t r = -1;
+    sb_read_lock(inode);
+    if (inode && inode->i_data.a_ops && VFS_S_ISREG(inode->i_mode)) {
+        r = vfs_pagecache_read(inode, buf, n, *pos);
+        if (r > 0) *pos += (uint64_t)r;
+    } else if (f->f_op && f->f_op->read) {
+        r = f->f_op->read(f, buf, n, pos);
+    }
+    sb_unlock(inode);
+    vfs_op_end(inode ? inode->i_sb : NULL, VFS_OP_READ, t0, r);
+    return r;
+}
+
+static ssize_t file_write_at(struct file *f, const void *buf, size_t n, uint64_t *pos) {
+    if (!f->f_op || !f->f_op->write) return -1;
+    uint64_t start = *pos;
+    const uint64_t t0 = vfs_op_begin();
+    sb_write_lock(f->f_inode);
+    ssize_t w = f->f_op->write(f, buf, n, pos);
+    /* drivers write behind the cache: drop whatever pages the write touched */
+    if (w > 0 && f->f_inode) vfs_pagecache_invalidate(f->f_inode, start, (uint64_t)w);
+    sb_unlock(f->f_inode);
+    vfs_op_end(f->f_inode ? f->f_inode->i_sb : NULL, VFS_OP_WRITE, t0, w);
+    return w;
 }
 
 ssize_t vfs_read(struct file *f, void *buf, size_t n) {
-    if (!f || !f->f_op || !f->f_op->read) return -1;
-    return f->f_op->read(f, buf, n, &f->f_pos);
+    if (!f) return -1;
+    return file_read_at(f, buf, n, &f->f_pos);
 }
 
 ssize_t vfs_write(struct file *f, const void *buf, size_t n) {
-    if (!f || !f->f_op || !f->f_op->write) return -1;
-    return f->f_op->write(f, buf, n, &f->f_pos);
+    if (!f) return -1;
+    return file_write_at(f, buf, n, &f->f_pos);
+}
+
+ssize_t vfs_pread(struct file *f, void *buf, size_t n, uint64_t off) {
+    if (!f) return -1;
+    uint64_t pos = off;
+    return file_read_at(f, buf, n, &pos);
+}
+
+ssize_t vfs_pwrite(struct file *f, const void *buf, size_t n, uint64_t off) {
+    if (!f) return -1;
+    uint64_t pos = off;
+    return file_write_at(f, buf, n, &pos);
+}
+
+ssize_t vfs_preadv(struct file *f, const vfs_iovec_t *iov, int iovcnt, uint64_t off) {
+    if (!f || (!iov && iovcnt > 0) || iovcnt < 0) return -EINVAL;
+    uint64_t pos = off;
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len == 0) continue;
+        ssize_t r = file_read_at(f, iov[i].iov_base, iov[i].iov_len, &pos);
+        if (r < 0) return total ? (ssize_t)total : r;
+        total += (size_t)r;
+        if ((size_t)r < iov[i].iov_len) break;   /* EOF */
+    }
+    return (ssize_t)total;
+}
+
+/* The new position for lseek, without moving f_pos. Drivers with llseek
+   are asked under the sb lock (SEEK_DATA/SEEK_HOLE walk the block map). */
+static int64_t file_seek(struct file *f, int64_t off, int whence) {
+    uint64_t npos = 0;
+    if (f->f_op && f->f_op->llseek) {
+        sb_read_lock(f->f_inode);
+        int rc = f->f_op->llseek(f, off, whence, &npos);
+        sb_unlock(f->f_inode);
+        if (rc < 0) return rc;
+        return (int64_t)npos;
+    }
+    const uint64_t size = f->f_inode ? f->f_inode->i_size : 0;
+    int64_t base;
+    switch (whence) {
+    case VFS_SEEK_SET: base = 0; break;
+    case VFS_SEEK_CUR: base = (int64_t)f->f_pos; break;
+    case VFS_SEEK_END: base = (int64_t)size; break;
+    case VFS_SEEK_DATA:
+    case VFS_SEEK_HOLE:
+        if (off < 0 || (uint64_t)off >= size) return -ENXIO;
+        return whence == VFS_SEEK_DATA ? off : (int64_t)size;
+    default: return -EINVAL;
+    }
+    if ((off < 0 && base + off < 0) || (off > 0 && base > INT64_MAX - off)) return -EINVAL;
+    return base + off;
+}
+
+int64_t vfs_lseek(struct file *f, int64_t off, int whence) {
+    if (!f) return -EINVAL;
+    const int64_t npos = file_seek(f, off, whence);
+    if (npos < 0) return npos;
+    f->f_pos = (uint64_t)npos;
+    return npos;
+}
+
+int vfs_fiemap(struct file *f, uint64_t start, uint64_t len,
+               vfs_extent_t *ext, unsigned max, unsigned *count) {
+    if (count) *count = 0;
+    if (!f || !ext || !count) return -EINVAL;
+    if (!f->f_op || !f->f_op->fiemap) return -EOPNOTSUPP;
+    sb_read_lock(f->f_inode);
+    int rc = f->f_op->fiemap(f, start, len, ext, max, count);
+    sb_unlock(f->f_inode);
+    return rc;
+}
+
+int vfs_fallocate(struct file *f, uint64_t off, uint64_t len) {
+    if (!f || !f->f_inode) return -EINVAL;
+    if (!f->f_op || !f->f_op->fallocate) return -EOPNOTSUPP;
+    if (len == 0) return 0;
+    if (off > UINT64_MAX - len) return -EFBIG;
+    sb_write_lock(f->f_inode);
+    int rc = f->f_op->fallocate(f, off, len);
+    sb_unlock(f->f_inode);
+    return rc;
+}
+
+/* The device extent covering 'pos', or false if it is a hole / unmapped. */
+static bool file_extent_at(struct file *f, uint64_t pos, uint64_t len, vfs_extent_t *out) {
+    unsigned n = 0;
+    if (vfs_fiemap(f, pos, len, out, 1, &n) != 0 || n == 0) return false;
+    if (out->fe_flags & VFS_FIEMAP_EXTENT_UNKNOWN) return false;
+    return out->fe_logical <= pos && pos - out->fe_logical < out->fe_length;
+}
+
+/* Device-to-device part of vfs_copy_file_range: walks both extent maps in
+   step and hands each overlapping piece to the block layer. A destination
+   piece with no blocks yet (a new or truncated file) is allocated through
+   fallocate first; a source hole past the destination's end is skipped, so
+   it stays a hole. Stops at the first piece it can't map, or at a trailing
+   hole (the bounce path sets the size); returns bytes moved. */
+static uint64_t copy_by_extents(struct file *in, uint64_t pin, struct file *out, uint64_t pout, uint64_t len) {
+    superblock_t *ssb = in->f_inode->i_sb, *dsb = out->f_inode->i_sb;
+    if (!ssb || !dsb || !ssb->bdev || !dsb->bdev) return 0;
+    if (dsb->s_flags & VFS_SB_RDONLY) return 0;
+
+    uint64_t done = 0;
+    while (done < len) {
+        vfs_extent_t se, de;
+        unsigned n = 0;
+        if (vfs_fiemap(in, pin + done, len - done, &se, 1, &n) != 0 || n == 0) break;
+        if (se.fe_flags & VFS_FIEMAP_EXTENT_UNKNOWN) break;
+        if (se.fe_logical > pin + done) {
+            const uint64_t gap = se.fe_logical - (pin + done);
+            if (gap >= len - done || pout + done < out->f_inode->i_size) break;
+            done += gap;
+            continue;
+        }
+
+        const uint64_t sin = pin + done - se.fe_logical;
+        uint64_t chunk = len - done;
+        if (chunk > se.fe_length - sin) chunk = se.fe_length - sin;
+        if (!file_extent_at(out, pout + done, chunk, &de) &&
+            (!out->f_op->fallocate || vfs_fallocate(out, pout + done, chunk) != 0 ||
+             !file_extent_at(out, pout + done, chunk, &de))) break;
+        const uint64_t din = pout + done - de.fe_logical;
+        if (chunk > de.fe_length - din) chunk = de.fe_length - din;
+
+        gu_write_lock(&dsb->s_lock);
+        bool ok = vblk_copy_range(ssb->bdev, se.fe_physical + sin,
+                                  dsb->bdev, de.fe_physical + din, chunk);
+        if (ok) vfs_pagecache_invalidate(out->f_inode, pout + done, chunk);
+        gu_rw_unlock(&dsb->s_lock);
+        if (!ok) break;
+        done += chunk;
+    }
+    return done;
+}
+
+ssize_t vfs_copy_file_range(struct file *in,  uint64_t *off_in,
+                            struct file *out, uint64_t *off_out, size_t len, unsigned flags) {
+    if (!in || !out || !in->f_inode || !out->f_inode) return -EINVAL;
+    uint64_t pin  = off_in  ? *off_in  : in->f_pos;
+    uint64_t pout = off_out ? *off_out : out->f_pos;
+
+    if (VFS_S_ISREG(in->f_inode->i_mode)) {
+        uint64_t isz = in->f_inode->i_size;
+        if (pin >= isz) return 0;
+        if (len > isz - pin) len = (size_t)(isz - pin);
+    }
+    if (len == 0) return 0;
+    if (len > (SIZE_MAX >> 1)) len = SIZE_MAX >> 1;      /* must fit ssize_t */
+
+    uint64_t done = 0;
+    if (in->f_op && in->f_op->fiemap && out->f_op && out->f_op->fiemap)
+        done = copy_by_extents(in, pin, out, pout, len);
+    if (flags & VFS_COPY_EXTENTS_ONLY) {
+        if (done == 0) return -EXDEV;
+    } else if (done < len) {
+        size_t cap = (len - done) < VFS_COPY_CHUNK ? (size_t)(len - done) : VFS_COPY_CHUNK;
+        uint8_t *buf = (uint8_t*)malloc(cap);
+        if (!buf) return done ? (ssize_t)done : -ENOMEM;
+        bool failed = false;
+        while (done < len && !failed) {
+            size_t want = (len - done) < cap ? (size_t)(len - done) : cap;
+            /* A hole in the source that lands past the end of the destination
+               needs no writing: it reads as zeros there too. Only the last
+               byte is written, so the destination still gets the full length. */
+            if (pout + done >= out->f_inode->i_size) {
+                int64_t data = file_seek(in, (int64_t)(pin + done), VFS_SEEK_DATA);
+                uint64_t skip = data == -ENXIO ? len - done
+                              : data > (int64_t)(pin + done) ? (uint64_t)data - (pin + done) : 0;
+                if (skip > len - done) skip = len - done;
+                if (skip == len - done) skip--;
+                if (skip) { done += skip; continue; }
+                int64_t hole = file_seek(in, (int64_t)(pin + done), VFS_SEEK_HOLE);
+                if (hole > (int64_t)(pin + done) && (uint64_t)hole - (pin + done) < want)
+                    want = (size_t)((uint64_t)hole - (pin + done));
+            }
+            ssize_t r = vfs_pread(in, buf, want, pin + done);
+            if (r <= 0) { failed = r < 0; break; }
+            size_t put = 0;
+            while (put < (size_t)r) {
+                ssize_t w = vfs_pwrite(out, buf + put, (size_t)r - put, pout + done + put);
+                if (w <= 0) { failed = true; break; }
+                put += (size_t)w;
+            }
+            done += put;
+        }
+        free(buf);
+        if (failed && done == 0) return -EIO;
+    }
+
+    if (off_in)  *off_in  += done; else in->f_pos  += done;
+    if (off_out) *off_out += done; else out->f_pos += done;
+    return (ssize_t)done;
 }
 
 int vfs_mkdir(const char *path, unsigned mode) {
 #if VFS_HAVE_CREATE_OP
     path_res_t r;
     if (vfs_resolve_path(path, &r) != 0) return -1;
-    if (!r.dir || !r.dir->i_op || !r.dir->i_op->mkdir) return -1;
-    return r.dir->i_op->mkdir(r.dir, r.leaf, mode);
+    int rc = -1;
+    sb_write_lock(r.dir);
+    if (r.dir && r.dir->i_op && r.dir->i_op->mkdir && !r.node && r.leaf)
+        rc = r.dir->i_op->mkdir(r.dir, r.leaf, mode);
+    sb_unlock(r.dir);
+    path_res_put(&r);
+    return rc;
 #else
     (void)path; (void)mode;
     return -1;
@@ -492,18 +1083,31 @@ int vfs_mkdir(const char *path, unsigned mode) {
 /* ---------- Metadata ---------- */
 int vfs_stat(const char *path, struct g_stat *st) {
     if (!st) return -1;
+    const uint64_t t0 = vfs_op_begin();
     path_res_t r;
-    if (vfs_resolve_path(path, &r) != 0) return -1;
-    if (!r.node || !r.node->i_op || !r.node->i_op->getattr) return -1;
-    return r.node->i_op->getattr(r.node, st);
+    if (vfs_resolve_path(path, &r) != 0) { vfs_op_end(NULL, VFS_OP_STAT, t0, -1); return -1; }
+    int rc = -1;
+    sb_read_lock(r.node);
+    if (r.node && r.node->i_op && r.node->i_op->getattr)
+        rc = r.node->i_op->getattr(r.node, st);
+    sb_unlock(r.node);
+    vfs_op_end(r.mnt ? r.mnt->sb : NULL, VFS_OP_STAT, t0, rc);
+    path_res_put(&r);
+    return rc;
 }
 
 int vfs_statfs(const char *path, struct g_statvfs *svfs) {
     if (!svfs) return -1;
     path_res_t r;
     if (vfs_resolve_path(path, &r) != 0) return -1;
-    if (!r.mnt || !r.mnt->sb || !r.mnt->sb->s_op || !r.mnt->sb->s_op->statfs) return -1;
-    return r.mnt->sb->s_op->statfs(r.mnt->sb, svfs);
+    int rc = -1;
+    if (r.mnt && r.mnt->sb && r.mnt->sb->s_op && r.mnt->sb->s_op->statfs) {
+        gu_read_lock(&r.mnt->sb->s_lock);
+        rc = r.mnt->sb->s_op->statfs(r.mnt->sb, svfs);
+        gu_rw_unlock(&r.mnt->sb->s_lock);
+    }
+    path_res_put(&r);
+    return rc;
 }
 
 /* ---- Built-in FS declarations (provided by each module) ---- */
@@ -512,13 +1116,23 @@ extern const filesystem_type_t VFS_FAT;
 extern const filesystem_type_t VFS_VFAT;
 extern const filesystem_type_t VFS_NTFS;
 extern const filesystem_type_t VFS_ISO9660;
+extern const filesystem_type_t VFS_TMPFS;
+extern const filesystem_type_t VFS_OVERLAY;
+
+/* Drivers may hold allocation state in memory until syncfs (ext2 bitmaps),
+   and leaving does not unmount: write it all back on the way out. */
+static void vfs_exit_sync(void) { (void)vfs_sync(); }
 
 int vfs_init(void) {
+    static bool hooked;
+    if (!hooked) { hooked = true; atexit(vfs_exit_sync); }
     (void)vfs_register(&VFS_EXT2);
     (void)vfs_register(&VFS_FAT);
     (void)vfs_register(&VFS_VFAT);
     (void)vfs_register(&VFS_NTFS);
     (void)vfs_register(&VFS_ISO9660);
+    (void)vfs_register(&VFS_TMPFS);
+    (void)vfs_register(&VFS_OVERLAY);
     return 0;
 }
 
@@ -526,9 +1140,12 @@ int vfs_readlink(const char *path, char *buf, size_t bufsz) {
     if (!path || !buf || bufsz == 0) return -1;
     path_res_t r;
     if (vfs_resolve_path(path, &r) != 0) return -1;
-    if (!r.node || !r.node->i_op || !r.node->i_op->readlink) return -1;
+    if (!r.node || !r.node->i_op || !r.node->i_op->readlink) { path_res_put(&r); return -1; }
     /* Contract: return number of bytes written (like readlink), and ensure NUL at caller if desired. */
+    sb_read_lock(r.node);
     int n = r.node->i_op->readlink(r.node, buf, bufsz - 1);
+    sb_unlock(r.node);
+    path_res_put(&r);
     if (n < 0) return -1;
     if ((size_t)n < bufsz) buf[n] = '\0';  /* convenience for callers */
     return n;
@@ -538,10 +1155,76 @@ ssize_t vfs_getdents64(struct file *f, void *buf, size_t bytes) {
     if (!f || !f->f_op || !f->f_op->getdents64) return -ENOTDIR;
     DBG("vfs:getdents64 enter pos=%llu cap=%zu",
         (unsigned long long)f->f_pos, bytes);
+    const uint64_t t0 = vfs_op_begin();
+    sb_read_lock(f->f_inode);
     ssize_t n = f->f_op->getdents64(f, buf, bytes);
+    sb_unlock(f->f_inode);
+    vfs_op_end(f->f_inode ? f->f_inode->i_sb : NULL, VFS_OP_GETDENTS, t0, n);
     DBG("vfs:getdents64 -> n=%zd newpos=%llu",
         n, (unsigned long long)f->f_pos);
     return n;
 }
 
+/* Generic readdirplus: one getdents64 batch, attributes via lookup+getattr
+   on the already-open directory inode (no walk from the mount root). If a
+   converted record doesn't fit, the directory is repositioned to resume at
+   that entry on the next call. */
+static ssize_t readdirplus_generic(struct file *f, void *buf, size_t bytes) {
+    inode_t *dir = f->f_inode;
+    uint8_t tmp[4096];
+    size_t tcap = bytes < sizeof tmp ? bytes : sizeof tmp;
+    uint64_t start = f->f_pos;
+
+    ssize_t n = f->f_op->getdents64(f, tmp, tcap);
+    if (n <= 0) return n;
+
+    size_t in = 0, out = 0;
+    uint64_t resume = start;
+    while (in < (size_t)n) {
+        vfs_dirent64_t *de = (vfs_dirent64_t*)(tmp + in);
+        size_t nlen = strlen(de->d_name);
+        size_t reclen = (offsetof(vfs_direntplus64_t, d_name) + nlen + 1 + 7u) & ~(size_t)7u;
+        if (out + reclen > bytes) break;
+
+        vfs_direntplus64_t *dp = (vfs_direntplus64_t*)((uint8_t*)buf + out);
+        memset(dp, 0, offsetof(vfs_direntplus64_t, d_name));
+        dp->d_ino    = de->d_ino;
+        dp->d_off    = de->d_off;
+        dp->d_reclen = (uint16_t)reclen;
+        dp->d_type   = de->d_type;
+        memcpy(dp->d_name, de->d_name, nlen + 1);
+
+        inode_t *child = NULL;
+        bool dot = strcmp(de->d_name, ".") == 0, dotdot = strcmp(de->d_name, "..") == 0;
+        if (dot) child = vfs_ihold(dir);
+        else if (!dotdot && dir->i_op && dir->i_op->lookup &&
+                 drv_lookup(dir, de->d_name, &child) != 0) child = NULL;
+        if (child) {
+            if (child->i_op && child->i_op->getattr && child->i_op->getattr(child, &dp->d_stat) == 0)
+                dp->d_flags |= VFS_DIRENTPLUS_STAT;
+            vfs_iput(child);
+        }
+
+        out   += reclen;
+        in    += de->d_reclen;
+        resume = (uint64_t)de->d_off;
+    }
+
+    if (in < (size_t)n) {
+        if (out == 0) { f->f_pos = start; return -EINVAL; }
+        f->f_pos = resume;
+    }
+    return (ssize_t)out;
+}
 
+ssize_t vfs_readdirplus(struct file *f, void *buf, size_t bytes) {
+    if (!f || !buf || !f->f_op) return -ENOTDIR;
+    if (!f->f_op->getdents64_plus && !f->f_op->getdents64) return -ENOTDIR;
+    const uint64_t t0 = vfs_op_begin();
+    sb_read_lock(f->f_inode);
+    ssize_t n = f->f_op->getdents64_plus ? f->f_op->getdents64_plus(f, buf, bytes)
+                                         : readdirplus_generic(f, buf, bytes);
+    sb_unlock(f->f_inode);
+    vfs_op_end(f->f_inode ? f->f_inode->i_sb : NULL, VFS_OP_GETDENTS, t0, n);
+    return n;
+}
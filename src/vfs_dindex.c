@@ -0,0 +1,290 @@
+// src/vfs_dindex.c — hashed per-directory name index
+//
+// The first lookup in a directory asks the driver to enumerate it once
+// (fill callback → vfs_dindex_add) into an open-addressed hash of names to
+// child metadata, and hangs the result off the directory inode. Later
+// lookups, hits and misses alike, are one probe sequence instead of a
+// record scan. Every index is on one global list bounded by
+// VFS_DINDEX_MAX_BYTES; when a new index pushes the total over, the oldest
+// indexes not used since the last sweep (second chance) are dropped and
+// rebuilt on their next lookup.
+//
+// Lookups run under the superblock lock (shared) like every driver lookup,
+// so they never race with insert/drop on their own directory, which need the
+// lock exclusive (or a dying inode). They can race with a budget sweep
+// started from another mount, so lookups read the index inside an RCU
+// section and the sweep frees only after a grace period. The list and the
+// byte counts are guarded by one mutex.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "gu_sync.h"
+
+#define DX_MIN_SLOTS 16u
+
+typedef struct dx_ent {
+    uint32_t          hash;
+    uint32_t          name_off;
+    vfs_dentry_info_t info;
+} dx_ent_t;
+
+struct vfs_dindex {
+    inode_t   *dir;             /* NULL until attached */
+    unsigned   flags;           /* VFS_DINDEX_* */
+    uint32_t  *slots;           /* entry index + 1; 0 = empty */
+    size_t     nslots;          /* power of two */
+    dx_ent_t  *ents;
+    size_t     n, ents_cap;
+    char      *names;
+    size_t     names_len, names_cap;
+    size_t     bytes;           /* charged to the budget */
+    bool       failed;          /* an add ran out of memory */
+    atomic_bool used;           /* looked up since the last sweep */
+    struct vfs_dindex *prev, *next;
+};
+
+static vfs_dindex_t *g_dx_head = NULL;   /* newest */
+static vfs_dindex_t *g_dx_tail = NULL;   /* sweep starts here */
+static vfs_dindex_stats_t g_dx;
+static gu_mutex_t g_dx_lock = GU_MUTEX_INIT;
+
+/* ---------- hashing ---------- */
+
+static inline unsigned char fold(unsigned char c, unsigned flags) {
+    return ((flags & VFS_DINDEX_CASEFOLD) && c >= 'A' && c <= 'Z') ? (unsigned char)(c - 'A' + 'a') : c;
+}
+
+static uint32_t name_hash(const char *s, size_t len, unsigned flags) {
+    uint32_t h = 2166136261u;                      /* FNV-1a */
+    for (size_t i = 0; i < len; ++i) { h ^= fold((unsigned char)s[i], flags); h *= 16777619u; }
+    return h ? h : 1u;
+}
+
+static bool name_eq(const char *a, const char *b, size_t blen, unsigned flags) {
+    for (size_t i = 0; i < blen; ++i)
+        if (!a[i] || fold((unsigned char)a[i], flags) != fold((unsigned char)b[i], flags)) return false;
+    return a[blen] == '\0';
+}
+
+static const dx_ent_t *dx_find(const vfs_dindex_t *dx, const char *name, size_t len, uint32_t h) {
+    if (!dx->nslots) return NULL;
+    for (size_t i = h & (dx->nslots - 1);; i = (i + 1) & (dx->nslots - 1)) {
+        uint32_t s = dx->slots[i];
+        if (!s) return NULL;
+        const dx_ent_t *e = &dx->ents[s - 1];
+        if (e->hash == h && name_eq(dx->names + e->name_off, name, len, dx->flags)) return e;
+    }
+}
+
+static size_t dx_bytes(const vfs_dindex_t *dx) {
+    return sizeof *dx + dx->nslots * sizeof *dx->slots +
+           dx->ents_cap * sizeof *dx->ents + dx->names_cap;
+}
+
+static bool dx_rehash(vfs_dindex_t *dx, size_t nslots) {
+    uint32_t *ns = (uint32_t*)calloc(nslots, sizeof *ns);
+    if (!ns) return false;
+    for (size_t k = 0; k < dx->n; ++k) {
+        size_t i = dx->ents[k].hash & (nslots - 1);
+        while (ns[i]) i = (i + 1) & (nslots - 1);
+        ns[i] = (uint32_t)(k + 1);
+    }
+    free(dx->slots);
+    dx->slots = ns;
+    dx->nslots = nslots;
+    return true;
+}
+
+static bool grow(void **p, size_t *cap, size_t need, size_t elem, size_t min) {
+    if (need <= *cap) return true;
+    size_t nc = *cap ? *cap : min;
+    while (nc < need) nc *= 2;
+    void *np = realloc(*p, nc * elem);
+    if (!np) return false;
+    *p = np;
+    *cap = nc;
+    return true;
+}
+
+/* Append without touching the budget; the first of two equal names wins,
+   as it would for a scan. */
+static int dx_add(vfs_dindex_t *dx, const char *name, size_t len, const vfs_dentry_info_t *info) {
+    uint32_t h = name_hash(name, len, dx->flags);
+    if (dx_find(dx, name, len, h)) return 0;
+    if ((dx->n + 1) * 4 > dx->nslots * 3 &&
+        !dx_rehash(dx, dx->nslots ? dx->nslots * 2 : DX_MIN_SLOTS)) return -ENOMEM;
+    if (!grow((void**)&dx->ents, &dx->ents_cap, dx->n + 1, sizeof *dx->ents, 8) ||
+        !grow((void**)&dx->names, &dx->names_cap, dx->names_len + len + 1, 1, 128)) return -ENOMEM;
+
+    dx_ent_t *e = &dx->ents[dx->n];
+    e->hash = h;
+    e->name_off = (uint32_t)dx->names_len;
+    e->info = *info;
+    memcpy(dx->names + dx->names_len, name, len);
+    dx->names[dx->names_len + len] = '\0';
+    dx->names_len += len + 1;
+
+    size_t i = h & (dx->nslots - 1);
+    while (dx->slots[i]) i = (i + 1) & (dx->nslots - 1);
+    dx->slots[i] = (uint32_t)(++dx->n);
+    return 0;
+}
+
+static void dx_free(vfs_dindex_t *dx) {
+    if (!dx) return;
+    free(dx->slots);
+    free(dx->ents);
+    free(dx->names);
+    free(dx);
+}
+
+/* ---------- global list (g_dx_lock held) ---------- */
+
+static void list_del(vfs_dindex_t *dx) {
+    if (dx->prev) dx->prev->next = dx->next; else g_dx_head = dx->next;
+    if (dx->next) dx->next->prev = dx->prev; else g_dx_tail = dx->prev;
+    dx->prev = dx->next = NULL;
+}
+
+static void list_add(vfs_dindex_t *dx) {
+    dx->prev = NULL;
+    dx->next = g_dx_head;
+    if (g_dx_head) g_dx_head->prev = dx;
+    g_dx_head = dx;
+    if (!g_dx_tail) g_dx_tail = dx;
+}
+
+/* Unpublish dx from its inode and the list; the caller frees it. */
+static void detach(vfs_dindex_t *dx) {
+    atomic_store_explicit(&dx->dir->i_dindex, NULL, memory_order_release);
+    list_del(dx);
+    g_dx.indexes--;
+    g_dx.entries -= dx->n;
+    g_dx.bytes   -= dx->bytes;
+}
+
+/* Publish dx on dir unless another thread got there first or it would not
+   fit; returns false if the caller still owns dx. */
+static bool attach(inode_t *dir, vfs_dindex_t *dx) {
+    vfs_dindex_t *victims = NULL;
+    gu_mutex_lock(&g_dx_lock);
+    vfs_dindex_t *expect = NULL;
+    if (dx->bytes > VFS_DINDEX_MAX_BYTES / 2 ||
+        !atomic_compare_exchange_strong(&dir->i_dindex, &expect, dx)) {
+        gu_mutex_unlock(&g_dx_lock);
+        return false;
+    }
+    dx->dir = dir;
+    list_add(dx);
+    g_dx.indexes++;
+    g_dx.entries += dx->n;
+    g_dx.bytes   += dx->bytes;
+    g_dx.builds++;
+
+    /* second-chance sweep from the oldest end; dx itself always stays */
+    size_t steps = g_dx.indexes * 2;
+    while (g_dx.bytes > VFS_DINDEX_MAX_BYTES && g_dx.indexes > 1 && steps--) {
+        vfs_dindex_t *v = g_dx_tail;
+        if (v == dx || atomic_exchange_explicit(&v->used, false, memory_order_relaxed)) {
+            list_del(v);
+            list_add(v);
+            continue;
+        }
+        detach(v);
+        g_dx.evictions++;
+        v->next = victims;
+        victims = v;
+    }
+    gu_mutex_unlock(&g_dx_lock);
+
+    if (victims) {
+        gu_rcu_synchronize();          /* lookups elsewhere may still hold them */
+        while (victims) { vfs_dindex_t *n = victims->next; dx_free(victims); victims = n; }
+    }
+    return true;
+}
+
+/* ---------- API ---------- */
+
+int vfs_dindex_add(vfs_dindex_t *dx, const char *name, size_t len, const vfs_dentry_info_t *info) {
+    if (!dx || !name || !info) return -EINVAL;
+    int rc = dx_add(dx, name, len, info);
+    if (rc == -ENOMEM) dx->failed = true;
+    return rc;
+}
+
+int vfs_dindex_lookup(inode_t *dir, const char *name, unsigned flags,
+                      vfs_dindex_fill_fn fill, vfs_dentry_info_t *out) {
+    if (!dir || !name || !fill || !out) return -EINVAL;
+    const size_t len = strlen(name);
+    const uint32_t h = name_hash(name, len, flags);
+
+    unsigned rcu = gu_rcu_read_lock();
+    vfs_dindex_t *dx = atomic_load_explicit(&dir->i_dindex, memory_order_acquire);
+    if (dx && dx->flags == flags) {
+        const dx_ent_t *e = dx_find(dx, name, len, h);
+        if (e) *out = e->info;
+        if (!atomic_load_explicit(&dx->used, memory_order_relaxed))
+            atomic_store_explicit(&dx->used, true, memory_order_relaxed);
+        gu_rcu_read_unlock(rcu);
+        return e ? 1 : 0;
+    }
+    gu_rcu_read_unlock(rcu);
+    if (dx) return -EINVAL;             /* indexed with other flags */
+
+    dx = (vfs_dindex_t*)calloc(1, sizeof *dx);
+    if (!dx) return -ENOMEM;
+    dx->flags = flags;
+    int rc = fill(dir, dx);
+    if (rc == 0 && dx->failed) rc = -ENOMEM;
+    if (rc != 0) { dx_free(dx); return rc < 0 ? rc : -EIO; }
+    dx->bytes = dx_bytes(dx);
+    DBG("vfs_dindex: ino=%llu indexed %zu names (%zu bytes)",
+        (unsigned long long)dir->i_ino, dx->n, dx->bytes);
+
+    const dx_ent_t *e = dx_find(dx, name, len, h);
+    if (e) *out = e->info;
+    if (!attach(dir, dx)) dx_free(dx);
+    return e ? 1 : 0;
+}
+
+void vfs_dindex_insert(inode_t *dir, const char *name, const vfs_dentry_info_t *info) {
+    if (!dir || !name || !info) return;
+    gu_mutex_lock(&g_dx_lock);
+    vfs_dindex_t *dx = atomic_load_explicit(&dir->i_dindex, memory_order_relaxed);
+    if (dx) {
+        size_t n0 = dx->n, b0 = dx->bytes;
+        if (dx_add(dx, name, strlen(name), info) != 0) {
+            detach(dx);                 /* can't keep it exact: drop it */
+            gu_mutex_unlock(&g_dx_lock);
+            dx_free(dx);
+            return;
+        }
+        dx->bytes = dx_bytes(dx);
+        g_dx.entries += dx->n - n0;
+        g_dx.bytes   += dx->bytes - b0;
+    }
+    gu_mutex_unlock(&g_dx_lock);
+}
+
+void vfs_dindex_drop(inode_t *dir) {
+    if (!dir || !atomic_load_explicit(&dir->i_dindex, memory_order_relaxed)) return;
+    gu_mutex_lock(&g_dx_lock);
+    vfs_dindex_t *dx = atomic_load_explicit(&dir->i_dindex, memory_order_relaxed);
+    if (dx) detach(dx);
+    gu_mutex_unlock(&g_dx_lock);
+    dx_free(dx);
+}
+
+void vfs_dindex_get_stats(vfs_dindex_stats_t *out) {
+    if (!out) return;
+    gu_mutex_lock(&g_dx_lock);
+    *out = g_dx;
+    gu_mutex_unlock(&g_dx_lock);
+}
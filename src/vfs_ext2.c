@@ -1,36 +1,103 @@
-// src/vfs_ext2.c — minimal EXT2 shim for the Guppy VFS
-// Supports: mount, mkdir, create+write (flush on close).
-// Not yet: readdir, file reads, stat fidelity.
+// src/vfs_ext2.c — EXT2 driver for the Guppy VFS
+// Supports: mount, on-disk inodes and attributes, file reads through the
+// page cache (direct/indirect/double/triple block maps), directory lookup
+// (htree or hashed index) and getdents64, create and mkdir in any
+// directory, streaming writes to new and existing files, truncate.
+// ext4 filesystems with extents, flex_bg, 64bit (below 2^32 blocks) and
+// huge_file mount read-only.
+//
+// Reads: a file's logical blocks are mapped through i_block[] and its
+// indirect blocks, which each inode keeps in a small cache of its own, so a
+// sequential read touches every indirect block once. Physically contiguous
+// blocks are merged into runs and each run is one device read, so a page
+// cache readahead batch is normally a single read. Metadata (superblock,
+// group descriptors, bitmaps, inode table, indirect blocks) goes through the
+// block cache; file data is read straight from the image. An ext4 inode's
+// extent tree is read whole the first time it is mapped, into one sorted
+// list with touching extents merged, and mapped with a binary search, so a
+// read inside an extent is one device read however large.
+//
+// Writes: each file open for writing has one fixed-size buffer
+// (EXT2_WBUF_BYTES) of whole blocks. When it fills, or a write lands
+// elsewhere, its blocks are mapped; holes get runs of contiguous blocks from
+// the allocator, starting where the file's last run ended (or at its inode's
+// group, which create picks from the parent directory's), and a missing
+// indirect block is allocated just ahead of the data it maps. Each physical
+// run then goes out as one write-through device write, so memory stays at
+// one buffer however large the file. Large aligned writes skip the buffer;
+// runs of up to EXT2_CACHED_RUN_BYTES (small files) go to the block cache
+// instead, where neighbouring files merge into one write-back. Readers see
+// buffered bytes over what is on disk. An all-zero block that would fill a
+// hole is not allocated, so files stay sparse; SEEK_DATA/SEEK_HOLE walk the
+// block map.
+//
+// Allocation: a group's block and inode bitmaps are read once, on first
+// use, and stay in memory for the mount; ext2_bitmap.c searches them a
+// 64-bit word at a time. Free counts in the descriptors and superblock are
+// kept as bits change.
+//
+// Metadata transactions: inode table, directory and indirect blocks that an
+// operation changes are copied into the mount's open transaction (a hash of
+// block number -> block), not written. Commit flushes cached data first,
+// then appends the dirty bitmaps, the descriptor blocks of changed groups
+// and the superblock (once, with the counts as they stand), sorts the lot by
+// block number and writes each run of consecutive blocks once. A write,
+// create or truncate commits when the transaction holds EXT2_TXN_MAX_BLOCKS
+// blocks or is EXT2_TXN_MAX_MS old; syncfs, fsync and unmount always do.
+// Reads of metadata look in the transaction before the image.
+//
+// Directories: their blocks are read through the page cache like file data.
+// With dir_index an indexed directory is searched through its htree, one
+// block per level; other directories are parsed once into the VFS name
+// index (vfs_dindex.c) and looked up by hash from then on. Adding a name
+// to an indexed directory turns it into a linear one (the flag is cleared;
+// e2fsck -D rebuilds the index).
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <time.h>
 
+#define DBG_CAT DBG_VFS
+#include "debug.h"
 #include "vblk.h"
+#include "diskio.h"
 #include "vfs.h"
 #include "vfs_stat.h"
-#include "ext2.h"   // ext2_mkdir_p(const char*), ext2_create_and_write(const char*, const uint8_t*, uint32_t)
-
-/* -------- feature toggles -------- */
-#ifndef VFS_HAVE_CREATE_OP
-#define VFS_HAVE_CREATE_OP 0   /* set to 1 in vfs.h when you add inode_ops->create */
-#endif
+#include "gu_sync.h"
+#include "ext2.h"   // on-disk layout
 
 #ifndef VFS_PATH_MAX
 #define VFS_PATH_MAX 1024
 #endif
 
-/* -------- small utils -------- */
-static char *xstrdup(const char *s) {
-    if (!s) return NULL;
-    size_t n = strlen(s) + 1;
-    char *p = (char*)malloc(n);
-    if (p) memcpy(p, s, n);
-    return p;
-}
+#ifndef EXT2_IND_CACHE
+#define EXT2_IND_CACHE 8    /* indirect blocks cached per inode */
+#endif
+
+#ifndef EXT2_TXN_MAX_BLOCKS
+#define EXT2_TXN_MAX_BLOCKS 1024    /* a transaction holding this many commits at the next op end */
+#endif
+#ifndef EXT2_TXN_MAX_MS
+#define EXT2_TXN_MAX_MS 5000        /* ...as does one this old */
+#endif
+#ifndef EXT2_TXN_RUN_BYTES
+#define EXT2_TXN_RUN_BYTES (1u << 20)   /* commit writes merged runs of up to this */
+#endif
+
+#ifndef EXT2_CACHED_RUN_BYTES
+#define EXT2_CACHED_RUN_BYTES (64u << 10)  /* data runs up to this are written back through the block cache */
+#endif
+
+#ifndef EXT2_WBUF_BYTES
+#define EXT2_WBUF_BYTES (1u << 20)  /* write buffer per file; a multiple of any block size */
+#endif
 
+/* -------- small utils -------- */
 static void join_relpath(const char *parent, const char *name, char *out, size_t cap) {
     if (!parent || parent[0] == '\0') {
         snprintf(out, cap, "%s", name ? name : "");
@@ -45,222 +112,1893 @@ static void join_relpath(const char *parent, const char *name, char *out, size_t
 }
 
 /* -------- mount state -------- */
+/* One group's bitmaps, read on first use and kept for the mount; they and
+   the counts go into the transaction when it commits. */
+typedef struct ext2_group {
+    uint64_t *bmap, *imap;      /* block_size bytes each, or NULL */
+    bool      bdirty, idirty;
+    bool      gdirty;           /* descriptor changed */
+} ext2_group_t;
+
+/* Metadata blocks changed since the last commit, one copy per block. */
+typedef struct ext2_txn_blk {
+    uint32_t  blk;
+    uint8_t  *data;             /* block_size bytes; NULL: free slot */
+} ext2_txn_blk_t;
+
+typedef struct ext2_txn {
+    gu_mutex_t      lock;       /* the table (writers also hold the sb lock exclusively) */
+    ext2_txn_blk_t *slot;       /* open addressing, cap a power of two */
+    uint32_t        cap, count;
+    uint64_t        opened_ms;  /* when count went non-zero */
+} ext2_txn_t;
+
 typedef struct ext2_fs {
-    vblk_t *dev;        /* reserved for future; helpers are global right now */
-    /* naive dir registry so lookup can find what we created via this driver */
-    char  **dirs;
-    size_t  ndirs, capdirs;
+    vblk_t *dev;
+    uint64_t off;               /* byte offset of the fs in the backing image */
+    ext2_superblock sb;
+    uint32_t block_size;
+    uint32_t inode_size;
+    uint32_t addr_per_block;    /* block numbers per indirect block */
+    uint32_t ngroups;
+    ext2_group_desc *gd;        /* ngroups descriptors, read at mount */
+    ext2_group_t *grp;          /* ngroups */
+    bool     sb_dirty;          /* free counts or features changed since the last commit */
+    ext2_txn_t txn;
+    bool     filetype;          /* dirents carry file_type */
+    bool     dir_index;         /* htree directories may exist */
+    bool     rdonly;            /* ext4: read, never written */
+    bool     huge_file;         /* i_blocks may be in fs blocks, with a high half */
 } ext2_fs_t;
 
-static bool ext2_dirs_add(ext2_fs_t *fs, const char *rel) {
-    if (!fs || !rel) return false;
-    for (size_t i = 0; i < fs->ndirs; ++i)
-        if (strcmp(fs->dirs[i], rel) == 0) return true;
-    if (fs->ndirs == fs->capdirs) {
-        size_t nc = fs->capdirs ? fs->capdirs * 2 : 16;
-        char **nv = (char**)realloc(fs->dirs, nc * sizeof(char*));
-        if (!nv) return false;
-        fs->dirs = nv; fs->capdirs = nc;
-    }
-    fs->dirs[fs->ndirs] = xstrdup(rel);
-    if (!fs->dirs[fs->ndirs]) return false;
-    fs->ndirs++;
-    return true;
-}
-static bool ext2_dirs_has(ext2_fs_t *fs, const char *rel) {
-    if (!fs || !rel) return false;
-    for (size_t i = 0; i < fs->ndirs; ++i)
-        if (strcmp(fs->dirs[i], rel) == 0) return true;
-    return false;
-}
-static void ext2_dirs_free(ext2_fs_t *fs) {
-    if (!fs) return;
-    for (size_t i = 0; i < fs->ndirs; ++i) free(fs->dirs[i]);
-    free(fs->dirs);
-    fs->dirs = NULL; fs->ndirs = fs->capdirs = 0;
-}
-
 /* -------- inode/file priv payloads -------- */
+/* One cached indirect block: its block number and block_size/4 pointers. */
+typedef struct ext2_ind {
+    uint32_t  blk;
+    uint32_t  used;             /* LRU tick */
+    bool      dirty;            /* changed by an allocation, not yet written */
+    uint32_t *ptr;
+} ext2_ind_t;
+
+/* One run of an extent-mapped file: logical blocks [lblk, lblk+len) are
+   physical blocks from pblk. Uninitialized extents are left out (holes). */
+typedef struct ext2_extent {
+    uint32_t lblk, len, pblk;
+} ext2_extent_t;
+
 typedef struct ext2_inode_priv {
     ext2_fs_t *fs;
     char      *rel;     /* relative path from mount root; "" for root */
     bool       is_dir;
+    uint32_t   ino;     /* on-disk inode number */
+    ext2_inode di;      /* on-disk inode, as last written */
+    gu_mutex_t map_lock;            /* readers share the sb lock: guards ind[] and ext */
+    uint32_t   map_tick;
+    ext2_ind_t ind[EXT2_IND_CACHE];
+    ext2_extent_t *ext;             /* EXT4_EXTENTS_FL: the whole tree, sorted; NULL until first mapped */
+    uint32_t   n_ext;
+    /* writing (sb lock exclusive) */
+    uint32_t   writers;             /* files open for writing */
+    uint32_t   add_hint;            /* directories: block the last name went into */
+    uint32_t   goal;                /* where the next allocation looks first */
+    uint8_t   *wbuf;                /* EXT2_WBUF_BYTES from block-aligned wpos */
+    uint64_t   wpos;
+    uint32_t   wlen;                /* buffered bytes; 0: nothing pending */
 } ext2_inode_priv_t;
 
 typedef struct ext2_file_priv {
     ext2_inode_priv_t *node;
-    uint8_t *buf; size_t len, cap;
+    bool     writing;
 } ext2_file_priv_t;
 
+static VFS_SLAB_CACHE(g_ext2_inode_cache, "ext2_inode", ext2_inode_priv_t);
+static VFS_SLAB_CACHE(g_ext2_file_cache,  "ext2_file",  ext2_file_priv_t);
+
+static const char *ext2_devkey(const ext2_fs_t *fs) {
+    vblk_t *dev = fs ? fs->dev : NULL;
+    return dev ? (dev->dev[0] ? dev->dev : dev->name) : NULL;
+}
+
+/* -------- on-disk metadata -------- */
+
+/* Metadata is read through the block cache, with the open transaction's
+   copies on top. Writes only go to the transaction; txn_commit puts each
+   changed block on the image once, sorted and merged into runs. */
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static inline uint32_t txn_hash(uint32_t blk, uint32_t cap) {
+    return (blk * 2654435761u) & (cap - 1);
+}
+
+/* txn lock held */
+static ext2_txn_blk_t *txn_find(const ext2_txn_t *t, uint32_t blk) {
+    if (!t->count) return NULL;
+    for (uint32_t i = txn_hash(blk, t->cap);; i = (i + 1) & (t->cap - 1)) {
+        ext2_txn_blk_t *e = &t->slot[i];
+        if (!e->data) return NULL;
+        if (e->blk == blk) return e;
+    }
+}
+
+static void txn_place(ext2_txn_t *t, uint32_t blk, uint8_t *data) {
+    uint32_t i = txn_hash(blk, t->cap);
+    while (t->slot[i].data) i = (i + 1) & (t->cap - 1);
+    t->slot[i].blk = blk;
+    t->slot[i].data = data;
+}
+
+/* Block blk's copy in the transaction, added if missing: read through the
+   cache unless the caller overwrites all of it. txn lock held. */
+static uint8_t *txn_get(ext2_fs_t *fs, uint32_t blk, bool whole) {
+    ext2_txn_t *t = &fs->txn;
+    ext2_txn_blk_t *e = txn_find(t, blk);
+    if (e) return e->data;
+
+    if ((t->count + 1) * 2 > t->cap) {          /* keep the load under a half */
+        const uint32_t ncap = t->cap ? t->cap * 2 : 64;
+        ext2_txn_blk_t *ns = (ext2_txn_blk_t*)calloc(ncap, sizeof *ns);
+        if (!ns) return NULL;
+        ext2_txn_blk_t *old = t->slot;
+        const uint32_t ocap = t->cap;
+        t->slot = ns;
+        t->cap = ncap;
+        for (uint32_t i = 0; i < ocap; ++i)
+            if (old[i].data) txn_place(t, old[i].blk, old[i].data);
+        free(old);
+    }
+    uint8_t *data = (uint8_t*)malloc(fs->block_size);
+    const char *key = ext2_devkey(fs);
+    if (!data || !key) { free(data); return NULL; }
+    if (!whole && !diskio_pread_cached(key, fs->off + (uint64_t)blk * fs->block_size, data, fs->block_size)) {
+        free(data);
+        return NULL;
+    }
+    txn_place(t, blk, data);
+    if (t->count++ == 0) t->opened_ms = now_ms();
+    return data;
+}
+
+/* Remove slot i, shifting later entries of its probe chain back over it
+   (linear probing has no tombstones). txn lock held. */
+static void txn_del(ext2_txn_t *t, uint32_t i) {
+    const uint32_t mask = t->cap - 1;
+    free(t->slot[i].data);
+    t->slot[i].data = NULL;
+    t->count--;
+    for (uint32_t j = (i + 1) & mask; t->slot[j].data; j = (j + 1) & mask) {
+        const uint32_t h = txn_hash(t->slot[j].blk, t->cap);
+        const bool stays = i <= j ? (i < h && h <= j) : (i < h || h <= j);
+        if (stays) continue;
+        t->slot[i] = t->slot[j];
+        t->slot[j].data = NULL;
+        i = j;
+    }
+}
+
+/* Drop freed blocks from the transaction: they may come back as file data,
+   which is written straight to the image. */
+static void txn_forget(ext2_fs_t *fs, uint32_t first, uint32_t n) {
+    ext2_txn_t *t = &fs->txn;
+    gu_mutex_lock(&t->lock);
+    for (uint32_t i = 0; t->count && i < t->cap; ) {
+        const ext2_txn_blk_t *e = &t->slot[i];
+        if (e->data && e->blk >= first && e->blk - first < n) txn_del(t, i);   /* slot i refilled: look again */
+        else ++i;
+    }
+    gu_mutex_unlock(&t->lock);
+}
+
+/* len bytes at byte 'in' of block 'blk' (the range may run into later blocks) */
+static bool meta_read(ext2_fs_t *fs, uint32_t blk, uint32_t in, void *dst, uint32_t len) {
+    const char *key = ext2_devkey(fs);
+    const uint32_t bs = fs->block_size;
+    if (!key || blk >= fs->sb.s_blocks_count) return false;
+    uint8_t *out = (uint8_t*)dst;
+    bool ok = true;
+    gu_mutex_lock(&fs->txn.lock);
+    if (!fs->txn.count) {
+        gu_mutex_unlock(&fs->txn.lock);
+        return diskio_pread_cached(key, fs->off + (uint64_t)blk * bs + in, dst, len);
+    }
+    for (blk += in / bs, in %= bs; len && ok; ++blk, in = 0) {
+        const uint32_t n = len < bs - in ? len : bs - in;
+        const ext2_txn_blk_t *e = txn_find(&fs->txn, blk);
+        if (e) memcpy(out, e->data + in, n);
+        else ok = diskio_pread_cached(key, fs->off + (uint64_t)blk * bs + in, out, n);
+        out += n;
+        len -= n;
+    }
+    gu_mutex_unlock(&fs->txn.lock);
+    return ok;
+}
+
+/* ...and changed in the open transaction */
+static bool meta_write(ext2_fs_t *fs, uint32_t blk, uint32_t in, const void *src, uint32_t len) {
+    const uint32_t bs = fs->block_size;
+    if (blk >= fs->sb.s_blocks_count) return false;
+    const uint8_t *from = (const uint8_t*)src;
+    bool ok = true;
+    gu_mutex_lock(&fs->txn.lock);
+    for (blk += in / bs, in %= bs; len && ok; ++blk, in = 0) {
+        const uint32_t n = len < bs - in ? len : bs - in;
+        uint8_t *d = txn_get(fs, blk, n == bs);
+        if (d) memcpy(d + in, from, n);
+        else ok = false;
+        from += n;
+        len -= n;
+    }
+    gu_mutex_unlock(&fs->txn.lock);
+    return ok;
+}
+
+/* The transaction's copies of the blocks behind len bytes from byte 'in'
+   of pblk on, put over dst (the image's bytes there). Bytes covered. */
+static uint64_t txn_overlay(ext2_fs_t *fs, uint32_t pblk, uint32_t in, uint8_t *dst, uint64_t len) {
+    const uint32_t bs = fs->block_size;
+    uint64_t got = 0;
+    gu_mutex_lock(&fs->txn.lock);
+    for (uint64_t at = 0; fs->txn.count && at < len; ) {
+        const uint32_t b = pblk + (uint32_t)((in + at) / bs), o = (uint32_t)((in + at) % bs);
+        const uint64_t n = len - at < bs - o ? len - at : bs - o;
+        const ext2_txn_blk_t *e = txn_find(&fs->txn, b);
+        if (e) { memcpy(dst + at, e->data + o, (size_t)n); got += n; }
+        at += n;
+    }
+    gu_mutex_unlock(&fs->txn.lock);
+    return got;
+}
+
+static int txn_cmp(const void *a, const void *b) {
+    const uint32_t x = (*(const ext2_txn_blk_t* const*)a)->blk, y = (*(const ext2_txn_blk_t* const*)b)->blk;
+    return x < y ? -1 : x > y;
+}
+
+/* Write every block of the transaction once, in block order, consecutive
+   blocks as one write; then start an empty one. */
+static int txn_write(ext2_fs_t *fs) {
+    ext2_txn_t *t = &fs->txn;
+    const char *key = ext2_devkey(fs);
+    const uint32_t bs = fs->block_size;
+    if (!t->count) return 0;
+    if (!key) return -EIO;
+    int rc = diskio_sync(key);                  /* file data first, then what points at it */
+    if (rc) return rc;
+
+    ext2_txn_blk_t **v = (ext2_txn_blk_t**)malloc(t->count * sizeof *v);
+    const uint32_t per_run = EXT2_TXN_RUN_BYTES / bs;
+    uint8_t *run = (uint8_t*)malloc((size_t)per_run * bs);
+    if (!v || !run) { free(v); free(run); return -ENOMEM; }
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < t->cap; ++i)
+        if (t->slot[i].data) v[n++] = &t->slot[i];
+    qsort(v, n, sizeof *v, txn_cmp);
+
+    uint32_t nwrites = 0;
+    for (uint32_t i = 0; i < n && rc == 0; ) {
+        uint32_t k = 1;
+        while (i + k < n && k < per_run && v[i + k]->blk == v[i]->blk + k) ++k;
+        const uint8_t *src = v[i]->data;
+        if (k > 1) {
+            for (uint32_t j = 0; j < k; ++j) memcpy(run + (size_t)j * bs, v[i + j]->data, bs);
+            src = run;
+        }
+        if (!diskio_pwrite(key, fs->off + (uint64_t)v[i]->blk * bs, src, k * bs)) rc = -EIO;
+        nwrites++;
+        i += k;
+    }
+    DBG("ext2: commit %u blocks in %u writes rc=%d", (unsigned)n, (unsigned)nwrites, rc);
+    free(run);
+    free(v);
+    if (rc) return rc;                          /* keep it: a later commit retries */
+
+    for (uint32_t i = 0; i < t->cap; ++i) {
+        free(t->slot[i].data);
+        t->slot[i].data = NULL;
+    }
+    t->count = 0;
+    return 0;
+}
+
+static inline uint64_t inode_size_of(const ext2_inode *di) {
+    uint64_t sz = di->i_size;
+    if (VFS_S_ISREG(di->i_mode)) sz |= (uint64_t)di->i_dir_acl << 32;   /* i_size_high */
+    return sz;
+}
+
+/* Inode table block and byte offset in it of inode 'ino'. */
+static int inode_loc(const ext2_fs_t *fs, uint32_t ino, uint32_t *blk, uint32_t *in) {
+    if (ino == 0 || ino > fs->sb.s_inodes_count) return -EINVAL;
+    const uint32_t grp = (ino - 1) / fs->sb.s_inodes_per_group;
+    const uint32_t idx = (ino - 1) % fs->sb.s_inodes_per_group;
+    if (grp >= fs->ngroups) return -EIO;
+    const uint64_t at = (uint64_t)idx * fs->inode_size;
+    *blk = fs->gd[grp].bg_inode_table + (uint32_t)(at / fs->block_size);
+    *in  = (uint32_t)(at % fs->block_size);
+    return 0;
+}
+
+static int read_inode(ext2_fs_t *fs, uint32_t ino, ext2_inode *out) {
+    uint32_t blk, in;
+    int rc = inode_loc(fs, ino, &blk, &in);
+    if (rc) return rc;
+    return meta_read(fs, blk, in, out, sizeof *out) ? 0 : -EIO;
+}
+
+/* The 128 bytes we know of inode 'ino'; 'fresh' also clears the rest of
+   a larger on-disk inode, which a new inode must not inherit. */
+static int write_inode(ext2_fs_t *fs, uint32_t ino, const ext2_inode *di, bool fresh) {
+    uint32_t blk, in;
+    int rc = inode_loc(fs, ino, &blk, &in);
+    if (rc) return rc;
+    if (!fresh || fs->inode_size == sizeof *di)
+        return meta_write(fs, blk, in, di, sizeof *di) ? 0 : -EIO;
+    uint8_t *slot = (uint8_t*)calloc(1, fs->inode_size);
+    if (!slot) return -ENOMEM;
+    memcpy(slot, di, sizeof *di);
+    rc = meta_write(fs, blk, in, slot, fs->inode_size) ? 0 : -EIO;
+    free(slot);
+    return rc;
+}
+
+/* -------- allocation (sb lock exclusive) -------- */
+
+static inline uint32_t group_first_block(const ext2_fs_t *fs, uint32_t g) {
+    return fs->sb.s_first_data_block + g * fs->sb.s_blocks_per_group;
+}
+
+/* Bits of group g's block or inode bitmap (at most one block's worth). */
+static uint32_t group_bits(const ext2_fs_t *fs, uint32_t g, bool inodes) {
+    uint32_t n = inodes ? fs->sb.s_inodes_per_group : fs->sb.s_blocks_per_group;
+    if (!inodes && fs->sb.s_blocks_count - group_first_block(fs, g) < n)
+        n = fs->sb.s_blocks_count - group_first_block(fs, g);
+    return n < fs->block_size * 8 ? n : fs->block_size * 8;
+}
+
+/* Group g's block (or inode) bitmap, read in the first time. Its free count
+   is checked against the descriptor's then, and the bitmap wins. */
+static uint64_t *group_map(ext2_fs_t *fs, uint32_t g, bool inodes) {
+    ext2_group_t *gr = &fs->grp[g];
+    uint64_t **slot = inodes ? &gr->imap : &gr->bmap;
+    if (*slot) return *slot;
+    uint64_t *map = (uint64_t*)malloc(fs->block_size);
+    if (!map) return NULL;
+    const uint32_t blk = inodes ? fs->gd[g].bg_inode_bitmap : fs->gd[g].bg_block_bitmap;
+    if (!meta_read(fs, blk, 0, map, fs->block_size)) { free(map); return NULL; }
+
+    const uint32_t nbits = group_bits(fs, g, inodes);
+    const uint32_t nfree = nbits - ext2_bitmap_count(map, nbits);
+    const uint32_t count = inodes ? fs->gd[g].bg_free_inodes_count : fs->gd[g].bg_free_blocks_count;
+    if (nfree != count) {
+        DBG("ext2: group %u %s bitmap has %u free, descriptor says %u",
+            (unsigned)g, inodes ? "inode" : "block", (unsigned)nfree, (unsigned)count);
+        if (inodes) {
+            fs->gd[g].bg_free_inodes_count = (uint16_t)nfree;
+            fs->sb.s_free_inodes_count = fs->sb.s_free_inodes_count + nfree >= count
+                                       ? fs->sb.s_free_inodes_count + nfree - count : 0;
+        } else {
+            fs->gd[g].bg_free_blocks_count = (uint16_t)nfree;
+            fs->sb.s_free_blocks_count = fs->sb.s_free_blocks_count + nfree >= count
+                                       ? fs->sb.s_free_blocks_count + nfree - count : 0;
+        }
+        fs->grp[g].gdirty = fs->sb_dirty = true;
+    }
+    *slot = map;
+    return map;
+}
+
+/* Up to 'want' free blocks in one contiguous run: at goal, else the first
+   free block after it, going on through the following groups. Marks them
+   in use; *first gets the run's start. The count, or -ENOSPC. */
+static int64_t alloc_blocks(ext2_fs_t *fs, uint32_t goal, uint32_t want, uint32_t *first) {
+    ext2_superblock *s = &fs->sb;
+    if (want == 0) return -EINVAL;
+    if (s->s_free_blocks_count == 0) return -ENOSPC;
+    if (goal < s->s_first_data_block || goal >= s->s_blocks_count) goal = s->s_first_data_block;
+    const uint32_t g0 = (goal - s->s_first_data_block) / s->s_blocks_per_group;
+
+    for (uint32_t k = 0; k <= fs->ngroups; ++k) {       /* g0 twice: from goal, then whole */
+        const uint32_t g = (g0 + k) % fs->ngroups;
+        const uint32_t nfree = fs->gd[g].bg_free_blocks_count;
+        if (nfree == 0) continue;
+        uint64_t *map = group_map(fs, g, false);
+        if (!map) return -EIO;
+        const uint32_t nbits = group_bits(fs, g, false);
+        const uint32_t i = ext2_bitmap_next_zero(map, k == 0 ? goal - group_first_block(fs, g) : 0, nbits);
+        if (i == nbits) continue;
+        const uint32_t n = ext2_bitmap_zero_run(map, i, nbits, want < nfree ? want : nfree);
+        ext2_bitmap_set_range(map, i, n);
+        fs->gd[g].bg_free_blocks_count -= (uint16_t)n;
+        s->s_free_blocks_count -= n < s->s_free_blocks_count ? n : s->s_free_blocks_count;
+        fs->grp[g].bdirty = fs->grp[g].gdirty = fs->sb_dirty = true;
+        *first = group_first_block(fs, g) + i;
+        return n;
+    }
+    return -ENOSPC;
+}
+
+/* Give back n blocks from 'first' (they may cross into the next group). */
+static int free_blocks(ext2_fs_t *fs, uint32_t first, uint32_t n) {
+    ext2_superblock *s = &fs->sb;
+    while (n) {
+        if (first < s->s_first_data_block || first >= s->s_blocks_count) return -EIO;
+        const uint32_t g = (first - s->s_first_data_block) / s->s_blocks_per_group;
+        const uint32_t i = first - group_first_block(fs, g);
+        uint32_t take = group_bits(fs, g, false) - i;
+        if (take > n) take = n;
+        uint64_t *map = group_map(fs, g, false);
+        if (!map || i >= group_bits(fs, g, false)) return -EIO;
+        const uint32_t was = ext2_bitmap_clear_range(map, i, take);
+        txn_forget(fs, first, take);
+        fs->gd[g].bg_free_blocks_count += (uint16_t)was;
+        s->s_free_blocks_count += was;
+        fs->grp[g].bdirty = fs->grp[g].gdirty = fs->sb_dirty = true;
+        first += take;
+        n -= take;
+    }
+    return 0;
+}
+
+/* A free inode, looking in group g0 first. */
+static int alloc_inode(ext2_fs_t *fs, uint32_t g0, bool dir, uint32_t *ino) {
+    ext2_superblock *s = &fs->sb;
+    if (s->s_free_inodes_count == 0) return -ENOSPC;
+    const uint32_t ipg = s->s_inodes_per_group;
+    const uint32_t first_ino = (s->s_rev_level >= 1 && s->s_first_ino) ? s->s_first_ino
+                                                                       : EXT2_GOOD_OLD_FIRST_INO;
+    for (uint32_t k = 0; k < fs->ngroups; ++k) {
+        const uint32_t g = (g0 + k) % fs->ngroups;
+        if (fs->gd[g].bg_free_inodes_count == 0) continue;
+        uint64_t *map = group_map(fs, g, true);
+        if (!map) return -EIO;
+        const uint64_t lo = (uint64_t)g * ipg;
+        const uint32_t nbits = group_bits(fs, g, true);
+        const uint32_t i = ext2_bitmap_next_zero(map, first_ino - 1 > lo ? (uint32_t)(first_ino - 1 - lo) : 0, nbits);
+        if (i == nbits) continue;
+        ext2_bitmap_set_range(map, i, 1);
+        fs->gd[g].bg_free_inodes_count--;
+        if (dir) fs->gd[g].bg_used_dirs_count++;
+        s->s_free_inodes_count--;
+        fs->grp[g].idirty = fs->grp[g].gdirty = fs->sb_dirty = true;
+        *ino = g * ipg + i + 1;
+        return 0;
+    }
+    return -ENOSPC;
+}
+
+/* Undo alloc_inode for an inode that never got linked anywhere. */
+static void free_inode(ext2_fs_t *fs, uint32_t ino, bool dir) {
+    const uint32_t g = (ino - 1) / fs->sb.s_inodes_per_group;
+    const uint32_t i = (ino - 1) % fs->sb.s_inodes_per_group;
+    ext2_inode dead;
+    memset(&dead, 0, sizeof dead);
+    dead.i_dtime = (uint32_t)time(NULL);
+    (void)write_inode(fs, ino, &dead, true);
+
+    uint64_t *map = group_map(fs, g, true);
+    if (!map || !ext2_bitmap_clear_range(map, i, 1)) return;
+    fs->gd[g].bg_free_inodes_count++;
+    if (dir && fs->gd[g].bg_used_dirs_count) fs->gd[g].bg_used_dirs_count--;
+    fs->sb.s_free_inodes_count++;
+    fs->grp[g].idirty = fs->grp[g].gdirty = fs->sb_dirty = true;
+}
+
+/* Commit: changed bitmaps, descriptor blocks and the superblock join the
+   transaction (counts are written once here, not per allocation), then
+   all of it goes to the image. sb lock exclusive. */
+static int txn_commit(ext2_fs_t *fs) {
+    const uint32_t bs = fs->block_size;
+    const uint32_t per_blk = bs / (uint32_t)sizeof *fs->gd;
+    int rc = 0;
+    for (uint32_t g = 0; g < fs->ngroups; ++g) {
+        ext2_group_t *gr = &fs->grp[g];
+        if (gr->bdirty) {
+            if (meta_write(fs, fs->gd[g].bg_block_bitmap, 0, gr->bmap, bs)) gr->bdirty = false;
+            else rc = -EIO;
+        }
+        if (gr->idirty) {
+            if (meta_write(fs, fs->gd[g].bg_inode_bitmap, 0, gr->imap, bs)) gr->idirty = false;
+            else rc = -EIO;
+        }
+    }
+    for (uint32_t g0 = 0; g0 < fs->ngroups; g0 += per_blk) {     /* descriptor blocks with a change */
+        const uint32_t n = fs->ngroups - g0 < per_blk ? fs->ngroups - g0 : per_blk;
+        bool dirty = false;
+        for (uint32_t g = g0; g < g0 + n; ++g) dirty |= fs->grp[g].gdirty;
+        if (!dirty) continue;
+        if (!meta_write(fs, fs->sb.s_first_data_block + 1 + g0 / per_blk, 0, &fs->gd[g0],
+                        n * (uint32_t)sizeof *fs->gd)) { rc = -EIO; continue; }
+        for (uint32_t g = g0; g < g0 + n; ++g) fs->grp[g].gdirty = false;
+    }
+    if (fs->sb_dirty) {
+        fs->sb.s_wtime = (uint32_t)time(NULL);
+        if (meta_write(fs, EXT2_SUPER_OFFSET / bs, EXT2_SUPER_OFFSET % bs, &fs->sb, sizeof fs->sb))
+            fs->sb_dirty = false;
+        else rc = -EIO;
+    }
+    int rw = txn_write(fs);
+    return rc ? rc : rw;
+}
+
+/* End of a changing operation: commit once the transaction is big or old
+   enough, so a run of small operations shares one commit. */
+static int txn_end(ext2_fs_t *fs) {
+    const ext2_txn_t *t = &fs->txn;
+    if (t->count < EXT2_TXN_MAX_BLOCKS && (!t->count || now_ms() - t->opened_ms < EXT2_TXN_MAX_MS))
+        return 0;
+    return txn_commit(fs);
+}
+
+static void fs_free(ext2_fs_t *fs) {
+    if (!fs) return;
+    for (uint32_t g = 0; fs->grp && g < fs->ngroups; ++g) {
+        free(fs->grp[g].bmap);
+        free(fs->grp[g].imap);
+    }
+    for (uint32_t i = 0; i < fs->txn.cap; ++i) free(fs->txn.slot[i].data);
+    free(fs->txn.slot);
+    gu_mutex_destroy(&fs->txn.lock);
+    free(fs->grp);
+    free(fs->gd);
+    free(fs);
+}
+
+static ext2_inode_priv_t *priv_new(superblock_t *sb, ext2_fs_t *fs, const char *rel, bool is_dir) {
+    ext2_inode_priv_t *ip = (ext2_inode_priv_t*)vfs_slab_alloc(&g_ext2_inode_cache, sb->s_slab);
+    if (!ip) return NULL;
+    ip->fs = fs;
+    ip->is_dir = is_dir;
+    ip->rel = vfs_slab_strdup(sb->s_slab, rel ? rel : "");
+    if (!ip->rel) { vfs_slab_free(ip); return NULL; }
+    gu_mutex_init(&ip->map_lock);
+    return ip;
+}
+
+static void priv_free(ext2_inode_priv_t *ip) {
+    if (!ip) return;
+    for (int i = 0; i < EXT2_IND_CACHE; ++i) free(ip->ind[i].ptr);
+    free(ip->ext);
+    free(ip->wbuf);
+    gu_mutex_destroy(&ip->map_lock);
+    vfs_slab_free(ip->rel);
+    vfs_slab_free(ip);
+}
+
+/* -------- block mapping (map_lock held) -------- */
+
+/* Indirect block blk in the inode's LRU of indirect blocks, read in unless
+   'fresh' (just allocated: it starts out zeroed). A dirty block pushed out
+   to make room is written back first. */
+static int ind_get(ext2_inode_priv_t *ip, uint32_t blk, bool fresh, ext2_ind_t **out) {
+    const uint32_t bs = ip->fs->block_size;
+    ext2_ind_t *c = NULL;
+    for (int i = 0; i < EXT2_IND_CACHE; ++i)
+        if (ip->ind[i].ptr && ip->ind[i].blk == blk) { c = &ip->ind[i]; break; }
+    if (!c) {
+        c = &ip->ind[0];
+        for (int i = 1; i < EXT2_IND_CACHE && c->ptr; ++i)
+            if (!ip->ind[i].ptr || ip->ind[i].used < c->used) c = &ip->ind[i];
+        if (c->ptr && c->dirty && !meta_write(ip->fs, c->blk, 0, c->ptr, bs)) return -EIO;
+        c->dirty = false;
+        if (!c->ptr && !(c->ptr = (uint32_t*)malloc(bs))) return -ENOMEM;
+        c->blk = 0;                                 /* invalid until the read succeeds */
+        if (fresh) memset(c->ptr, 0, bs);
+        else if (!meta_read(ip->fs, blk, 0, c->ptr, bs)) return -EIO;
+        c->blk = blk;
+    }
+    c->used = ++ip->map_tick;
+    *out = c;
+    return 0;
+}
+
+/* Entry 'slot' of indirect block 'blk'; a zero blk is a hole in the tree
+   and maps to zero. */
+static int ind_entry(ext2_inode_priv_t *ip, uint32_t blk, uint32_t slot, uint32_t *out) {
+    *out = 0;
+    if (blk == 0) return 0;
+    ext2_ind_t *c;
+    int rc = ind_get(ip, blk, false, &c);
+    if (rc) return rc;
+    *out = c->ptr[slot];
+    return 0;
+}
+
+/* Write back the indirect blocks allocations changed. */
+static int ind_sync(ext2_inode_priv_t *ip) {
+    for (int i = 0; i < EXT2_IND_CACHE; ++i) {
+        ext2_ind_t *c = &ip->ind[i];
+        if (!c->ptr || !c->dirty) continue;
+        if (!meta_write(ip->fs, c->blk, 0, c->ptr, ip->fs->block_size)) return -EIO;
+        c->dirty = false;
+    }
+    return 0;
+}
+
+/* Forget the cached indirect blocks (after a truncate freed some). */
+static void ind_drop(ext2_inode_priv_t *ip) {
+    for (int i = 0; i < EXT2_IND_CACHE; ++i) { ip->ind[i].blk = 0; ip->ind[i].dirty = false; }
+}
+
+/* Where the pointer to logical block lblk lives: off[0] indexes i_block[],
+   off[1..depth] the indirect blocks below it. The depth (0-3), or -EFBIG
+   past the triple-indirect tree. */
+static int bmap_path(const ext2_fs_t *fs, uint64_t lblk, uint32_t off[4]) {
+    const uint64_t apb = fs->addr_per_block;
+    if (lblk < EXT2_NDIR_BLOCKS) { off[0] = (uint32_t)lblk; return 0; }
+    lblk -= EXT2_NDIR_BLOCKS;
+    uint64_t span = apb;                        /* blocks under one tree of this depth */
+    for (unsigned d = 0; d < 3; ++d, span *= apb) {
+        if (lblk >= span) { lblk -= span; continue; }
+        off[0] = EXT2_IND_BLOCK + d;
+        uint64_t per = span / apb;
+        for (unsigned k = 1; k <= d + 1; ++k, per /= apb) {
+            off[k] = (uint32_t)(lblk / per);
+            lblk %= per;
+        }
+        return (int)d + 1;
+    }
+    return -EFBIG;
+}
+
+/* Physical block of logical block lblk (0: hole), or -errno. For a hole,
+   *span is how many blocks from lblk are certainly holes too: the rest of
+   the subtree whose pointer was zero. */
+static int bmap_locked(ext2_inode_priv_t *ip, uint64_t lblk, uint32_t *out, uint64_t *span) {
+    const uint64_t apb = ip->fs->addr_per_block;
+    uint32_t off[4];
+    const int depth = bmap_path(ip->fs, lblk, off);
+    if (depth < 0) return depth;
+    uint32_t blk = ip->di.i_block[off[0]];
+    int k = 0;                                  /* level of the pointer just read */
+    while (k < depth && blk) {
+        int rc = ind_entry(ip, blk, off[++k], &blk);
+        if (rc) return rc;
+    }
+    *out = blk;
+    *span = 1;
+    if (!blk) {                                 /* blocks under that pointer, less those before lblk */
+        uint64_t cover = 1, before = 0;
+        for (int j = depth; j > k; --j) { before += off[j] * cover; cover *= apb; }
+        *span = cover - before;
+    }
+    return 0;
+}
+
+/* Growing list of extents while a tree is read. */
+typedef struct ext2_ext_list {
+    ext2_extent_t *e;
+    uint32_t       n, cap;
+} ext2_ext_list_t;
+
+static int ext_push(ext2_ext_list_t *l, uint32_t lblk, uint32_t len, uint32_t pblk) {
+    if (l->n) {
+        ext2_extent_t *last = &l->e[l->n - 1];
+        if ((uint64_t)last->lblk + last->len > lblk) return -EIO;        /* out of order or overlapping */
+        if (last->lblk + last->len == lblk && last->pblk + last->len == pblk && last->len <= UINT32_MAX - len) {
+            last->len += len;                   /* contiguous on both sides: one run */
+            return 0;
+        }
+    }
+    if (l->n == l->cap) {
+        const uint32_t cap = l->cap ? l->cap * 2 : 8;
+        ext2_extent_t *e = (ext2_extent_t*)realloc(l->e, cap * sizeof *e);
+        if (!e) return -ENOMEM;
+        l->e = e;
+        l->cap = cap;
+    }
+    l->e[l->n++] = (ext2_extent_t){ .lblk = lblk, .len = len, .pblk = pblk };
+    return 0;
+}
+
+/* Append the extents under one tree node ('room' bytes: i_block[] or a
+   whole block) to l, in order. 'depth' is what the node must say it is. */
+static int ext_collect(ext2_fs_t *fs, const uint8_t *node, uint32_t room, unsigned depth, ext2_ext_list_t *l) {
+    const ext4_extent_header *h = (const ext4_extent_header*)node;
+    if (h->eh_magic != EXT4_EXT_MAGIC || h->eh_depth != depth || h->eh_entries > h->eh_max ||
+        sizeof *h + (size_t)h->eh_max * sizeof(ext4_extent) > room)
+        return -EIO;
+    const uint64_t nblocks = fs->sb.s_blocks_count;
+    if (depth == 0) {
+        const ext4_extent *e = (const ext4_extent*)(h + 1);
+        for (uint32_t i = 0; i < h->eh_entries; ++i) {
+            const bool uninit = e[i].ee_len > EXT4_EXT_INIT_MAX_LEN;
+            const uint32_t len = uninit ? e[i].ee_len - EXT4_EXT_INIT_MAX_LEN : e[i].ee_len;
+            const uint64_t start = ((uint64_t)e[i].ee_start_hi << 32) | e[i].ee_start_lo;
+            if (len == 0 || uninit) continue;
+            if (start + len > nblocks || (uint64_t)e[i].ee_block + len > (1ull << 32)) return -EIO;
+            int rc = ext_push(l, e[i].ee_block, len, (uint32_t)start);
+            if (rc) return rc;
+        }
+        return 0;
+    }
+    const ext4_extent_idx *x = (const ext4_extent_idx*)(h + 1);
+    uint8_t *child = (uint8_t*)malloc(fs->block_size);
+    if (!child) return -ENOMEM;
+    int rc = 0;
+    for (uint32_t i = 0; i < h->eh_entries && rc == 0; ++i) {
+        const uint64_t leaf = ((uint64_t)x[i].ei_leaf_hi << 32) | x[i].ei_leaf_lo;
+        if (leaf >= nblocks) rc = -EIO;
+        else if (!meta_read(fs, (uint32_t)leaf, 0, child, fs->block_size)) rc = -EIO;
+        else rc = ext_collect(fs, child, fs->block_size, depth - 1, l);
+    }
+    free(child);
+    return rc;
+}
+
+/* The inode's extent tree as one sorted list, read the first time it is
+   mapped; neighbouring extents that continue each other are merged. */
+static int ext_load(ext2_inode_priv_t *ip) {
+    if (ip->ext) return 0;
+    const ext4_extent_header *h = (const ext4_extent_header*)ip->di.i_block;
+    ext2_ext_list_t l = { 0 };
+    int rc = h->eh_depth > EXT4_EXT_MAX_DEPTH ? -EIO
+           : ext_collect(ip->fs, (const uint8_t*)ip->di.i_block, sizeof ip->di.i_block, h->eh_depth, &l);
+    if (rc == 0 && !l.e && !(l.e = (ext2_extent_t*)malloc(sizeof *l.e))) rc = -ENOMEM;
+    if (rc) {
+        if (rc == -EIO) DBG("ext2: bad extent tree in inode %u", (unsigned)ip->ino);
+        free(l.e);
+        return rc;
+    }
+    ip->ext = l.e;
+    ip->n_ext = l.n;
+    return 0;
+}
+
+/* bmap_run for an extent-mapped inode: a binary search for the extent
+   holding lblk, else the hole up to the next one. */
+static int64_t ext_map(ext2_inode_priv_t *ip, uint64_t lblk, uint64_t max, uint32_t *pblk) {
+    int rc = ext_load(ip);
+    if (rc) return rc;
+    uint32_t lo = 0, hi = ip->n_ext;            /* first extent starting past lblk */
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (ip->ext[mid].lblk <= lblk) lo = mid + 1;
+        else hi = mid;
+    }
+    *pblk = 0;
+    if (lo) {
+        const ext2_extent_t *e = &ip->ext[lo - 1];
+        const uint64_t end = (uint64_t)e->lblk + e->len;
+        if (lblk < end) {
+            *pblk = e->pblk + (uint32_t)(lblk - e->lblk);
+            return (int64_t)(end - lblk < max ? end - lblk : max);
+        }
+    }
+    if (lo < ip->n_ext && ip->ext[lo].lblk - lblk < max) return (int64_t)(ip->ext[lo].lblk - lblk);
+    return (int64_t)max;
+}
+
+/* Map up to max blocks from lblk. *pblk gets the first physical block (0 for
+   a hole); returns how many blocks from there are contiguous on disk (or all
+   holes), or -errno. */
+static int64_t bmap_run(ext2_inode_priv_t *ip, uint64_t lblk, uint64_t max, uint32_t *pblk) {
+    uint32_t first = 0, next = 0;
+    if (ip->di.i_flags & EXT4_EXTENTS_FL) {
+        gu_mutex_lock(&ip->map_lock);
+        const int64_t n = ext_map(ip, lblk, max, pblk);
+        gu_mutex_unlock(&ip->map_lock);
+        return n;
+    }
+    uint64_t span = 0;
+    gu_mutex_lock(&ip->map_lock);
+    int rc = bmap_locked(ip, lblk, &first, &span);
+    uint64_t n = rc ? 0 : (first ? 1 : span);  /* holes go a missing subtree at a time */
+    while (n < max && bmap_locked(ip, lblk + n, &next, &span) == 0 &&
+           (uint64_t)next == (first ? (uint64_t)first + n : 0))
+        n += first ? 1 : span;
+    gu_mutex_unlock(&ip->map_lock);
+    if (n > max) n = max;
+    if (n == 0) return rc;
+    if (first && (uint64_t)first + n > ip->fs->sb.s_blocks_count) return -EIO;
+    *pblk = first;
+    return (int64_t)n;
+}
+
+/* Back up to 'want' blocks of the hole at lblk with one run, no further than
+   the end of the pointer table that maps lblk. Indirect blocks missing above
+   it are allocated first, so the data follows them on disk. The run's first
+   block in *pblk; returns its length or -errno. */
+static int64_t alloc_map(ext2_inode_priv_t *ip, uint64_t lblk, uint64_t want, uint32_t *pblk) {
+    ext2_fs_t *fs = ip->fs;
+    const uint32_t spb = fs->block_size / 512u;
+    uint32_t off[4];
+    const int depth = bmap_path(fs, lblk, off);
+    if (depth < 0) return depth;
+    if ((uint64_t)ip->di.i_blocks + (want + 3) * spb > UINT32_MAX) return -EFBIG;
+    if (!ip->goal)
+        ip->goal = fs->sb.s_first_data_block +
+                   (ip->ino - 1) / fs->sb.s_inodes_per_group * fs->sb.s_blocks_per_group;
+
+    ext2_ind_t *tab = NULL;                     /* table holding the pointer; NULL: i_block[] */
+    uint32_t slot = off[0];
+    for (int k = 1; k <= depth; ++k) {
+        uint32_t blk = tab ? tab->ptr[slot] : ip->di.i_block[slot];
+        const bool fresh = blk == 0;
+        if (fresh) {
+            int64_t n = alloc_blocks(fs, ip->goal, 1, &blk);
+            if (n < 0) return n;
+            ip->goal = blk + 1;
+            ip->di.i_blocks += spb;
+            if (tab) { tab->ptr[slot] = blk; tab->dirty = true; }
+            else ip->di.i_block[slot] = blk;
+        }
+        int rc = ind_get(ip, blk, fresh, &tab);     /* never evicts the parent: it is the newest */
+        if (rc) return rc;
+        if (fresh) tab->dirty = true;
+        slot = off[k];
+    }
+
+    const uint32_t room = (tab ? fs->addr_per_block : EXT2_NDIR_BLOCKS) - slot;
+    if (want > room) want = room;
+    uint32_t first = 0;
+    const int64_t n = alloc_blocks(fs, ip->goal, (uint32_t)want, &first);
+    if (n < 0) return n;
+    for (uint32_t i = 0; i < (uint32_t)n; ++i) {
+        if (tab) tab->ptr[slot + i] = first + i;
+        else ip->di.i_block[slot + i] = first + i;
+    }
+    if (tab) tab->dirty = true;
+    ip->di.i_blocks += (uint32_t)n * spb;
+    ip->goal = first + (uint32_t)n;
+    *pblk = first;
+    return n;
+}
+
+/* Read n bytes at pos (inside the file) with one device read per physical
+   run; holes read as zeros. 0 or -errno. */
+static int read_range(ext2_inode_priv_t *ip, uint64_t pos, uint8_t *dst, size_t n) {
+    const uint32_t bs = ip->fs->block_size;
+    while (n) {
+        const uint32_t in = (uint32_t)(pos % bs);
+        uint32_t pblk = 0;
+        int64_t cnt = bmap_run(ip, pos / bs, ((uint64_t)in + n + bs - 1) / bs, &pblk);
+        if (cnt < 0) return (int)cnt;
+        uint64_t take = (uint64_t)cnt * bs - in;
+        if (take > n) take = n;
+        if (take > (1u << 30)) take = 1u << 30;     /* vblk_read_bytes takes 32-bit lengths */
+        if (!pblk) memset(dst, 0, (size_t)take);
+        else if (ip->is_dir && txn_overlay(ip->fs, pblk, in, dst, take) == take)
+            ;                                   /* directory blocks are metadata: all in the transaction */
+        else if (!vblk_read_bytes(ip->fs->dev, (uint64_t)pblk * bs + in, (uint32_t)take, dst))
+            return -EIO;
+        else if (ip->is_dir) txn_overlay(ip->fs, pblk, in, dst, take);
+        pos += take; dst += take; n -= (size_t)take;
+    }
+    return 0;
+}
+
+/* -------- writing (sb lock exclusive) -------- */
+
+/* n blocks from physical block pblk, write-through, at most 1 GiB a call.
+   A short run (a small file, a tail) is left in the block cache instead,
+   where those of neighbouring files merge into one write. */
+static int put_run(const ext2_fs_t *fs, uint32_t pblk, const uint8_t *src, uint64_t n) {
+    const char *key = ext2_devkey(fs);
+    const uint32_t bs = fs->block_size;
+    if (!key || (uint64_t)pblk + n > fs->sb.s_blocks_count) return -EIO;
+    if (n * bs <= EXT2_CACHED_RUN_BYTES)
+        return diskio_pwrite_cached(key, fs->off + (uint64_t)pblk * bs, src, (uint32_t)(n * bs)) ? 0 : -EIO;
+    while (n) {
+        const uint64_t step = n < (1u << 30) / bs ? n : (1u << 30) / bs;
+        if (!diskio_pwrite(key, fs->off + (uint64_t)pblk * bs, src, (uint32_t)(step * bs))) return -EIO;
+        pblk += (uint32_t)step; src += step * bs; n -= step;
+    }
+    return 0;
+}
+
+static inline bool block_is_zero(const uint8_t *p, uint32_t bs) {
+    return p[0] == 0 && memcmp(p, p + 1, bs - 1) == 0;
+}
+
+/* How many of the n blocks at p are all zeros (or all not), from the first. */
+static uint64_t zero_blocks(const uint8_t *p, uint64_t n, uint32_t bs, bool zero) {
+    uint64_t k = 0;
+    while (k < n && block_is_zero(p + k * bs, bs) == zero) k++;
+    return k;
+}
+
+/* nblk whole blocks from src into the file at lblk, allocating its holes;
+   blocks that end up physically contiguous go out as one write. All-zero
+   blocks that would fill a hole are left out: the hole reads the same. */
+static int write_blocks(ext2_inode_priv_t *ip, uint64_t lblk, const uint8_t *src, uint64_t nblk) {
+    const uint32_t bs = ip->fs->block_size;
+    uint32_t run_at = 0;
+    uint64_t run_len = 0;                       /* pending: blocks from run_at, data at run_src */
+    const uint8_t *run_src = src;
+    int rc = 0;
+    while (nblk) {
+        uint32_t pblk = 0;
+        int64_t n = bmap_run(ip, lblk, nblk, &pblk);
+        if (n > 0 && !pblk) {
+            const uint64_t z = zero_blocks(src, (uint64_t)n, bs, true);
+            if (z) {                            /* stays a hole */
+                if (run_len && (rc = put_run(ip->fs, run_at, run_src, run_len)) != 0) break;
+                run_len = 0;
+                lblk += z; src += z * bs; nblk -= z;
+                run_src = src;
+                continue;
+            }
+            gu_mutex_lock(&ip->map_lock);
+            n = alloc_map(ip, lblk, zero_blocks(src, (uint64_t)n, bs, false), &pblk);
+            gu_mutex_unlock(&ip->map_lock);
+        }
+        if (n < 0) { rc = (int)n; break; }
+        if (run_len && (uint64_t)run_at + run_len != pblk) {
+            if ((rc = put_run(ip->fs, run_at, run_src, run_len)) != 0) break;
+            run_src += run_len * bs;
+            run_len = 0;
+        }
+        if (!run_len) run_at = pblk;
+        run_len += (uint64_t)n;
+        lblk += (uint64_t)n;
+        src += (uint64_t)n * bs;
+        nblk -= (uint64_t)n;
+    }
+    if (rc == 0 && run_len) rc = put_run(ip->fs, run_at, run_src, run_len);
+    gu_mutex_lock(&ip->map_lock);
+    int src_rc = ind_sync(ip);
+    gu_mutex_unlock(&ip->map_lock);
+    return rc ? rc : src_rc;
+}
+
+/* On-disk size of a regular file; past 2 GiB that takes large_file. */
+static int set_size(ext2_inode_priv_t *ip, uint64_t size) {
+    ext2_fs_t *fs = ip->fs;
+    if (size > 0x7fffffffu && !(fs->sb.s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_LARGE_FILE)) {
+        if (fs->sb.s_rev_level < 1) return -EFBIG;
+        fs->sb.s_feature_ro_compat |= EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+        fs->sb_dirty = true;
+    }
+    ip->di.i_size    = (uint32_t)size;
+    ip->di.i_dir_acl = (uint32_t)(size >> 32);
+    return 0;
+}
+
+/* Data up to 'end' is on disk: size, times and block map follow it. */
+static int commit_inode(ext2_inode_priv_t *ip, uint64_t end) {
+    if (end > inode_size_of(&ip->di)) {
+        int rc = set_size(ip, end);
+        if (rc) return rc;
+    }
+    ip->di.i_mtime = ip->di.i_ctime = (uint32_t)time(NULL);
+    return write_inode(ip->fs, ip->ino, &ip->di, false);
+}
+
+/* [pos, pos+n) of the write buffer from what the disk holds there: the
+   file's data below its on-disk size, zeros past it. */
+static int wbuf_fill(ext2_inode_priv_t *ip, uint64_t pos, uint64_t n) {
+    uint8_t *dst = ip->wbuf + (pos - ip->wpos);
+    const uint64_t dsize = inode_size_of(&ip->di);
+    const uint64_t disk = pos >= dsize ? 0 : (n < dsize - pos ? n : dsize - pos);
+    if (disk) {
+        int rc = read_range(ip, pos, dst, (size_t)disk);
+        if (rc) return rc;
+    }
+    memset(dst + disk, 0, (size_t)(n - disk));
+    return 0;
+}
+
+/* Write what is buffered out as whole blocks (completing the last one from
+   disk), then the inode. */
+static int wbuf_flush(ext2_inode_priv_t *ip) {
+    if (!ip->wlen) return 0;
+    const uint32_t bs = ip->fs->block_size;
+    const uint64_t end = ip->wpos + ip->wlen;
+    const uint32_t tail = (uint32_t)((bs - end % bs) % bs);
+    int rc = wbuf_fill(ip, end, tail);
+    if (rc == 0) rc = write_blocks(ip, ip->wpos / bs, ip->wbuf, ((uint64_t)ip->wlen + tail) / bs);
+    ip->wlen = 0;
+    if (rc == 0) rc = commit_inode(ip, end);
+    return rc;
+}
+
+/* Buffered bytes of [pos, pos+n) over what read_range got from disk. */
+static void wbuf_overlay(const ext2_inode_priv_t *ip, uint64_t pos, uint8_t *dst, size_t n) {
+    if (!ip->wlen) return;
+    const uint64_t lo = pos > ip->wpos ? pos : ip->wpos;
+    const uint64_t hi = pos + n < ip->wpos + ip->wlen ? pos + n : ip->wpos + ip->wlen;
+    if (lo < hi) memcpy(dst + (lo - pos), ip->wbuf + (lo - ip->wpos), (size_t)(hi - lo));
+}
+
+/* Blocks freed by a truncate, handed back a contiguous run at a time. */
+typedef struct ext2_freer {
+    ext2_fs_t *fs;
+    uint32_t   first, n;
+    uint64_t   freed;
+    int        rc;
+} ext2_freer_t;
+
+static void freer_flush(ext2_freer_t *fr) {
+    if (fr->n && fr->rc == 0) fr->rc = free_blocks(fr->fs, fr->first, fr->n);
+    fr->n = 0;
+}
+
+static void freer_put(ext2_freer_t *fr, uint32_t blk) {
+    fr->freed++;
+    if (fr->n && fr->first + fr->n == blk) { fr->n++; return; }
+    freer_flush(fr);
+    fr->first = blk;
+    fr->n = 1;
+}
+
+/* Free what indirect block blk (level 1-3) maps at or past its relative
+   block 'from'. The block itself is the caller's; it is rewritten when some
+   of it stays. */
+static int trunc_tree(ext2_inode_priv_t *ip, ext2_freer_t *fr, uint32_t blk, unsigned level, uint64_t from) {
+    const uint32_t apb = ip->fs->addr_per_block;
+    uint32_t *tab = (uint32_t*)malloc(ip->fs->block_size);
+    if (!tab) return -ENOMEM;
+    if (!meta_read(ip->fs, blk, 0, tab, ip->fs->block_size)) { free(tab); return -EIO; }
+    uint64_t per = 1;
+    for (unsigned k = 1; k < level; ++k) per *= apb;
+
+    int rc = 0;
+    for (uint64_t s = from / per; s < apb && rc == 0; ++s) {
+        const uint32_t child = tab[s];
+        if (!child) continue;
+        const uint64_t rel = s * per;
+        if (level > 1 && rel < from) { rc = trunc_tree(ip, fr, child, level - 1, from - rel); continue; }
+        if (level > 1 && (rc = trunc_tree(ip, fr, child, level - 1, 0)) != 0) break;
+        freer_put(fr, child);
+        tab[s] = 0;
+    }
+    if (rc == 0 && from && !meta_write(ip->fs, blk, 0, tab, ip->fs->block_size)) rc = -EIO;
+    free(tab);
+    return rc;
+}
+
+/* Free every block from logical block 'keep' on, indirect blocks included. */
+static int free_from(ext2_inode_priv_t *ip, uint64_t keep) {
+    const uint64_t apb = ip->fs->addr_per_block;
+    ext2_freer_t fr = { .fs = ip->fs };
+    int rc = 0;
+    for (uint64_t i = keep; i < EXT2_NDIR_BLOCKS; ++i)
+        if (ip->di.i_block[i]) { freer_put(&fr, ip->di.i_block[i]); ip->di.i_block[i] = 0; }
+    uint64_t base = EXT2_NDIR_BLOCKS, span = apb;
+    for (unsigned d = 0; d < 3 && rc == 0; ++d, base += span, span *= apb) {
+        const uint32_t blk = ip->di.i_block[EXT2_IND_BLOCK + d];
+        if (!blk || keep >= base + span) continue;
+        if (keep > base) { rc = trunc_tree(ip, &fr, blk, d + 1, keep - base); continue; }
+        if ((rc = trunc_tree(ip, &fr, blk, d + 1, 0)) != 0) break;
+        freer_put(&fr, blk);
+        ip->di.i_block[EXT2_IND_BLOCK + d] = 0;
+    }
+    freer_flush(&fr);
+    const uint64_t dec = fr.freed * (ip->fs->block_size / 512u);
+    ip->di.i_blocks = dec < ip->di.i_blocks ? ip->di.i_blocks - (uint32_t)dec : 0;
+    return rc ? rc : fr.rc;
+}
+
 /* -------- super_ops -------- */
 static int s_statfs(struct superblock *sb, struct g_statvfs *sv) {
-    (void)sb;
-    if (!sv) return -1;
+    ext2_fs_t *fs = sb ? (ext2_fs_t*)sb->fs_private : NULL;
+    if (!fs || !sv) return -1;
     memset(sv, 0, sizeof *sv);
-    sv->f_bsize  = 4096;
-    sv->f_frsize = 4096;
+    const ext2_superblock *s = &fs->sb;
+    sv->f_bsize  = fs->block_size;
+    sv->f_frsize = fs->block_size;
+    sv->f_blocks = s->s_blocks_count;
+    sv->f_bfree  = s->s_free_blocks_count;
+    sv->f_bavail = s->s_free_blocks_count > s->s_r_blocks_count
+                 ? s->s_free_blocks_count - s->s_r_blocks_count : 0;
+    sv->f_files  = s->s_inodes_count;
+    sv->f_ffree  = s->s_free_inodes_count;
+    sv->f_favail = s->s_free_inodes_count;
     sv->f_namemax = 255;
     return 0;
 }
-static int s_syncfs(struct superblock *sb) { (void)sb; return 0; }
+static int s_syncfs(struct superblock *sb) {
+    ext2_fs_t *fs = sb ? (ext2_fs_t*)sb->fs_private : NULL;
+    const char *key = ext2_devkey(fs);
+    if (!key) return 0;
+    int rc = txn_commit(fs);
+    int rs = diskio_sync(key);
+    return rc ? rc : rs;
+}
+static void s_evict_inode(struct inode *ino) {
+    if (!ino) return;
+    priv_free((ext2_inode_priv_t*)ino->i_private);
+    ino->i_private = NULL;
+}
 static void s_kill_sb(struct superblock *sb) {
     if (!sb) return;
-    if (sb->root) {
-        ext2_inode_priv_t *ip = (ext2_inode_priv_t*)sb->root->i_private;
-        if (ip) { free(ip->rel); free(ip); }
-        free(sb->root);
-    }
+    vfs_iput(sb->root);
+    sb->root = NULL;
+    vfs_evict_inodes(sb);
     ext2_fs_t *fs = (ext2_fs_t*)sb->fs_private;
-    ext2_dirs_free(fs);
-    free(fs);
-    free(sb);
+    if (fs) (void)txn_commit(fs);      /* normally done already by the syncfs before */
+    fs_free(fs);
+    vfs_free_sb(sb);
 }
 
 /* -------- forward decl for i_open so we can reference it in file_ops -------- */
 static int i_open(struct inode *ino, struct file **out, int flags, uint32_t mode);
 
-/* -------- file_ops (write path; no read yet) -------- */
+/* -------- file_ops -------- */
 static int f_release(struct file *f) {
     if (!f) return 0;
     ext2_file_priv_t *fp = (ext2_file_priv_t*)f->private_data;
     if (fp) {
-        if (fp->node && fp->node->rel) {
-            (void)ext2_create_and_write(fp->node->rel, fp->buf, (uint32_t)fp->len);
+        ext2_inode_priv_t *ip = fp->node;
+        if (fp->writing && ip && --ip->writers == 0) {          /* last writer: sb lock exclusive */
+            int rc = wbuf_flush(ip);
+            if (rc == 0) rc = txn_end(ip->fs);
+            if (rc != 0) fprintf(stderr, "ext2: write-back of '%s' failed (%d)\n", ip->rel, rc);
+            free(ip->wbuf);
+            ip->wbuf = NULL;
         }
-        free(fp->buf);
-        free(fp);
+        vfs_slab_free(fp);
     }
-    free(f);
+    vfs_free_file(f);
     return 0;
 }
+/* Writes collect in the inode's buffer until it is full or one lands
+   outside it; a write of at least a buffer's worth that starts on a block
+   boundary goes straight to disk instead. */
 static ssize_t f_write(struct file *f, const void *buf, size_t n, uint64_t *pos) {
-    (void)pos; /* append-only buffer for now */
     ext2_file_priv_t *fp = (ext2_file_priv_t*)f->private_data;
-    if (!fp || !buf) return -1;
-    if (fp->len + n > fp->cap) {
-        size_t nc = fp->cap ? fp->cap * 2 : 4096;
-        while (nc < fp->len + n) nc *= 2;
-        uint8_t *nb = (uint8_t*)realloc(fp->buf, nc);
-        if (!nb) return -1;
-        fp->buf = nb; fp->cap = nc;
-    }
-    memcpy(fp->buf + fp->len, buf, n);
-    fp->len += n;
-    return (ssize_t)n;
+    if (!fp || !buf || !pos || !fp->writing) return -1;
+    ext2_inode_priv_t *ip = fp->node;
+    inode_t *inode = f->f_inode;
+    const uint32_t bs = ip->fs->block_size;
+    const uint64_t start = (f->f_flags & VFS_O_APPEND) ? inode->i_size : *pos;
+    if (start > UINT64_MAX - n) return -EFBIG;
+
+    const uint8_t *src = (const uint8_t*)buf;
+    uint64_t at = start;
+    size_t left = n;
+    int rc = 0;
+    while (left && rc == 0) {
+        if (ip->wlen && (at < ip->wpos || at > ip->wpos + ip->wlen || at - ip->wpos >= EXT2_WBUF_BYTES)) {
+            rc = wbuf_flush(ip);
+            continue;
+        }
+        if (!ip->wlen && at % bs == 0 && left >= EXT2_WBUF_BYTES) {
+            const uint64_t nblk = (left < (1u << 30) ? left : (1u << 30)) / bs;
+            if ((rc = write_blocks(ip, at / bs, src, nblk)) == 0) rc = commit_inode(ip, at + nblk * bs);
+            if (rc) break;
+            at += nblk * bs; src += nblk * bs; left -= (size_t)(nblk * bs);
+            continue;
+        }
+        if (!ip->wlen) {                        /* start the buffer on the block 'at' is in */
+            if (!ip->wbuf && !(ip->wbuf = (uint8_t*)malloc(EXT2_WBUF_BYTES))) { rc = -ENOMEM; break; }
+            ip->wpos = at - at % bs;
+            if ((rc = wbuf_fill(ip, ip->wpos, at - ip->wpos)) != 0) break;
+            ip->wlen = (uint32_t)(at - ip->wpos);
+        }
+        const uint32_t in = (uint32_t)(at - ip->wpos);
+        const size_t take = left < EXT2_WBUF_BYTES - in ? left : EXT2_WBUF_BYTES - in;
+        memcpy(ip->wbuf + in, src, take);
+        if (in + take > ip->wlen) ip->wlen = in + (uint32_t)take;
+        at += take; src += take; left -= take;
+        if (ip->wlen == EXT2_WBUF_BYTES) rc = wbuf_flush(ip);
+    }
+    if (rc == 0) rc = txn_end(ip->fs);
+
+    const size_t done = n - left;
+    if (done == 0 && rc) return rc;
+    if (at > inode->i_size) inode->i_size = at;
+    /* the VFS drops cached pages from *pos; an append wrote elsewhere */
+    if (start != *pos) vfs_pagecache_invalidate(inode, start, done);
+    *pos = at;
+    return (ssize_t)done;
 }
+/* Uncached read: the on-disk blocks, with anything still buffered on top. */
 static ssize_t f_read(struct file *f, void *buf, size_t n, uint64_t *pos) {
-    (void)f; (void)buf; (void)n; (void)pos;
-    return -1; /* not implemented yet */
+    ext2_file_priv_t *fp = (ext2_file_priv_t*)f->private_data;
+    if (!fp || !buf || !pos) return -1;
+    const uint64_t size = f->f_inode->i_size;
+    if (*pos >= size) return 0;
+    if (n > size - *pos) n = (size_t)(size - *pos);
+    int rc = read_range(fp->node, *pos, (uint8_t*)buf, n);
+    if (rc) return rc;
+    wbuf_overlay(fp->node, *pos, (uint8_t*)buf, n);
+    *pos += n;
+    return (ssize_t)n;
+}
+/* Push out the write buffer and the allocation state, then everything the
+   block cache holds. */
+static int f_fsync(struct file *f) {
+    ext2_file_priv_t *fp = f ? (ext2_file_priv_t*)f->private_data : NULL;
+    if (!fp || !fp->node) return 0;
+    int rc = wbuf_flush(fp->node);
+    if (rc == 0) rc = txn_commit(fp->node->fs);
+    if (rc) return rc;
+    const char *key = ext2_devkey(fp->node->fs);
+    return key ? diskio_sync(key) : 0;
 }
-static int f_fsync(struct file *f) { (void)f; return 0; }
 static int f_ioctl(struct file *f, unsigned long c, void *a) { (void)f;(void)c;(void)a; return -1; }
+/* First offset at or after off that is data (want_data) or hole, walking
+   the block map; bytes still in the write buffer count as data. A hole
+   search that finds none stops at i_size. */
+static int seek_data_hole(struct file *f, uint64_t off, bool want_data, uint64_t *newpos) {
+    ext2_inode_priv_t *ip = (ext2_inode_priv_t*)f->f_inode->i_private;
+    const uint64_t size = f->f_inode->i_size;
+    if (!ip || off >= size) return -ENXIO;
+    if (ip->is_dir) { *newpos = want_data ? off : size; return 0; }
+
+    const uint32_t bs = ip->fs->block_size;
+    const uint64_t last = (size - 1) / bs;
+    const uint64_t wlo = ip->wlen ? ip->wpos / bs : 1, whi = ip->wlen ? (ip->wpos + ip->wlen - 1) / bs : 0;
+    uint64_t lblk = off / bs;
+    while (lblk <= last) {
+        if (lblk >= wlo && lblk <= whi) {
+            if (want_data) break;
+            lblk = whi + 1;
+            continue;
+        }
+        uint64_t max = last - lblk + 1;
+        if (lblk < wlo && wlo - lblk < max) max = wlo - lblk;
+        uint32_t pblk = 0;
+        int64_t n = bmap_run(ip, lblk, max, &pblk);
+        if (n < 0) return (int)n;
+        if (n == 0) break;
+        if ((pblk != 0) == want_data) break;
+        lblk += (uint64_t)n;
+    }
+    if (lblk > last) {
+        if (want_data) return -ENXIO;
+        *newpos = size;
+        return 0;
+    }
+    *newpos = lblk * bs > off ? lblk * bs : off;
+    return 0;
+}
+
 static int f_llseek(struct file *f, int64_t off, int whence, uint64_t *newpos) {
-    (void)f; (void)off; (void)whence; if (newpos) *newpos = 0; return 0;
+    ext2_file_priv_t *fp = (ext2_file_priv_t*)f->private_data;
+    if (!fp || !newpos) return -EINVAL;
+    int64_t base;
+    switch (whence) {
+    case VFS_SEEK_SET: base = 0; break;
+    case VFS_SEEK_CUR: base = (int64_t)f->f_pos; break;
+    case VFS_SEEK_END: base = (int64_t)f->f_inode->i_size; break;
+    case VFS_SEEK_DATA:
+    case VFS_SEEK_HOLE:
+        if (off < 0) return -ENXIO;
+        return seek_data_hole(f, (uint64_t)off, whence == VFS_SEEK_DATA, newpos);
+    default: return -EINVAL;
+    }
+    if (base + off < 0) return -EINVAL;
+    *newpos = (uint64_t)(base + off);
+    return 0;
+}
+/* Blocks for the holes of [off, off+len), zeroed on the image, and i_size
+   grown to cover the range. Buffered data goes out first so it is not
+   written over what lands in the new blocks. */
+static int f_fallocate(struct file *f, uint64_t off, uint64_t len) {
+    ext2_file_priv_t *fp = (ext2_file_priv_t*)f->private_data;
+    if (!fp || !fp->writing) return -EBADF;
+    ext2_inode_priv_t *ip = fp->node;
+    const char *key = ext2_devkey(ip->fs);
+    if (!key) return -EIO;
+    int rc = wbuf_flush(ip);
+    const uint32_t bs = ip->fs->block_size;
+    const uint64_t last = (off + len - 1) / bs;
+    uint64_t lblk = off / bs;
+    while (rc == 0 && lblk <= last) {
+        uint32_t pblk = 0;
+        int64_t n = bmap_run(ip, lblk, last - lblk + 1, &pblk);
+        if (n > 0 && !pblk) {
+            gu_mutex_lock(&ip->map_lock);
+            n = alloc_map(ip, lblk, (uint64_t)n, &pblk);
+            gu_mutex_unlock(&ip->map_lock);
+            if (n > 0 && !diskio_zero_range(key, ip->fs->off + (uint64_t)pblk * bs, (uint64_t)n * bs)) n = -EIO;
+        }
+        if (n <= 0) rc = n ? (int)n : -EIO;
+        else lblk += (uint64_t)n;
+    }
+    gu_mutex_lock(&ip->map_lock);
+    int ind_rc = ind_sync(ip);
+    gu_mutex_unlock(&ip->map_lock);
+    if (rc == 0) rc = ind_rc;
+    if (rc == 0) rc = commit_inode(ip, off + len);
+    if (rc == 0) rc = txn_end(ip->fs);
+    if (rc == 0 && off + len > f->f_inode->i_size) f->f_inode->i_size = off + len;
+    return rc;
+}
+/* One extent per physically contiguous run of mapped blocks; blocks still
+   in the write buffer are reported as one EXTENT_UNKNOWN piece. */
+static int f_fiemap(struct file *f, uint64_t start, uint64_t len,
+                    vfs_extent_t *ext, unsigned max, unsigned *count) {
+    if (!f || !ext || !count) return -EINVAL;
+    *count = 0;
+    ext2_inode_priv_t *ip = (ext2_inode_priv_t*)f->f_inode->i_private;
+    if (!ip || ip->is_dir) return -EISDIR;
+    const uint64_t size = f->f_inode->i_size;
+    if (max == 0 || start >= size) return 0;
+
+    const uint32_t bs = ip->fs->block_size;
+    const uint64_t end = (len && len < size - start) ? start + len : size;
+    const uint64_t last = (size - 1) / bs;
+    const uint64_t wlo = ip->wlen ? ip->wpos / bs : 1, whi = ip->wlen ? (ip->wpos + ip->wlen - 1) / bs : 0;
+    uint64_t lblk = start / bs;
+    while (lblk <= (end - 1) / bs && *count < max) {
+        if (lblk >= wlo && lblk <= whi) {       /* still in the write buffer: not on disk yet */
+            vfs_extent_t *e = &ext[(*count)++];
+            e->fe_logical  = lblk * bs;
+            e->fe_physical = 0;
+            e->fe_length   = (whi + 1 - lblk) * bs;
+            if (e->fe_length > size - e->fe_logical) e->fe_length = size - e->fe_logical;
+            e->fe_flags    = VFS_FIEMAP_EXTENT_UNKNOWN;
+            lblk = whi + 1;
+            continue;
+        }
+        uint64_t want = last - lblk + 1;
+        if (lblk < wlo && wlo - lblk < want) want = wlo - lblk;
+        uint32_t pblk = 0;
+        int64_t cnt = bmap_run(ip, lblk, want, &pblk);
+        if (cnt < 0) return *count ? 0 : (int)cnt;
+        if (pblk) {
+            vfs_extent_t *e = &ext[(*count)++];
+            e->fe_logical  = lblk * bs;
+            e->fe_physical = (uint64_t)pblk * bs;
+            e->fe_length   = (uint64_t)cnt * bs;
+            if (e->fe_length > size - e->fe_logical) e->fe_length = size - e->fe_logical;
+            e->fe_flags    = 0;
+        }
+        lblk += (uint64_t)cnt;
+    }
+    if (*count && lblk > last) ext[*count - 1].fe_flags |= VFS_FIEMAP_EXTENT_LAST;
+    return 0;
 }
 
 static const file_ops_t EXT2_FOPS_FILE = {
-    .open    = i_open,     /* <- now wired, removes 'i_open unused' warning */
+    .open    = i_open,
     .release = f_release,
     .read    = f_read,
     .write   = f_write,
     .fsync   = f_fsync,
     .ioctl   = f_ioctl,
     .llseek  = f_llseek,
-    .getdents64 = NULL,    /* no readdir yet */
+    .fiemap  = f_fiemap,
+    .fallocate = f_fallocate,
 };
 
+/* -------- address_space_ops -------- */
+static int ext2_readpages(struct inode *inode, vfs_page_t **pages, unsigned n) {
+    if (!inode || !pages || n == 0) return -EINVAL;
+    ext2_inode_priv_t *ip = (ext2_inode_priv_t*)inode->i_private;
+    if (!ip) return -EINVAL;
+
+    const uint64_t start = pages[0]->index << VFS_PAGE_SHIFT;
+    uint64_t len = (uint64_t)n * VFS_PAGE_SIZE;
+    if (start >= inode->i_size) len = 0;
+    else if (len > inode->i_size - start) len = inode->i_size - start;
+
+    uint8_t *tmp = NULL;
+    if (len) {
+        tmp = (uint8_t*)malloc((size_t)len);
+        if (!tmp) return -ENOMEM;
+        int rc = read_range(ip, start, tmp, (size_t)len);
+        if (rc) { free(tmp); return rc; }
+        wbuf_overlay(ip, start, tmp, (size_t)len);
+    }
+
+    for (unsigned i = 0; i < n; ++i) {
+        uint64_t at = (uint64_t)i * VFS_PAGE_SIZE;
+        size_t take = (at < len) ? (size_t)(len - at) : 0;
+        if (take > VFS_PAGE_SIZE) take = VFS_PAGE_SIZE;
+        if (take) memcpy(pages[i]->data, tmp + at, take);
+        if (take < VFS_PAGE_SIZE) memset(pages[i]->data + take, 0, VFS_PAGE_SIZE - take);
+    }
+    free(tmp);
+    return 0;
+}
+
+static int ext2_readpage(struct inode *inode, vfs_page_t *pg) {
+    return ext2_readpages(inode, &pg, 1);
+}
+
+static const address_space_ops_t EXT2_AOPS = {
+    .readpage  = ext2_readpage,
+    .readpages = ext2_readpages,
+};
+
+/* -------- directories -------- */
+#define EXT2_DX_MAX_LEAVES 8    /* leaves scanned for one hash collision chain */
+
+static inline uint32_t dirent_rec_len(const ext2_dirent *de, uint32_t bs) {
+    uint32_t len = de->rec_len;
+    return (bs >= 65536 && (len == 0 || len == 65535)) ? 65536 : len;   /* 64 KiB blocks */
+}
+
+/* Record at *off in a directory block, or NULL at the end of the block or at
+   a malformed record (the rest of that block is then skipped). Advances *off. */
+static const ext2_dirent *dirent_next(const uint8_t *blk, uint32_t bs, uint32_t *off) {
+    if (*off + 8 > bs) return NULL;
+    const ext2_dirent *de = (const ext2_dirent*)(blk + *off);
+    const uint32_t rl = dirent_rec_len(de, bs);
+    if (rl < 8 || (rl & 3) || rl > bs - *off || 8u + de->name_len > rl) return NULL;
+    *off += rl;
+    return de;
+}
+
+static inline uint8_t dirent_dtype(const ext2_fs_t *fs, const ext2_dirent *de) {
+    static const uint8_t k_dtype[8] = {
+        VFS_DT_UNKNOWN, VFS_DT_REG, VFS_DT_DIR, VFS_DT_CHR,
+        VFS_DT_BLK, VFS_DT_FIFO, VFS_DT_SOCK, VFS_DT_LNK,
+    };
+    return (fs->filetype && de->file_type < 8) ? k_dtype[de->file_type] : VFS_DT_UNKNOWN;
+}
+
+/* Logical block lblk of a directory, through the page cache. */
+static int dir_read_block(inode_t *dir, uint64_t lblk, uint8_t *dst) {
+    const uint32_t bs = ((ext2_inode_priv_t*)dir->i_private)->fs->block_size;
+    ssize_t r = vfs_pagecache_read(dir, dst, bs, lblk * bs);
+    return r == (ssize_t)bs ? 0 : (r < 0 ? (int)r : -EIO);
+}
+
+/* f_pos is the byte offset of the next record in the directory. */
+static ssize_t d_getdents64(struct file *dirf, void *buf, size_t bytes) {
+    if (!dirf || !buf) return -EINVAL;
+    inode_t *dir = dirf->f_inode;
+    ext2_inode_priv_t *dp = (ext2_inode_priv_t*)dir->i_private;
+    if (!dp || !dp->is_dir) return -ENOTDIR;
+    const uint32_t bs = dp->fs->block_size;
+    uint8_t *blk = (uint8_t*)malloc(bs);
+    if (!blk) return -ENOMEM;
+
+    uint64_t pos = dirf->f_pos;
+    size_t out = 0;
+    bool full = false;
+    int rc = 0;
+    while (!full && pos < dir->i_size) {
+        const uint64_t base = pos - pos % bs;
+        if ((rc = dir_read_block(dir, pos / bs, blk)) != 0) break;
+        for (uint32_t off = 0;;) {
+            const uint32_t at = off;
+            const ext2_dirent *de = dirent_next(blk, bs, &off);
+            if (!de) break;
+            if (base + at < pos || !de->inode) continue;
+
+            const size_t nlen = de->name_len;
+            const size_t reclen = (offsetof(vfs_dirent64_t, d_name) + nlen + 1 + 7u) & ~(size_t)7u;
+            if (out + reclen > bytes) { full = true; pos = base + at; break; }
+            vfs_dirent64_t *o = (vfs_dirent64_t*)((uint8_t*)buf + out);
+            o->d_ino    = de->inode;
+            o->d_off    = (int64_t)(base + off);
+            o->d_reclen = (uint16_t)reclen;
+            o->d_type   = dirent_dtype(dp->fs, de);
+            memcpy(o->d_name, de->name, nlen);
+            o->d_name[nlen] = '\0';
+            out += reclen;
+        }
+        if (!full) pos = base + bs;
+    }
+    free(blk);
+    if (out == 0 && (rc || full)) return rc ? rc : -EINVAL;
+    dirf->f_pos = pos;
+    return (ssize_t)out;
+}
+
+static const file_ops_t EXT2_FOPS_DIR = {
+    .open       = i_open,
+    .release    = f_release,
+    .getdents64 = d_getdents64,
+};
+
+/* Every record of the directory into its name index (vfs_dindex.c). */
+static int dir_index_fill(inode_t *dir, vfs_dindex_t *dx) {
+    ext2_inode_priv_t *dp = (ext2_inode_priv_t*)dir->i_private;
+    const uint32_t bs = dp->fs->block_size;
+    uint8_t *blk = (uint8_t*)malloc(bs);
+    if (!blk) return -ENOMEM;
+    int rc = 0;
+    for (uint64_t lblk = 0; rc == 0 && lblk < dir->i_size / bs; ++lblk) {
+        if ((rc = dir_read_block(dir, lblk, blk)) != 0) break;
+        for (uint32_t off = 0;;) {
+            const ext2_dirent *de = dirent_next(blk, bs, &off);
+            if (!de) break;
+            if (!de->inode) continue;
+            const vfs_dentry_info_t info = {
+                .ino = de->inode, .mode = (uint32_t)dirent_dtype(dp->fs, de) << 12,
+            };
+            if ((rc = vfs_dindex_add(dx, de->name, de->name_len, &info)) != 0) break;
+        }
+    }
+    free(blk);
+    return rc;
+}
+
+/* Look name up through the directory's htree: one block per index level,
+   then the leaf (and the leaves that continue a hash collision). -EAGAIN if
+   the tree is not one we can use, so the caller indexes the whole directory. */
+static int dx_lookup(inode_t *dir, const char *name, size_t nlen, uint8_t *blk, uint32_t *ino) {
+    const ext2_fs_t *fs = ((ext2_inode_priv_t*)dir->i_private)->fs;
+    const uint32_t bs = fs->block_size;
+    int rc = dir_read_block(dir, 0, blk);
+    if (rc) return rc;
+
+    const ext2_dx_root_info info = *(const ext2_dx_root_info*)(blk + 24);
+    if (info.reserved_zero || info.info_length < 8 || info.indirect_levels > 1) return -EAGAIN;
+    unsigned version = info.hash_version;
+    if (version <= EXT2_DX_HASH_TEA && (fs->sb.s_flags & EXT2_FLAGS_UNSIGNED_HASH)) version += 3;
+    uint32_t seed[4], hash;
+    memcpy(seed, fs->sb.s_hash_seed, sizeof seed);
+    if (!ext2_dirhash(name, nlen, version, seed, &hash)) return -EAGAIN;
+
+    uint32_t leaves[EXT2_DX_MAX_LEAVES];
+    unsigned nleaves = 0;
+    uint32_t off = 24u + info.info_length;
+    for (unsigned level = 0;; ++level) {
+        const ext2_dx_countlimit *cl = (const ext2_dx_countlimit*)(blk + off);
+        const ext2_dx_entry *e = (const ext2_dx_entry*)(blk + off);
+        if (cl->count == 0 || cl->count > cl->limit || off + cl->limit * 8u > bs) return -EAGAIN;
+
+        int lo = 1, hi = (int)cl->count - 1, at = 0;      /* last entry with hash <= ours */
+        while (lo <= hi) {
+            const int mid = lo + (hi - lo) / 2;
+            if (e[mid].hash > hash) hi = mid - 1;
+            else { at = mid; lo = mid + 1; }
+        }
+        if (level == info.indirect_levels) {
+            leaves[nleaves++] = e[at].block & 0x0fffffffu;
+            for (int k = at + 1; k < (int)cl->count && nleaves < EXT2_DX_MAX_LEAVES &&
+                                 (e[k].hash & 1u) && (e[k].hash & ~1u) == hash; ++k)
+                leaves[nleaves++] = e[k].block & 0x0fffffffu;
+            break;
+        }
+        if ((rc = dir_read_block(dir, e[at].block & 0x0fffffffu, blk)) != 0) return rc;
+        off = 8;                /* past the empty record that hides an index node */
+    }
+
+    for (unsigned i = 0; i < nleaves; ++i) {
+        if ((uint64_t)leaves[i] * bs >= dir->i_size) return -EAGAIN;
+        if ((rc = dir_read_block(dir, leaves[i], blk)) != 0) return rc;
+        for (uint32_t o = 0;;) {
+            const ext2_dirent *de = dirent_next(blk, bs, &o);
+            if (!de) break;
+            if (de->inode && de->name_len == nlen && memcmp(de->name, name, nlen) == 0) {
+                *ino = de->inode;
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Inode number of name in dir; *ino stays 0 if it is not there. */
+static int dir_find(inode_t *dir, const char *name, uint32_t *ino) {
+    ext2_inode_priv_t *dp = (ext2_inode_priv_t*)dir->i_private;
+    const size_t nlen = strlen(name);
+    *ino = 0;
+    if (nlen == 0 || nlen > 255) return 0;
+
+    /* "." and ".." sit in block 0, outside the hashed leaves */
+    const bool dot = name[0] == '.' && (nlen == 1 || (nlen == 2 && name[1] == '.'));
+    if (dp->fs->dir_index && (dp->di.i_flags & EXT2_INDEX_FL) && !dot) {
+        uint8_t *blk = (uint8_t*)malloc(dp->fs->block_size);
+        if (!blk) return -ENOMEM;
+        int rc = dx_lookup(dir, name, nlen, blk, ino);
+        free(blk);
+        if (rc != -EAGAIN) return rc;
+        DBG("ext2: htree of '%s' not usable, indexing it instead", dp->rel);
+    }
+
+    vfs_dentry_info_t info;
+    int rc = vfs_dindex_lookup(dir, name, 0, dir_index_fill, &info);
+    if (rc < 0) return rc;
+    if (rc) *ino = (uint32_t)info.ino;
+    return 0;
+}
+
 /* -------- inode_ops -------- */
+static const inode_ops_t EXT2_IOPS;
+
+/* Fill a new VFS inode from on-disk inode 'ino'. */
+static int inode_fill(inode_t *inode, ext2_fs_t *fs, uint32_t ino, const char *rel) {
+    ext2_inode di;
+    int rc = read_inode(fs, ino, &di);
+    if (rc) return rc;
+    if (di.i_mode == 0 || di.i_links_count == 0) return -ENOENT;    /* freed inode */
+
+    const bool dir = VFS_S_ISDIR(di.i_mode);
+    ext2_inode_priv_t *ip = priv_new(inode->i_sb, fs, rel, dir);
+    if (!ip) return -ENOMEM;
+    ip->ino = ino;
+    ip->di  = di;
+
+    inode->i_mode  = di.i_mode;
+    inode->i_uid   = di.i_uid;
+    inode->i_gid   = di.i_gid;
+    inode->i_size  = inode_size_of(&di);
+    inode->i_atime = di.i_atime;
+    inode->i_ctime = di.i_ctime;
+    inode->i_mtime = di.i_mtime;
+    inode->i_nlink = di.i_links_count;
+    inode->i_op    = &EXT2_IOPS;
+    inode->i_fop   = dir ? &EXT2_FOPS_DIR : &EXT2_FOPS_FILE;
+    if (dir || VFS_S_ISREG(di.i_mode)) inode->i_data.a_ops = &EXT2_AOPS;
+    inode->i_private = ip;
+    return 0;
+}
+
+static inline uint32_t dirent_size(size_t nlen) { return (uint32_t)(8u + nlen + 3u) & ~3u; }
+
+static inline void dirent_set_rec_len(ext2_dirent *de, uint32_t len) {
+    de->rec_len = (uint16_t)(len >= 65536 ? 65535 : len);
+}
+
+/* Link name -> ino into dir: into the first record with room to spare,
+   else a new block at its end. Keeps the directory's page cache and name
+   index current. */
+static int dir_add(inode_t *dir, const char *name, size_t nlen, uint32_t ino, uint8_t ftype) {
+    ext2_inode_priv_t *dp = (ext2_inode_priv_t*)dir->i_private;
+    ext2_fs_t *fs = dp->fs;
+    const uint32_t bs = fs->block_size;
+    const uint32_t need = dirent_size(nlen);
+    uint8_t *blk = (uint8_t*)malloc(bs);
+    if (!blk) return -ENOMEM;
+
+    /* the htree would need the name in its hash's leaf: go linear instead */
+    dp->di.i_flags &= ~EXT2_INDEX_FL;
+
+    /* start where the last name went, so filling a big directory does not
+       rescan its full blocks for every name */
+    int rc = 0;
+    const uint64_t nblk = dir->i_size / bs;
+    uint64_t lblk = 0;
+    ext2_dirent *slot = NULL;
+    for (uint64_t k = 0; k < nblk; ++k) {
+        lblk = (dp->add_hint + k) % nblk;
+        if ((rc = dir_read_block(dir, lblk, blk)) != 0) break;
+        for (uint32_t off = 0;;) {
+            const uint32_t at = off;
+            ext2_dirent *de = (ext2_dirent*)dirent_next(blk, bs, &off);
+            if (!de) break;
+            const uint32_t used = de->inode ? dirent_size(de->name_len) : 0;
+            if (off - at - used < need) continue;
+            if (used) {                         /* split the slack off the record */
+                ext2_dirent *ne = (ext2_dirent*)(blk + at + used);
+                dirent_set_rec_len(ne, off - at - used);
+                dirent_set_rec_len(de, used);
+                de = ne;
+            }
+            slot = de;
+            break;
+        }
+        if (slot) break;
+    }
+    if (rc == 0 && !slot) {                     /* full: one more block */
+        uint32_t pblk = 0;
+        lblk = dir->i_size / bs;
+        memset(blk, 0, bs);
+        slot = (ext2_dirent*)blk;
+        dirent_set_rec_len(slot, bs);
+        gu_mutex_lock(&dp->map_lock);
+        int64_t n = alloc_map(dp, lblk, 1, &pblk);
+        rc = n < 0 ? (int)n : ind_sync(dp);
+        gu_mutex_unlock(&dp->map_lock);
+        if (rc == 0) {
+            dp->di.i_size += bs;
+            dir->i_size += bs;
+        }
+    }
+    if (rc == 0) {
+        slot->inode     = ino;
+        slot->name_len  = (uint8_t)nlen;
+        slot->file_type = fs->filetype ? ftype : 0;
+        memcpy(slot->name, name, nlen);
+        uint32_t pblk = 0;
+        int64_t n = bmap_run(dp, lblk, 1, &pblk);
+        if (n < 0) rc = (int)n;
+        else if (!pblk || !meta_write(fs, pblk, 0, blk, bs)) rc = -EIO;
+    }
+    if (rc == 0) {
+        dp->di.i_mtime = dp->di.i_ctime = (uint32_t)time(NULL);
+        rc = write_inode(fs, dp->ino, &dp->di, false);
+    }
+    const vfs_dentry_info_t info = {
+        .ino = ino, .mode = rc == 0 ? (uint32_t)dirent_dtype(fs, slot) << 12 : 0,
+    };
+    free(blk);
+    if (rc) return rc;
+
+    dp->add_hint = (uint32_t)lblk;
+    vfs_pagecache_invalidate(dir, lblk * bs, bs);
+    vfs_dindex_insert(dir, name, &info);
+    dir->i_mtime = dp->di.i_mtime;
+    dir->i_ctime = dp->di.i_ctime;
+    return 0;
+}
+
 static int i_getattr(struct inode *ino, struct g_stat *st) {
     if (!ino || !st) return -1;
     memset(st, 0, sizeof *st);
     ext2_inode_priv_t *ip = (ext2_inode_priv_t*)ino->i_private;
-    st->st_mode = (ip && ip->is_dir) ? VFS_S_IFDIR : VFS_S_IFREG;
+    if (!ip) return -1;
+    st->st_ino     = ip->ino;
+    st->st_mode    = ip->di.i_mode;
+    st->st_nlink   = ip->di.i_links_count;
+    st->st_uid     = ip->di.i_uid;
+    st->st_gid     = ip->di.i_gid;
+    st->st_size    = ino->i_size;
+    st->st_blksize = ip->fs->block_size;
+    st->st_blocks  = ip->di.i_blocks;
+    if (ip->fs->huge_file) {                    /* l_i_blocks_hi, and maybe fs-block units */
+        st->st_blocks |= (uint64_t)(ip->di.i_osd2[0] | ip->di.i_osd2[1] << 8) << 32;
+        if (ip->di.i_flags & EXT4_HUGE_FILE_FL) st->st_blocks *= ip->fs->block_size / 512u;
+    }
+    st->st_atim.tv_sec = ip->di.i_atime;
+    st->st_mtim.tv_sec = ip->di.i_mtime;
+    st->st_ctim.tv_sec = ip->di.i_ctime;
     return 0;
 }
 
+/* A new directory: an inode in the parent's group (or the next with room),
+   one block holding "." and "..", and the parent's link count. */
 static int i_mkdir(struct inode *dir, const char *name, uint32_t mode) {
-    (void)mode; /* ext2 helpers ignore mode */
-    if (!dir || !name) return -1;
+    if (!dir || !name) return -EINVAL;
     ext2_inode_priv_t *dp = (ext2_inode_priv_t*)dir->i_private;
-    if (!dp || !dp->fs) return -1;
+    if (!dp || !dp->fs) return -EINVAL;
+    if (!dp->is_dir) return -ENOTDIR;
+    if (dp->fs->rdonly) return -EROFS;
+    const size_t nlen = strlen(name);
+    if (nlen == 0 || nlen > 255 || strchr(name, '/')) return -EINVAL;
+    if (dp->di.i_links_count >= EXT2_LINK_MAX) return -EMLINK;
 
-    char full[VFS_PATH_MAX];
-    join_relpath(dp->rel ? dp->rel : "", name, full, sizeof full);
+    uint32_t nr = 0;
+    int rc = dir_find(dir, name, &nr);
+    if (rc) return rc;
+    if (nr) return -EEXIST;
 
-    if (!ext2_mkdir_p(full)) return -1;
-    if (!ext2_dirs_add(dp->fs, full)) return -1;
-    return 0;
+    ext2_fs_t *fs = dp->fs;
+    const uint32_t bs = fs->block_size;
+    if ((rc = alloc_inode(fs, (dp->ino - 1) / fs->sb.s_inodes_per_group, true, &nr)) != 0) return rc;
+    uint32_t blk = 0;
+    const uint32_t g = (nr - 1) / fs->sb.s_inodes_per_group;
+    int64_t n = alloc_blocks(fs, fs->sb.s_first_data_block + g * fs->sb.s_blocks_per_group, 1, &blk);
+    if (n < 0) { free_inode(fs, nr, true); return (int)n; }
+
+    uint8_t *buf = (uint8_t*)calloc(1, bs);
+    if (!buf) rc = -ENOMEM;
+    else {
+        ext2_dirent *dot = (ext2_dirent*)buf;
+        dot->inode = nr;
+        dot->name_len = 1;
+        dot->file_type = fs->filetype ? EXT2_FT_DIR : 0;
+        dot->name[0] = '.';
+        dirent_set_rec_len(dot, dirent_size(1));
+        ext2_dirent *dotdot = (ext2_dirent*)(buf + dirent_size(1));
+        dotdot->inode = dp->ino;
+        dotdot->name_len = 2;
+        dotdot->file_type = dot->file_type;
+        memcpy(dotdot->name, "..", 2);
+        dirent_set_rec_len(dotdot, bs - dirent_size(1));
+        if (!meta_write(fs, blk, 0, buf, bs)) rc = -EIO;
+        free(buf);
+    }
+
+    ext2_inode di;
+    memset(&di, 0, sizeof di);
+    di.i_mode = (uint16_t)(VFS_S_IFDIR | ((mode & 07777) ? (mode & 07777) : 0755));
+    di.i_links_count = 2;
+    di.i_size = bs;
+    di.i_blocks = bs / 512u;
+    di.i_block[0] = blk;
+    di.i_atime = di.i_ctime = di.i_mtime = (uint32_t)time(NULL);
+    if (rc == 0) rc = write_inode(fs, nr, &di, true);
+    if (rc == 0) rc = dir_add(dir, name, nlen, nr, EXT2_FT_DIR);
+    if (rc) {
+        (void)free_blocks(fs, blk, 1);
+        free_inode(fs, nr, true);
+        return rc;
+    }
+    dp->di.i_links_count++;                     /* the new ".." */
+    if ((rc = write_inode(fs, dp->ino, &dp->di, false)) != 0) return rc;
+    dir->i_nlink = dp->di.i_links_count;
+    return txn_end(fs);
 }
 
-#if VFS_HAVE_CREATE_OP
 static int i_create(struct inode *dir, const char *name, uint32_t mode, struct inode **out) {
-    (void)mode;  /* permissions not enforced by helpers */
-    if (!out || !dir || !name) return -1;
+    if (!out || !dir || !name) return -EINVAL;
+    *out = NULL;
     ext2_inode_priv_t *dp = (ext2_inode_priv_t*)dir->i_private;
-    if (!dp || !dp->fs) return -1;
-
-    char full[VFS_PATH_MAX];
-    join_relpath(dp->rel ? dp->rel : "", name, full, sizeof full);
-
-    inode_t *ino = (inode_t*)calloc(1, sizeof *ino);
-    if (!ino) return -1;
+    if (!dp || !dp->fs) return -EINVAL;
+    if (!dp->is_dir) return -ENOTDIR;
+    if (dp->fs->rdonly) return -EROFS;
+    const size_t nlen = strlen(name);
+    if (nlen == 0 || nlen > 255 || strchr(name, '/')) return -EINVAL;
 
-    ext2_inode_priv_t *ip = (ext2_inode_priv_t*)calloc(1, sizeof *ip);
-    if (!ip) { free(ino); return -1; }
-    ip->fs = dp->fs;
-    ip->is_dir = false;
-    ip->rel = xstrdup(full);
-    if (!ip->rel) { free(ip); free(ino); return -1; }
+    uint32_t nr = 0;
+    int rc = dir_find(dir, name, &nr);
+    if (rc) return rc;
+    if (nr) return -EEXIST;
 
-    ino->i_ino = 0;
-    ino->i_mode = VFS_S_IFREG;
-    ino->i_sb   = dir->i_sb;
-    ino->i_op   = dir->i_op;
-    ino->i_fop  = &EXT2_FOPS_FILE;
-    ino->i_private = ip;
+    /* in the parent's group, so the file's blocks start out near it */
+    ext2_fs_t *fs = dp->fs;
+    if ((rc = alloc_inode(fs, (dp->ino - 1) / fs->sb.s_inodes_per_group, false, &nr)) != 0) return rc;
+    ext2_inode di;
+    memset(&di, 0, sizeof di);
+    di.i_mode = (uint16_t)(VFS_S_IFREG | ((mode & 07777) ? (mode & 07777) : 0644));
+    di.i_links_count = 1;
+    di.i_atime = di.i_ctime = di.i_mtime = (uint32_t)time(NULL);
+    if ((rc = write_inode(fs, nr, &di, true)) == 0)
+        rc = dir_add(dir, name, nlen, nr, EXT2_FT_REG_FILE);
+    if (rc) { free_inode(fs, nr, false); return rc; }
+    if ((rc = txn_end(fs)) != 0) return rc;
 
+    inode_t *ino = vfs_iget(dir->i_sb, nr);
+    if (!ino) return -ENOMEM;
+    if (ino->i_state & VFS_I_NEW) {
+        char full[VFS_PATH_MAX];
+        join_relpath(dp->rel ? dp->rel : "", name, full, sizeof full);
+        if ((rc = inode_fill(ino, fs, nr, full)) != 0) { vfs_iget_failed(ino); return rc; }
+        vfs_unlock_new_inode(ino);
+    }
     *out = ino;
     return 0;
 }
-#endif
 
 static int i_lookup(struct inode *dir, const char *name, struct inode **out) {
     if (out) *out = NULL;
     if (!dir || !name) return -1;
     ext2_inode_priv_t *dp = (ext2_inode_priv_t*)dir->i_private;
     if (!dp || !dp->fs) return -1;
+    if (!dp->is_dir) return -ENOTDIR;
 
-    char full[VFS_PATH_MAX];
-    join_relpath(dp->rel ? dp->rel : "", name, full, sizeof full);
+    uint32_t nr = 0;
+    int rc = dir_find(dir, name, &nr);
+    if (rc) return rc;
+    if (nr == 0) return 0;                      /* not found (ok for lookup) */
 
-    if (!ext2_dirs_has(dp->fs, full)) {
-        return 0; /* not found (ok for lookup) */
-    }
-
-    inode_t *ino = (inode_t*)calloc(1, sizeof *ino);
+    inode_t *ino = vfs_iget(dir->i_sb, nr);
     if (!ino) return -1;
-
-    ext2_inode_priv_t *ip = (ext2_inode_priv_t*)calloc(1, sizeof *ip);
-    if (!ip) { free(ino); return -1; }
-    ip->fs = dp->fs;
-    ip->is_dir = true;
-    ip->rel = xstrdup(full);
-    if (!ip->rel) { free(ip); free(ino); return -1; }
-
-    ino->i_ino = 0;
-    ino->i_mode = VFS_S_IFDIR;
-    ino->i_sb   = dir->i_sb;
-    ino->i_op   = dir->i_op;
-    ino->i_fop  = NULL;             /* no dir open/readdir yet */
-    ino->i_private = ip;
-
+    if (ino->i_state & VFS_I_NEW) {
+        char full[VFS_PATH_MAX];
+        join_relpath(dp->rel ? dp->rel : "", name, full, sizeof full);
+        if ((rc = inode_fill(ino, dp->fs, nr, full)) != 0) { vfs_iget_failed(ino); return rc; }
+        vfs_unlock_new_inode(ino);
+    }
     if (out) *out = ino;
     return 0;
 }
 
 static int i_readlink(struct inode *ino, char *buf, size_t bufsz) { (void)ino;(void)buf;(void)bufsz; return -1; }
 static int i_setattr(struct inode *ino, const void *attr) { (void)ino;(void)attr; return -1; }
-static int i_truncate(struct inode *ino, uint64_t size) { (void)ino;(void)size; return 0; }
+
+/* Shrinking frees the blocks past the new end and zeroes the rest of the
+   last one, so growing the file again reads zeros there. */
+static int i_truncate(struct inode *ino, uint64_t size) {
+    ext2_inode_priv_t *ip = ino ? (ext2_inode_priv_t*)ino->i_private : NULL;
+    if (!ip) return -EINVAL;
+    if (ip->is_dir) return -EISDIR;
+    if (ip->fs->rdonly) return -EROFS;
+    const uint32_t bs = ip->fs->block_size;
+    int rc = wbuf_flush(ip);
+    if (rc) return rc;
+
+    if (size < inode_size_of(&ip->di)) {
+        gu_mutex_lock(&ip->map_lock);
+        rc = free_from(ip, (size + bs - 1) / bs);
+        ind_drop(ip);
+        gu_mutex_unlock(&ip->map_lock);
+        ip->goal = 0;
+        uint32_t pblk = 0;
+        if (rc == 0 && size % bs && bmap_run(ip, size / bs, 1, &pblk) > 0 && pblk) {
+            const uint32_t in = (uint32_t)(size % bs);
+            uint8_t *zero = (uint8_t*)calloc(1, bs - in);
+            const char *key = ext2_devkey(ip->fs);
+            if (!zero || !key ||
+                !diskio_pwrite(key, ip->fs->off + (uint64_t)pblk * bs + in, zero, bs - in))
+                rc = -EIO;
+            free(zero);
+        }
+    }
+    if (rc == 0) rc = set_size(ip, size);
+    if (rc == 0) {
+        ip->di.i_mtime = ip->di.i_ctime = (uint32_t)time(NULL);
+        rc = write_inode(ip->fs, ip->ino, &ip->di, false);
+    }
+    if (rc == 0) ino->i_size = size;
+    if (rc == 0) rc = txn_end(ip->fs);
+    return rc;
+}
 static int i_unlink(struct inode *d, const char *n) { (void)d;(void)n; return -1; }
 static int i_rename(struct inode *od, const char *on, struct inode *nd, const char *nn) { (void)od;(void)on;(void)nd;(void)nn; return -1; }
 static int i_symlink(struct inode *d, const char *n, const char *t) { (void)d;(void)n;(void)t; return -1; }
@@ -272,21 +2010,32 @@ static int i_open(struct inode *ino, struct file **out, int flags, uint32_t mode
     *out = NULL;
 
     ext2_inode_priv_t *ip = (ext2_inode_priv_t*)ino->i_private;
-    if (!ip || ip->is_dir) return -1; /* only files are openable here */
+    if (!ip) return -1;
 
-    /* write or append only for now */
-    if ((flags & VFS_O_ACCMODE) == VFS_O_RDONLY) return -1;
+    const bool writing = (flags & VFS_O_ACCMODE) != VFS_O_RDONLY;
+    if (writing && ip->fs->rdonly) return -EROFS;
+    if (ip->is_dir) {
+        if (writing) return -EISDIR;
+        struct file *d = vfs_alloc_file(ino);
+        if (!d) return -1;
+        d->f_pos   = 0;
+        d->f_flags = flags;
+        d->f_op    = &EXT2_FOPS_DIR;
+        *out = d;
+        return 0;
+    }
+    if (writing && !VFS_S_ISREG(ip->di.i_mode)) return -EINVAL;
 
-    struct file *f = (struct file*)calloc(1, sizeof *f);
+    struct file *f = vfs_alloc_file(ino);
     if (!f) return -1;
 
-    ext2_file_priv_t *fp = (ext2_file_priv_t*)calloc(1, sizeof *fp);
-    if (!fp) { free(f); return -1; }
+    ext2_file_priv_t *fp = (ext2_file_priv_t*)vfs_slab_alloc(&g_ext2_file_cache, ino->i_sb->s_slab);
+    if (!fp) { vfs_free_file(f); return -1; }
 
     fp->node = ip;
-    fp->buf  = NULL; fp->len = fp->cap = 0;
+    fp->writing = writing;
+    if (writing) ip->writers++;             /* sb lock exclusive: opened for writing */
 
-    f->f_inode = ino;
     f->f_pos   = 0;
     f->f_flags = flags;
     f->f_op    = &EXT2_FOPS_FILE;
@@ -307,21 +2056,110 @@ static const inode_ops_t EXT2_IOPS = {
     .truncate = i_truncate,
     .symlink  = i_symlink,
     .readlink = i_readlink,
-#if VFS_HAVE_CREATE_OP
     .create   = i_create,
-#endif
 };
 
 /* -------- probe / mount / umount -------- */
 
-/* ext2 sb lives at byte 1024; magic 0xEF53 at +56 within that 1024 */
+/* Features a mount handles. Incompatible ones past EXT2_INCOMPAT_RW, and
+   read-only-compatible ones past EXT2_RO_COMPAT_RW, make it read-only. */
+#define EXT2_INCOMPAT_RW  EXT2_FEATURE_INCOMPAT_FILETYPE
+#define EXT2_INCOMPAT_RO  (EXT4_FEATURE_INCOMPAT_RECOVER | EXT4_FEATURE_INCOMPAT_EXTENTS | \
+                           EXT4_FEATURE_INCOMPAT_64BIT | EXT4_FEATURE_INCOMPAT_FLEX_BG | \
+                           EXT4_FEATURE_INCOMPAT_CSUM_SEED | EXT4_FEATURE_INCOMPAT_LARGEDIR)
+#define EXT2_RO_COMPAT_RW (EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER | EXT2_FEATURE_RO_COMPAT_LARGE_FILE)
+
+/* ext2 sb lives at byte 1024; magic 0xEF53 at +56 within that 1024. Whether
+   its features can be read is up to mount, which says why not. */
 static bool ext2_probe(vblk_t *dev, char *label_out, size_t label_cap) {
-    uint8_t sb[1024];
-    if (!vblk_read_bytes(dev, 1024, sizeof sb, sb)) return false;
-    uint16_t magic = (uint16_t)(sb[56] | (sb[57] << 8));
-    bool ok = (magic == 0xEF53);
-    if (ok && label_out && label_cap) label_out[0] = '\0'; /* optional label */
-    return ok;
+    ext2_superblock s;
+    if (!vblk_read_bytes(dev, EXT2_SUPER_OFFSET, sizeof s, &s)) return false;
+    if (s.s_magic != EXT2_SUPER_MAGIC) return false;
+    if (label_out && label_cap)
+        snprintf(label_out, label_cap, "%.*s", (int)sizeof s.s_volume_name, s.s_volume_name);
+    return true;
+}
+
+/* The descriptor table. 64bit descriptors (s_desc_size bytes) keep the
+   32-bit ones' layout in their first 32 bytes and the high halves of the
+   block numbers after; those must be zero, as the driver's block numbers
+   are 32-bit. */
+static int load_group_descs(ext2_fs_t *fs) {
+    const ext2_superblock *s = &fs->sb;
+    const uint32_t dsz = (s->s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT) ? s->s_desc_size
+                                                                                : (uint32_t)sizeof *fs->gd;
+    if (dsz < sizeof *fs->gd || dsz > fs->block_size || (dsz & (dsz - 1))) return -EINVAL;
+    const size_t bytes = (size_t)fs->ngroups * dsz;
+    fs->gd = (ext2_group_desc*)malloc((size_t)fs->ngroups * sizeof *fs->gd);
+    uint8_t *raw = dsz == sizeof *fs->gd ? (uint8_t*)fs->gd : (uint8_t*)malloc(bytes);
+    if (!fs->gd || !raw) { if (raw != (uint8_t*)fs->gd) free(raw); return -ENOMEM; }
+    int rc = 0;
+    for (size_t at = 0; at < bytes && rc == 0; at += fs->block_size) {   /* meta_read takes 32-bit lengths */
+        const size_t n = bytes - at < fs->block_size ? bytes - at : fs->block_size;
+        if (!meta_read(fs, s->s_first_data_block + 1 + (uint32_t)(at / fs->block_size), 0, raw + at, (uint32_t)n))
+            rc = -EIO;
+    }
+    for (uint32_t g = 0; rc == 0 && dsz != sizeof *fs->gd && g < fs->ngroups; ++g) {
+        const uint8_t *d = raw + (size_t)g * dsz;
+        uint32_t hi[3];
+        memcpy(hi, d + sizeof *fs->gd, sizeof hi);  /* bg_{block_bitmap,inode_bitmap,inode_table}_hi */
+        if (hi[0] | hi[1] | hi[2]) {
+            fprintf(stderr, "ext2: group %u has metadata past block 2^32\n", (unsigned)g);
+            rc = -EFBIG;
+        }
+        memcpy(&fs->gd[g], d, sizeof *fs->gd);
+    }
+    if (raw != (uint8_t*)fs->gd) free(raw);
+    return rc;
+}
+
+/* Superblock and group descriptors; everything else is read on demand. */
+static int ext2_load_super(ext2_fs_t *fs) {
+    const char *key = ext2_devkey(fs);
+    ext2_superblock *s = &fs->sb;
+    if (!key || !diskio_pread_cached(key, fs->off + EXT2_SUPER_OFFSET, s, sizeof *s)) return -EIO;
+    if (s->s_magic != EXT2_SUPER_MAGIC) return -EINVAL;
+    if (s->s_log_block_size > 6 || s->s_blocks_per_group == 0 || s->s_inodes_per_group == 0 ||
+        s->s_first_data_block >= s->s_blocks_count) {
+        DBG("ext2: implausible superblock");
+        return -EINVAL;
+    }
+    if (s->s_rev_level >= 1) {
+        const uint32_t unknown = s->s_feature_incompat & ~(EXT2_INCOMPAT_RW | EXT2_INCOMPAT_RO);
+        if (unknown) {
+            fprintf(stderr, "ext2: unsupported incompatible features 0x%x\n", (unsigned)unknown);
+            return -EINVAL;
+        }
+        if ((s->s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT) && s->s_blocks_count_hi) {
+            fprintf(stderr, "ext2: filesystems of 2^32 blocks or more are not supported\n");
+            return -EFBIG;
+        }
+        fs->rdonly = (s->s_feature_incompat & ~EXT2_INCOMPAT_RW) || (s->s_feature_ro_compat & ~EXT2_RO_COMPAT_RW);
+        fs->huge_file = (s->s_feature_ro_compat & EXT4_FEATURE_RO_COMPAT_HUGE_FILE) != 0;
+        if (s->s_feature_incompat & EXT4_FEATURE_INCOMPAT_RECOVER)
+            fprintf(stderr, "ext2: journal needs recovery; reading the filesystem as last checkpointed\n");
+    }
+
+    fs->block_size = 1024u << s->s_log_block_size;
+    fs->inode_size = s->s_rev_level >= 1 ? s->s_inode_size : EXT2_GOOD_OLD_INODE_SIZE;
+    if (fs->inode_size < EXT2_GOOD_OLD_INODE_SIZE || fs->inode_size > fs->block_size ||
+        (fs->inode_size & (fs->inode_size - 1)))
+        return -EINVAL;
+    fs->addr_per_block = fs->block_size / sizeof(uint32_t);
+    fs->filetype  = s->s_rev_level >= 1 && (s->s_feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE);
+    fs->dir_index = s->s_rev_level >= 1 && (s->s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX);
+    fs->ngroups = (s->s_blocks_count - s->s_first_data_block + s->s_blocks_per_group - 1)
+                / s->s_blocks_per_group;
+
+    int rc = load_group_descs(fs);
+    if (rc) return rc;
+    fs->grp = (ext2_group_t*)calloc(fs->ngroups, sizeof *fs->grp);
+    if (!fs->grp) return -ENOMEM;
+
+    DBG("ext2: %u blocks of %u, %u groups, %u inodes of %u bytes%s",
+        (unsigned)s->s_blocks_count, (unsigned)fs->block_size, (unsigned)fs->ngroups,
+        (unsigned)s->s_inodes_count, (unsigned)fs->inode_size, fs->rdonly ? ", read-only" : "");
+    return 0;
 }
 
 static int ext2_mount(vblk_t *dev, const char *opts, superblock_t **out_sb) {
@@ -332,43 +2170,35 @@ static int ext2_mount(vblk_t *dev, const char *opts, superblock_t **out_sb) {
     ext2_fs_t *fs = (ext2_fs_t*)calloc(1, sizeof *fs);
     if (!fs) return -1;
     fs->dev = dev;
+    fs->off = dev->lba_start * 512ull;
+    gu_mutex_init(&fs->txn.lock);
 
-    /* remember mount root "" so lookup can resolve relative children we create */
-    if (!ext2_dirs_add(fs, "")) { free(fs); return -1; }
+    if (ext2_load_super(fs) != 0) { fs_free(fs); return -1; }
 
-    superblock_t *sb = (superblock_t*)calloc(1, sizeof *sb);
-    if (!sb) { ext2_dirs_free(fs); free(fs); return -1; }
+    superblock_t *sb = vfs_alloc_sb();
+    if (!sb) { fs_free(fs); return -1; }
 
     static const super_ops_t SOP = {
-        .statfs  = s_statfs,
-        .syncfs  = s_syncfs,
-        .kill_sb = s_kill_sb,
+        .statfs      = s_statfs,
+        .syncfs      = s_syncfs,
+        .kill_sb     = s_kill_sb,
+        .evict_inode = s_evict_inode,
     };
-
-    inode_t *root = (inode_t*)calloc(1, sizeof *root);
-    if (!root) { free(sb); ext2_dirs_free(fs); free(fs); return -1; }
-
-    ext2_inode_priv_t *rip = (ext2_inode_priv_t*)calloc(1, sizeof *rip);
-    if (!rip) { free(root); free(sb); ext2_dirs_free(fs); free(fs); return -1; }
-
-    rip->fs = fs;
-    rip->is_dir = true;
-    rip->rel = xstrdup("");
-    if (!rip->rel) { free(rip); free(root); free(sb); ext2_dirs_free(fs); free(fs); return -1; }
-
-    root->i_ino  = 2;                /* conventional ext2 root */
-    root->i_mode = VFS_S_IFDIR;
-    root->i_sb   = sb;
-    root->i_op   = &EXT2_IOPS;
-    root->i_fop  = NULL;             /* no dir open/readdir yet */
-    root->i_private = rip;
-
+    sb->s_op = &SOP;
     sb->fs_type    = NULL;
     sb->bdev       = dev;
-    sb->block_size = 1024;
-    sb->root       = root;
-    sb->s_op       = &SOP;
+    sb->block_size = fs->block_size;
     sb->fs_private = fs;
+    if (fs->rdonly) sb->s_flags |= VFS_SB_RDONLY;
+
+    inode_t *root = vfs_iget(sb, EXT2_ROOT_INO);
+    if (!root || inode_fill(root, fs, EXT2_ROOT_INO, "") != 0 || !VFS_S_ISDIR(root->i_mode)) {
+        if (root) vfs_iget_failed(root);
+        s_kill_sb(sb);
+        return -1;
+    }
+    vfs_unlock_new_inode(root);
+    sb->root = root;
 
     *out_sb = sb;
     return 0;
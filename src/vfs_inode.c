@@ -0,0 +1,266 @@
+// src/vfs_inode.c — shared, reference-counted inode cache (iget/iput)
+//
+// One hash table keyed by (superblock, i_ino) for every mounted filesystem.
+// Inodes with i_count == 0 are parked on a global LRU instead of being freed,
+// so repeated path walks hit the same object (and whatever per-inode state
+// the driver hangs off i_private). The LRU is trimmed to VFS_INODE_CACHE_MAX.
+//
+// All of it (hash, LRU, per-sb lists, i_count, i_state) is guarded by one
+// mutex. A thread that finds an inode still VFS_I_NEW sleeps on g_icond until
+// the filling thread unlocks it or gives up (VFS_I_BAD). s_op->evict_inode
+// runs with the lock held and must not call back into iget/iput.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "gu_sync.h"
+
+#define ICACHE_MIN_BUCKETS 256u
+
+static inode_t **g_ihash      = NULL;
+static size_t    g_ihash_cap  = 0;     /* buckets (power of two) */
+static size_t    g_ihash_n    = 0;     /* hashed inodes */
+
+static inode_t  *g_lru_head   = NULL;  /* most recently released */
+static inode_t  *g_lru_tail   = NULL;  /* eviction candidate */
+static size_t    g_lru_n      = 0;
+
+static size_t    g_inodes_live = 0;    /* hashed + unhashed */
+
+static VFS_SLAB_CACHE(g_inode_cache, "inode", inode_t);
+
+static gu_mutex_t g_ilock = GU_MUTEX_INIT;
+static gu_cond_t  g_icond = GU_COND_INIT;  /* VFS_I_NEW cleared somewhere */
+
+/* ---------- hashing ---------- */
+
+static inline size_t ihash(const superblock_t *sb, uint64_t ino) {
+    uint64_t h = (uint64_t)(uintptr_t)sb ^ (ino * 0x9E3779B97F4A7C15ull);
+    h ^= h >> 29;
+    return (size_t)h & (g_ihash_cap - 1);
+}
+
+static bool ihash_grow(void) {
+    size_t ncap = g_ihash_cap ? g_ihash_cap * 2 : ICACHE_MIN_BUCKETS;
+    inode_t **nt = (inode_t**)calloc(ncap, sizeof *nt);
+    if (!nt) return false;
+
+    inode_t **old = g_ihash;
+    size_t ocap = g_ihash_cap;
+    g_ihash = nt; g_ihash_cap = ncap;
+
+    for (size_t b = 0; b < ocap; ++b) {
+        inode_t *i = old[b];
+        while (i) {
+            inode_t *next = i->i_hash_next;
+            size_t h = ihash(i->i_sb, i->i_ino);
+            i->i_hash_next = g_ihash[h];
+            g_ihash[h] = i;
+            i = next;
+        }
+    }
+    free(old);
+    return true;
+}
+
+static void ihash_remove(inode_t *inode) {
+    if (!(inode->i_state & VFS_I_HASHED)) return;
+    inode_t **pp = &g_ihash[ihash(inode->i_sb, inode->i_ino)];
+    while (*pp && *pp != inode) pp = &(*pp)->i_hash_next;
+    if (*pp) *pp = inode->i_hash_next;
+    inode->i_hash_next = NULL;
+    inode->i_state &= ~VFS_I_HASHED;
+    g_ihash_n--;
+}
+
+/* ---------- LRU of unreferenced inodes ---------- */
+
+static void lru_del(inode_t *inode) {
+    if (!inode->i_lru_prev && !inode->i_lru_next && g_lru_head != inode) return;
+    if (inode->i_lru_prev) inode->i_lru_prev->i_lru_next = inode->i_lru_next;
+    else                   g_lru_head = inode->i_lru_next;
+    if (inode->i_lru_next) inode->i_lru_next->i_lru_prev = inode->i_lru_prev;
+    else                   g_lru_tail = inode->i_lru_prev;
+    inode->i_lru_prev = inode->i_lru_next = NULL;
+    g_lru_n--;
+}
+
+static void lru_add(inode_t *inode) {
+    inode->i_lru_prev = NULL;
+    inode->i_lru_next = g_lru_head;
+    if (g_lru_head) g_lru_head->i_lru_prev = inode;
+    g_lru_head = inode;
+    if (!g_lru_tail) g_lru_tail = inode;
+    g_lru_n++;
+}
+
+/* ---------- per-superblock list ---------- */
+
+static void sb_list_add(inode_t *inode) {
+    superblock_t *sb = inode->i_sb;
+    inode->i_sb_prev = NULL;
+    inode->i_sb_next = sb->s_inodes;
+    if (sb->s_inodes) sb->s_inodes->i_sb_prev = inode;
+    sb->s_inodes = inode;
+    sb->s_ninodes++;
+}
+
+static void sb_list_del(inode_t *inode) {
+    superblock_t *sb = inode->i_sb;
+    if (inode->i_sb_prev) inode->i_sb_prev->i_sb_next = inode->i_sb_next;
+    else                  sb->s_inodes = inode->i_sb_next;
+    if (inode->i_sb_next) inode->i_sb_next->i_sb_prev = inode->i_sb_prev;
+    inode->i_sb_prev = inode->i_sb_next = NULL;
+    sb->s_ninodes--;
+}
+
+/* ---------- lifetime ---------- */
+
+static void evict(inode_t *inode) {
+    ihash_remove(inode);
+    lru_del(inode);
+    sb_list_del(inode);
+    vfs_pagecache_truncate(inode);
+    vfs_dindex_drop(inode);
+    superblock_t *sb = inode->i_sb;
+    if (sb && sb->s_op && sb->s_op->evict_inode) sb->s_op->evict_inode(inode);
+    g_inodes_live--;
+    vfs_slab_free(inode);
+}
+
+/* Free an inode whose driver never finished filling it. */
+static void destroy_bad(inode_t *inode) {
+    /* i_private is not ours to free: the driver never finished filling it */
+    sb_list_del(inode);
+    g_inodes_live--;
+    vfs_slab_free(inode);
+}
+
+static void lru_trim(size_t keep) {
+    while (g_lru_n > keep && g_lru_tail) evict(g_lru_tail);
+}
+
+static inode_t *alloc_inode(superblock_t *sb) {
+    inode_t *inode = (inode_t*)vfs_slab_alloc(&g_inode_cache, sb->s_slab);
+    if (!inode) return NULL;
+    inode->i_sb    = sb;
+    inode->i_count = 1;
+    sb_list_add(inode);
+    g_inodes_live++;
+    return inode;
+}
+
+inode_t *vfs_iget(superblock_t *sb, uint64_t ino) {
+    if (!sb) return NULL;
+
+    gu_mutex_lock(&g_ilock);
+    if (g_ihash_cap) {
+        for (inode_t *i = g_ihash[ihash(sb, ino)]; i; i = i->i_hash_next) {
+            if (i->i_sb == sb && i->i_ino == ino) {
+                if (i->i_count++ == 0) lru_del(i);
+                /* someone else is filling it: wait for the outcome */
+                while (i->i_state & VFS_I_NEW) gu_cond_wait(&g_icond, &g_ilock);
+                if (i->i_state & VFS_I_BAD) {
+                    if (--i->i_count == 0) destroy_bad(i);
+                    i = NULL;
+                }
+                gu_mutex_unlock(&g_ilock);
+                vfs_icache_account(sb, true);
+                return i;
+            }
+        }
+    }
+
+    inode_t *inode = NULL;
+    if (g_ihash_n + 1 > g_ihash_cap && !ihash_grow()) goto out;
+
+    inode = alloc_inode(sb);
+    if (!inode) goto out;
+    inode->i_ino   = ino;
+    inode->i_state = VFS_I_NEW | VFS_I_HASHED;
+
+    size_t h = ihash(sb, ino);
+    inode->i_hash_next = g_ihash[h];
+    g_ihash[h] = inode;
+    g_ihash_n++;
+out:
+    gu_mutex_unlock(&g_ilock);
+    vfs_icache_account(sb, false);
+    return inode;
+}
+
+inode_t *vfs_new_inode(superblock_t *sb) {
+    if (!sb) return NULL;
+    gu_mutex_lock(&g_ilock);
+    inode_t *inode = alloc_inode(sb);
+    gu_mutex_unlock(&g_ilock);
+    return inode;
+}
+
+void vfs_unlock_new_inode(inode_t *inode) {
+    if (!inode) return;
+    gu_mutex_lock(&g_ilock);
+    inode->i_state &= ~VFS_I_NEW;
+    gu_cond_broadcast(&g_icond);
+    gu_mutex_unlock(&g_ilock);
+}
+
+void vfs_iget_failed(inode_t *inode) {
+    if (!inode) return;
+    gu_mutex_lock(&g_ilock);
+    ihash_remove(inode);
+    inode->i_state = (inode->i_state & ~VFS_I_NEW) | VFS_I_BAD;
+    gu_cond_broadcast(&g_icond);
+    /* waiters hold their own refs and drop them when they see VFS_I_BAD */
+    if (--inode->i_count == 0) destroy_bad(inode);
+    gu_mutex_unlock(&g_ilock);
+}
+
+inode_t *vfs_ihold(inode_t *inode) {
+    if (!inode) return NULL;
+    gu_mutex_lock(&g_ilock);
+    if (inode->i_count++ == 0) lru_del(inode);
+    gu_mutex_unlock(&g_ilock);
+    return inode;
+}
+
+void vfs_iput(inode_t *inode) {
+    if (!inode) return;
+    gu_mutex_lock(&g_ilock);
+    if (inode->i_count == 0) {
+        DBG("vfs_iput: inode %llu already unreferenced", (unsigned long long)inode->i_ino);
+    } else if (--inode->i_count == 0) {
+        if (!(inode->i_state & VFS_I_HASHED)) {
+            evict(inode);
+        } else {
+            lru_add(inode);
+            lru_trim(VFS_INODE_CACHE_MAX);
+        }
+    }
+    gu_mutex_unlock(&g_ilock);
+}
+
+void vfs_evict_inodes(superblock_t *sb) {
+    if (!sb) return;
+    gu_mutex_lock(&g_ilock);
+    while (sb->s_inodes) {
+        inode_t *inode = sb->s_inodes;
+        if (inode->i_count) {
+            DBG("vfs_evict_inodes: inode %llu still has %u refs; evicting anyway",
+                (unsigned long long)inode->i_ino, inode->i_count);
+        }
+        evict(inode);
+    }
+    gu_mutex_unlock(&g_ilock);
+}
+
+size_t vfs_inode_cache_count(void) {
+    gu_mutex_lock(&g_ilock);
+    size_t n = g_inodes_live;
+    gu_mutex_unlock(&g_ilock);
+    return n;
+}
@@ -0,0 +1,149 @@
+// src/vfs_intern.c — process-wide table of interned path components
+//
+// An open-addressed table of atom pointers, probed linearly by the atom's
+// FNV-1a hash. Slots only ever go from NULL to an atom, and an atom is fully
+// written before the release store that publishes it, so readers probe with
+// acquire loads and no lock. Writers serialise on one mutex, re-probe, and
+// when the table passes 1/2 full publish a copy twice the size. A retired
+// table is not freed: a reader may still be probing it, and all of them
+// together are smaller than the live one, so they stay chained off it.
+//
+// Atoms are carved from 64 KiB chunks and live for the rest of the process.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "gu_sync.h"
+
+#define INTERN_MIN_SLOTS 1024u
+#define INTERN_CHUNK     (64u << 10)
+
+typedef struct itab {
+    size_t       mask;
+    struct itab *retired;            /* previous, smaller table */
+    _Atomic(vfs_atom_t) slot[];
+} itab_t;
+
+typedef struct ichunk {
+    struct ichunk *next;
+    size_t         used, cap;
+    unsigned char  mem[];           /* header keeps it pointer-aligned */
+} ichunk_t;
+
+static itab_t *_Atomic g_tab = NULL;
+static ichunk_t       *g_chunks = NULL;
+static vfs_intern_stats_t g_in;
+static gu_mutex_t      g_in_lock = GU_MUTEX_INIT;
+
+uint32_t vfs_name_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;                      /* FNV-1a */
+    for (size_t i = 0; i < len; ++i) { h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
+}
+
+static vfs_atom_t probe(const itab_t *t, const char *s, size_t len, uint32_t h, size_t *free_slot) {
+    for (size_t i = h & t->mask;; i = (i + 1) & t->mask) {
+        vfs_atom_t a = atomic_load_explicit(&((itab_t*)t)->slot[i], memory_order_acquire);
+        if (!a) { if (free_slot) *free_slot = i; return NULL; }
+        if (a->hash == h && a->len == len && memcmp(a->name, s, len) == 0) return a;
+    }
+}
+
+vfs_atom_t vfs_intern_find(const char *name, size_t len) {
+    if (!name || len > VFS_ATOM_MAX_LEN) return NULL;
+    const itab_t *t = atomic_load_explicit(&g_tab, memory_order_acquire);
+    return t ? probe(t, name, len, vfs_name_hash(name, len), NULL) : NULL;
+}
+
+/* ---------- writer side (g_in_lock held) ---------- */
+
+static itab_t *tab_new(size_t nslots) {
+    itab_t *t = (itab_t*)calloc(1, sizeof *t + nslots * sizeof t->slot[0]);
+    if (t) t->mask = nslots - 1;
+    return t;
+}
+
+static bool tab_grow(void) {
+    itab_t *old = atomic_load_explicit(&g_tab, memory_order_relaxed);
+    size_t nslots = old ? (old->mask + 1) * 2 : INTERN_MIN_SLOTS;
+    itab_t *t = tab_new(nslots);
+    if (!t) return false;
+    if (old) {
+        for (size_t i = 0; i <= old->mask; ++i) {
+            vfs_atom_t a = atomic_load_explicit(&old->slot[i], memory_order_relaxed);
+            if (!a) continue;
+            size_t j = a->hash & t->mask;
+            while (atomic_load_explicit(&t->slot[j], memory_order_relaxed)) j = (j + 1) & t->mask;
+            atomic_store_explicit(&t->slot[j], a, memory_order_relaxed);
+        }
+    }
+    t->retired = old;
+    atomic_store_explicit(&g_tab, t, memory_order_release);
+    g_in.slots = nslots;
+    g_in.bytes += nslots * sizeof t->slot[0];
+    DBG("vfs_intern: table grown to %zu slots (%llu atoms)", nslots, (unsigned long long)g_in.atoms);
+    return true;
+}
+
+static struct vfs_atom *atom_alloc(size_t len) {
+    size_t need = (sizeof(struct vfs_atom) + len + 1 + 3) & ~(size_t)3;
+    if (!g_chunks || g_chunks->cap - g_chunks->used < need) {
+        ichunk_t *c = (ichunk_t*)malloc(sizeof *c + INTERN_CHUNK);
+        if (!c) return NULL;
+        c->used = 0;
+        c->cap = INTERN_CHUNK;
+        c->next = g_chunks;
+        g_chunks = c;
+        g_in.bytes += sizeof *c + INTERN_CHUNK;
+    }
+    struct vfs_atom *a = (struct vfs_atom*)(g_chunks->mem + g_chunks->used);
+    g_chunks->used += need;
+    return a;
+}
+
+vfs_atom_t vfs_intern(const char *name, size_t len) {
+    if (!name || len > VFS_ATOM_MAX_LEN) return NULL;
+    const uint32_t h = vfs_name_hash(name, len);
+    const itab_t *t = atomic_load_explicit(&g_tab, memory_order_acquire);
+    vfs_atom_t a = t ? probe(t, name, len, h, NULL) : NULL;
+    if (a) return a;
+
+    gu_mutex_lock(&g_in_lock);
+    t = atomic_load_explicit(&g_tab, memory_order_relaxed);
+    size_t at = 0;
+    a = t ? probe(t, name, len, h, &at) : NULL;         /* raced with another writer? */
+    if (a) { gu_mutex_unlock(&g_in_lock); return a; }
+
+    if (g_in.bytes >= VFS_INTERN_MAX_BYTES) {
+        gu_mutex_unlock(&g_in_lock);
+        DBG("vfs_intern: budget of %u bytes used up", (unsigned)VFS_INTERN_MAX_BYTES);
+        return NULL;
+    }
+    if (!t || (g_in.atoms + 1) * 2 > t->mask + 1) {
+        if (!tab_grow()) { gu_mutex_unlock(&g_in_lock); return NULL; }
+        t = atomic_load_explicit(&g_tab, memory_order_relaxed);
+        (void)probe(t, name, len, h, &at);
+    }
+    struct vfs_atom *na = atom_alloc(len);
+    if (!na) { gu_mutex_unlock(&g_in_lock); return NULL; }
+    na->hash = h;
+    na->len = (uint32_t)len;
+    memcpy(na->name, name, len);
+    na->name[len] = '\0';
+    atomic_store_explicit(&((itab_t*)t)->slot[at], na, memory_order_release);
+    g_in.atoms++;
+    gu_mutex_unlock(&g_in_lock);
+    return na;
+}
+
+void vfs_intern_get_stats(vfs_intern_stats_t *out) {
+    if (!out) return;
+    gu_mutex_lock(&g_in_lock);
+    *out = g_in;
+    gu_mutex_unlock(&g_in_lock);
+}
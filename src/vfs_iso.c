@@ -23,6 +23,15 @@ typedef struct {
     iso9660_t iso;   /* low-level ISO state (PVD/SVD/root extent etc.) */
 } iso_fs_t;
 
+/* ===== Inode numbers =====
+ * Directories are numbered by their extent (each has its own), everything
+ * else by the byte position of its directory record. A file record can never
+ * sit at byte 0 of a directory extent ("." lives there), so the two spaces
+ * don't collide and zero-length files sharing LBA 0 stay distinct. */
+static inline uint64_t iso_ino(bool is_dir, uint32_t extent_lba, uint64_t rec_pos) {
+    return is_dir ? (uint64_t)extent_lba * ISO_SECTOR_SIZE : rec_pos;
+}
+
 /* ===== Inode private payload ===== */
 typedef struct iso_inode {
     iso_fs_t *fs;
@@ -32,13 +41,21 @@ typedef struct iso_inode {
     time_t   mtime;
 } iso_inode_t;
 
+static VFS_SLAB_CACHE(g_iso_inode_cache, "iso_inode", iso_inode_t);
+
 /* ---- forward prototypes so initializers see the symbols ---- */
 static int     iso_file_open   (struct inode *inode, struct file **out, int flags, uint32_t mode);
 static int     iso_file_release(struct file *f);
 static ssize_t iso_file_read   (struct file *f, void *buf, size_t n, uint64_t *ppos);
+static int     iso_file_fiemap (struct file *f, uint64_t start, uint64_t len,
+                                vfs_extent_t *ext, unsigned max, unsigned *count);
+
+static int     iso_readpages   (struct inode *inode, vfs_page_t **pages, unsigned n);
+static int     iso_readpage    (struct inode *inode, vfs_page_t *pg);
 
 static int     iso_dir_open    (struct inode *inode, struct file **out, int flags, uint32_t mode);
 static ssize_t iso_dir_getdents64(struct file *dirf, void *buf, size_t bytes);
+static ssize_t iso_dir_getdents64_plus(struct file *dirf, void *buf, size_t bytes);
 
 static int     iso_getattr     (struct inode *inode, struct g_stat *st);
 static int     iso_lookup      (struct inode *dir, const char *name, struct inode **out);
@@ -56,6 +73,7 @@ static const file_ops_t FOPS_DIR = {
     .ioctl      = NULL,
     .llseek     = NULL,
     .getdents64 = iso_dir_getdents64,
+    .getdents64_plus = iso_dir_getdents64_plus,
 };
 
 static const file_ops_t ISO_FILE_FOPS = {
@@ -67,6 +85,14 @@ static const file_ops_t ISO_FILE_FOPS = {
     .ioctl       = NULL,
     .llseek      = NULL,
     .getdents64  = NULL,
+    .fiemap      = iso_file_fiemap,
+};
+
+/* File data goes through the VFS page cache; an extent is contiguous on disc
+   so a batch of pages is a single device read. */
+static const address_space_ops_t ISO_AOPS = {
+    .readpage  = iso_readpage,
+    .readpages = iso_readpages,
 };
 
 /* File-only i_ops: no .lookup, so the VFS won’t treat it like a directory */
@@ -145,18 +171,22 @@ static int iso_statfs(struct superblock *sb, struct g_statvfs *sv) {
 
 static int iso_syncfs(struct superblock *sb) { (void)sb; return 0; }
 
+static void iso_evict_inode(struct inode *inode) {
+    if (!inode) return;
+    vfs_slab_free(inode->i_private);
+    inode->i_private = NULL;
+}
+
 static void iso_kill_sb(struct superblock *sb) {
     if (!sb) return;
     iso_fs_t *fs = (iso_fs_t*)sb->fs_private;
 
-    // free root inode payload first
-    if (sb->root) {
-        iso_inode_t *rip = (iso_inode_t*)sb->root->i_private;
-        free(rip);
-        free(sb->root);
-    }
+    // drop the root reference, then let the inode cache free every payload
+    vfs_iput(sb->root);
+    sb->root = NULL;
+    vfs_evict_inodes(sb);
     free(fs);
-    free(sb);
+    vfs_free_sb(sb);
 }
 
 /* ===== file (regular) file_ops ===== */
@@ -167,9 +197,8 @@ static int iso_file_open(struct inode *inode, struct file **out, int flags, uint
     iso_inode_t *ip = (iso_inode_t*)inode->i_private;
     if (!ip || ip->is_dir) return -1;
 
-    struct file *f = (struct file*)calloc(1, sizeof *f);
+    struct file *f = vfs_alloc_file(inode);
     if (!f) return -1;
-    f->f_inode = inode;
     f->f_flags = flags;
     f->f_pos   = 0;
     f->f_op    = &ISO_FILE_FOPS;   // <-- missing before
@@ -179,44 +208,79 @@ static int iso_file_open(struct inode *inode, struct file **out, int flags, uint
 }
 
 static int iso_file_release(struct file *f) {
-	free(f);
+	vfs_free_file(f);
 	return 0;
 }
 
-/* Read helper: copy from extent using iso_read_sector() */
+/* Uncached read: the extent is contiguous, so any byte range is one device read */
 static ssize_t iso_file_read(struct file *f, void *buf, size_t n, uint64_t *ppos) {
     if (!f || !buf || !ppos) return -1;
     iso_inode_t *ip = (iso_inode_t*)f->f_inode->i_private;
     if (!ip || ip->is_dir) return -EISDIR;
 
-    const uint32_t bs = f->f_inode->i_sb ? f->f_inode->i_sb->block_size : 2048;
     uint64_t pos = *ppos;
     if (pos >= ip->extent_size) return 0; // EOF
     if (n > (size_t)(ip->extent_size - pos)) n = (size_t)(ip->extent_size - pos);
 
-    uint8_t *dst = (uint8_t*)buf;
-    size_t   copied = 0;
+    uint64_t off = (uint64_t)ip->extent_lba * ISO_SECTOR_SIZE + pos;
+    if (!vblk_read_bytes(ip->fs->iso.dev, off, (uint32_t)n, buf)) return -EIO;
 
-    uint32_t lba = ip->extent_lba + (uint32_t)(pos / bs);
-    uint32_t in_sector = (uint32_t)(pos % bs);
+    *ppos = pos + n;
+    return (ssize_t)n;
+}
 
-    while (copied < n) {
-        uint8_t sec[2048];
-        if (!iso_read_sector(&ip->fs->iso, lba, sec)) return (copied > 0) ? (ssize_t)copied : -EIO;
+/* A file is one contiguous extent on disc */
+static int iso_file_fiemap(struct file *f, uint64_t start, uint64_t len,
+                           vfs_extent_t *ext, unsigned max, unsigned *count) {
+    (void)len;
+    if (!f || !ext || !count) return -EINVAL;
+    *count = 0;
+    iso_inode_t *ip = (iso_inode_t*)f->f_inode->i_private;
+    if (!ip || ip->is_dir) return -EISDIR;
+    if (max == 0 || start >= ip->extent_size) return 0;
 
-        size_t take = bs - in_sector;
-        size_t left = n - copied;
-        if (take > left) take = left;
+    ext[0].fe_logical  = 0;
+    ext[0].fe_physical = (uint64_t)ip->extent_lba * ISO_SECTOR_SIZE;
+    ext[0].fe_length   = ip->extent_size;
+    ext[0].fe_flags    = VFS_FIEMAP_EXTENT_LAST;
+    *count = 1;
+    return 0;
+}
 
-        memcpy(dst + copied, sec + in_sector, take);
-        copied    += take;
-        pos       += take;
-        lba       += 1;
-        in_sector  = 0;
+static int iso_readpages(struct inode *inode, vfs_page_t **pages, unsigned n) {
+    if (!inode || !pages || n == 0) return -EINVAL;
+    iso_inode_t *ip = (iso_inode_t*)inode->i_private;
+    if (!ip || ip->is_dir) return -EISDIR;
+
+    const uint64_t start = pages[0]->index << VFS_PAGE_SHIFT;
+    uint64_t len = (uint64_t)n * VFS_PAGE_SIZE;
+    if (start >= ip->extent_size) len = 0;
+    else if (len > ip->extent_size - start) len = ip->extent_size - start;
+
+    uint8_t *tmp = NULL;
+    if (len) {
+        tmp = (uint8_t*)malloc((size_t)len);
+        if (!tmp) return -ENOMEM;
+        uint64_t off = (uint64_t)ip->extent_lba * ISO_SECTOR_SIZE + start;
+        if (!vblk_read_bytes(ip->fs->iso.dev, off, (uint32_t)len, tmp)) {
+            free(tmp);
+            return -EIO;
+        }
     }
 
-    *ppos = pos;
-    return (ssize_t)copied;
+    for (unsigned i = 0; i < n; ++i) {
+        uint64_t at = (uint64_t)i * VFS_PAGE_SIZE;
+        size_t take = (at < len) ? (size_t)(len - at) : 0;
+        if (take > VFS_PAGE_SIZE) take = VFS_PAGE_SIZE;
+        if (take) memcpy(pages[i]->data, tmp + at, take);
+        if (take < VFS_PAGE_SIZE) memset(pages[i]->data + take, 0, VFS_PAGE_SIZE - take);
+    }
+    free(tmp);
+    return 0;
+}
+
+static int iso_readpage(struct inode *inode, vfs_page_t *pg) {
+    return iso_readpages(inode, &pg, 1);
 }
 
 static int iso_dir_open(struct inode *inode, struct file **out, int flags, uint32_t mode) {
@@ -226,10 +290,9 @@ static int iso_dir_open(struct inode *inode, struct file **out, int flags, uint3
     iso_inode_t *ip = (iso_inode_t*)inode->i_private;
     if (!ip || !ip->is_dir) return -ENOTDIR;
 
-    struct file *f = (struct file*)calloc(1, sizeof *f);
+    struct file *f = vfs_alloc_file(inode);
     if (!f) return -1;
 
-    f->f_inode = inode;
     f->f_flags = flags | VFS_O_DIRECTORY;  // don’t require caller to set it
     f->f_pos   = 0;
     f->f_op    = &FOPS_DIR;                // <-- critical so getdents64 is reachable
@@ -241,7 +304,25 @@ static int iso_dir_open(struct inode *inode, struct file **out, int flags, uint3
 
 /* ===== inode_ops ===== */
 
-// Replace the entire iso_lookup(...) with this version
+static int iso_index_rec(const iso_rec_t *r, void *user) {
+    const bool is_dir = (r->flags & 0x02) != 0;
+    const vfs_dentry_info_t di = {
+        .ino   = iso_ino(is_dir, r->lba, r->rec_pos),
+        .size  = r->size,
+        .mtime = (int64_t)iso_recdate_to_time(r->rec + 18),
+        .flags = r->flags,
+        .loc   = r->lba,
+    };
+    return vfs_dindex_add((vfs_dindex_t*)user, r->name, strlen(r->name), &di) == -ENOMEM;
+}
+
+/* One pass over the directory's records builds its name index. */
+static int iso_index_fill(struct inode *dir, vfs_dindex_t *dx) {
+    iso_inode_t *dip = (iso_inode_t*)dir->i_private;
+    int rc = iso_walk_dir(&dip->fs->iso, dip->extent_lba, dip->extent_size, iso_index_rec, dx);
+    return rc == 0 ? 0 : rc > 0 ? -ENOMEM : -EIO;
+}
+
 static int iso_lookup(struct inode *dir, const char *name, struct inode **out) {
     if (out) *out = NULL;
     if (!dir || !name || !out) return -EINVAL;
@@ -252,10 +333,20 @@ static int iso_lookup(struct inode *dir, const char *name, struct inode **out) {
     uint32_t lba = 0, size = 0;
     uint8_t  flags = 0;
 	time_t   mtime = 0;
-
-    int rc = iso_walk_component(&dip->fs->iso,
+    uint64_t rec_pos = 0, ino = 0;
+
+    /* names are stored lower-cased; lookups are case-insensitive */
+    vfs_dentry_info_t di;
+    int rc = vfs_dindex_lookup(dir, name, VFS_DINDEX_CASEFOLD, iso_index_fill, &di);
+    if (rc == 1) {
+        lba = (uint32_t)di.loc; size = (uint32_t)di.size;
+        flags = (uint8_t)di.flags; mtime = (time_t)di.mtime; ino = di.ino;
+    } else if (rc < 0) {
+        rc = iso_walk_component(&dip->fs->iso,
                                 dip->extent_lba, dip->extent_size,
-                                name, &lba, &size, &flags, &mtime);
+                                name, &lba, &size, &flags, &mtime, &rec_pos);
+        ino = iso_ino((flags & 0x02) != 0, lba, rec_pos);
+    }
     if (rc != 1) {
         DBG("iso_lookup: '%s' not found rc=%d", name, rc);
         return -ENOENT;
@@ -263,9 +354,16 @@ static int iso_lookup(struct inode *dir, const char *name, struct inode **out) {
 
     const bool is_dir = (flags & 0x02) != 0;
 
-    inode_t *child = (inode_t*)calloc(1, sizeof *child);
-    iso_inode_t *cip = (iso_inode_t*)calloc(1, sizeof *cip);
-    if (!child || !cip) { free(child); free(cip); return -ENOMEM; }
+    inode_t *child = vfs_iget(dir->i_sb, ino);
+    if (!child) return -ENOMEM;
+    if (!(child->i_state & VFS_I_NEW)) {
+        *out = child;
+        DBG("iso_lookup: name='%s' -> cached inode %llu", name, (unsigned long long)child->i_ino);
+        return 0;
+    }
+
+    iso_inode_t *cip = (iso_inode_t*)vfs_slab_alloc(&g_iso_inode_cache, dir->i_sb->s_slab);
+    if (!cip) { vfs_iget_failed(child); return -ENOMEM; }
 
     cip->fs          = dip->fs;
     cip->is_dir      = is_dir;
@@ -273,10 +371,10 @@ static int iso_lookup(struct inode *dir, const char *name, struct inode **out) {
     cip->extent_size = size;
 	cip->mtime       = mtime;
 
-    child->i_ino     = lba; // stable id: start LBA
     child->i_mode    = (is_dir ? VFS_S_IFDIR : VFS_S_IFREG) |
                        (is_dir ? VFS_MODE_DIR_0755 : VFS_MODE_FILE_0644);
-    child->i_sb      = dir->i_sb;
+    child->i_size    = size;
+    child->i_mtime   = (uint64_t)mtime;
     child->i_private = cip;
 
     // Inode ops: dir has .lookup, file does not
@@ -284,7 +382,9 @@ static int iso_lookup(struct inode *dir, const char *name, struct inode **out) {
 
     // File ops: single, file-scope tables
     child->i_fop = is_dir ? &FOPS_DIR : &ISO_FILE_FOPS;
+    if (!is_dir) child->i_data.a_ops = &ISO_AOPS;
 
+    vfs_unlock_new_inode(child);
     *out = child;
 
     DBG("iso_lookup: name='%s' -> lba=%u size=%u flags=0x%02X (%s)",
@@ -334,38 +434,39 @@ static int iso_mount_fs(vblk_t *dev, const char *opts, superblock_t **out_sb) {
     DBG("iso_mount_fs: iso_mount OK root=[lba=%u size=%u] bs=%u",
         fs->iso.root_lba, fs->iso.root_size, fs->iso.block_size);
 
-    superblock_t *sb = (superblock_t*)calloc(1, sizeof *sb);
-    if (!sb) { DBG("iso_mount_fs: calloc(sb) failed"); free(fs); return -1; }
+    superblock_t *sb = vfs_alloc_sb();
+    if (!sb) { DBG("iso_mount_fs: vfs_alloc_sb failed"); free(fs); return -1; }
+
+    static const super_ops_t SOP = {
+        .statfs      = iso_statfs,
+        .syncfs      = iso_syncfs,
+        .kill_sb     = iso_kill_sb,
+        .evict_inode = iso_evict_inode,
+    };
+    sb->s_op = &SOP;
 
-    inode_t *root = (inode_t*)calloc(1, sizeof *root);
-    if (!root) { DBG("iso_mount_fs: calloc(root) failed"); free(sb); free(fs); return -1; }
+    iso_inode_t *rip = (iso_inode_t*)vfs_slab_alloc(&g_iso_inode_cache, sb->s_slab);
+    if (!rip) { DBG("iso_mount_fs: alloc(rip) failed"); vfs_free_sb(sb); free(fs); return -1; }
 
-    iso_inode_t *rip = (iso_inode_t*)calloc(1, sizeof *rip);
-    if (!rip) { DBG("iso_mount_fs: calloc(rip) failed"); free(root); free(sb); free(fs); return -1; }
+    inode_t *root = vfs_iget(sb, iso_ino(true, fs->iso.root_lba, 0));
+    if (!root) { DBG("iso_mount_fs: vfs_iget(root) failed"); vfs_free_sb(sb); free(fs); return -1; }
 
     rip->fs          = fs;
     rip->is_dir      = true;
     rip->extent_lba  = fs->iso.root_lba;
     rip->extent_size = fs->iso.root_size;
 
-    root->i_ino     = rip->extent_lba; // handy for debugging
     root->i_mode    = VFS_S_IFDIR | VFS_MODE_DIR_0755;
-    root->i_sb      = sb;
+    root->i_size    = rip->extent_size;
     root->i_op      = &ISO_IOPS;
 	root->i_fop     = &FOPS_DIR;           // use the global one
     root->i_private = rip;
-
-    static const super_ops_t SOP = {
-        .statfs = iso_statfs,
-        .syncfs = iso_syncfs,
-        .kill_sb= iso_kill_sb,
-    };
+    vfs_unlock_new_inode(root);
 
     sb->fs_type = (struct filesystem_type *)&VFS_ISO9660;
     sb->bdev       = dev;
     sb->block_size = fs->iso.block_size ? fs->iso.block_size : 2048;   // reflect PVD, default 2048
     sb->root       = root;
-    sb->s_op       = &SOP;
     sb->fs_private = fs;
     sb->s_flags   |= VFS_SB_RDONLY;  // enforce read-only at VFS layer
 
@@ -388,7 +489,10 @@ const filesystem_type_t VFS_ISO9660 = {
     .umount = iso_umount_fs,
 };
 
-static ssize_t iso_dir_getdents64(struct file *dirf, void *buf, size_t bytes)
+/* One pass over the directory extent, packing either plain dirents or
+   dirent+attribute records; the attributes come straight from the record
+   being parsed. Each sector is read once. */
+static ssize_t iso_dir_fill(struct file *dirf, void *buf, size_t bytes, bool plus)
 {
     if (!dirf || !buf) return -1;
 
@@ -398,30 +502,32 @@ static ssize_t iso_dir_getdents64(struct file *dirf, void *buf, size_t bytes)
     const uint32_t bs   = dirf->f_inode->i_sb ? dirf->f_inode->i_sb->block_size : 2048;
     const uint32_t base = dip->extent_lba;
     const uint32_t dsz  = dip->extent_size;
+    const size_t   hdr  = plus ? offsetof(vfs_direntplus64_t, d_name)
+                               : offsetof(vfs_dirent64_t, d_name);
 
     uint64_t pos = dirf->f_pos;
     size_t written = 0;
 
-	DBG("iso_dir_getdents64: pos=%llu cap=%zu", (unsigned long long)dirf->f_pos, bytes);
-
-    DBG("iso_dir_getdents64: start pos=%llu cap=%zu (lba=%u size=%u)",
-        (unsigned long long)pos, bytes, base, dsz);
+    DBG("iso_dir_fill: start pos=%llu cap=%zu plus=%d (lba=%u size=%u)",
+        (unsigned long long)pos, bytes, (int)plus, base, dsz);
 
     // minimal space: header + 1 char name + NUL
-    const size_t MIN_ENTRY = offsetof(vfs_dirent64_t, d_name) + 2;
-    if (bytes < MIN_ENTRY) return -EINVAL;
+    if (bytes < hdr + 2) return -EINVAL;
+
+    uint8_t  sec[2048];
+    uint32_t sec_loaded = UINT32_MAX;
 
     while (pos < dsz) {
         uint32_t si = (uint32_t)(pos / bs);
         uint32_t so = (uint32_t)(pos % bs);
 
-        uint8_t sec[2048];
-        if (!iso_read_sector(&dip->fs->iso, base + si, sec)) {
-            return (written > 0) ? (ssize_t)written : -EIO;
+        if (si != sec_loaded) {
+            if (!iso_read_sector(&dip->fs->iso, base + si, sec)) {
+                return (written > 0) ? (ssize_t)written : -EIO;
+            }
+            sec_loaded = si;
         }
 
-        if (so >= bs) { pos = (uint64_t)(si + 1) * bs; continue; }
-
         uint8_t *rec = sec + so;
         uint8_t  len = rec[0];
 
@@ -431,8 +537,8 @@ static ssize_t iso_dir_getdents64(struct file *dirf, void *buf, size_t bytes)
         uint8_t  id_len   = rec[32];
         const uint8_t *id = rec + 33;
 
-        uint32_t extent_lba = (uint32_t)rec[2] | ((uint32_t)rec[3]<<8) | ((uint32_t)rec[4]<<16) | ((uint32_t)rec[5]<<24);
-        uint32_t data_len   = (uint32_t)rec[10]| ((uint32_t)rec[11]<<8)| ((uint32_t)rec[12]<<16)| ((uint32_t)rec[13]<<24);
+        uint32_t extent_lba = rd_le32(rec + 2);
+        uint32_t data_len   = rd_le32(rec + 10);
         uint8_t  flags      = rec[25];
 
         // Build printable name
@@ -448,36 +554,63 @@ static ssize_t iso_dir_getdents64(struct file *dirf, void *buf, size_t bytes)
                 unsigned char c = id[i];
                 if (c == 0) { n = i; break; }
                 if (c == '/') c = '_';
-                if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
-                name[i] = (char)c;
+                name[i] = (char)to_upper_ascii(c);
             }
             name[n] = '\0';
             char *semi = strchr(name, ';'); if (semi) *semi = '\0';
         }
 
-        uint8_t dtype = (flags & 0x02) ? VFS_DT_DIR : VFS_DT_REG;
+        const bool is_dir = (flags & 0x02) != 0;
+        const uint64_t ino = iso_ino(is_dir, extent_lba, (uint64_t)base * bs + pos);
 
-        // Pack one dirent (aligned to 8 bytes)
-        size_t need   = offsetof(vfs_dirent64_t, d_name) + strlen(name) + 1;
-        size_t reclen = (need + 7u) & ~7u;
+        // Pack one record (aligned to 8 bytes)
+        size_t nlen   = strlen(name);
+        size_t reclen = (hdr + nlen + 1 + 7u) & ~(size_t)7u;
 
         if (written + reclen > bytes) break; // buffer full; return what we have
 
-        vfs_dirent64_t *de = (vfs_dirent64_t *)((uint8_t*)buf + written);
-        de->d_ino    = extent_lba;
-        de->d_off    = (int64_t)(pos + len);   // next file position
-        de->d_reclen = (uint16_t)reclen;
-        de->d_type   = dtype;
-        memcpy(de->d_name, name, strlen(name) + 1);
+        uint8_t *at = (uint8_t*)buf + written;
+        if (plus) {
+            vfs_direntplus64_t *de = (vfs_direntplus64_t *)at;
+            memset(de, 0, hdr);
+            de->d_ino    = ino;
+            de->d_off    = (int64_t)(pos + len);
+            de->d_reclen = (uint16_t)reclen;
+            de->d_type   = is_dir ? VFS_DT_DIR : VFS_DT_REG;
+            de->d_flags  = VFS_DIRENTPLUS_STAT;
+            de->d_stat.st_ino     = ino;
+            de->d_stat.st_mode    = is_dir ? (VFS_S_IFDIR | VFS_MODE_DIR_0755)
+                                           : (VFS_S_IFREG | VFS_MODE_FILE_0644);
+            de->d_stat.st_nlink   = 1;
+            de->d_stat.st_size    = data_len;
+            de->d_stat.st_blksize = bs;
+            de->d_stat.st_mtime   = iso_recdate_to_time(rec + 18);
+            memcpy(de->d_name, name, nlen + 1);
+        } else {
+            vfs_dirent64_t *de = (vfs_dirent64_t *)at;
+            de->d_ino    = ino;
+            de->d_off    = (int64_t)(pos + len);   // next file position
+            de->d_reclen = (uint16_t)reclen;
+            de->d_type   = is_dir ? VFS_DT_DIR : VFS_DT_REG;
+            memcpy(de->d_name, name, nlen + 1);
+        }
 
         written += reclen;
         pos     += len;
-
-        (void)data_len; // not needed here
     }
 
     dirf->f_pos = pos;
-    DBG("iso_dir_getdents64: wrote=%zu newpos=%llu",
+    DBG("iso_dir_fill: wrote=%zu newpos=%llu",
         written, (unsigned long long)pos);
     return (ssize_t)written;
-}
\ No newline at end of file
+}
+
+static ssize_t iso_dir_getdents64(struct file *dirf, void *buf, size_t bytes)
+{
+    return iso_dir_fill(dirf, buf, bytes, false);
+}
+
+static ssize_t iso_dir_getdents64_plus(struct file *dirf, void *buf, size_t bytes)
+{
+    return iso_dir_fill(dirf, buf, bytes, true);
+}
@@ -0,0 +1,138 @@
+// src/vfs_mmap.c — read-only file mappings (vfs_mmap / vfs_munmap)
+//
+// A range that the driver's fiemap reports as one extent on the
+// superblock's device is mapped straight out of the backing image
+// (vblk_map_range), so the caller reads the image's pages in place. Anything
+// else — split or unknown extents, device-less filesystems, hosts without
+// mmap — gets an anonymous mapping filled through vfs_pread (and so through
+// the page cache) and then write-protected.
+//
+// Live mappings sit on one list so vfs_munmap only needs the address.
+
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE             /* MAP_ANONYMOUS under strict -std=c11 */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "vblk.h"
+#include "diskio.h"
+#include "gu_sync.h"
+
+typedef struct vfs_mapping {
+    const void         *addr;
+    size_t              len;
+    bool                direct;     /* image mapping, else anonymous copy */
+    struct vfs_mapping *next;
+} vfs_mapping_t;
+
+static vfs_mapping_t   *g_maps = NULL;
+static vfs_mmap_stats_t g_mm;
+static gu_mutex_t       g_mm_lock = GU_MUTEX_INIT;
+
+/* The single extent holding all of [off, off+len) on sb->bdev, if any. */
+static const void *map_direct(struct file *f, uint64_t off, size_t len) {
+    superblock_t *sb = f->f_inode->i_sb;
+    if (!sb || !sb->bdev || !f->f_op || !f->f_op->fiemap) return NULL;
+    vfs_extent_t ext;
+    unsigned n = 0;
+    if (vfs_fiemap(f, off, len, &ext, 1, &n) != 0 || n != 1) return NULL;
+    if (ext.fe_flags & VFS_FIEMAP_EXTENT_UNKNOWN) return NULL;
+    if (ext.fe_logical > off || ext.fe_logical + ext.fe_length < off + len) return NULL;
+    return vblk_map_range(sb->bdev, ext.fe_physical + (off - ext.fe_logical), len);
+}
+
+static void *anon_alloc(size_t len) {
+#if !defined(_WIN32)
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+#else
+    return malloc(len);
+#endif
+}
+
+static void anon_free(void *p, size_t len) {
+#if !defined(_WIN32)
+    (void)munmap(p, len);
+#else
+    (void)len;
+    free(p);
+#endif
+}
+
+static const void *map_copy(struct file *f, uint64_t off, size_t len) {
+    uint8_t *p = (uint8_t*)anon_alloc(len);
+    if (!p) return NULL;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = vfs_pread(f, p + done, len - done, off + done);
+        if (r <= 0) { anon_free(p, len); return NULL; }
+        done += (size_t)r;
+    }
+#if !defined(_WIN32)
+    (void)mprotect(p, len, PROT_READ);
+#endif
+    return p;
+}
+
+const void *vfs_mmap(struct file *f, uint64_t off, size_t len) {
+    if (!f || !f->f_inode || !VFS_S_ISREG(f->f_inode->i_mode) || len == 0) return NULL;
+    const uint64_t isz = f->f_inode->i_size;
+    if (off > isz || len > isz - off) return NULL;
+
+    vfs_mapping_t *m = (vfs_mapping_t*)malloc(sizeof *m);
+    if (!m) return NULL;
+    m->len = len;
+    m->addr = map_direct(f, off, len);
+    m->direct = m->addr != NULL;
+    if (!m->addr) m->addr = map_copy(f, off, len);
+    if (!m->addr) { free(m); return NULL; }
+    DBG("vfs_mmap: ino=%llu off=%llu len=%zu %s",
+        (unsigned long long)f->f_inode->i_ino, (unsigned long long)off, len,
+        m->direct ? "direct" : "copied");
+
+    gu_mutex_lock(&g_mm_lock);
+    m->next = g_maps;
+    g_maps = m;
+    if (m->direct) g_mm.direct++; else g_mm.copied++;
+    g_mm.live++;
+    g_mm.live_bytes += len;
+    gu_mutex_unlock(&g_mm_lock);
+    return m->addr;
+}
+
+int vfs_munmap(const void *addr) {
+    if (!addr) return -EINVAL;
+    gu_mutex_lock(&g_mm_lock);
+    vfs_mapping_t **pp = &g_maps;
+    while (*pp && (*pp)->addr != addr) pp = &(*pp)->next;
+    vfs_mapping_t *m = *pp;
+    if (m) {
+        *pp = m->next;
+        g_mm.live--;
+        g_mm.live_bytes -= m->len;
+    }
+    gu_mutex_unlock(&g_mm_lock);
+    if (!m) return -EINVAL;
+
+    if (m->direct) diskio_unmap_range(m->addr, m->len);
+    else           anon_free((void*)m->addr, m->len);
+    free(m);
+    return 0;
+}
+
+void vfs_mmap_get_stats(vfs_mmap_stats_t *out) {
+    if (!out) return;
+    gu_mutex_lock(&g_mm_lock);
+    *out = g_mm;
+    gu_mutex_unlock(&g_mm_lock);
+}
@@ -0,0 +1,165 @@
+// src/vfs_opstats.c — per-superblock operation counters and latency histograms
+//
+// Each superblock owns VFS_OPSTAT_SHARDS copies of its counters. A thread is
+// given a shard the first time it records anything and keeps it, so as long
+// as there are no more busy threads than shards every cache line is written
+// by one thread only: the hot path is two clock reads and a handful of
+// uncontended relaxed adds, with no locks. Readers sum the shards; a snapshot
+// taken while other threads run may be a few events behind, never torn.
+//
+// Operations that fail before reaching a mount (bad path, no mount) are
+// charged to a static block that vfs_sb_stats_get(NULL, ...) reports.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "vfs.h"
+
+#ifndef VFS_OPSTAT_SHARDS
+#define VFS_OPSTAT_SHARDS 8
+#endif
+
+typedef struct {
+    _Atomic uint64_t calls, errors, bytes, ns;
+    _Atomic uint64_t hist[VFS_OPSTAT_BUCKETS];
+} op_ctr_t;
+
+typedef struct {
+    op_ctr_t         op[VFS_OP_NR];
+    _Atomic uint64_t icache_hits, icache_misses;
+} opstat_shard_t;
+
+struct vfs_opstats {
+    opstat_shard_t shard[VFS_OPSTAT_SHARDS];
+};
+
+static struct vfs_opstats g_nomount;
+static atomic_uint         g_next_shard;
+static _Thread_local int   t_shard = -1;
+
+static const char *const g_op_names[VFS_OP_NR] = {
+    [VFS_OP_OPEN]     = "open",
+    [VFS_OP_LOOKUP]   = "lookup",
+    [VFS_OP_STAT]     = "stat",
+    [VFS_OP_GETDENTS] = "getdents",
+    [VFS_OP_READ]     = "read",
+    [VFS_OP_WRITE]    = "write",
+};
+
+const char *vfs_op_name(vfs_op_t op) {
+    return (unsigned)op < VFS_OP_NR ? g_op_names[op] : "?";
+}
+
+static inline opstat_shard_t *my_shard(superblock_t *sb) {
+    if (t_shard < 0)
+        t_shard = (int)(atomic_fetch_add_explicit(&g_next_shard, 1, memory_order_relaxed)
+                        % VFS_OPSTAT_SHARDS);
+    struct vfs_opstats *s = (sb && sb->s_stats) ? sb->s_stats : &g_nomount;
+    return &s->shard[t_shard];
+}
+
+static inline void bump(_Atomic uint64_t *c, uint64_t v) {
+    atomic_fetch_add_explicit(c, v, memory_order_relaxed);
+}
+
+/* floor(log2(ns)), clamped to the last bucket; 0 ns lands in bucket 0. */
+static inline unsigned lat_bucket(uint64_t ns) {
+    unsigned b = 0;
+    if (ns >> 32) { ns >>= 32; b += 32; }
+    if (ns >> 16) { ns >>= 16; b += 16; }
+    if (ns >> 8)  { ns >>= 8;  b += 8; }
+    if (ns >> 4)  { ns >>= 4;  b += 4; }
+    if (ns >> 2)  { ns >>= 2;  b += 2; }
+    if (ns >> 1)  {            b += 1; }
+    return b < VFS_OPSTAT_BUCKETS ? b : VFS_OPSTAT_BUCKETS - 1;
+}
+
+uint64_t vfs_op_begin(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void vfs_op_end(superblock_t *sb, vfs_op_t op, uint64_t t0, int64_t rc) {
+    if ((unsigned)op >= VFS_OP_NR) return;
+    uint64_t t1 = vfs_op_begin();
+    uint64_t ns = t1 > t0 ? t1 - t0 : 0;
+    op_ctr_t *c = &my_shard(sb)->op[op];
+    bump(&c->calls, 1);
+    bump(&c->ns, ns);
+    bump(&c->hist[lat_bucket(ns)], 1);
+    if (rc < 0) bump(&c->errors, 1);
+    else if (op == VFS_OP_READ || op == VFS_OP_WRITE) bump(&c->bytes, (uint64_t)rc);
+}
+
+void vfs_icache_account(superblock_t *sb, bool hit) {
+    opstat_shard_t *s = my_shard(sb);
+    bump(hit ? &s->icache_hits : &s->icache_misses, 1);
+}
+
+static inline uint64_t rd(const _Atomic uint64_t *c) {
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+void vfs_sb_stats_get(const superblock_t *sb, vfs_sb_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof *out);
+    const struct vfs_opstats *s = sb ? sb->s_stats : &g_nomount;
+    if (!s) return;
+    for (int i = 0; i < VFS_OPSTAT_SHARDS; ++i) {
+        const opstat_shard_t *sh = &s->shard[i];
+        for (int op = 0; op < VFS_OP_NR; ++op) {
+            const op_ctr_t *c = &sh->op[op];
+            vfs_op_stats_t *o = &out->op[op];
+            o->calls  += rd(&c->calls);
+            o->errors += rd(&c->errors);
+            o->bytes  += rd(&c->bytes);
+            o->ns     += rd(&c->ns);
+            for (int b = 0; b < VFS_OPSTAT_BUCKETS; ++b) o->hist[b] += rd(&c->hist[b]);
+        }
+        out->icache_hits   += rd(&sh->icache_hits);
+        out->icache_misses += rd(&sh->icache_misses);
+    }
+}
+
+void vfs_sb_stats_reset(superblock_t *sb) {
+    struct vfs_opstats *s = sb ? sb->s_stats : &g_nomount;
+    if (!s) return;
+    for (int i = 0; i < VFS_OPSTAT_SHARDS; ++i) {
+        opstat_shard_t *sh = &s->shard[i];
+        for (int op = 0; op < VFS_OP_NR; ++op) {
+            op_ctr_t *c = &sh->op[op];
+            atomic_store_explicit(&c->calls,  0, memory_order_relaxed);
+            atomic_store_explicit(&c->errors, 0, memory_order_relaxed);
+            atomic_store_explicit(&c->bytes,  0, memory_order_relaxed);
+            atomic_store_explicit(&c->ns,     0, memory_order_relaxed);
+            for (int b = 0; b < VFS_OPSTAT_BUCKETS; ++b)
+                atomic_store_explicit(&c->hist[b], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&sh->icache_hits,   0, memory_order_relaxed);
+        atomic_store_explicit(&sh->icache_misses, 0, memory_order_relaxed);
+    }
+}
+
+uint64_t vfs_op_stats_quantile(const vfs_op_stats_t *s, double q) {
+    if (!s || s->calls == 0) return 0;
+    uint64_t want = (uint64_t)(q * (double)s->calls + 0.5);
+    if (want == 0) want = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < VFS_OPSTAT_BUCKETS; ++b) {
+        seen += s->hist[b];
+        if (seen >= want) return (uint64_t)2 << b;
+    }
+    return (uint64_t)2 << (VFS_OPSTAT_BUCKETS - 1);
+}
+
+struct vfs_opstats *vfs_opstats_new(void) {
+    return (struct vfs_opstats*)calloc(1, sizeof(struct vfs_opstats));
+}
+
+void vfs_opstats_free(struct vfs_opstats *s) {
+    free(s);
+}
@@ -0,0 +1,682 @@
+// src/vfs_overlay.c — overlay filesystem: writable upper dir over a read-only lower dir
+// Usage: mount -t overlay -o lowerdir=/iso,upperdir=/t none /merged
+//
+// Both layers are ordinary directories somewhere in the VFS (an ISO or ext2
+// mount below, tmpfs or ext2 on top) and are only reached through the public
+// vfs_* calls, so each layer's own superblock lock still guards it. The
+// overlay's lock is always taken first and the layers never call back up.
+//
+// Every name seen so far has an ovl_node_t keyed by its parent node and its
+// interned name (so a repeat lookup is one hash probe and pointer compares),
+// recording which layers hold it and its path relative to the overlay root
+// for reaching the layers; nodes give stable inode
+// numbers and live until umount (there is no unlink/rename yet, so a name
+// never stops existing). A lookup consults the upper layer, then the lower.
+// Opening a lower file for writing copies it up first (parent directories,
+// then data unless O_TRUNC makes that pointless); read-only opens and
+// unmodified files are served straight from the lower layer. Directory
+// listings are merged once — upper entries shadow lower ones — and cached on
+// the directory node with each entry's attributes until something in that
+// directory changes.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "vfs_stat.h"
+#include "gu_arena.h"
+#include "gu_sync.h"
+
+#define OVL_MIN_BUCKETS 64u
+
+typedef struct ovl_dent {
+    char         *name;
+    uint64_t      ino;
+    uint8_t       type;         /* VFS_DT_* */
+    uint8_t       layer;        /* 0 upper, 1 lower (merge order) */
+    bool          has_stat;
+    struct g_stat st;
+} ovl_dent_t;
+
+/* Merged listing; open directory handles keep a reference. */
+typedef struct ovl_dir {
+    _Atomic int refs;
+    size_t      n, cap;
+    ovl_dent_t *v;
+} ovl_dir_t;
+
+typedef struct ovl_node {
+    vfs_atom_t       name;      /* "" for the root */
+    char            *rel;       /* "" for the root, else "a/b/c" */
+    uint64_t         ino;
+    uint32_t         mode;
+    _Atomic bool     upper, lower;  /* only ever go false -> true */
+    struct ovl_node *parent;
+    struct ovl_node *hnext;
+    ovl_dir_t       *dir;       /* cached listing (directories) */
+} ovl_node_t;
+
+static VFS_SLAB_CACHE(g_ovl_node_cache, "ovl_node", ovl_node_t);
+
+typedef struct ovl_fs {
+    vfs_slab_owner_t *own;
+    char        *lowerdir, *upperdir;
+    ovl_node_t  *root;
+    ovl_node_t **tab;           /* node hash by (parent, name) */
+    size_t       cap, n;
+    uint64_t     next_ino;
+    gu_mutex_t   lock;          /* tab and every node's dir pointer */
+} ovl_fs_t;
+
+static const inode_ops_t OVL_IOPS;
+static const file_ops_t  OVL_FOPS_FILE;
+static const file_ops_t  OVL_FOPS_DIR;
+
+static ovl_fs_t *fs_of(const inode_t *inode) { return (ovl_fs_t*)inode->i_sb->fs_private; }
+
+/* Path of 'rel' inside a layer; arena memory, so callers bracket with a mark. */
+static char *layer_path(const char *root, const char *rel) {
+    if (!rel[0]) return gu_arena_strdup(root);
+    size_t lr = strlen(root);
+    return gu_arena_printf("%s%s%s", root, (lr && root[lr - 1] == '/') ? "" : "/", rel);
+}
+
+/* ---------- listings ---------- */
+
+static void dir_put(ovl_dir_t *d) {
+    if (!d || atomic_fetch_sub_explicit(&d->refs, 1, memory_order_acq_rel) != 1) return;
+    for (size_t i = 0; i < d->n; ++i) free(d->v[i].name);
+    free(d->v);
+    free(d);
+}
+
+/* Something in directory 'n' changed: the next open lists it again. */
+static void dir_invalidate(ovl_fs_t *fs, ovl_node_t *n) {
+    if (!n) return;
+    gu_mutex_lock(&fs->lock);
+    ovl_dir_t *d = n->dir;
+    n->dir = NULL;
+    gu_mutex_unlock(&fs->lock);
+    dir_put(d);
+}
+
+static bool dir_add(ovl_dir_t *d, const vfs_direntplus64_t *de, uint8_t layer) {
+    if (d->n == d->cap) {
+        size_t nc = d->cap ? d->cap * 2 : 32;
+        ovl_dent_t *nv = (ovl_dent_t*)realloc(d->v, nc * sizeof *nv);
+        if (!nv) return false;
+        d->v = nv;
+        d->cap = nc;
+    }
+    ovl_dent_t *e = &d->v[d->n];
+    memset(e, 0, sizeof *e);
+    size_t len = strlen(de->d_name);
+    e->name = (char*)malloc(len + 1);
+    if (!e->name) return false;
+    memcpy(e->name, de->d_name, len + 1);
+    e->type     = de->d_type;
+    e->layer    = layer;
+    e->has_stat = (de->d_flags & VFS_DIRENTPLUS_STAT) != 0;
+    if (e->has_stat) e->st = de->d_stat;
+    d->n++;
+    return true;
+}
+
+static bool dir_read_layer(ovl_dir_t *d, const char *path, uint8_t layer) {
+    struct file *f = NULL;
+    if (vfs_open(path, VFS_O_RDONLY | VFS_O_DIRECTORY, 0, &f) != 0) return false;
+    uint8_t buf[8192];
+    bool ok = true;
+    ssize_t n;
+    while (ok && (n = vfs_readdirplus(f, buf, sizeof buf)) > 0) {
+        for (size_t off = 0; off < (size_t)n; ) {
+            const vfs_direntplus64_t *de = (const vfs_direntplus64_t*)(buf + off);
+            off += de->d_reclen;
+            if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) continue;
+            if (!dir_add(d, de, layer)) { ok = false; break; }
+        }
+    }
+    vfs_close(f);
+    return ok;
+}
+
+static int dent_cmp(const void *a, const void *b) {
+    const ovl_dent_t *x = (const ovl_dent_t*)a, *y = (const ovl_dent_t*)b;
+    int c = strcmp(x->name, y->name);
+    return c ? c : (int)x->layer - (int)y->layer;
+}
+
+static ovl_node_t *node_get(ovl_fs_t *fs, ovl_node_t *parent, const char *name, uint32_t mode,
+                            bool upper, bool lower);
+
+/* Merge upper over lower, sorted by name; upper wins on duplicates. */
+static ovl_dir_t *dir_build(ovl_fs_t *fs, ovl_node_t *dn) {
+    ovl_dir_t *d = (ovl_dir_t*)calloc(1, sizeof *d);
+    if (!d) return NULL;
+    atomic_init(&d->refs, 1);
+
+    gu_arena_mark_t m = gu_arena_mark();
+    bool ok = (!dn->upper || dir_read_layer(d, layer_path(fs->upperdir, dn->rel), 0)) &&
+              (!dn->lower || dir_read_layer(d, layer_path(fs->lowerdir, dn->rel), 1));
+    gu_arena_release(m);
+    if (!ok) { dir_put(d); return NULL; }
+
+    if (d->n > 1) qsort(d->v, d->n, sizeof *d->v, dent_cmp);
+    size_t w = 0;
+    for (size_t i = 0; i < d->n; ++i) {
+        if (w && strcmp(d->v[w - 1].name, d->v[i].name) == 0) {
+            ovl_dent_t *keep = &d->v[w - 1];
+            if (d->v[i].layer == 1 && keep->layer == 0) keep->layer = 2;   /* in both */
+            free(d->v[i].name);
+            continue;
+        }
+        d->v[w++] = d->v[i];
+    }
+    d->n = w;
+
+    for (size_t i = 0; i < d->n; ++i) {
+        ovl_dent_t *e = &d->v[i];
+        uint32_t mode = e->has_stat ? e->st.st_mode
+                                    : (e->type == VFS_DT_DIR ? VFS_S_IFDIR | 0755 : VFS_S_IFREG | 0644);
+        ovl_node_t *cn = node_get(fs, dn, e->name, mode, e->layer != 1, e->layer != 0);
+        if (!cn) { dir_put(d); return NULL; }
+        e->ino = cn->ino;
+        if (e->has_stat) e->st.st_ino = cn->ino;
+    }
+    return d;
+}
+
+/* Referenced listing for dn, building it when there is none. */
+static ovl_dir_t *dir_get(ovl_fs_t *fs, ovl_node_t *dn) {
+    gu_mutex_lock(&fs->lock);
+    ovl_dir_t *d = dn->dir;
+    if (d) atomic_fetch_add_explicit(&d->refs, 1, memory_order_relaxed);
+    gu_mutex_unlock(&fs->lock);
+    if (d) return d;
+
+    d = dir_build(fs, dn);
+    if (!d) return NULL;
+    gu_mutex_lock(&fs->lock);
+    if (!dn->dir) {
+        dn->dir = d;
+        atomic_fetch_add_explicit(&d->refs, 1, memory_order_relaxed);
+    }
+    gu_mutex_unlock(&fs->lock);
+    DBG("overlay: listed '%s': %zu entries", dn->rel, d->n);
+    return d;
+}
+
+/* ---------- nodes ---------- */
+
+/* The root is its own parent; it is keyed under parent NULL. */
+static const ovl_node_t *key_parent(const ovl_node_t *n) { return n->parent == n ? NULL : n->parent; }
+
+static uint32_t node_hash(const ovl_node_t *parent, vfs_atom_t name) {
+    return name->hash ^ (uint32_t)((parent ? parent->ino : 0) * 0x9E3779B1u);
+}
+
+static ovl_node_t *tab_find(const ovl_fs_t *fs, const ovl_node_t *parent, vfs_atom_t name) {
+    if (!fs->cap || !name) return NULL;
+    for (ovl_node_t *n = fs->tab[node_hash(parent, name) & (fs->cap - 1)]; n; n = n->hnext)
+        if (n->name == name && key_parent(n) == parent) return n;
+    return NULL;
+}
+
+static bool tab_grow(ovl_fs_t *fs) {
+    size_t nc = fs->cap ? fs->cap * 2 : OVL_MIN_BUCKETS;
+    ovl_node_t **nt = (ovl_node_t**)calloc(nc, sizeof *nt);
+    if (!nt) return false;
+    for (size_t i = 0; i < fs->cap; ++i) {
+        for (ovl_node_t *n = fs->tab[i], *next; n; n = next) {
+            next = n->hnext;
+            size_t s = node_hash(key_parent(n), n->name) & (nc - 1);
+            n->hnext = nt[s];
+            nt[s] = n;
+        }
+    }
+    free(fs->tab);
+    fs->tab = nt;
+    fs->cap = nc;
+    return true;
+}
+
+/* Find or register parent/name. Layer flags only ever get added. */
+static ovl_node_t *node_get(ovl_fs_t *fs, ovl_node_t *parent, const char *name, uint32_t mode,
+                            bool upper, bool lower) {
+    vfs_atom_t an = vfs_intern(name, strlen(name));
+    if (!an) return NULL;
+    gu_arena_mark_t m = gu_arena_mark();
+    const char *rel = parent && parent->rel[0] ? gu_arena_printf("%s/%s", parent->rel, name) : name;
+    gu_mutex_lock(&fs->lock);
+    ovl_node_t *n = tab_find(fs, parent, an);
+    if (!n && rel && (fs->n < fs->cap || tab_grow(fs))) {
+        n = (ovl_node_t*)vfs_slab_alloc(&g_ovl_node_cache, fs->own);
+        if (n) n->rel = vfs_slab_strdup(fs->own, rel);
+        if (n && !n->rel) { vfs_slab_free(n); n = NULL; }
+        if (n) {
+            n->name   = an;
+            n->ino    = fs->next_ino++;
+            n->mode   = mode;
+            n->parent = parent ? parent : n;
+            size_t s  = node_hash(parent, an) & (fs->cap - 1);
+            n->hnext  = fs->tab[s];
+            fs->tab[s] = n;
+            fs->n++;
+        }
+    }
+    if (n && upper) n->upper = true;
+    if (n && lower) n->lower = true;
+    gu_mutex_unlock(&fs->lock);
+    gu_arena_release(m);
+    return n;
+}
+
+static int node_stat(ovl_fs_t *fs, const ovl_node_t *n, struct g_stat *st) {
+    gu_arena_mark_t m = gu_arena_mark();
+    int rc = vfs_stat(layer_path(n->upper ? fs->upperdir : fs->lowerdir, n->rel), st);
+    gu_arena_release(m);
+    if (rc != 0) return -ENOENT;
+    st->st_ino = n->ino;
+    return 0;
+}
+
+static int node_iget(superblock_t *sb, ovl_node_t *n, inode_t **out) {
+    inode_t *inode = vfs_iget(sb, n->ino);
+    if (!inode) return -ENOMEM;
+    if (inode->i_state & VFS_I_NEW) {
+        struct g_stat st;
+        if (node_stat((ovl_fs_t*)sb->fs_private, n, &st) != 0) {
+            vfs_iget_failed(inode);
+            return -ENOENT;
+        }
+        inode->i_mode    = st.st_mode;
+        inode->i_size    = st.st_size;
+        inode->i_mtime   = (uint64_t)st.st_mtim.tv_sec;
+        inode->i_nlink   = 1;
+        inode->i_op      = &OVL_IOPS;
+        inode->i_fop     = VFS_S_ISDIR(st.st_mode) ? &OVL_FOPS_DIR : &OVL_FOPS_FILE;
+        inode->i_private = n;
+        vfs_unlock_new_inode(inode);
+    }
+    *out = inode;
+    return 0;
+}
+
+/* Make n exist in the upper layer: parents first, then n itself. A file's
+   data comes along unless the caller is about to truncate it anyway. */
+static int copy_up(ovl_fs_t *fs, ovl_node_t *n, bool data) {
+    if (n->upper) return 0;
+    int rc = copy_up(fs, n->parent, true);
+    if (rc != 0) return rc;
+
+    gu_arena_mark_t m = gu_arena_mark();
+    const char *up = layer_path(fs->upperdir, n->rel);
+    const char *lo = layer_path(fs->lowerdir, n->rel);
+    uint64_t bytes = 0;
+    if (VFS_S_ISDIR(n->mode)) {
+        struct g_stat st;
+        if (vfs_mkdir(up, n->mode & 07777) != 0 && (vfs_stat(up, &st) != 0 || !VFS_S_ISDIR(st.st_mode)))
+            rc = -EIO;
+    } else {
+        struct file *in = NULL, *out = NULL;
+        if (vfs_open(up, VFS_O_WRONLY | VFS_O_CREAT | VFS_O_TRUNC, n->mode & 07777, &out) != 0) rc = -EIO;
+        else if (data && vfs_open(lo, VFS_O_RDONLY, 0, &in) != 0) rc = -EIO;
+        while (rc == 0 && in) {
+            ssize_t c = vfs_copy_file_range(in, NULL, out, NULL, (size_t)1 << 30, 0);
+            if (c < 0) rc = -EIO;
+            if (c <= 0) break;
+            bytes += (uint64_t)c;
+        }
+        if (in) vfs_close(in);
+        if (out && vfs_close(out) != 0 && rc == 0) rc = -EIO;
+    }
+    gu_arena_release(m);
+    if (rc != 0) return rc;
+
+    n->upper = true;
+    dir_invalidate(fs, n->parent);
+    DBG("overlay: copied up '%s' (%llu bytes)", n->rel, (unsigned long long)bytes);
+    return 0;
+}
+
+/* ---------- inode ops ---------- */
+
+static int ovl_lookup(struct inode *dir, const char *name, struct inode **out) {
+    if (out) *out = NULL;
+    if (!dir || !name || !out) return -EINVAL;
+    ovl_fs_t *fs = fs_of(dir);
+    ovl_node_t *dn = (ovl_node_t*)dir->i_private;
+    if (!dn || !VFS_S_ISDIR(dn->mode)) return -ENOTDIR;
+
+    /* nodes hold interned names, so a name nobody interned has no node yet;
+       only node_get interns, and only names that exist in a layer */
+    vfs_atom_t an = vfs_intern_find(name, strlen(name));
+    ovl_node_t *n = NULL;
+    if (an) {
+        gu_mutex_lock(&fs->lock);
+        n = tab_find(fs, dn, an);
+        gu_mutex_unlock(&fs->lock);
+    }
+
+    if (!n) {
+        gu_arena_mark_t m = gu_arena_mark();
+        const char *rel = dn->rel[0] ? gu_arena_printf("%s/%s", dn->rel, name) : name;
+        struct g_stat st;
+        if (!rel) n = NULL;
+        else if (dn->upper && vfs_stat(layer_path(fs->upperdir, rel), &st) == 0)
+            n = node_get(fs, dn, name, st.st_mode, true, false);
+        else if (dn->lower && vfs_stat(layer_path(fs->lowerdir, rel), &st) == 0)
+            n = node_get(fs, dn, name, st.st_mode, false, true);
+        gu_arena_release(m);
+    }
+    if (!n) return -ENOENT;
+    return node_iget(dir->i_sb, n, out);
+}
+
+static int ovl_getattr(struct inode *inode, struct g_stat *st) {
+    if (!inode || !st) return -1;
+    ovl_node_t *n = (ovl_node_t*)inode->i_private;
+    return n && node_stat(fs_of(inode), n, st) == 0 ? 0 : -1;
+}
+
+static int ovl_make(struct inode *dir, const char *name, uint32_t mode, ovl_node_t **out) {
+    ovl_fs_t *fs = fs_of(dir);
+    ovl_node_t *dn = (ovl_node_t*)dir->i_private;
+    if (!dn || !VFS_S_ISDIR(dn->mode)) return -ENOTDIR;
+    if (!name[0] || strlen(name) > 255 || strchr(name, '/')) return -EINVAL;
+    inode_t *existing = NULL;
+    if (ovl_lookup(dir, name, &existing) == 0) { vfs_iput(existing); return -EEXIST; }
+
+    int rc = copy_up(fs, dn, true);
+    if (rc != 0) return rc;
+    gu_arena_mark_t m = gu_arena_mark();
+    const char *rel = dn->rel[0] ? gu_arena_printf("%s/%s", dn->rel, name) : name;
+    const char *up = rel ? layer_path(fs->upperdir, rel) : NULL;
+    if (!up) rc = -ENOMEM;
+    else if (VFS_S_ISDIR(mode)) rc = vfs_mkdir(up, mode & 07777) == 0 ? 0 : -EIO;
+    else {
+        struct file *f = NULL;
+        rc = vfs_open(up, VFS_O_WRONLY | VFS_O_CREAT, mode & 07777, &f) == 0 ? 0 : -EIO;
+        if (f) vfs_close(f);
+    }
+    gu_arena_release(m);
+    if (rc != 0) return rc;
+
+    *out = node_get(fs, dn, name, mode, true, false);
+    dir_invalidate(fs, dn);
+    return *out ? 0 : -ENOMEM;
+}
+
+static int ovl_create(struct inode *dir, const char *name, uint32_t mode, struct inode **out) {
+    if (!dir || !name || !out) return -EINVAL;
+    ovl_node_t *n = NULL;
+    int rc = ovl_make(dir, name, VFS_S_IFREG | (mode & 07777), &n);
+    if (rc != 0) return rc;
+    return node_iget(dir->i_sb, n, out);
+}
+
+static int ovl_mkdir(struct inode *dir, const char *name, uint32_t mode) {
+    if (!dir || !name) return -EINVAL;
+    ovl_node_t *n = NULL;
+    return ovl_make(dir, name, VFS_S_IFDIR | (mode & 07777), &n);
+}
+
+/* Only reached for O_TRUNC opens, whose upper file was already truncated. */
+static int ovl_truncate(struct inode *inode, uint64_t size) {
+    ovl_node_t *n = inode ? (ovl_node_t*)inode->i_private : NULL;
+    if (!n || VFS_S_ISDIR(n->mode)) return -EISDIR;
+    if (size != 0 || !n->upper) return -EOPNOTSUPP;
+    inode->i_size = 0;
+    dir_invalidate(fs_of(inode), n->parent);
+    return 0;
+}
+
+/* ---------- files ---------- */
+
+static int ovl_open(struct inode *inode, struct file **out, int flags, uint32_t mode) {
+    if (!inode || !out) return -1;
+    ovl_fs_t *fs = fs_of(inode);
+    ovl_node_t *n = (ovl_node_t*)inode->i_private;
+    if (!n) return -1;
+    const bool wr = (flags & VFS_O_ACCMODE) != VFS_O_RDONLY || (flags & VFS_O_TRUNC);
+    if ((flags & VFS_O_DIRECTORY) && !VFS_S_ISDIR(n->mode)) return -1;
+
+    void *priv = NULL;
+    if (VFS_S_ISDIR(n->mode)) {
+        if (wr) return -1;
+        priv = dir_get(fs, n);
+    } else {
+        if (wr && copy_up(fs, n, !(flags & VFS_O_TRUNC)) != 0) return -1;
+        gu_arena_mark_t m = gu_arena_mark();
+        struct file *inner = NULL;
+        if (vfs_open(layer_path(n->upper ? fs->upperdir : fs->lowerdir, n->rel),
+                     flags & ~(VFS_O_CREAT | VFS_O_EXCL), mode, &inner) == 0) priv = inner;
+        gu_arena_release(m);
+        if (inner && wr) dir_invalidate(fs, n->parent);
+    }
+    if (!priv) return -1;
+
+    struct file *f = vfs_alloc_file(inode);
+    if (!f) {
+        if (VFS_S_ISDIR(n->mode)) dir_put((ovl_dir_t*)priv); else vfs_close((struct file*)priv);
+        return -1;
+    }
+    f->f_flags      = flags;
+    f->f_op         = VFS_S_ISDIR(n->mode) ? &OVL_FOPS_DIR : &OVL_FOPS_FILE;
+    f->private_data = priv;
+    *out = f;
+    return 0;
+}
+
+static int ovl_release(struct file *f) {
+    if (!f) return 0;
+    int rc = 0;
+    if (f->f_op == &OVL_FOPS_DIR) dir_put((ovl_dir_t*)f->private_data);
+    else {
+        struct file *inner = (struct file*)f->private_data;
+        if (inner && inner->f_inode && (f->f_flags & VFS_O_ACCMODE) != VFS_O_RDONLY)
+            f->f_inode->i_size = inner->f_inode->i_size;    /* released under the write lock */
+        rc = vfs_close(inner);
+    }
+    vfs_free_file(f);
+    return rc;
+}
+
+static ssize_t ovl_read(struct file *f, void *buf, size_t len, uint64_t *pos) {
+    if (!f || !buf || !pos) return -EINVAL;
+    ssize_t r = vfs_pread((struct file*)f->private_data, buf, len, *pos);
+    if (r > 0) *pos += (uint64_t)r;
+    return r;
+}
+
+static ssize_t ovl_write(struct file *f, const void *buf, size_t len, uint64_t *pos) {
+    if (!f || !buf || !pos) return -EINVAL;
+    struct file *inner = (struct file*)f->private_data;
+    ssize_t w = vfs_pwrite(inner, buf, len, *pos);
+    if (w <= 0) return w;
+    uint64_t isz = inner->f_inode ? inner->f_inode->i_size : 0;
+    *pos = (f->f_flags & VFS_O_APPEND) ? isz : *pos + (uint64_t)w;
+    if (isz > f->f_inode->i_size) f->f_inode->i_size = isz;
+    return w;
+}
+
+static int ovl_fsync(struct file *f) {
+    return f ? vfs_fsync((struct file*)f->private_data) : -EINVAL;
+}
+
+/* f_pos is an entry index: 0 ".", 1 "..", then the merged listing. */
+static ssize_t ovl_emit(struct file *dirf, void *buf, size_t bytes, bool plus) {
+    if (!dirf || !buf) return -EINVAL;
+    ovl_dir_t *d = (ovl_dir_t*)dirf->private_data;
+    ovl_node_t *dn = (ovl_node_t*)dirf->f_inode->i_private;
+    if (!d || !dn) return -ENOTDIR;
+    const size_t head = plus ? offsetof(vfs_direntplus64_t, d_name) : offsetof(vfs_dirent64_t, d_name);
+
+    uint64_t idx = dirf->f_pos;
+    size_t out = 0;
+    for (;; ++idx) {
+        const char *name; uint64_t ino; uint8_t type = VFS_DT_DIR;
+        const ovl_dent_t *e = NULL;
+        if (idx == 0)               { name = ".";  ino = dn->ino; }
+        else if (idx == 1)          { name = ".."; ino = dn->parent->ino; }
+        else if (idx - 2 < d->n)    { e = &d->v[idx - 2]; name = e->name; ino = e->ino; type = e->type; }
+        else break;
+
+        size_t nlen = strlen(name);
+        size_t reclen = (head + nlen + 1 + 7u) & ~(size_t)7u;
+        if (out + reclen > bytes) {
+            if (out == 0) return -EINVAL;
+            break;
+        }
+        uint8_t *rec = (uint8_t*)buf + out;
+        if (plus) {
+            vfs_direntplus64_t *dp = (vfs_direntplus64_t*)rec;
+            memset(dp, 0, head);
+            dp->d_ino = ino; dp->d_off = (int64_t)(idx + 1);
+            dp->d_reclen = (uint16_t)reclen; dp->d_type = type;
+            if (e && e->has_stat) { dp->d_stat = e->st; dp->d_flags |= VFS_DIRENTPLUS_STAT; }
+            else if (idx == 0 && ovl_getattr(dirf->f_inode, &dp->d_stat) == 0) dp->d_flags |= VFS_DIRENTPLUS_STAT;
+            memcpy(dp->d_name, name, nlen + 1);
+        } else {
+            vfs_dirent64_t *de = (vfs_dirent64_t*)rec;
+            de->d_ino = ino; de->d_off = (int64_t)(idx + 1);
+            de->d_reclen = (uint16_t)reclen; de->d_type = type;
+            memcpy(de->d_name, name, nlen + 1);
+        }
+        out += reclen;
+    }
+    dirf->f_pos = idx;
+    return (ssize_t)out;
+}
+
+static ssize_t ovl_getdents64(struct file *dirf, void *buf, size_t bytes) {
+    return ovl_emit(dirf, buf, bytes, false);
+}
+
+static ssize_t ovl_getdents64_plus(struct file *dirf, void *buf, size_t bytes) {
+    return ovl_emit(dirf, buf, bytes, true);
+}
+
+static const inode_ops_t OVL_IOPS = {
+    .lookup   = ovl_lookup,
+    .mkdir    = ovl_mkdir,
+    .create   = ovl_create,
+    .getattr  = ovl_getattr,
+    .truncate = ovl_truncate,
+};
+
+static const file_ops_t OVL_FOPS_FILE = {
+    .open    = ovl_open,
+    .release = ovl_release,
+    .read    = ovl_read,
+    .write   = ovl_write,
+    .fsync   = ovl_fsync,
+};
+
+static const file_ops_t OVL_FOPS_DIR = {
+    .open            = ovl_open,
+    .release         = ovl_release,
+    .getdents64      = ovl_getdents64,
+    .getdents64_plus = ovl_getdents64_plus,
+};
+
+/* ---------- superblock ---------- */
+
+static int ovl_statfs(struct superblock *sb, struct g_statvfs *sv) {
+    if (!sb || !sv) return -1;
+    return vfs_statfs(((ovl_fs_t*)sb->fs_private)->upperdir, sv);
+}
+
+static void ovl_fs_free(ovl_fs_t *fs) {
+    if (!fs) return;
+    for (size_t i = 0; i < fs->cap; ++i)
+        for (ovl_node_t *n = fs->tab[i]; n; n = n->hnext) dir_put(n->dir);
+    free(fs->tab);
+    free(fs->lowerdir);
+    free(fs->upperdir);
+    gu_mutex_destroy(&fs->lock);
+    free(fs);
+}
+
+static void ovl_kill_sb(struct superblock *sb) {
+    if (!sb) return;
+    vfs_iput(sb->root);
+    sb->root = NULL;
+    vfs_evict_inodes(sb);       /* inodes only borrow nodes */
+    ovl_fs_free((ovl_fs_t*)sb->fs_private);
+    vfs_free_sb(sb);
+}
+
+static const super_ops_t OVL_SOP = {
+    .statfs  = ovl_statfs,
+    .kill_sb = ovl_kill_sb,
+};
+
+/* Copy the value of "key=" from a comma-separated option string. */
+static char *opt_dup(const char *opts, const char *key) {
+    size_t kl = strlen(key);
+    for (const char *p = opts; p && *p; ) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len > kl && strncmp(p, key, kl) == 0 && p[kl] == '=') {
+            char *v = (char*)malloc(len - kl);
+            if (v) { memcpy(v, p + kl + 1, len - kl - 1); v[len - kl - 1] = '\0'; }
+            return v;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+static bool is_dir(const char *path) {
+    struct g_stat st;
+    return path && vfs_stat(path, &st) == 0 && VFS_S_ISDIR(st.st_mode);
+}
+
+static int ovl_mount(vblk_t *dev, const char *opts, superblock_t **out_sb) {
+    (void)dev;
+    if (!out_sb) return -1;
+    *out_sb = NULL;
+
+    ovl_fs_t *fs = (ovl_fs_t*)calloc(1, sizeof *fs);
+    if (!fs) return -1;
+    gu_mutex_init(&fs->lock);
+    fs->lowerdir = opt_dup(opts, "lowerdir");
+    fs->upperdir = opt_dup(opts, "upperdir");
+    if (!is_dir(fs->lowerdir) || !is_dir(fs->upperdir)) {
+        fprintf(stderr, "overlay: need -o lowerdir=<dir>,upperdir=<dir> (both existing directories)\n");
+        ovl_fs_free(fs);
+        return -1;
+    }
+
+    superblock_t *sb = vfs_alloc_sb();
+    if (!sb) { ovl_fs_free(fs); return -1; }
+    fs->own = sb->s_slab;
+    fs->next_ino = 2;
+    fs->root = node_get(fs, NULL, "", VFS_S_IFDIR | 0755, true, true);
+    sb->s_op       = &OVL_SOP;
+    sb->block_size = VFS_PAGE_SIZE;
+    sb->fs_private = fs;
+    if (!fs->root || node_iget(sb, fs->root, &sb->root) != 0) {
+        ovl_fs_free(fs);
+        vfs_free_sb(sb);
+        return -1;
+    }
+    fs->root->mode = sb->root->i_mode;
+    DBG("overlay: mounted lower='%s' upper='%s'", fs->lowerdir, fs->upperdir);
+    *out_sb = sb;
+    return 0;
+}
+
+const filesystem_type_t VFS_OVERLAY = {
+    .name     = "overlay",
+    .mount    = ovl_mount,
+    .fs_flags = VFS_FS_NODEV,
+};
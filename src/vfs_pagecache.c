@@ -0,0 +1,280 @@
+// src/vfs_pagecache.c — per-inode page cache for file data
+//
+// Each inode owns an address_space: a small hash of VFS_PAGE_SIZE pages keyed
+// by page index. Every cached page in the process also sits on one global LRU
+// so the total stays within VFS_PAGECACHE_MAX_BYTES. Misses are filled by the
+// driver's readpage(s) hook, batching the requested range plus a readahead
+// window that doubles while the caller keeps reading sequentially.
+//
+// One mutex guards every mapping, the LRU and the stats. The driver fill runs
+// without it; a mapping's a_gen is bumped by every invalidation, and a batch
+// read under an older generation is thrown away instead of being inserted.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "gu_sync.h"
+
+#define PC_MIN_BUCKETS  16u
+#define PC_RA_MIN_PAGES 4u
+#define PC_MAX_PAGES    (VFS_PAGECACHE_MAX_BYTES / VFS_PAGE_SIZE)
+
+static vfs_page_t *g_lru_head = NULL;   /* most recently used */
+static vfs_page_t *g_lru_tail = NULL;   /* eviction candidate */
+static vfs_pagecache_stats_t g_pc;
+static gu_mutex_t g_pc_lock = GU_MUTEX_INIT;
+
+/* ---------- per-mapping hash ---------- */
+
+static inline size_t pg_slot(const address_space_t *as, uint64_t index) {
+    return (size_t)((index * 0x9E3779B97F4A7C15ull) >> 32) & (as->a_cap - 1);
+}
+
+static vfs_page_t *pg_find(const address_space_t *as, uint64_t index) {
+    if (!as->a_cap) return NULL;
+    for (vfs_page_t *pg = as->a_pages[pg_slot(as, index)]; pg; pg = pg->hnext)
+        if (pg->index == index) return pg;
+    return NULL;
+}
+
+static bool pg_hash_grow(address_space_t *as) {
+    size_t ncap = as->a_cap ? as->a_cap * 2 : PC_MIN_BUCKETS;
+    vfs_page_t **nt = (vfs_page_t**)calloc(ncap, sizeof *nt);
+    if (!nt) return false;
+
+    vfs_page_t **old = as->a_pages;
+    size_t ocap = as->a_cap;
+    as->a_pages = nt; as->a_cap = ncap;
+
+    for (size_t b = 0; b < ocap; ++b) {
+        vfs_page_t *pg = old[b];
+        while (pg) {
+            vfs_page_t *next = pg->hnext;
+            size_t h = pg_slot(as, pg->index);
+            pg->hnext = as->a_pages[h];
+            as->a_pages[h] = pg;
+            pg = next;
+        }
+    }
+    free(old);
+    return true;
+}
+
+/* ---------- global LRU ---------- */
+
+static void lru_del(vfs_page_t *pg) {
+    if (pg->lru_prev) pg->lru_prev->lru_next = pg->lru_next;
+    else              g_lru_head = pg->lru_next;
+    if (pg->lru_next) pg->lru_next->lru_prev = pg->lru_prev;
+    else              g_lru_tail = pg->lru_prev;
+    pg->lru_prev = pg->lru_next = NULL;
+}
+
+static void lru_add(vfs_page_t *pg) {
+    pg->lru_prev = NULL;
+    pg->lru_next = g_lru_head;
+    if (g_lru_head) g_lru_head->lru_prev = pg;
+    g_lru_head = pg;
+    if (!g_lru_tail) g_lru_tail = pg;
+}
+
+static void lru_touch(vfs_page_t *pg) {
+    if (g_lru_head == pg) return;
+    lru_del(pg);
+    lru_add(pg);
+}
+
+/* ---------- page lifetime ---------- */
+
+static void page_free(vfs_page_t *pg) {
+    address_space_t *as = pg->mapping;
+    vfs_page_t **pp = &as->a_pages[pg_slot(as, pg->index)];
+    while (*pp && *pp != pg) pp = &(*pp)->hnext;
+    if (*pp) *pp = pg->hnext;
+    as->a_nrpages--;
+    lru_del(pg);
+    g_pc.pages--;
+    g_pc.bytes -= VFS_PAGE_SIZE;
+    free(pg);
+}
+
+/* Make room for 'incoming' pages under the global budget. */
+static void pc_shrink(uint64_t incoming) {
+    while (g_lru_tail && g_pc.pages + incoming > PC_MAX_PAGES) {
+        page_free(g_lru_tail);
+        g_pc.evictions++;
+    }
+}
+
+static void pc_release_mapping_table(address_space_t *as) {
+    if (as->a_nrpages) return;
+    free(as->a_pages);
+    as->a_pages = NULL;
+    as->a_cap = 0;
+}
+
+/* ---------- miss path ---------- */
+
+/* Read pages [index, last] that are not yet cached, growing the batch up to
+   the readahead window. Stops early at the first page already present.
+   Called and returns with g_pc_lock held; drops it around the driver call. */
+static int pc_fill(inode_t *inode, uint64_t index, uint64_t want_last) {
+    address_space_t *as = &inode->i_data;
+    const uint64_t eof_last = (inode->i_size - 1) >> VFS_PAGE_SHIFT;
+
+    uint32_t win = PC_RA_MIN_PAGES;
+    if (as->a_ra_pages && index == as->a_ra_next) {
+        win = as->a_ra_pages * 2;
+        if (win > VFS_RA_MAX_PAGES) win = VFS_RA_MAX_PAGES;
+    }
+
+    uint64_t last = index + win - 1;
+    if (want_last > last) last = want_last;
+    if (last > eof_last) last = eof_last;
+    if (last - index + 1 > VFS_RA_MAX_PAGES) last = index + VFS_RA_MAX_PAGES - 1;
+
+    vfs_page_t *batch[VFS_RA_MAX_PAGES];
+    unsigned n = 0;
+    for (uint64_t i = index; i <= last; ++i) {
+        if (i != index && pg_find(as, i)) break;
+        vfs_page_t *pg = (vfs_page_t*)malloc(sizeof *pg + VFS_PAGE_SIZE);
+        if (!pg) break;
+        memset(pg, 0, sizeof *pg);
+        pg->mapping = as;
+        pg->index   = i;
+        batch[n++]  = pg;
+    }
+    if (n == 0) return -ENOMEM;
+
+    const uint64_t gen = as->a_gen;
+    gu_mutex_unlock(&g_pc_lock);
+    int rc = 0;
+    if (as->a_ops->readpages) {
+        rc = as->a_ops->readpages(inode, batch, n);
+    } else {
+        for (unsigned k = 0; k < n && rc == 0; ++k)
+            rc = as->a_ops->readpage(inode, batch[k]);
+    }
+    gu_mutex_lock(&g_pc_lock);
+
+    if (rc < 0) {
+        DBG("pagecache: fill ino=%llu [%llu..+%u] failed rc=%d",
+            (unsigned long long)inode->i_ino, (unsigned long long)index, n, rc);
+        for (unsigned k = 0; k < n; ++k) free(batch[k]);
+        return rc;
+    }
+    if (as->a_gen != gen) {
+        /* invalidated while we were reading: the data may predate a write */
+        for (unsigned k = 0; k < n; ++k) free(batch[k]);
+        return 0;
+    }
+
+    pc_shrink(n);
+    for (unsigned k = 0; k < n; ++k) {
+        vfs_page_t *pg = batch[k];
+        if (pg_find(as, pg->index)) { free(pg); continue; }   /* another reader won */
+        if (as->a_nrpages + 1 > as->a_cap && !pg_hash_grow(as)) {
+            for (; k < n; ++k) free(batch[k]);
+            break;
+        }
+        size_t h = pg_slot(as, pg->index);
+        pg->hnext = as->a_pages[h];
+        as->a_pages[h] = pg;
+        as->a_nrpages++;
+        lru_add(pg);
+        g_pc.pages++;
+        g_pc.bytes += VFS_PAGE_SIZE;
+    }
+
+    uint64_t asked = want_last - index + 1;
+    if (n > asked) g_pc.readahead += n - asked;
+    as->a_ra_next  = index + n;
+    as->a_ra_pages = win;
+    return 0;
+}
+
+/* ---------- public API ---------- */
+
+ssize_t vfs_pagecache_read(inode_t *inode, void *buf, size_t n, uint64_t pos) {
+    if (!inode || !buf) return -EINVAL;
+    address_space_t *as = &inode->i_data;
+    if (!as->a_ops || (!as->a_ops->readpage && !as->a_ops->readpages)) return -EINVAL;
+
+    if (pos >= inode->i_size || n == 0) return 0;
+    if (n > inode->i_size - pos) n = (size_t)(inode->i_size - pos);
+
+    const uint64_t last = (pos + n - 1) >> VFS_PAGE_SHIFT;
+    uint8_t *dst = (uint8_t*)buf;
+    size_t copied = 0;
+    int retries = 0;
+
+    gu_mutex_lock(&g_pc_lock);
+    while (copied < n) {
+        uint64_t idx = pos >> VFS_PAGE_SHIFT;
+        size_t   in  = (size_t)(pos & (VFS_PAGE_SIZE - 1));
+
+        vfs_page_t *pg = pg_find(as, idx);
+        if (pg) {
+            g_pc.hits++;
+            lru_touch(pg);
+        } else {
+            g_pc.misses++;
+            int rc = pc_fill(inode, idx, last);
+            if (rc < 0) { gu_mutex_unlock(&g_pc_lock); return copied ? (ssize_t)copied : rc; }
+            pg = pg_find(as, idx);
+            if (!pg) {
+                /* raced with an invalidation (or the LRU): try again a few times */
+                if (++retries < 4) continue;
+                gu_mutex_unlock(&g_pc_lock);
+                return copied ? (ssize_t)copied : -ENOMEM;
+            }
+        }
+
+        size_t take = VFS_PAGE_SIZE - in;
+        if (take > n - copied) take = n - copied;
+        memcpy(dst + copied, pg->data + in, take);
+        copied += take;
+        pos    += take;
+    }
+    gu_mutex_unlock(&g_pc_lock);
+    return (ssize_t)copied;
+}
+
+void vfs_pagecache_invalidate(inode_t *inode, uint64_t off, uint64_t len) {
+    if (!inode) return;
+    address_space_t *as = &inode->i_data;
+    gu_mutex_lock(&g_pc_lock);
+    as->a_gen++;
+    if (!as->a_nrpages) { pc_release_mapping_table(as); gu_mutex_unlock(&g_pc_lock); return; }
+
+    const uint64_t first = off >> VFS_PAGE_SHIFT;
+    const uint64_t last  = (len == 0 || off + len < off) ? UINT64_MAX
+                                                         : (off + len - 1) >> VFS_PAGE_SHIFT;
+    for (size_t b = 0; b < as->a_cap; ++b) {
+        vfs_page_t *pg = as->a_pages[b];
+        while (pg) {
+            vfs_page_t *next = pg->hnext;
+            if (pg->index >= first && pg->index <= last) page_free(pg);
+            pg = next;
+        }
+    }
+    as->a_ra_pages = 0;
+    pc_release_mapping_table(as);
+    gu_mutex_unlock(&g_pc_lock);
+}
+
+void vfs_pagecache_truncate(inode_t *inode) {
+    vfs_pagecache_invalidate(inode, 0, 0);
+}
+
+void vfs_pagecache_get_stats(vfs_pagecache_stats_t *out) {
+    if (!out) return;
+    gu_mutex_lock(&g_pc_lock);
+    *out = g_pc;
+    gu_mutex_unlock(&g_pc_lock);
+}
@@ -0,0 +1,377 @@
+// src/vfs_slab.c — object caches for inodes, files and driver payloads
+//
+// A cache hands out zeroed fixed-size objects carved from VFS_SLAB_CHUNK-byte
+// chunks obtained from malloc. Each object is preceded by a small header that
+// records its cache and owner:
+//
+//   - Free objects sit either in a per-thread magazine (no locking) or in the
+//     cache's depot (cache mutex). An empty magazine refills half-way from
+//     the depot, a full one spills half of itself back, so threads that keep
+//     allocating and freeing the same type rarely touch the depot.
+//   - A live object's header names its owner, and the owner keeps atomic
+//     per-cache counts for per-mount stats, so alloc and free take no lock
+//     beyond the depot's. vfs_slab_owner_release() finds a dead
+//     superblock's leftovers by sweeping each cache's chunks once, under
+//     that cache's lock, and returns them to the depot in one go. Only
+//     oversized strings, which are malloc'd whole, sit on an owner list.
+//
+// Chunks are never given back to malloc; the caches only grow to the peak
+// number of objects alive at once. A thread's magazines are flushed to the
+// depots when it exits.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdalign.h>
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "gu_sync.h"
+
+#ifndef VFS_SLAB_CHUNK
+#define VFS_SLAB_CHUNK     (64u * 1024u)
+#endif
+#define VFS_SLAB_MAX_CACHES 32
+#define VFS_SLAB_MAG        32          /* objects per thread per cache */
+
+#define SLAB_ALIGN   alignof(max_align_t)
+#define SLAB_ROUND(n) (((n) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+
+typedef struct slab_hdr {
+    vfs_slab_cache_t *cache;            /* NULL: oversized string, malloc'd whole */
+    vfs_slab_owner_t *_Atomic owner;    /* set while live; read by owner release sweeps */
+    struct slab_hdr  *prev, *next;      /* owner list (oversized); depot link when free */
+} slab_hdr_t;
+
+#define HDR_SIZE SLAB_ROUND(sizeof(slab_hdr_t))
+
+static inline void       *hdr_obj(slab_hdr_t *h) { return (char*)h + HDR_SIZE; }
+static inline slab_hdr_t *obj_hdr(void *p)       { return (slab_hdr_t*)((char*)p - HDR_SIZE); }
+static inline size_t      stride_of(const vfs_slab_cache_t *c) { return HDR_SIZE + SLAB_ROUND(c->size); }
+
+struct vfs_slab_owner {
+    gu_mutex_t  lock;                   /* 'large' only */
+    slab_hdr_t *large;                  /* oversized strings */
+    _Atomic uint64_t live[VFS_SLAB_MAX_CACHES + 1];   /* [0]: oversized strings */
+};
+
+/* ---------- registry ---------- */
+
+static vfs_slab_cache_t *_Atomic g_caches[VFS_SLAB_MAX_CACHES];
+static _Atomic int g_ncaches;
+static gu_mutex_t  g_reg_lock = GU_MUTEX_INIT;
+
+/* 1-based id of 'c', registering it on first use; 0 if the table is full. */
+static int cache_id(vfs_slab_cache_t *c) {
+    int id = atomic_load_explicit(&c->id, memory_order_acquire);
+    if (id) return id;
+    gu_mutex_lock(&g_reg_lock);
+    id = atomic_load_explicit(&c->id, memory_order_relaxed);
+    if (!id) {
+        int n = atomic_load_explicit(&g_ncaches, memory_order_relaxed);
+        if (n < VFS_SLAB_MAX_CACHES) {
+            atomic_store_explicit(&g_caches[n], c, memory_order_relaxed);
+            atomic_store_explicit(&g_ncaches, n + 1, memory_order_release);
+            id = n + 1;
+            atomic_store_explicit(&c->id, id, memory_order_release);
+        } else {
+            DBG("vfs_slab: no room to register cache '%s'", c->name);
+        }
+    }
+    gu_mutex_unlock(&g_reg_lock);
+    return id;
+}
+
+/* ---------- depot ---------- */
+
+static size_t chunk_objs(const vfs_slab_cache_t *c) {
+    size_t n = (VFS_SLAB_CHUNK - HDR_SIZE) / stride_of(c);
+    return n < 8 ? 8 : n;
+}
+
+/* Carve a new chunk into the depot. Caller holds c->lock. */
+static bool depot_grow(vfs_slab_cache_t *c) {
+    const size_t stride = stride_of(c);
+    const size_t n = chunk_objs(c);
+    char *chunk = (char*)malloc(HDR_SIZE + n * stride);
+    if (!chunk) return false;
+    *(void**)chunk = c->chunks;          /* chunk list link lives in the first slot */
+    c->chunks = chunk;
+    c->nchunks++;
+    for (size_t i = n; i-- > 0; ) {
+        slab_hdr_t *h = (slab_hdr_t*)(chunk + HDR_SIZE + i * stride);
+        h->cache = c;
+        atomic_init(&h->owner, NULL);
+        h->next  = (slab_hdr_t*)c->depot;
+        c->depot = h;
+    }
+    return true;
+}
+
+/* ---------- per-thread magazines ---------- */
+
+typedef struct slab_mag {
+    unsigned    n;
+    slab_hdr_t *obj[VFS_SLAB_MAG];
+} slab_mag_t;
+
+static _Thread_local slab_mag_t t_mag[VFS_SLAB_MAX_CACHES];
+static _Thread_local bool       t_mag_armed;
+static pthread_key_t  g_mag_key;
+static pthread_once_t g_mag_once = PTHREAD_ONCE_INIT;
+
+/* Move the top 'n' objects of 'm' to the depot of cache c. */
+static void mag_spill(vfs_slab_cache_t *c, slab_mag_t *m, unsigned n) {
+    gu_mutex_lock(&c->lock);
+    while (n-- > 0 && m->n > 0) {
+        slab_hdr_t *h = m->obj[--m->n];
+        h->next  = (slab_hdr_t*)c->depot;
+        c->depot = h;
+    }
+    gu_mutex_unlock(&c->lock);
+}
+
+static void mag_flush_all(void *unused) {
+    (void)unused;
+    int n = atomic_load_explicit(&g_ncaches, memory_order_acquire);
+    for (int i = 0; i < n; ++i) {
+        if (t_mag[i].n) mag_spill(atomic_load_explicit(&g_caches[i], memory_order_relaxed),
+                                  &t_mag[i], VFS_SLAB_MAG);
+    }
+}
+
+static void mag_key_init(void) { (void)pthread_key_create(&g_mag_key, mag_flush_all); }
+
+/* Arrange for this thread's magazines to be flushed when it exits. */
+static void mag_arm(void) {
+    if (t_mag_armed) return;
+    pthread_once(&g_mag_once, mag_key_init);
+    (void)pthread_setspecific(g_mag_key, t_mag);
+    t_mag_armed = true;
+}
+
+static bool mag_refill(vfs_slab_cache_t *c, slab_mag_t *m) {
+    mag_arm();
+    gu_mutex_lock(&c->lock);
+    if (!c->depot && !depot_grow(c)) { gu_mutex_unlock(&c->lock); return false; }
+    while (c->depot && m->n < VFS_SLAB_MAG / 2) {
+        slab_hdr_t *h = (slab_hdr_t*)c->depot;
+        c->depot = h->next;
+        m->obj[m->n++] = h;
+    }
+    gu_mutex_unlock(&c->lock);
+    return true;
+}
+
+/* ---------- owners ---------- */
+
+/* Charge h to o. Cached objects only get tagged and counted; oversized
+   strings (id 0) also go on o's list, the one place the owner lock is taken. */
+static void owner_link(vfs_slab_owner_t *o, slab_hdr_t *h, int id) {
+    atomic_store_explicit(&h->owner, o, memory_order_relaxed);
+    h->prev = h->next = NULL;
+    if (!o) return;
+    atomic_fetch_add_explicit(&o->live[id], 1, memory_order_relaxed);
+    if (id) return;
+    gu_mutex_lock(&o->lock);
+    h->next = o->large;
+    if (o->large) o->large->prev = h;
+    o->large = h;
+    gu_mutex_unlock(&o->lock);
+}
+
+static void owner_unlink(slab_hdr_t *h, int id) {
+    vfs_slab_owner_t *o = atomic_load_explicit(&h->owner, memory_order_relaxed);
+    if (!o) return;
+    atomic_fetch_sub_explicit(&o->live[id], 1, memory_order_relaxed);
+    if (!id) {
+        gu_mutex_lock(&o->lock);
+        if (h->prev) h->prev->next = h->next;
+        else         o->large = h->next;
+        if (h->next) h->next->prev = h->prev;
+        gu_mutex_unlock(&o->lock);
+        h->prev = h->next = NULL;
+    }
+    atomic_store_explicit(&h->owner, NULL, memory_order_relaxed);
+}
+
+vfs_slab_owner_t *vfs_slab_owner_new(void) {
+    vfs_slab_owner_t *o = (vfs_slab_owner_t*)calloc(1, sizeof *o);
+    if (o) gu_mutex_init(&o->lock);
+    return o;
+}
+
+/* Nothing allocates for o any more (its superblock is dead), so any object
+   still tagged with it is a leftover: sweep every chunk of every cache and
+   put those straight back on the depot, one cache lock each. */
+size_t vfs_slab_owner_release(vfs_slab_owner_t *o) {
+    if (!o) return 0;
+    size_t n = 0;
+    gu_mutex_lock(&o->lock);
+    for (slab_hdr_t *h = o->large, *next; h; h = next) {
+        next = h->next;
+        free(h);
+        n++;
+    }
+    o->large = NULL;
+    gu_mutex_unlock(&o->lock);
+
+    int nc = atomic_load_explicit(&g_ncaches, memory_order_acquire);
+    for (int i = 0; i < nc; ++i) {
+        if (!atomic_load_explicit(&o->live[i + 1], memory_order_relaxed)) continue;
+        vfs_slab_cache_t *c = atomic_load_explicit(&g_caches[i], memory_order_relaxed);
+        const size_t stride = stride_of(c), per = chunk_objs(c);
+        uint64_t cnt = 0;
+        gu_mutex_lock(&c->lock);
+        for (char *chunk = (char*)c->chunks; chunk; chunk = *(char**)chunk) {
+            for (size_t k = 0; k < per; ++k) {
+                slab_hdr_t *h = (slab_hdr_t*)(chunk + HDR_SIZE + k * stride);
+                if (atomic_load_explicit(&h->owner, memory_order_relaxed) != o) continue;
+                atomic_store_explicit(&h->owner, NULL, memory_order_relaxed);
+                h->next  = (slab_hdr_t*)c->depot;
+                c->depot = h;
+                cnt++;
+            }
+        }
+        gu_mutex_unlock(&c->lock);
+        atomic_fetch_add_explicit(&c->frees, cnt, memory_order_relaxed);
+        n += cnt;
+    }
+    gu_mutex_destroy(&o->lock);
+    free(o);
+    return n;
+}
+
+/* ---------- alloc / free ---------- */
+
+void *vfs_slab_alloc(vfs_slab_cache_t *c, vfs_slab_owner_t *owner) {
+    if (!c || !c->size) return NULL;
+    int id = cache_id(c);
+    if (!id) return NULL;
+    slab_mag_t *m = &t_mag[id - 1];
+    if (m->n == 0 && !mag_refill(c, m)) return NULL;
+
+    slab_hdr_t *h = m->obj[--m->n];
+    owner_link(owner, h, id);
+    atomic_fetch_add_explicit(&c->allocs, 1, memory_order_relaxed);
+    void *p = hdr_obj(h);
+    memset(p, 0, c->size);
+    return p;
+}
+
+void vfs_slab_free(void *obj) {
+    if (!obj) return;
+    slab_hdr_t *h = obj_hdr(obj);
+    vfs_slab_cache_t *c = h->cache;
+    if (!c) {                            /* oversized string */
+        owner_unlink(h, 0);
+        free(h);
+        return;
+    }
+    int id = atomic_load_explicit(&c->id, memory_order_relaxed);
+    owner_unlink(h, id);
+    atomic_fetch_add_explicit(&c->frees, 1, memory_order_relaxed);
+
+    slab_mag_t *m = &t_mag[id - 1];
+    if (m->n == VFS_SLAB_MAG) mag_spill(c, m, VFS_SLAB_MAG / 2);
+    mag_arm();
+    m->obj[m->n++] = h;
+}
+
+/* ---------- strings ---------- */
+
+/* Size classes for vfs_slab_strdup(); longer strings are malloc'd whole. */
+static VFS_SLAB_CACHE(g_str32,   "str-32",   char[32]);
+static VFS_SLAB_CACHE(g_str64,   "str-64",   char[64]);
+static VFS_SLAB_CACHE(g_str128,  "str-128",  char[128]);
+static VFS_SLAB_CACHE(g_str256,  "str-256",  char[256]);
+static VFS_SLAB_CACHE(g_str1024, "str-1024", char[1024]);
+
+char *vfs_slab_strdup(vfs_slab_owner_t *owner, const char *s) {
+    if (!s) return NULL;
+    size_t n = strlen(s) + 1;
+    vfs_slab_cache_t *c = n <= 32  ? &g_str32  : n <= 64  ? &g_str64 :
+                          n <= 128 ? &g_str128 : n <= 256 ? &g_str256 :
+                          n <= 1024 ? &g_str1024 : NULL;
+    char *p;
+    if (c) {
+        p = (char*)vfs_slab_alloc(c, owner);
+    } else {
+        slab_hdr_t *h = (slab_hdr_t*)malloc(HDR_SIZE + n);
+        if (!h) return NULL;
+        h->cache = NULL;
+        owner_link(owner, h, 0);
+        p = (char*)hdr_obj(h);
+    }
+    if (p) memcpy(p, s, n);
+    return p;
+}
+
+/* ---------- stats ---------- */
+
+int vfs_slab_get_stats(vfs_slab_stats_t *out, int max) {
+    int n = atomic_load_explicit(&g_ncaches, memory_order_acquire);
+    int k = 0;
+    for (int i = 0; i < n && k < max; ++i) {
+        vfs_slab_cache_t *c = atomic_load_explicit(&g_caches[i], memory_order_relaxed);
+        uint64_t a = atomic_load_explicit(&c->allocs, memory_order_relaxed);
+        uint64_t f = atomic_load_explicit(&c->frees,  memory_order_relaxed);
+        gu_mutex_lock(&c->lock);
+        uint64_t chunks = c->nchunks;
+        gu_mutex_unlock(&c->lock);
+        out[k++] = (vfs_slab_stats_t){ .name = c->name, .obj_size = c->size,
+                                       .live = a >= f ? a - f : 0,
+                                       .allocs = a, .frees = f, .chunks = chunks };
+    }
+    return k;
+}
+
+int vfs_slab_owner_stats(vfs_slab_owner_t *o, vfs_slab_stats_t *out, int max) {
+    if (!o) return 0;
+    int n = atomic_load_explicit(&g_ncaches, memory_order_acquire);
+    int k = 0;
+    for (int i = 0; i < n && k < max; ++i) {
+        const uint64_t live = atomic_load_explicit(&o->live[i + 1], memory_order_relaxed);
+        if (!live) continue;
+        vfs_slab_cache_t *c = atomic_load_explicit(&g_caches[i], memory_order_relaxed);
+        out[k++] = (vfs_slab_stats_t){ .name = c->name, .obj_size = c->size, .live = live };
+    }
+    const uint64_t large = atomic_load_explicit(&o->live[0], memory_order_relaxed);
+    if (large && k < max)
+        out[k++] = (vfs_slab_stats_t){ .name = "str-large", .live = large };
+    return k;
+}
+
+/* ---------- superblocks and files ---------- */
+
+static VFS_SLAB_CACHE(g_file_cache, "file", struct file);
+
+superblock_t *vfs_alloc_sb(void) {
+    superblock_t *sb = (superblock_t*)calloc(1, sizeof *sb);
+    if (!sb) return NULL;
+    sb->s_slab = vfs_slab_owner_new();
+    sb->s_stats = vfs_opstats_new();
+    if (!sb->s_stats) { vfs_slab_owner_release(sb->s_slab); free(sb); return NULL; }
+    return sb;
+}
+
+void vfs_free_sb(superblock_t *sb) {
+    if (!sb) return;
+    size_t n = vfs_slab_owner_release(sb->s_slab);
+    if (n) DBG("vfs_free_sb: %zu objects returned in bulk", n);
+    vfs_opstats_free(sb->s_stats);
+    free(sb);
+}
+
+struct file *vfs_alloc_file(inode_t *inode) {
+    superblock_t *sb = inode ? inode->i_sb : NULL;
+    struct file *f = (struct file*)vfs_slab_alloc(&g_file_cache, sb ? sb->s_slab : NULL);
+    if (f) f->f_inode = inode;
+    return f;
+}
+
+void vfs_free_file(struct file *f) {
+    vfs_slab_free(f);
+}
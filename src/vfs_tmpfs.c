@@ -0,0 +1,379 @@
+// src/vfs_tmpfs.c — in-memory filesystem (no backing device)
+// Supports: lookup, create, mkdir, read/write/truncate, getdents, statfs.
+// Everything lives in a tree of tmpfs_node_t owned by the superblock; inodes
+// are just cached views of nodes and carry no state of their own. Nodes and
+// names are charged to the superblock's slab owner, so unmounting only has to
+// free file data and lets vfs_free_sb() drop the tree in one sweep. The VFS
+// superblock lock serialises writers, so the tree needs no locking here.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define DBG_CAT DBG_VFS
+#include "debug.h"
+#include "vfs.h"
+#include "vfs_stat.h"
+
+typedef struct tmpfs_node {
+    char              *name;
+    uint64_t           ino;
+    uint32_t           mode;
+    int64_t            mtime;
+    struct tmpfs_node *parent;
+    struct tmpfs_node *kids, *kids_tail;   /* directories: children in creation order */
+    struct tmpfs_node *next;               /* sibling */
+    size_t             nkids;
+    uint8_t           *data;               /* regular files */
+    uint64_t           size, cap;
+} tmpfs_node_t;
+
+static VFS_SLAB_CACHE(g_tmpfs_node_cache, "tmpfs_node", tmpfs_node_t);
+
+typedef struct tmpfs_fs {
+    vfs_slab_owner_t *own;      /* sb->s_slab */
+    tmpfs_node_t *root;
+    uint64_t      next_ino;
+    uint64_t      nnodes, bytes;
+} tmpfs_fs_t;
+
+static const inode_ops_t TMPFS_IOPS;
+static const file_ops_t  TMPFS_FOPS_FILE;
+static const file_ops_t  TMPFS_FOPS_DIR;
+
+/* ---------- nodes ---------- */
+
+static tmpfs_node_t *node_new(tmpfs_fs_t *fs, tmpfs_node_t *parent, const char *name, uint32_t mode) {
+    tmpfs_node_t *n = (tmpfs_node_t*)vfs_slab_alloc(&g_tmpfs_node_cache, fs->own);
+    if (!n) return NULL;
+    n->name = vfs_slab_strdup(fs->own, name);
+    if (!n->name) { vfs_slab_free(n); return NULL; }
+    n->ino    = fs->next_ino++;
+    n->mode   = mode;
+    n->mtime  = (int64_t)time(NULL);
+    n->parent = parent ? parent : n;
+    if (parent) {
+        if (parent->kids_tail) parent->kids_tail->next = n; else parent->kids = n;
+        parent->kids_tail = n;
+        parent->nkids++;
+        parent->mtime = n->mtime;
+    }
+    fs->nnodes++;
+    return n;
+}
+
+/* Nodes and names themselves go back with the superblock's slab owner. */
+static void node_free_data(tmpfs_node_t *n) {
+    for (tmpfs_node_t *c = n->kids; c; c = c->next) node_free_data(c);
+    free(n->data);
+    n->data = NULL;
+}
+
+static tmpfs_node_t *node_find(const tmpfs_node_t *dir, const char *name) {
+    for (tmpfs_node_t *c = dir->kids; c; c = c->next)
+        if (strcmp(c->name, name) == 0) return c;
+    return NULL;
+}
+
+static bool node_reserve(tmpfs_fs_t *fs, tmpfs_node_t *n, uint64_t need) {
+    if (need <= n->cap) return true;
+    if (need > (SIZE_MAX >> 1)) return false;
+    uint64_t ncap = n->cap ? n->cap : 4096;
+    while (ncap < need) ncap *= 2;
+    uint8_t *p = (uint8_t*)realloc(n->data, (size_t)ncap);
+    if (!p) return false;
+    fs->bytes += ncap - n->cap;
+    n->data = p;
+    n->cap  = ncap;
+    return true;
+}
+
+static int node_set_size(tmpfs_fs_t *fs, tmpfs_node_t *n, uint64_t size) {
+    if (size > n->size) {
+        if (!node_reserve(fs, n, size)) return -ENOSPC;
+        memset(n->data + n->size, 0, (size_t)(size - n->size));
+    }
+    n->size  = size;
+    n->mtime = (int64_t)time(NULL);
+    return 0;
+}
+
+/* ---------- inodes ---------- */
+
+static tmpfs_fs_t *fs_of(const inode_t *inode) {
+    return (tmpfs_fs_t*)inode->i_sb->fs_private;
+}
+
+static int node_iget(superblock_t *sb, tmpfs_node_t *n, inode_t **out) {
+    inode_t *inode = vfs_iget(sb, n->ino);
+    if (!inode) return -ENOMEM;
+    if (inode->i_state & VFS_I_NEW) {
+        inode->i_mode    = n->mode;
+        inode->i_size    = n->size;
+        inode->i_mtime   = (uint64_t)n->mtime;
+        inode->i_nlink   = 1;
+        inode->i_op      = &TMPFS_IOPS;
+        inode->i_fop     = VFS_S_ISDIR(n->mode) ? &TMPFS_FOPS_DIR : &TMPFS_FOPS_FILE;
+        inode->i_private = n;
+        vfs_unlock_new_inode(inode);
+    }
+    *out = inode;
+    return 0;
+}
+
+static int tmpfs_index_fill(struct inode *dir, vfs_dindex_t *dx) {
+    const tmpfs_node_t *dn = (const tmpfs_node_t*)dir->i_private;
+    for (tmpfs_node_t *c = dn->kids; c; c = c->next) {
+        const vfs_dentry_info_t di = { .ino = c->ino, .mode = c->mode, .loc = (uintptr_t)c };
+        int rc = vfs_dindex_add(dx, c->name, strlen(c->name), &di);
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+/* Child by name through the directory's index (the kids list is unsorted). */
+static tmpfs_node_t *child_find(struct inode *dir, const char *name) {
+    vfs_dentry_info_t di;
+    int rc = vfs_dindex_lookup(dir, name, 0, tmpfs_index_fill, &di);
+    if (rc < 0) return node_find((const tmpfs_node_t*)dir->i_private, name);
+    return rc ? (tmpfs_node_t*)(uintptr_t)di.loc : NULL;
+}
+
+static int tmpfs_lookup(struct inode *dir, const char *name, struct inode **out) {
+    if (out) *out = NULL;
+    if (!dir || !name || !out) return -EINVAL;
+    tmpfs_node_t *dn = (tmpfs_node_t*)dir->i_private;
+    if (!dn || !VFS_S_ISDIR(dn->mode)) return -ENOTDIR;
+    tmpfs_node_t *n = child_find(dir, name);
+    if (!n) return -ENOENT;
+    return node_iget(dir->i_sb, n, out);
+}
+
+static int tmpfs_make(struct inode *dir, const char *name, uint32_t mode, tmpfs_node_t **out) {
+    tmpfs_node_t *dn = (tmpfs_node_t*)dir->i_private;
+    if (!dn || !VFS_S_ISDIR(dn->mode)) return -ENOTDIR;
+    if (!name[0] || strlen(name) > 255 || strchr(name, '/')) return -EINVAL;
+    if (child_find(dir, name)) return -EEXIST;
+    *out = node_new(fs_of(dir), dn, name, mode);
+    if (!*out) return -ENOMEM;
+    const vfs_dentry_info_t di = { .ino = (*out)->ino, .mode = mode, .loc = (uintptr_t)*out };
+    vfs_dindex_insert(dir, name, &di);
+    dir->i_mtime = (uint64_t)dn->mtime;
+    return 0;
+}
+
+static int tmpfs_create(struct inode *dir, const char *name, uint32_t mode, struct inode **out) {
+    if (!dir || !name || !out) return -EINVAL;
+    tmpfs_node_t *n = NULL;
+    int rc = tmpfs_make(dir, name, VFS_S_IFREG | (mode & 07777), &n);
+    if (rc != 0) return rc;
+    return node_iget(dir->i_sb, n, out);
+}
+
+static int tmpfs_mkdir(struct inode *dir, const char *name, uint32_t mode) {
+    if (!dir || !name) return -EINVAL;
+    tmpfs_node_t *n = NULL;
+    return tmpfs_make(dir, name, VFS_S_IFDIR | (mode & 07777), &n);
+}
+
+static int tmpfs_getattr(struct inode *inode, struct g_stat *st) {
+    if (!inode || !st) return -1;
+    tmpfs_node_t *n = (tmpfs_node_t*)inode->i_private;
+    if (!n) return -1;
+    memset(st, 0, sizeof *st);
+    st->st_mode    = n->mode;
+    st->st_ino     = n->ino;
+    st->st_nlink   = 1;
+    st->st_size    = n->size;
+    st->st_blksize = VFS_PAGE_SIZE;
+    st->st_blocks  = (n->cap + 511) / 512;
+    st->st_mtime   = n->mtime;
+    return 0;
+}
+
+static int tmpfs_truncate(struct inode *inode, uint64_t size) {
+    tmpfs_node_t *n = inode ? (tmpfs_node_t*)inode->i_private : NULL;
+    if (!n || VFS_S_ISDIR(n->mode)) return -EISDIR;
+    int rc = node_set_size(fs_of(inode), n, size);
+    if (rc == 0) inode->i_size = size;
+    return rc;
+}
+
+/* ---------- files ---------- */
+
+static int tmpfs_open(struct inode *inode, struct file **out, int flags, uint32_t mode) {
+    (void)mode;
+    if (!inode || !out) return -1;
+    tmpfs_node_t *n = (tmpfs_node_t*)inode->i_private;
+    if (!n) return -1;
+    if ((flags & VFS_O_DIRECTORY) && !VFS_S_ISDIR(n->mode)) return -1;
+    if (VFS_S_ISDIR(n->mode) && (flags & VFS_O_ACCMODE) != VFS_O_RDONLY) return -1;
+
+    struct file *f = vfs_alloc_file(inode);
+    if (!f) return -1;
+    f->f_flags = flags;
+    f->f_op    = VFS_S_ISDIR(n->mode) ? &TMPFS_FOPS_DIR : &TMPFS_FOPS_FILE;
+    *out = f;
+    return 0;
+}
+
+static int tmpfs_release(struct file *f) {
+    vfs_free_file(f);
+    return 0;
+}
+
+static ssize_t tmpfs_read(struct file *f, void *buf, size_t len, uint64_t *pos) {
+    if (!f || !buf || !pos) return -EINVAL;
+    tmpfs_node_t *n = (tmpfs_node_t*)f->f_inode->i_private;
+    if (*pos >= n->size) return 0;
+    if (len > n->size - *pos) len = (size_t)(n->size - *pos);
+    memcpy(buf, n->data + *pos, len);
+    *pos += len;
+    return (ssize_t)len;
+}
+
+static ssize_t tmpfs_write(struct file *f, const void *buf, size_t len, uint64_t *pos) {
+    if (!f || !buf || !pos) return -EINVAL;
+    if ((f->f_flags & VFS_O_ACCMODE) == VFS_O_RDONLY) return -EBADF;
+    inode_t *inode = f->f_inode;
+    tmpfs_node_t *n = (tmpfs_node_t*)inode->i_private;
+    uint64_t at = (f->f_flags & VFS_O_APPEND) ? n->size : *pos;
+    if (len == 0) return 0;
+    if (at + len < at) return -EFBIG;
+    if (at + len > n->size) {
+        int rc = node_set_size(fs_of(inode), n, at + len);
+        if (rc != 0) return rc;
+    }
+    memcpy(n->data + at, buf, len);
+    n->mtime = (int64_t)time(NULL);
+    inode->i_size  = n->size;
+    inode->i_mtime = (uint64_t)n->mtime;
+    *pos = at + len;
+    return (ssize_t)len;
+}
+
+/* f_pos is an entry index: 0 ".", 1 "..", then children in creation order. */
+static ssize_t tmpfs_getdents64(struct file *dirf, void *buf, size_t bytes) {
+    if (!dirf || !buf) return -EINVAL;
+    tmpfs_node_t *dn = (tmpfs_node_t*)dirf->f_inode->i_private;
+    if (!dn || !VFS_S_ISDIR(dn->mode)) return -ENOTDIR;
+
+    uint64_t idx = dirf->f_pos;
+    tmpfs_node_t *c = dn->kids;
+    for (uint64_t i = 2; c && i < idx; ++i) c = c->next;
+
+    size_t out = 0;
+    for (;;) {
+        const char *name; uint64_t ino; uint8_t type;
+        if (idx == 0)      { name = ".";  ino = dn->ino;         type = VFS_DT_DIR; }
+        else if (idx == 1) { name = ".."; ino = dn->parent->ino; type = VFS_DT_DIR; }
+        else if (c)        { name = c->name; ino = c->ino;
+                             type = VFS_S_ISDIR(c->mode) ? VFS_DT_DIR : VFS_DT_REG; }
+        else break;
+
+        size_t nlen = strlen(name);
+        size_t reclen = (offsetof(vfs_dirent64_t, d_name) + nlen + 1 + 7u) & ~(size_t)7u;
+        if (out + reclen > bytes) {
+            if (out == 0) return -EINVAL;
+            break;
+        }
+        vfs_dirent64_t *de = (vfs_dirent64_t*)((uint8_t*)buf + out);
+        de->d_ino    = ino;
+        de->d_off    = (int64_t)(idx + 1);
+        de->d_reclen = (uint16_t)reclen;
+        de->d_type   = type;
+        memcpy(de->d_name, name, nlen + 1);
+        out += reclen;
+
+        if (idx++ >= 2) c = c->next;
+    }
+    dirf->f_pos = idx;
+    return (ssize_t)out;
+}
+
+static const inode_ops_t TMPFS_IOPS = {
+    .lookup   = tmpfs_lookup,
+    .mkdir    = tmpfs_mkdir,
+    .create   = tmpfs_create,
+    .getattr  = tmpfs_getattr,
+    .truncate = tmpfs_truncate,
+};
+
+static const file_ops_t TMPFS_FOPS_FILE = {
+    .open    = tmpfs_open,
+    .release = tmpfs_release,
+    .read    = tmpfs_read,
+    .write   = tmpfs_write,
+};
+
+static const file_ops_t TMPFS_FOPS_DIR = {
+    .open       = tmpfs_open,
+    .release    = tmpfs_release,
+    .getdents64 = tmpfs_getdents64,
+};
+
+/* ---------- superblock ---------- */
+
+static int tmpfs_statfs(struct superblock *sb, struct g_statvfs *sv) {
+    if (!sb || !sv) return -1;
+    tmpfs_fs_t *fs = (tmpfs_fs_t*)sb->fs_private;
+    memset(sv, 0, sizeof *sv);
+    sv->f_bsize   = VFS_PAGE_SIZE;
+    sv->f_frsize  = VFS_PAGE_SIZE;
+    sv->f_blocks  = (fs->bytes + VFS_PAGE_SIZE - 1) / VFS_PAGE_SIZE;
+    sv->f_files   = fs->nnodes;
+    sv->f_namemax = 255;
+    return 0;
+}
+
+static void tmpfs_kill_sb(struct superblock *sb) {
+    if (!sb) return;
+    tmpfs_fs_t *fs = (tmpfs_fs_t*)sb->fs_private;
+    vfs_iput(sb->root);
+    sb->root = NULL;
+    vfs_evict_inodes(sb);       /* inodes only borrow nodes; nothing to free per inode */
+    if (fs) {
+        node_free_data(fs->root);
+        free(fs);
+    }
+    vfs_free_sb(sb);
+}
+
+static const super_ops_t TMPFS_SOP = {
+    .statfs  = tmpfs_statfs,
+    .kill_sb = tmpfs_kill_sb,
+};
+
+static int tmpfs_mount(vblk_t *dev, const char *opts, superblock_t **out_sb) {
+    (void)dev; (void)opts;
+    if (!out_sb) return -1;
+    *out_sb = NULL;
+
+    tmpfs_fs_t *fs = (tmpfs_fs_t*)calloc(1, sizeof *fs);
+    superblock_t *sb = vfs_alloc_sb();
+    if (!fs || !sb) { free(fs); vfs_free_sb(sb); return -1; }
+    fs->own = sb->s_slab;
+    fs->next_ino = 2;           /* conventional root inode number */
+    fs->root = node_new(fs, NULL, "", VFS_S_IFDIR | 0755);
+    if (!fs->root) { free(fs); vfs_free_sb(sb); return -1; }
+
+    sb->s_op       = &TMPFS_SOP;
+    sb->block_size = VFS_PAGE_SIZE;
+    sb->fs_private = fs;
+    if (node_iget(sb, fs->root, &sb->root) != 0) {
+        free(fs); vfs_free_sb(sb);
+        return -1;
+    }
+    DBG("tmpfs: mounted sb=%p root=%p", (void*)sb, (void*)sb->root);
+    *out_sb = sb;
+    return 0;
+}
+
+const filesystem_type_t VFS_TMPFS = {
+    .name     = "tmpfs",
+    .mount    = tmpfs_mount,
+    .fs_flags = VFS_FS_NODEV,
+};